@@ -1,5 +1,6 @@
 #include "agent_loop.h"
 #include "agent/context_builder.h"
+#include "agent/turn_arena.h"
 #include "mimi_config.h"
 #include "bus/message_bus.h"
 #include "llm/llm_proxy.h"
@@ -11,6 +12,10 @@
 #include "esp_log.h"
 #include "esp_heap_caps.h"
 #include "esp_random.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
 #include "cJSON.h"
 
 static const char *TAG = "agent";
@@ -59,159 +64,422 @@ static cJSON *build_assistant_content(const llm_response_t *resp)
     return content;
 }
 
-/* Build the user message with tool_result blocks */
-static cJSON *build_tool_results(const llm_response_t *resp, char *tool_output, size_t tool_output_size)
+/* Run the requested tools. Calls run concurrently where the tools allow
+ * it; outputs is a slab of MIMI_MAX_TOOL_CALLS buffers of output_size
+ * bytes each, one per call. Returns the number of jobs filled. */
+static int run_tools(const llm_response_t *resp, tool_job_t *jobs,
+                     char *outputs, size_t output_size)
 {
-    cJSON *content = cJSON_CreateArray();
-
-    for (int i = 0; i < resp->call_count; i++) {
-        const llm_tool_call_t *call = &resp->calls[i];
-
-        /* Execute tool */
-        tool_output[0] = '\0';
-        tool_registry_execute(call->name, call->input, tool_output, tool_output_size);
+    int n = resp->call_count < MIMI_MAX_TOOL_CALLS ? resp->call_count : MIMI_MAX_TOOL_CALLS;
+    tool_job_t run[MIMI_MAX_TOOL_CALLS];
+    int run_idx[MIMI_MAX_TOOL_CALLS];
+    int n_run = 0;
+
+    for (int i = 0; i < n; i++) {
+        jobs[i].name = resp->calls[i].name;
+        jobs[i].input_json = resp->calls[i].input ? resp->calls[i].input : "{}";
+        jobs[i].output = outputs + i * output_size;
+        jobs[i].output_size = output_size;
+
+        /* Arguments that did not parse are reported back, never guessed */
+        if (resp->calls[i].input_invalid) {
+            snprintf(jobs[i].output, output_size,
+                     "Error: input for %s was not valid JSON; call it again with a JSON object",
+                     jobs[i].name);
+            jobs[i].err = ESP_ERR_INVALID_ARG;
+            continue;
+        }
+        run[n_run] = jobs[i];
+        run_idx[n_run++] = i;
+    }
+    if (n_run > 0) tool_registry_execute_batch(run, n_run);
+    for (int k = 0; k < n_run; k++) jobs[run_idx[k]].err = run[k].err;
+    return n;
+}
 
-        ESP_LOGI(TAG, "Tool %s result: %d bytes", call->name, (int)strlen(tool_output));
+/* Build the user message content with tool_result blocks */
+static cJSON *build_tool_results(const llm_response_t *resp, const tool_job_t *jobs, int n)
+{
+    cJSON *content = cJSON_CreateArray();
+    for (int i = 0; i < n; i++) {
+        ESP_LOGI(TAG, "Tool %s result: %d bytes", jobs[i].name, (int)strlen(jobs[i].output));
 
         /* Build tool_result block */
         cJSON *result_block = cJSON_CreateObject();
         cJSON_AddStringToObject(result_block, "type", "tool_result");
-        cJSON_AddStringToObject(result_block, "tool_use_id", call->id);
-        cJSON_AddStringToObject(result_block, "content", tool_output);
+        cJSON_AddStringToObject(result_block, "tool_use_id", resp->calls[i].id);
+        cJSON_AddStringToObject(result_block, "content", jobs[i].output);
         cJSON_AddItemToArray(content, result_block);
     }
 
     return content;
 }
 
-static void agent_loop_task(void *arg)
-{
-    ESP_LOGI(TAG, "Agent loop started on core %d", xPortGetCoreID());
+/* ── Turn profiling ───────────────────────────────────────────── */
 
-    /* Allocate large buffers from PSRAM */
-    char *system_prompt = heap_caps_calloc(1, MIMI_CONTEXT_BUF_SIZE, MALLOC_CAP_SPIRAM);
-    char *history_json = heap_caps_calloc(1, MIMI_LLM_STREAM_BUF_SIZE, MALLOC_CAP_SPIRAM);
-    char *tool_output = heap_caps_calloc(1, TOOL_OUTPUT_SIZE, MALLOC_CAP_SPIRAM);
+static agent_stats_t s_stats;
+static portMUX_TYPE s_stats_mux = portMUX_INITIALIZER_UNLOCKED;
 
-    if (!system_prompt || !history_json || !tool_output) {
-        ESP_LOGE(TAG, "Failed to allocate PSRAM buffers");
-        vTaskDelete(NULL);
-        return;
-    }
+static const char *s_stage_names[AGENT_STAGE_COUNT] = {
+    "prompt", "history", "first_token", "llm", "tools", "save", "turn",
+};
 
-    const char *tools_json = tool_registry_get_tools_json();
+static void stage_add(agent_stage_t stage, int64_t start_us)
+{
+    uint32_t us = (uint32_t)(esp_timer_get_time() - start_us);
+    portENTER_CRITICAL(&s_stats_mux);
+    agent_stage_stats_t *st = &s_stats.stage[stage];
+    st->count++;
+    st->total_us += us;
+    if (us > st->max_us) st->max_us = us;
+    portEXIT_CRITICAL(&s_stats_mux);
+}
 
-    while (1) {
-        mimi_msg_t msg;
-        esp_err_t err = message_bus_pop_inbound(&msg, UINT32_MAX);
-        if (err != ESP_OK) continue;
+/* ── Partial reply streaming ──────────────────────────────────── */
 
-        ESP_LOGI(TAG, "Processing message from %s:%s", msg.channel, msg.chat_id);
+/* Coalesces LLM text deltas into DELTA messages on the outbound bus so
+ * channels see progress without one queue entry per token. */
+typedef struct {
+    const mimi_msg_t *src;
+    char buf[MIMI_STREAM_FLUSH_BYTES + 1];
+    size_t len;
+    int64_t last_flush_us;
+    int64_t call_start_us;      /* current LLM call; 0 once its first delta arrived */
+} delta_stream_t;
 
-        /* 1. Build system prompt */
-        context_build_system_prompt(system_prompt, MIMI_CONTEXT_BUF_SIZE);
+static void delta_flush(delta_stream_t *ds)
+{
+    if (ds->len == 0) return;
+
+    mimi_msg_t out = {0};
+    strncpy(out.channel, ds->src->channel, sizeof(out.channel) - 1);
+    strncpy(out.chat_id, ds->src->chat_id, sizeof(out.chat_id) - 1);
+    out.kind = MIMI_MSG_DELTA;
+    out.content = malloc(ds->len + 1);
+    if (out.content) {
+        memcpy(out.content, ds->buf, ds->len);
+        out.content[ds->len] = '\0';
+        if (message_bus_push_outbound(&out) != ESP_OK) {
+            free(out.content);
+        }
+    }
+    ds->len = 0;
+    ds->last_flush_us = esp_timer_get_time();
+}
 
-        /* 2. Load session history into cJSON array */
-        session_get_history_json(msg.chat_id, history_json,
-                                 MIMI_LLM_STREAM_BUF_SIZE, MIMI_AGENT_MAX_HISTORY);
+static void on_text_delta(const char *text, size_t len, void *ctx)
+{
+    delta_stream_t *ds = (delta_stream_t *)ctx;
+    if (ds->call_start_us) {
+        stage_add(AGENT_STAGE_FIRST_TOKEN, ds->call_start_us);
+        ds->call_start_us = 0;
+    }
+    while (len > 0) {
+        size_t room = MIMI_STREAM_FLUSH_BYTES - ds->len;
+        size_t n = len < room ? len : room;
+        memcpy(ds->buf + ds->len, text, n);
+        ds->len += n;
+        text += n;
+        len -= n;
+        if (ds->len >= MIMI_STREAM_FLUSH_BYTES) delta_flush(ds);
+    }
+    if (esp_timer_get_time() - ds->last_flush_us >= MIMI_STREAM_FLUSH_MS * 1000LL) {
+        delta_flush(ds);
+    }
+}
 
-        cJSON *messages = cJSON_Parse(history_json);
-        if (!messages) messages = cJSON_CreateArray();
+/* ── Worker pool ──────────────────────────────────────────────── */
 
-        /* 3. Append current user message */
-        cJSON *user_msg = cJSON_CreateObject();
-        cJSON_AddStringToObject(user_msg, "role", "user");
-        cJSON_AddStringToObject(user_msg, "content", msg.content);
-        cJSON_AddItemToArray(messages, user_msg);
+/* Per-worker turn state. Buffers are sized once at start-up so the pool's
+ * PSRAM footprint is fixed: see worker_psram_bytes(). */
+typedef struct {
+    int id;
+    QueueHandle_t queue;        /* the one message handed over by the dispatcher */
+    char *system_prompt;
+    char *tool_output;          /* MIMI_MAX_TOOL_CALLS x TOOL_OUTPUT_SIZE slab */
+    llm_body_t body;            /* request body, reused across turns */
+    turn_arena_t *arena;        /* turn-local cJSON trees; heap if NULL */
+} agent_worker_t;
 
-        /* 4. ReAct loop */
-        char *final_text = NULL;
-        int iteration = 0;
+static agent_worker_t s_workers[MIMI_AGENT_WORKERS];
+static int s_worker_count = 0;
+static QueueHandle_t s_idle_queue = NULL;   /* agent_worker_t * ready for a message */
 
-        while (iteration < MIMI_AGENT_MAX_TOOL_ITER) {
-            llm_response_t resp;
-            err = llm_chat_tools(system_prompt, messages, tools_json, &resp);
+static size_t worker_psram_bytes(void)
+{
+    return MIMI_CONTEXT_BUF_SIZE
+         + (size_t)MIMI_MAX_TOOL_CALLS * TOOL_OUTPUT_SIZE
+         + MIMI_AGENT_ARENA_SIZE
+         + MIMI_LLM_BODY_INIT_SIZE
+         + MIMI_LLM_SSE_LINE_MAX;
+}
 
-            if (err != ESP_OK) {
-                ESP_LOGE(TAG, "LLM call failed: %s", esp_err_to_name(err));
-                break;
-            }
+static void process_message(agent_worker_t *w, mimi_msg_t *msg)
+{
+    ESP_LOGI(TAG, "Processing message from %s:%s", msg->channel, msg->chat_id);
+
+    int64_t turn_start = esp_timer_get_time();
+
+    /* 1. Build system prompt */
+    context_build_system_prompt(w->system_prompt, MIMI_CONTEXT_BUF_SIZE);
+    stage_add(AGENT_STAGE_PROMPT, turn_start);
+
+    /* 2. Load session history (PSRAM cache, flash on miss) */
+    int64_t t0 = esp_timer_get_time();
+    turn_arena_bind(w->arena);
+    cJSON *messages = session_get_history(msg->chat_id, MIMI_AGENT_MAX_HISTORY);
+    if (!messages) messages = cJSON_CreateArray();
+
+    /* 3. Append current user message */
+    cJSON *user_msg = cJSON_CreateObject();
+    cJSON_AddStringToObject(user_msg, "role", "user");
+    cJSON_AddStringToObject(user_msg, "content", msg->content);
+    cJSON_AddItemToArray(messages, user_msg);
+    turn_arena_unbind(w->arena);
+    stage_add(AGENT_STAGE_HISTORY, t0);
+
+    /* 4. ReAct loop (messages only grow, so each call encodes the new tail) */
+    char *final_text = NULL;
+    int iteration = 0;
+    delta_stream_t ds = { .src = msg, .last_flush_us = esp_timer_get_time() };
+
+    esp_err_t err = llm_request_begin(&w->body, w->system_prompt, tool_registry_get_tools_json());
+    while (err == ESP_OK && iteration < MIMI_AGENT_MAX_TOOL_ITER) {
+        llm_response_t resp;
+        t0 = esp_timer_get_time();
+        ds.call_start_us = t0;
+        err = llm_chat_request(&w->body, messages, &resp, on_text_delta, &ds);
+        delta_flush(&ds);
+        stage_add(AGENT_STAGE_LLM, t0);
+
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "LLM call failed: %s", esp_err_to_name(err));
+            break;
+        }
 
-            if (!resp.tool_use) {
-                /* Normal completion — save final text and break */
-                if (resp.text && resp.text_len > 0) {
-                    final_text = strdup(resp.text);
-                }
-                llm_response_free(&resp);
-                break;
+        if (!resp.tool_use) {
+            /* Normal completion — save final text and break */
+            if (resp.text && resp.text_len > 0) {
+                final_text = strdup(resp.text);
             }
+            llm_response_free(&resp);
+            break;
+        }
 
-            ESP_LOGI(TAG, "Tool use iteration %d: %d calls", iteration + 1, resp.call_count);
-
-            /* Append assistant message with content array */
-            cJSON *asst_msg = cJSON_CreateObject();
-            cJSON_AddStringToObject(asst_msg, "role", "assistant");
-            cJSON_AddItemToObject(asst_msg, "content", build_assistant_content(&resp));
-            cJSON_AddItemToArray(messages, asst_msg);
-
-            /* Execute tools and append results */
-            cJSON *tool_results = build_tool_results(&resp, tool_output, TOOL_OUTPUT_SIZE);
-            cJSON *result_msg = cJSON_CreateObject();
-            cJSON_AddStringToObject(result_msg, "role", "user");
-            cJSON_AddItemToObject(result_msg, "content", tool_results);
-            cJSON_AddItemToArray(messages, result_msg);
+        ESP_LOGI(TAG, "Tool use iteration %d: %d calls", iteration + 1, resp.call_count);
+
+        /* Execute tools (unbound: tool code keeps its own allocations) */
+        tool_job_t jobs[MIMI_MAX_TOOL_CALLS] = {0};
+        t0 = esp_timer_get_time();
+        int n = run_tools(&resp, jobs, w->tool_output, TOOL_OUTPUT_SIZE);
+        stage_add(AGENT_STAGE_TOOLS, t0);
+
+        /* Append assistant message with content array, then results */
+        turn_arena_bind(w->arena);
+        cJSON *asst_msg = cJSON_CreateObject();
+        cJSON_AddStringToObject(asst_msg, "role", "assistant");
+        cJSON_AddItemToObject(asst_msg, "content", build_assistant_content(&resp));
+        cJSON_AddItemToArray(messages, asst_msg);
+
+        cJSON *result_msg = cJSON_CreateObject();
+        cJSON_AddStringToObject(result_msg, "role", "user");
+        cJSON_AddItemToObject(result_msg, "content", build_tool_results(&resp, jobs, n));
+        cJSON_AddItemToArray(messages, result_msg);
+        turn_arena_unbind(w->arena);
+
+        llm_response_free(&resp);
+        iteration++;
+    }
 
-            llm_response_free(&resp);
-            iteration++;
+    cJSON_Delete(messages);     /* heap nodes only; the arena goes at once */
+    turn_arena_reset(w->arena);
+
+    /* 5. Send response */
+    if (final_text && final_text[0]) {
+        /* Save to session (only user text + final assistant text) */
+        t0 = esp_timer_get_time();
+        session_append(msg->chat_id, "user", msg->content);
+        session_append(msg->chat_id, "assistant", final_text);
+        stage_add(AGENT_STAGE_SAVE, t0);
+
+        /* Push response to outbound */
+        mimi_msg_t out = {0};
+        strncpy(out.channel, msg->channel, sizeof(out.channel) - 1);
+        strncpy(out.chat_id, msg->chat_id, sizeof(out.chat_id) - 1);
+        out.content = final_text;  /* transfer ownership */
+        if (message_bus_push_outbound(&out) != ESP_OK) free(out.content);
+    } else {
+        /* Error or empty response */
+        free(final_text);
+        mimi_msg_t out = {0};
+        strncpy(out.channel, msg->channel, sizeof(out.channel) - 1);
+        strncpy(out.chat_id, msg->chat_id, sizeof(out.chat_id) - 1);
+        out.content = strdup("Sorry, I encountered an error.");
+        if (out.content && message_bus_push_outbound(&out) != ESP_OK) {
+            free(out.content);
         }
+        portENTER_CRITICAL(&s_stats_mux);
+        s_stats.failed++;
+        portEXIT_CRITICAL(&s_stats_mux);
+    }
+    stage_add(AGENT_STAGE_TURN, turn_start);
+}
 
-        cJSON_Delete(messages);
+static void agent_worker_task(void *arg)
+{
+    agent_worker_t *w = (agent_worker_t *)arg;
+    ESP_LOGI(TAG, "Agent worker %d started on core %d", w->id, xPortGetCoreID());
 
-        /* 5. Send response */
-        if (final_text && final_text[0]) {
-            /* Save to session (only user text + final assistant text) */
-            session_append(msg.chat_id, "user", msg.content);
-            session_append(msg.chat_id, "assistant", final_text);
+    while (1) {
+        mimi_msg_t msg;
+        if (xQueueReceive(w->queue, &msg, portMAX_DELAY) != pdTRUE) continue;
 
-            /* Push response to outbound */
-            mimi_msg_t out = {0};
-            strncpy(out.channel, msg.channel, sizeof(out.channel) - 1);
-            strncpy(out.chat_id, msg.chat_id, sizeof(out.chat_id) - 1);
-            out.content = final_text;  /* transfer ownership */
-            message_bus_push_outbound(&out);
-        } else {
-            /* Error or empty response */
-            free(final_text);
-            mimi_msg_t out = {0};
-            strncpy(out.channel, msg.channel, sizeof(out.channel) - 1);
-            strncpy(out.chat_id, msg.chat_id, sizeof(out.chat_id) - 1);
-            out.content = strdup("Sorry, I encountered an error.");
-            if (out.content) {
-                message_bus_push_outbound(&out);
-            }
-        }
+        turn_arena_stats_t as;
+        turn_arena_get_stats(w->arena, &as);
+        uint32_t allocs_before = as.allocs;
+
+        process_message(w, &msg);
+        message_bus_inbound_done(&msg);     /* the chat's next message may go */
 
         /* Free inbound message content */
         free(msg.content);
 
         /* Log memory status */
-        ESP_LOGI(TAG, "Free PSRAM: %d bytes",
-                 (int)heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+        turn_arena_get_stats(w->arena, &as);
+        uint32_t allocs = as.allocs - allocs_before;
+        portENTER_CRITICAL(&s_stats_mux);
+        s_stats.turns++;
+        s_stats.allocs += allocs;
+        if (allocs > s_stats.allocs_max) s_stats.allocs_max = allocs;
+        portEXIT_CRITICAL(&s_stats_mux);
+        ESP_LOGI(TAG, "[%d] Free PSRAM: %d bytes, arena peak %d/%d KB (%u spills), stack free %d",
+                 w->id, (int)heap_caps_get_free_size(MALLOC_CAP_SPIRAM),
+                 (int)(as.high_water / 1024), (int)(as.size / 1024), (unsigned)as.spills,
+                 (int)uxTaskGetStackHighWaterMark(NULL));
+
+        xQueueSend(s_idle_queue, &w, portMAX_DELAY);
+    }
+}
+
+/* Hands inbound messages to idle workers. Messages stay on the bus until a
+ * worker is free, so the bus can order them by priority and coalesce bursts;
+ * the bus never releases a chat that is still being processed, which keeps
+ * each chat's turns in order while different chats run in parallel.
+ * It only moves messages between queues, so its stack lives in PSRAM; the
+ * workers write sessions to SPIFFS and keep theirs in internal RAM. */
+static void agent_dispatch_task(void *arg)
+{
+    ESP_LOGI(TAG, "Agent dispatcher started with %d workers", s_worker_count);
+
+    while (1) {
+        agent_worker_t *w;
+        if (xQueueReceive(s_idle_queue, &w, portMAX_DELAY) != pdTRUE) continue;
+
+        mimi_msg_t msg;
+        while (message_bus_pop_inbound(&msg, UINT32_MAX) != ESP_OK) {}
+
+        ESP_LOGD(TAG, "%s:%s -> worker %d", msg.channel, msg.chat_id, w->id);
+        xQueueSend(w->queue, &msg, portMAX_DELAY);
+    }
+}
+
+static esp_err_t worker_alloc(agent_worker_t *w, int id)
+{
+    w->id = id;
+    w->queue = xQueueCreate(1, sizeof(mimi_msg_t));
+    w->system_prompt = heap_caps_calloc(1, MIMI_CONTEXT_BUF_SIZE, MALLOC_CAP_SPIRAM);
+    w->tool_output = heap_caps_calloc(MIMI_MAX_TOOL_CALLS, TOOL_OUTPUT_SIZE, MALLOC_CAP_SPIRAM);
+    llm_body_init(&w->body);
+    /* Arenas are never freed, so take one only once the rest is in place.
+     * Without it every turn would build its cJSON trees on the heap: don't
+     * start the worker at all. */
+    if (w->queue && w->system_prompt && w->tool_output) {
+        w->arena = turn_arena_create(MIMI_AGENT_ARENA_SIZE);
+    }
+    if (!w->arena) {
+        if (w->queue) vQueueDelete(w->queue);
+        free(w->system_prompt);
+        free(w->tool_output);
+        memset(w, 0, sizeof(*w));
+        return ESP_ERR_NO_MEM;
     }
+    return ESP_OK;
 }
 
 esp_err_t agent_loop_init(void)
 {
+    esp_err_t err = context_builder_init();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Prompt cache alloc failed");
+        return err;
+    }
     ESP_LOGI(TAG, "Agent loop initialized");
     return ESP_OK;
 }
 
 esp_err_t agent_loop_start(void)
 {
-    BaseType_t ret = xTaskCreatePinnedToCore(
-        agent_loop_task, "agent_loop",
-        MIMI_AGENT_STACK, NULL,
-        MIMI_AGENT_PRIO, NULL, MIMI_AGENT_CORE);
+    /* Fit the pool into the PSRAM budget */
+    int want = MIMI_AGENT_WORKERS;
+    int fit = (int)(MIMI_AGENT_PSRAM_BUDGET / worker_psram_bytes());
+    if (fit < 1) fit = 1;
+    if (want > fit) {
+        ESP_LOGW(TAG, "PSRAM budget allows %d of %d agent workers", fit, want);
+        want = fit;
+    }
 
+    s_idle_queue = xQueueCreate(MIMI_AGENT_WORKERS, sizeof(agent_worker_t *));
+    if (!s_idle_queue) return ESP_ERR_NO_MEM;
+
+    for (int i = 0; i < want; i++) {
+        agent_worker_t *w = &s_workers[s_worker_count];
+        if (worker_alloc(w, s_worker_count) != ESP_OK) {
+            ESP_LOGW(TAG, "Agent worker %d: PSRAM buffers unavailable", i);
+            break;
+        }
+        char name[16];
+        snprintf(name, sizeof(name), "agent_%d", s_worker_count);
+        if (xTaskCreatePinnedToCore(agent_worker_task, name,
+                                    MIMI_AGENT_STACK, w,
+                                    MIMI_AGENT_PRIO, NULL, MIMI_AGENT_CORE) != pdPASS) {
+            ESP_LOGW(TAG, "Agent worker %d not started", i);
+            break;
+        }
+        xQueueSend(s_idle_queue, &w, 0);
+        s_worker_count++;
+    }
+    if (s_worker_count == 0) {
+        ESP_LOGE(TAG, "No agent worker could be started");
+        return ESP_FAIL;
+    }
+
+    BaseType_t ret = xTaskCreatePinnedToCoreWithCaps(
+        agent_dispatch_task, "agent_loop",
+        MIMI_AGENT_DISPATCH_STACK, NULL,
+        MIMI_AGENT_PRIO, NULL, MIMI_AGENT_CORE, MALLOC_CAP_SPIRAM);
+
+    ESP_LOGI(TAG, "Agent pool: %d workers, ~%d KB PSRAM each",
+             s_worker_count, (int)(worker_psram_bytes() / 1024));
     return (ret == pdPASS) ? ESP_OK : ESP_FAIL;
 }
+
+void agent_loop_get_stats(agent_stats_t *out)
+{
+    portENTER_CRITICAL(&s_stats_mux);
+    *out = s_stats;
+    portEXIT_CRITICAL(&s_stats_mux);
+
+    for (int i = 0; i < s_worker_count; i++) {
+        turn_arena_stats_t as;
+        turn_arena_get_stats(s_workers[i].arena, &as);
+        out->spills += as.spills;
+        if (as.high_water > out->arena_peak) out->arena_peak = as.high_water;
+    }
+    out->psram_min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM);
+    out->internal_min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+}
+
+const char *agent_loop_stage_name(agent_stage_t stage)
+{
+    return stage < AGENT_STAGE_COUNT ? s_stage_names[stage] : "?";
+}
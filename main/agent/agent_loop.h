@@ -1,6 +1,8 @@
 #pragma once
 
 #include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
 
 /**
  * Initialize the agent loop.
@@ -8,7 +10,42 @@
 esp_err_t agent_loop_init(void);
 
 /**
- * Start the agent loop task (runs on Core 1).
+ * Start the agent dispatcher and worker pool (Core 1).
  * Consumes from inbound queue, calls Claude API, pushes to outbound queue.
+ * Messages of one chat are processed in order; different chats in parallel.
  */
 esp_err_t agent_loop_start(void);
+
+/* Stages of a turn timed by the workers */
+typedef enum {
+    AGENT_STAGE_PROMPT = 0,     /* system prompt build */
+    AGENT_STAGE_HISTORY,        /* session load + user message */
+    AGENT_STAGE_FIRST_TOKEN,    /* LLM request start to first text delta */
+    AGENT_STAGE_LLM,            /* one LLM call, complete */
+    AGENT_STAGE_TOOLS,          /* one batch of tool calls */
+    AGENT_STAGE_SAVE,           /* session append */
+    AGENT_STAGE_TURN,           /* whole turn */
+    AGENT_STAGE_COUNT,
+} agent_stage_t;
+
+typedef struct {
+    uint32_t count;
+    uint64_t total_us;
+    uint32_t max_us;
+} agent_stage_stats_t;
+
+typedef struct {
+    agent_stage_stats_t stage[AGENT_STAGE_COUNT];
+    uint32_t turns;
+    uint32_t failed;            /* turns answered with the error reply */
+    uint32_t allocs_max;        /* arena allocations of the busiest turn */
+    uint64_t allocs;            /* arena allocations, all turns */
+    uint32_t spills;            /* allocations the arenas could not hold */
+    size_t arena_peak;          /* largest arena use of any turn */
+    size_t psram_min_free;      /* heap low-water marks since boot */
+    size_t internal_min_free;
+} agent_stats_t;
+
+void agent_loop_get_stats(agent_stats_t *out);
+
+const char *agent_loop_stage_name(agent_stage_t stage);
@@ -3,9 +3,15 @@
 #include "memory/memory_store.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <stdbool.h>
+#include <time.h>
 #include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "cJSON.h"
 
 static const char *TAG = "context";
@@ -61,63 +67,185 @@ static size_t append_file(char *buf, size_t size, size_t offset, const char *pat
     return off;
 }
 
-esp_err_t context_build_system_prompt(char *buf, size_t size)
+/* ── Prompt segment cache ─────────────────────────────────────── */
+
+/* The prompt is the static preamble plus three file-backed segments. Each
+ * segment remembers the memory_store generation (and, for daily notes, the
+ * day) it was read at, and only stale segments touch SPIFFS. */
+
+static const char s_preamble[] =
+    "# MimiClaw\n\n"
+    "You are MimiClaw, a personal AI assistant running on an ESP32-S3 device.\n"
+    "You communicate through Telegram and WebSocket.\n\n"
+    "Be helpful, accurate, and concise.\n\n"
+    "## Available Tools\n"
+    "You have access to the following tools:\n"
+    "- web_search: Search the web for current information. "
+    "Use this when you need up-to-date facts, news, weather, or anything beyond your training data.\n"
+    "- web_fetch: Fetch content from a specific URL (http/https). "
+    "Use this when the user provides a direct link and wants the page content.\n"
+    "- get_current_time: Get the current date and time. "
+    "You do NOT have an internal clock — always use this tool when you need to know the time or date.\n"
+    "- read_file: Read a file from SPIFFS (path must start with /spiffs/).\n"
+    "- write_file: Write/overwrite a file on SPIFFS.\n"
+    "- edit_file: Find-and-replace edit a file on SPIFFS.\n"
+    "- list_dir: List files on SPIFFS, optionally filter by prefix.\n\n"
+    "Use tools when needed. Provide your final answer as text after using tools.\n\n"
+    "## Memory\n"
+    "You have persistent memory stored on local flash:\n"
+    "- Long-term memory: /spiffs/memory/MEMORY.md\n"
+    "- Daily notes: /spiffs/memory/daily/<YYYY-MM-DD>.md\n\n"
+    "IMPORTANT: Actively use memory to remember things across conversations.\n"
+    "- When you learn something new about the user (name, preferences, habits, context), write it to MEMORY.md.\n"
+    "- When something noteworthy happens in a conversation, append it to today's daily note.\n"
+    "- Always read_file MEMORY.md before writing, so you can edit_file to update without losing existing content.\n"
+    "- Use get_current_time to know today's date before writing daily notes.\n"
+    "- Keep MEMORY.md concise and organized — summarize, don't dump raw conversation.\n"
+    "- You should proactively save memory without being asked. If the user tells you their name, preferences, or important facts, persist them immediately.\n";
+
+typedef enum {
+    SEG_BOOTSTRAP = 0,      /* AGENTS.md + SOUL.md + USER.md */
+    SEG_LONG_TERM,          /* MEMORY.md */
+    SEG_DAILY,              /* last 3 daily notes */
+    SEG_COUNT,
+} prompt_seg_id_t;
+
+typedef struct {
+    char *text;             /* PSRAM */
+    size_t cap;
+    size_t len;
+    uint32_t gen;
+    int day;                /* SEG_DAILY only */
+    bool valid;
+} prompt_seg_t;
+
+static const memory_gen_t s_seg_gen[SEG_COUNT] = {
+    [SEG_BOOTSTRAP] = MEMORY_GEN_CONFIG,
+    [SEG_LONG_TERM] = MEMORY_GEN_LONG_TERM,
+    [SEG_DAILY]     = MEMORY_GEN_DAILY,
+};
+
+static const size_t s_seg_cap[SEG_COUNT] = {
+    [SEG_BOOTSTRAP] = MIMI_CONTEXT_BUF_SIZE,
+    [SEG_LONG_TERM] = 4096 + 64,
+    [SEG_DAILY]     = 4096 + 64,
+};
+
+static prompt_seg_t s_segs[SEG_COUNT];
+static char *s_prompt;      /* assembled prompt, PSRAM */
+static size_t s_prompt_len;
+static bool s_prompt_valid;
+static SemaphoreHandle_t s_prompt_lock;
+
+static int current_day(void)
 {
-    if (!buf || size == 0) return ESP_ERR_INVALID_ARG;
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    return tm.tm_year * 366 + tm.tm_yday;
+}
 
+static void seg_fill(prompt_seg_id_t id, char *buf, size_t size)
+{
     /* Keep large scratch buffers off task stack to avoid stack overflow corruption. */
-    static char s_mem_buf[4096];
-    static char s_recent_buf[4096];
-
+    static char s_scratch[4096];
     size_t off = 0;
     buf[0] = '\0';
 
-    off = append_fmt(buf, size, off,
-        "# MimiClaw\n\n"
-        "You are MimiClaw, a personal AI assistant running on an ESP32-S3 device.\n"
-        "You communicate through Telegram and WebSocket.\n\n"
-        "Be helpful, accurate, and concise.\n\n"
-        "## Available Tools\n"
-        "You have access to the following tools:\n"
-        "- web_search: Search the web for current information. "
-        "Use this when you need up-to-date facts, news, weather, or anything beyond your training data.\n"
-        "- web_fetch: Fetch content from a specific URL (http/https). "
-        "Use this when the user provides a direct link and wants the page content.\n"
-        "- get_current_time: Get the current date and time. "
-        "You do NOT have an internal clock — always use this tool when you need to know the time or date.\n"
-        "- read_file: Read a file from SPIFFS (path must start with /spiffs/).\n"
-        "- write_file: Write/overwrite a file on SPIFFS.\n"
-        "- edit_file: Find-and-replace edit a file on SPIFFS.\n"
-        "- list_dir: List files on SPIFFS, optionally filter by prefix.\n\n"
-        "Use tools when needed. Provide your final answer as text after using tools.\n\n"
-        "## Memory\n"
-        "You have persistent memory stored on local flash:\n"
-        "- Long-term memory: /spiffs/memory/MEMORY.md\n"
-        "- Daily notes: /spiffs/memory/daily/<YYYY-MM-DD>.md\n\n"
-        "IMPORTANT: Actively use memory to remember things across conversations.\n"
-        "- When you learn something new about the user (name, preferences, habits, context), write it to MEMORY.md.\n"
-        "- When something noteworthy happens in a conversation, append it to today's daily note.\n"
-        "- Always read_file MEMORY.md before writing, so you can edit_file to update without losing existing content.\n"
-        "- Use get_current_time to know today's date before writing daily notes.\n"
-        "- Keep MEMORY.md concise and organized — summarize, don't dump raw conversation.\n"
-        "- You should proactively save memory without being asked. If the user tells you their name, preferences, or important facts, persist them immediately.\n");
-
-    /* Bootstrap files */
-    off = append_file(buf, size, off, MIMI_AGENTS_FILE, "Agent Rules");
-    off = append_file(buf, size, off, MIMI_SOUL_FILE, "Personality");
-    off = append_file(buf, size, off, MIMI_USER_FILE, "User Info");
-
-    /* Long-term memory */
-    if (memory_read_long_term(s_mem_buf, sizeof(s_mem_buf)) == ESP_OK && s_mem_buf[0]) {
-        off = append_fmt(buf, size, off, "\n## Long-term Memory\n\n%s\n", s_mem_buf);
+    switch (id) {
+    case SEG_BOOTSTRAP:
+        off = append_file(buf, size, off, MIMI_AGENTS_FILE, "Agent Rules");
+        off = append_file(buf, size, off, MIMI_SOUL_FILE, "Personality");
+        off = append_file(buf, size, off, MIMI_USER_FILE, "User Info");
+        break;
+    case SEG_LONG_TERM:
+        if (memory_read_long_term(s_scratch, sizeof(s_scratch)) == ESP_OK && s_scratch[0]) {
+            off = append_fmt(buf, size, off, "\n## Long-term Memory\n\n%s\n", s_scratch);
+        }
+        break;
+    case SEG_DAILY:
+        if (memory_read_recent(s_scratch, sizeof(s_scratch), 3) == ESP_OK && s_scratch[0]) {
+            off = append_fmt(buf, size, off, "\n## Recent Notes\n\n%s\n", s_scratch);
+        }
+        break;
+    default:
+        break;
     }
+}
+
+/* Refresh stale segments; returns true if any changed */
+static bool segs_refresh(void)
+{
+    bool changed = false;
+    int day = current_day();
+
+    for (int i = 0; i < SEG_COUNT; i++) {
+        prompt_seg_t *seg = &s_segs[i];
+        /* Sample the generation before reading so a concurrent write is
+         * picked up on the next turn rather than lost. */
+        uint32_t gen = memory_generation(s_seg_gen[i]);
+        if (seg->valid && seg->gen == gen && (i != SEG_DAILY || seg->day == day)) continue;
+
+        if (!seg->text) {
+            seg->text = heap_caps_calloc(1, s_seg_cap[i], MALLOC_CAP_SPIRAM);
+            if (!seg->text) continue;
+            seg->cap = s_seg_cap[i];
+        }
+        seg_fill(i, seg->text, seg->cap);
+        seg->len = strlen(seg->text);
+        seg->gen = gen;
+        seg->day = day;
+        seg->valid = true;
+        changed = true;
+    }
+    return changed;
+}
+
+static void prompt_assemble(void)
+{
+    size_t off = 0;
+    size_t room = MIMI_CONTEXT_BUF_SIZE - 1;
+    size_t n = sizeof(s_preamble) - 1;
+    if (n > room) n = room;
+    memcpy(s_prompt, s_preamble, n);
+    off = n;
+
+    for (int i = 0; i < SEG_COUNT && off < room; i++) {
+        if (!s_segs[i].valid) continue;
+        n = s_segs[i].len;
+        if (n > room - off) n = room - off;
+        memcpy(s_prompt + off, s_segs[i].text, n);
+        off += n;
+    }
+    s_prompt[off] = '\0';
+    s_prompt_len = off;
+    s_prompt_valid = true;
+}
+
+esp_err_t context_builder_init(void)
+{
+    s_prompt_lock = xSemaphoreCreateMutex();
+    s_prompt = heap_caps_calloc(1, MIMI_CONTEXT_BUF_SIZE, MALLOC_CAP_SPIRAM);
+    if (!s_prompt_lock || !s_prompt) return ESP_ERR_NO_MEM;
+    return ESP_OK;
+}
+
+esp_err_t context_build_system_prompt(char *buf, size_t size)
+{
+    if (!buf || size == 0) return ESP_ERR_INVALID_ARG;
+    if (!s_prompt_lock || !s_prompt) return ESP_ERR_INVALID_STATE;
 
-    /* Recent daily notes (last 3 days) */
-    if (memory_read_recent(s_recent_buf, sizeof(s_recent_buf), 3) == ESP_OK && s_recent_buf[0]) {
-        off = append_fmt(buf, size, off, "\n## Recent Notes\n\n%s\n", s_recent_buf);
+    xSemaphoreTake(s_prompt_lock, portMAX_DELAY);
+    if (segs_refresh() || !s_prompt_valid) {
+        prompt_assemble();
+        ESP_LOGI(TAG, "System prompt built: %d bytes", (int)s_prompt_len);
     }
 
-    ESP_LOGI(TAG, "System prompt built: %d bytes", (int)off);
+    /* Unchanged turns cost one copy */
+    size_t n = s_prompt_len < size - 1 ? s_prompt_len : size - 1;
+    memcpy(buf, s_prompt, n);
+    buf[n] = '\0';
+    xSemaphoreGive(s_prompt_lock);
     return ESP_OK;
 }
 
@@ -3,9 +3,16 @@
 #include "esp_err.h"
 #include <stddef.h>
 
+/**
+ * Allocate the system-prompt cache. Call once before building prompts.
+ */
+esp_err_t context_builder_init(void);
+
 /**
  * Build the system prompt from bootstrap files (AGENTS.md, SOUL.md, USER.md)
  * and memory context (MEMORY.md + recent daily notes).
+ * Sections are cached and re-read only when memory_store reports a write
+ * to their files or the day changes.
  *
  * @param buf   Output buffer (caller allocates, recommend MIMI_CONTEXT_BUF_SIZE)
  * @param size  Buffer size
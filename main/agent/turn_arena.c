@@ -0,0 +1,127 @@
+#include "turn_arena.h"
+#include "mimi_config.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "cJSON.h"
+
+static const char *TAG = "arena";
+
+#define ARENA_ALIGN  8
+
+struct turn_arena {
+    char *base;
+    size_t size;
+    size_t used;
+    size_t high_water;
+    uint32_t allocs;
+    uint32_t spills;
+    TaskHandle_t owner;         /* task whose cJSON allocations land here, or NULL */
+};
+
+/* Fixed table so the hooks can scan without locking: entries are only
+ * appended, and base/size never change once published. */
+static turn_arena_t s_arenas[MIMI_AGENT_ARENA_MAX];
+static volatile int s_arena_count = 0;
+static portMUX_TYPE s_arena_mux = portMUX_INITIALIZER_UNLOCKED;
+
+/* ── cJSON hooks ──────────────────────────────────────────────── */
+
+static void *arena_malloc(size_t size)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    for (int i = 0; i < s_arena_count; i++) {
+        turn_arena_t *a = &s_arenas[i];
+        if (a->owner != self) continue;
+
+        size_t need = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+        if (need > a->size - a->used) {
+            a->spills++;
+            break;
+        }
+        void *p = a->base + a->used;
+        a->used += need;
+        a->allocs++;
+        if (a->used > a->high_water) a->high_water = a->used;
+        return p;
+    }
+    return malloc(size);
+}
+
+static void arena_free(void *ptr)
+{
+    for (int i = 0; i < s_arena_count; i++) {
+        const turn_arena_t *a = &s_arenas[i];
+        if ((char *)ptr >= a->base && (char *)ptr < a->base + a->size) return;
+    }
+    free(ptr);
+}
+
+/* ── Public API ───────────────────────────────────────────────── */
+
+turn_arena_t *turn_arena_create(size_t size)
+{
+    char *base = heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+    if (!base) {
+        ESP_LOGE(TAG, "Failed to allocate %d byte arena", (int)size);
+        return NULL;
+    }
+
+    turn_arena_t *a = NULL;
+    bool first = false;
+    portENTER_CRITICAL(&s_arena_mux);
+    if (s_arena_count < MIMI_AGENT_ARENA_MAX) {
+        a = &s_arenas[s_arena_count];
+        a->base = base;
+        a->size = size;
+        first = (s_arena_count == 0);
+        s_arena_count++;
+    }
+    portEXIT_CRITICAL(&s_arena_mux);
+
+    if (!a) {
+        ESP_LOGE(TAG, "Arena table full (%d)", MIMI_AGENT_ARENA_MAX);
+        free(base);
+        return NULL;
+    }
+
+    if (first) {
+        cJSON_Hooks hooks = { .malloc_fn = arena_malloc, .free_fn = arena_free };
+        cJSON_InitHooks(&hooks);
+    }
+    ESP_LOGI(TAG, "Turn arena %d: %d KB PSRAM", s_arena_count - 1, (int)(size / 1024));
+    return a;
+}
+
+void turn_arena_bind(turn_arena_t *a)
+{
+    if (a) a->owner = xTaskGetCurrentTaskHandle();
+}
+
+void turn_arena_unbind(turn_arena_t *a)
+{
+    if (a) a->owner = NULL;
+}
+
+void turn_arena_reset(turn_arena_t *a)
+{
+    if (!a) return;
+    a->owner = NULL;
+    a->used = 0;
+}
+
+void turn_arena_get_stats(const turn_arena_t *a, turn_arena_stats_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (!a) return;
+    out->size = a->size;
+    out->used = a->used;
+    out->high_water = a->high_water;
+    out->allocs = a->allocs;
+    out->spills = a->spills;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * PSRAM bump arena for the cJSON trees of one agent turn.
+ *
+ * cJSON allocations are routed through global hooks: while an arena is
+ * bound to the calling task they are carved from it, otherwise (other
+ * tasks, or unbound stretches such as SSE parsing and tool execution)
+ * they fall through to the heap. Freeing an arena pointer is a no-op;
+ * turn_arena_reset() reclaims the whole turn at once.
+ *
+ * Strings returned by cJSON_Print*() while bound must be released with
+ * cJSON_free(), never free().
+ */
+
+typedef struct turn_arena turn_arena_t;
+
+typedef struct {
+    size_t size;
+    size_t used;
+    size_t high_water;          /* peak use of any turn since boot */
+    uint32_t allocs;            /* allocations served by the arena since boot */
+    uint32_t spills;            /* allocations that did not fit, served by heap */
+} turn_arena_stats_t;
+
+/**
+ * Allocate an arena of size bytes in PSRAM. Installs the cJSON hooks on
+ * first use.
+ */
+turn_arena_t *turn_arena_create(size_t size);
+
+/** Route cJSON allocations of the calling task to the arena. */
+void turn_arena_bind(turn_arena_t *a);
+
+/** Stop routing; allocations already made stay valid until reset. */
+void turn_arena_unbind(turn_arena_t *a);
+
+/** Drop everything allocated since the last reset. O(1). */
+void turn_arena_reset(turn_arena_t *a);
+
+void turn_arena_get_stats(const turn_arena_t *a, turn_arena_stats_t *out);
@@ -11,6 +11,7 @@
 
 #include "driver/i2s.h"
 #include "driver/spi_master.h"
+#include "esp_heap_caps.h"
 #include "esp_log.h"
 #include "esp_timer.h"
 #include "esp_vfs_fat.h"
@@ -19,6 +20,7 @@
 #include "freertos/task.h"
 #include "driver/sdspi_host.h"
 #include "sdmmc_cmd.h"
+#include "audio/pcm_ring.h"
 
 static const char *TAG = "audio_service";
 
@@ -45,6 +47,16 @@ static const char *TAG = "audio_service";
 
 #define AUDIO_IO_CHUNK_BYTES     1024
 
+/* Recording is split in two tasks: capture reads I2S into a PSRAM ring and
+ * never touches the card, the writer drains it to FAT in whole blocks. The
+ * ring covers SD write stalls of up to RING / (rate * 8) seconds (2 s). */
+#define AUDIO_REC_RING_BYTES     (256 * 1024)
+#define AUDIO_REC_BLOCK_BYTES    (16 * 1024)    /* multiple of the 512 B sector */
+#define AUDIO_REC_CAPTURE_PRIO   6
+#define AUDIO_REC_WRITER_PRIO    3
+
+#define WAV_HEADER_BYTES         44
+
 typedef struct {
     uint32_t sample_rate;
     uint16_t bits_per_sample;
@@ -59,12 +71,18 @@ static bool s_i2s_inited = false;
 static sdmmc_card_t *s_card = NULL;
 
 static bool s_recording = false;
-static bool s_record_stop = false;
+static atomic_bool s_record_stop;
+static atomic_bool s_capture_done;
 static TaskHandle_t s_record_task = NULL;
+static TaskHandle_t s_writer_task = NULL;
 static FILE *s_record_fp = NULL;
-static size_t s_record_data_bytes = 0;
 static char s_record_path[128];
 
+static pcm_ring_t s_rec_ring;
+static uint8_t *s_rec_ring_buf = NULL;
+static audio_record_stats_t s_rec_stats;       /* writer-side fields */
+static portMUX_TYPE s_rec_stats_mux = portMUX_INITIALIZER_UNLOCKED;
+
 static bool s_playing = false;
 static bool s_play_stop = false;
 static TaskHandle_t s_play_task = NULL;
@@ -188,7 +206,7 @@ static void wav_write_header(FILE *fp,
                              uint16_t channels,
                              uint32_t data_size)
 {
-    uint8_t h[44] = {0};
+    uint8_t h[WAV_HEADER_BYTES] = {0};
     uint32_t byte_rate = sample_rate * channels * (bits_per_sample / 8);
     uint16_t block_align = (uint16_t)(channels * (bits_per_sample / 8));
     long cur = ftell(fp);
@@ -365,6 +383,7 @@ static esp_err_t i2s_init_if_needed(void)
     return ESP_OK;
 }
 
+/* Producer: I2S → mono mix → ring. Never blocks on the SD card. */
 static void record_task(void *arg)
 {
     (void)arg;
@@ -373,25 +392,9 @@ static void record_task(void *arg)
     int32_t peak_r = 0;
     uint64_t last_log_samples = 0;
 
-    lock_take();
-    FILE *fp = s_record_fp;
-    lock_give();
-    if (!fp) {
-        vTaskDelete(NULL);
-        return;
-    }
-
-    wav_write_header(fp, AUDIO_REC_SAMPLE_RATE, AUDIO_REC_BITS, AUDIO_REC_CHANNELS, 0);
     i2s_zero_dma_buffer(AUDIO_I2S_PORT);
 
-    while (1) {
-        lock_take();
-        bool stop = s_record_stop;
-        lock_give();
-        if (stop) {
-            break;
-        }
-
+    while (!atomic_load(&s_record_stop)) {
         size_t bytes_read = 0;
         esp_err_t ret = i2s_read(AUDIO_I2S_PORT, buf, sizeof(buf), &bytes_read, pdMS_TO_TICKS(200));
         if (ret != ESP_OK || bytes_read == 0) {
@@ -427,28 +430,101 @@ static void record_task(void *arg)
             last_log_samples = s_rec_samples_total;
         }
 
-        size_t wrote = fwrite(buf, 1, bytes_read, fp);
-        if (wrote != bytes_read) {
-            ESP_LOGE(TAG, "record write failed");
+        /* A full ring drops the chunk and counts an overrun */
+        pcm_ring_write(&s_rec_ring, buf, frames * sizeof(int32_t) * 2);
+        if (pcm_ring_used(&s_rec_ring) >= AUDIO_REC_BLOCK_BYTES) {
+            xTaskNotifyGive(s_writer_task);
+        }
+    }
+
+    atomic_store(&s_capture_done, true);
+    xTaskNotifyGive(s_writer_task);
+    vTaskDelete(NULL);
+}
+
+/* Consumer: ring → file in AUDIO_REC_BLOCK_BYTES writes, aligned to the file
+ * offset so FAT can write whole sectors straight from the ring. Owns the
+ * file and finishes the recording once capture has stopped. */
+static void record_writer_task(void *arg)
+{
+    (void)arg;
+
+    lock_take();
+    FILE *fp = s_record_fp;
+    lock_give();
+
+    /* Blocks are already large; stdio buffering would only add a copy */
+    setvbuf(fp, NULL, _IONBF, 0);
+    wav_write_header(fp, AUDIO_REC_SAMPLE_RATE, AUDIO_REC_BITS, AUDIO_REC_CHANNELS, 0);
+    fseek(fp, WAV_HEADER_BYTES, SEEK_SET);
+
+    size_t file_pos = WAV_HEADER_BYTES;
+    size_t data_bytes = 0;
+    bool failed = false;
+
+    while (1) {
+        /* Read the flag first: everything captured before it is then visible */
+        bool done = atomic_load(&s_capture_done);
+        size_t used = pcm_ring_used(&s_rec_ring);
+        size_t want = AUDIO_REC_BLOCK_BYTES - (file_pos % AUDIO_REC_BLOCK_BYTES);
+
+        if (used == 0 && done) {
             break;
         }
+        if (used < want && !done) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(200));
+            continue;
+        }
+        if (want > used) {
+            want = used;
+        }
 
-        lock_take();
-        s_record_data_bytes += wrote;
-        lock_give();
+        while (want > 0) {
+            const uint8_t *p = NULL;
+            size_t n = pcm_ring_peek(&s_rec_ring, &p);
+            if (n > want) n = want;
+
+            /* After a write error keep draining so capture can finish */
+            if (!failed) {
+                int64_t t0 = esp_timer_get_time();
+                size_t wrote = fwrite(p, 1, n, fp);
+                uint32_t dt = (uint32_t)(esp_timer_get_time() - t0);
+                if (wrote != n) {
+                    ESP_LOGE(TAG, "record write failed");
+                    failed = true;
+                    atomic_store(&s_record_stop, true);
+                } else {
+                    file_pos += n;
+                    data_bytes += n;
+                }
+                portENTER_CRITICAL(&s_rec_stats_mux);
+                s_rec_stats.writes++;
+                s_rec_stats.bytes_written = data_bytes;
+                if (dt > s_rec_stats.max_write_us) s_rec_stats.max_write_us = dt;
+                portEXIT_CRITICAL(&s_rec_stats_mux);
+            }
+            pcm_ring_consume(&s_rec_ring, n);
+            want -= n;
+        }
     }
 
+    audio_record_stats_t st;
+    audio_service_get_record_stats(&st);
+
     lock_take();
     wav_write_header(fp, AUDIO_REC_SAMPLE_RATE, AUDIO_REC_BITS, AUDIO_REC_CHANNELS,
-                     (uint32_t)s_record_data_bytes);
+                     (uint32_t)data_bytes);
     fflush(fp);
     fclose(fp);
-    ESP_LOGI(TAG, "record saved: %s (%u bytes)", s_record_path, (unsigned)s_record_data_bytes);
+    ESP_LOGI(TAG, "record saved: %s (%u bytes, %u overruns, ring peak %u KB, slowest write %u ms)",
+             s_record_path, (unsigned)data_bytes, (unsigned)st.overruns,
+             (unsigned)(st.ring_high_water / 1024), (unsigned)(st.max_write_us / 1000));
+    heap_caps_free(s_rec_ring_buf);
+    s_rec_ring_buf = NULL;
     s_record_fp = NULL;
-    s_record_data_bytes = 0;
     s_recording = false;
-    s_record_stop = false;
     s_record_task = NULL;
+    s_writer_task = NULL;
     lock_give();
 
     vTaskDelete(NULL);
@@ -562,6 +638,19 @@ esp_err_t audio_service_init(void)
     return ret;
 }
 
+esp_err_t audio_service_mount_sd(void)
+{
+    if (!s_lock) {
+        s_lock = xSemaphoreCreateMutex();
+        if (!s_lock) return ESP_ERR_NO_MEM;
+    }
+
+    lock_take();
+    esp_err_t ret = sd_mount_if_needed();
+    lock_give();
+    return ret;
+}
+
 bool audio_service_is_recording(void)
 {
     bool v = false;
@@ -609,19 +698,43 @@ esp_err_t audio_service_start_recording(char *out_path, size_t out_path_size)
         return ret;
     }
 
+    s_rec_ring_buf = heap_caps_malloc(AUDIO_REC_RING_BYTES, MALLOC_CAP_SPIRAM);
+    if (!s_rec_ring_buf) {
+        fclose(fp);
+        lock_give();
+        return ESP_ERR_NO_MEM;
+    }
+    pcm_ring_init(&s_rec_ring, s_rec_ring_buf, AUDIO_REC_RING_BYTES);
+
+    portENTER_CRITICAL(&s_rec_stats_mux);
+    memset(&s_rec_stats, 0, sizeof(s_rec_stats));
+    portEXIT_CRITICAL(&s_rec_stats_mux);
+
     s_record_fp = fp;
-    s_record_data_bytes = 0;
     s_rec_samples_total = 0;
-    s_record_stop = false;
+    atomic_store(&s_record_stop, false);
+    atomic_store(&s_capture_done, false);
     s_recording = true;
-    BaseType_t ok = xTaskCreatePinnedToCore(record_task, "audio_rec", 4096, NULL, 4, &s_record_task, 0);
+    BaseType_t ok = xTaskCreatePinnedToCore(record_writer_task, "audio_wr", 4096, NULL,
+                                            AUDIO_REC_WRITER_PRIO, &s_writer_task, 0);
     if (ok != pdPASS) {
         fclose(fp);
+        heap_caps_free(s_rec_ring_buf);
+        s_rec_ring_buf = NULL;
         s_record_fp = NULL;
         s_recording = false;
         lock_give();
         return ESP_ERR_NO_MEM;
     }
+    ok = xTaskCreatePinnedToCore(record_task, "audio_rec", 4096, NULL,
+                                 AUDIO_REC_CAPTURE_PRIO, &s_record_task, 0);
+    if (ok != pdPASS) {
+        /* The writer finishes the (empty) file and clears the state */
+        atomic_store(&s_capture_done, true);
+        xTaskNotifyGive(s_writer_task);
+        lock_give();
+        return ESP_ERR_NO_MEM;
+    }
 
     if (out_path && out_path_size > 0) {
         strncpy(out_path, s_record_path, out_path_size - 1);
@@ -638,10 +751,11 @@ esp_err_t audio_service_stop_recording(void)
         lock_give();
         return ESP_ERR_INVALID_STATE;
     }
-    s_record_stop = true;
+    atomic_store(&s_record_stop, true);
     lock_give();
 
-    for (int i = 0; i < 40; i++) {
+    /* Allow the writer time to drain a full ring to a slow card */
+    for (int i = 0; i < 80; i++) {
         if (!audio_service_is_recording()) {
             return ESP_OK;
         }
@@ -650,6 +764,21 @@ esp_err_t audio_service_stop_recording(void)
     return ESP_ERR_TIMEOUT;
 }
 
+void audio_service_get_record_stats(audio_record_stats_t *out)
+{
+    portENTER_CRITICAL(&s_rec_stats_mux);
+    *out = s_rec_stats;
+    portEXIT_CRITICAL(&s_rec_stats_mux);
+
+    /* The ring struct outlives its buffer, so the counters stay readable */
+    out->recording = audio_service_is_recording();
+    out->overruns = atomic_load(&s_rec_ring.overruns);
+    out->dropped_bytes = atomic_load(&s_rec_ring.dropped_bytes);
+    out->ring_high_water = atomic_load(&s_rec_ring.high_water);
+    out->ring_used = out->recording ? pcm_ring_used(&s_rec_ring) : 0;
+    out->ring_size = AUDIO_REC_RING_BYTES;
+}
+
 esp_err_t audio_service_play_file(const char *path)
 {
     if (!path || path[0] == '\0') {
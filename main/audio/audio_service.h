@@ -7,13 +7,31 @@
 #define AUDIO_SERVICE_MAX_FILES      24
 #define AUDIO_SERVICE_MAX_NAME_LEN   48
 
+typedef struct {
+    bool recording;
+    uint32_t overruns;          /* I2S chunks dropped because the ring was full */
+    size_t dropped_bytes;
+    size_t ring_size;
+    size_t ring_used;
+    size_t ring_high_water;     /* peak ring fill this recording */
+    uint32_t writes;            /* fwrite calls to the card */
+    size_t bytes_written;       /* PCM bytes in the file so far */
+    uint32_t max_write_us;      /* slowest single fwrite */
+} audio_record_stats_t;
+
 esp_err_t audio_service_init(void);
 
+/** Mount the SD card at /sdcard if nobody has yet (shared with other users). */
+esp_err_t audio_service_mount_sd(void);
+
 bool audio_service_is_recording(void);
 bool audio_service_is_playing(void);
 
 esp_err_t audio_service_start_recording(char *out_path, size_t out_path_size);
 esp_err_t audio_service_stop_recording(void);
+
+/** Pipeline counters for the current (or last) recording. */
+void audio_service_get_record_stats(audio_record_stats_t *out);
 esp_err_t audio_service_play_file(const char *path);
 esp_err_t audio_service_set_playback_volume_percent(int percent);
 int audio_service_get_playback_volume_percent(void);
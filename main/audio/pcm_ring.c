@@ -0,0 +1,72 @@
+#include "audio/pcm_ring.h"
+
+#include <string.h>
+
+bool pcm_ring_init(pcm_ring_t *r, uint8_t *buf, size_t cap)
+{
+    if (!buf || cap == 0 || (cap & (cap - 1)) != 0) {
+        return false;
+    }
+    r->buf = buf;
+    r->cap = cap;
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    atomic_init(&r->overruns, 0);
+    atomic_init(&r->dropped_bytes, 0);
+    atomic_init(&r->high_water, 0);
+    return true;
+}
+
+size_t pcm_ring_used(const pcm_ring_t *r)
+{
+    size_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    return head - tail;
+}
+
+bool pcm_ring_write(pcm_ring_t *r, const void *data, size_t len)
+{
+    size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    size_t used = head - tail;
+
+    if (len > r->cap - used) {
+        atomic_fetch_add_explicit(&r->overruns, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&r->dropped_bytes, len, memory_order_relaxed);
+        return false;
+    }
+
+    size_t off = head & (r->cap - 1);
+    size_t first = r->cap - off;
+    if (first > len) first = len;
+    memcpy(r->buf + off, data, first);
+    memcpy(r->buf, (const uint8_t *)data + first, len - first);
+
+    /* Publish the bytes only after they are in place */
+    atomic_store_explicit(&r->head, head + len, memory_order_release);
+
+    used += len;
+    if (used > atomic_load_explicit(&r->high_water, memory_order_relaxed)) {
+        atomic_store_explicit(&r->high_water, used, memory_order_relaxed);
+    }
+    return true;
+}
+
+size_t pcm_ring_peek(const pcm_ring_t *r, const uint8_t **ptr)
+{
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    size_t off = tail & (r->cap - 1);
+    size_t span = r->cap - off;
+    size_t used = head - tail;
+
+    *ptr = r->buf + off;
+    return used < span ? used : span;
+}
+
+void pcm_ring_consume(pcm_ring_t *r, size_t n)
+{
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    /* The producer may reuse the space once it sees the new tail */
+    atomic_store_explicit(&r->tail, tail + n, memory_order_release);
+}
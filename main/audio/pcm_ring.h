@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Single-producer / single-consumer byte ring for recorded PCM.
+ *
+ * The producer (I2S capture) and the consumer (SD writer) each own one
+ * index; the other side only reads it, so no lock is needed. Writes are
+ * all-or-nothing: a chunk that does not fit is dropped whole and counted as
+ * an overrun, which keeps the stream frame-aligned. The consumer reads in
+ * place through pcm_ring_peek(), so blocks go to the file without a copy.
+ * Pure C, no ESP-IDF dependencies.
+ */
+
+typedef struct {
+    uint8_t *buf;
+    size_t cap;                 /* power of two */
+    atomic_size_t head;         /* total bytes written, producer-owned */
+    atomic_size_t tail;         /* total bytes read, consumer-owned */
+    /* Producer-side counters */
+    atomic_uint overruns;       /* chunks dropped because the ring was full */
+    atomic_size_t dropped_bytes;
+    atomic_size_t high_water;   /* peak fill level seen by the producer */
+} pcm_ring_t;
+
+/** Attach buf (cap bytes, power of two). Returns false if cap is invalid. */
+bool pcm_ring_init(pcm_ring_t *r, uint8_t *buf, size_t cap);
+
+/** Bytes ready to be read. */
+size_t pcm_ring_used(const pcm_ring_t *r);
+
+/** Producer: copy len bytes in, or drop them all and count an overrun. */
+bool pcm_ring_write(pcm_ring_t *r, const void *data, size_t len);
+
+/**
+ * Consumer: contiguous readable span at the tail. May be shorter than
+ * pcm_ring_used() when the data wraps; consume it and peek again.
+ */
+size_t pcm_ring_peek(const pcm_ring_t *r, const uint8_t **ptr);
+
+/** Consumer: release n bytes returned by pcm_ring_peek(). */
+void pcm_ring_consume(pcm_ring_t *r, size_t n);
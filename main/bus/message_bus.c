@@ -1,59 +1,399 @@
 #include "message_bus.h"
 #include "mimi_config.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 
 static const char *TAG = "bus";
 
-static QueueHandle_t s_inbound_queue;
-static QueueHandle_t s_outbound_queue;
+/* ── Inbound: priority slots with per-chat coalescing ─────────── */
+
+typedef struct {
+    mimi_msg_t msg;
+    bool used;
+    uint32_t seq;               /* arrival order */
+    int64_t enq_us;
+} in_slot_t;
+
+static in_slot_t s_in[MIMI_BUS_INBOUND_SLOTS];
+static char s_in_flight[MIMI_BUS_INFLIGHT_MAX][96];    /* chat_ids being processed */
+static int s_in_count = 0;
+static uint32_t s_in_seq = 0;
+static SemaphoreHandle_t s_in_lock;
+static SemaphoreHandle_t s_in_ready;    /* push or done: a pop may now succeed */
+static SemaphoreHandle_t s_in_space;    /* pop: a push may now fit */
+
+/* Outbound subscribers; the table is filled at start-up and then read-only */
+typedef struct {
+    char channel[16];
+    mimi_outbound_cb_t cb;
+    mimi_outbound_opts_t opts;
+    QueueHandle_t queue;
+    mimi_outbound_stats_t stats;
+} out_sub_t;
+
+static out_sub_t s_subs[MIMI_BUS_MAX_SUBSCRIBERS];
+static volatile int s_sub_count = 0;
+
+static message_bus_stats_t s_stats;
+static uint64_t s_wait_total_ms = 0;
+
+static uint8_t classify(const mimi_msg_t *msg)
+{
+    if (msg->prio >= MIMI_PRIO_LOW && msg->prio <= MIMI_PRIO_HIGH) return msg->prio;
+    if (strcmp(msg->channel, MIMI_CHAN_CLI) == 0) return MIMI_PRIO_HIGH;
+    /* Telegram groups and supergroups have negative chat ids */
+    if (strcmp(msg->channel, MIMI_CHAN_TELEGRAM) == 0 && msg->chat_id[0] == '-') {
+        return MIMI_PRIO_LOW;
+    }
+    return MIMI_PRIO_NORMAL;
+}
+
+/* Slots a class may fill: high-priority traffic always finds room */
+static int class_limit(uint8_t prio)
+{
+    switch (prio) {
+    case MIMI_PRIO_LOW:    return MIMI_BUS_LOW_SLOTS;
+    case MIMI_PRIO_NORMAL: return MIMI_BUS_INBOUND_SLOTS - MIMI_BUS_HIGH_RESERVED;
+    default:               return MIMI_BUS_INBOUND_SLOTS;
+    }
+}
+
+static int in_flight_find(const char *chat_id)
+{
+    for (int i = 0; i < MIMI_BUS_INFLIGHT_MAX; i++) {
+        if (s_in_flight[i][0] && strcmp(s_in_flight[i], chat_id) == 0) return i;
+    }
+    return -1;
+}
+
+static int in_flight_free_slot(void)
+{
+    for (int i = 0; i < MIMI_BUS_INFLIGHT_MAX; i++) {
+        if (!s_in_flight[i][0]) return i;
+    }
+    return -1;
+}
+
+/* Append to the chat's newest waiting message. Merging into an older one
+ * would move this text ahead of messages queued after it, so a newest slot
+ * that is full or of another class means a new slot. Caller holds s_in_lock. */
+static bool try_coalesce(const mimi_msg_t *msg, uint8_t prio)
+{
+    in_slot_t *last = NULL;
+    for (int i = 0; i < MIMI_BUS_INBOUND_SLOTS; i++) {
+        in_slot_t *s = &s_in[i];
+        if (!s->used || strcmp(s->msg.chat_id, msg->chat_id) != 0 ||
+            strcmp(s->msg.channel, msg->channel) != 0) {
+            continue;
+        }
+        if (!last || (int32_t)(s->seq - last->seq) > 0) last = s;
+    }
+    if (!last || last->msg.prio != prio) return false;
+
+    size_t a = strlen(last->msg.content);
+    size_t b = strlen(msg->content);
+    if (a + 1 + b > MIMI_BUS_COALESCE_MAX) return false;
+    char *merged = realloc(last->msg.content, a + 1 + b + 1);
+    if (!merged) return false;
+    merged[a] = '\n';
+    memcpy(merged + a + 1, msg->content, b + 1);
+    last->msg.content = merged;
+    free(msg->content);
+    return true;
+}
+
+/* Push without waiting. Caller holds s_in_lock. */
+static esp_err_t in_push_locked(const mimi_msg_t *msg, uint8_t prio)
+{
+    if (try_coalesce(msg, prio)) {
+        s_stats.in_pushed++;
+        s_stats.in_coalesced++;
+        return ESP_OK;
+    }
+    if (s_in_count >= class_limit(prio)) return ESP_ERR_NO_MEM;
+
+    for (int i = 0; i < MIMI_BUS_INBOUND_SLOTS; i++) {
+        in_slot_t *s = &s_in[i];
+        if (s->used) continue;
+        s->msg = *msg;
+        s->msg.prio = prio;
+        s->used = true;
+        s->seq = s_in_seq++;
+        s->enq_us = esp_timer_get_time();
+        s_in_count++;
+        if (s_in_count > s_stats.in_peak) s_stats.in_peak = s_in_count;
+        s_stats.in_pushed++;
+        return ESP_OK;
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+/* Best eligible slot: highest class, then oldest; chats in flight wait.
+ * Caller holds s_in_lock. */
+static in_slot_t *in_pick_locked(void)
+{
+    if (in_flight_free_slot() < 0) return NULL;
+
+    in_slot_t *best = NULL;
+    for (int i = 0; i < MIMI_BUS_INBOUND_SLOTS; i++) {
+        in_slot_t *s = &s_in[i];
+        if (!s->used || in_flight_find(s->msg.chat_id) >= 0) continue;
+        if (!best || s->msg.prio > best->msg.prio ||
+            (s->msg.prio == best->msg.prio && (int32_t)(s->seq - best->seq) < 0)) {
+            best = s;
+        }
+    }
+    if (!best) return NULL;
+
+    /* An older message of the same chat (lower class) goes first */
+    for (int i = 0; i < MIMI_BUS_INBOUND_SLOTS; i++) {
+        in_slot_t *s = &s_in[i];
+        if (s->used && (int32_t)(s->seq - best->seq) < 0 &&
+            strcmp(s->msg.chat_id, best->msg.chat_id) == 0) {
+            best = s;
+        }
+    }
+    return best;
+}
+
+static TickType_t ms_to_ticks(uint32_t timeout_ms)
+{
+    return (timeout_ms == UINT32_MAX) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+}
 
 esp_err_t message_bus_init(void)
 {
-    s_inbound_queue = xQueueCreate(MIMI_BUS_QUEUE_LEN, sizeof(mimi_msg_t));
-    s_outbound_queue = xQueueCreate(MIMI_BUS_QUEUE_LEN, sizeof(mimi_msg_t));
+    s_in_lock = xSemaphoreCreateMutex();
+    s_in_ready = xSemaphoreCreateBinary();
+    s_in_space = xSemaphoreCreateBinary();
 
-    if (!s_inbound_queue || !s_outbound_queue) {
+    if (!s_in_lock || !s_in_ready || !s_in_space) {
         ESP_LOGE(TAG, "Failed to create message queues");
         return ESP_ERR_NO_MEM;
     }
 
-    ESP_LOGI(TAG, "Message bus initialized (queue depth %d)", MIMI_BUS_QUEUE_LEN);
+    ESP_LOGI(TAG, "Message bus initialized (inbound %d slots)", MIMI_BUS_INBOUND_SLOTS);
     return ESP_OK;
 }
 
 esp_err_t message_bus_push_inbound(const mimi_msg_t *msg)
 {
-    if (xQueueSend(s_inbound_queue, msg, pdMS_TO_TICKS(1000)) != pdTRUE) {
-        ESP_LOGW(TAG, "Inbound queue full, dropping message");
-        return ESP_ERR_NO_MEM;
+    uint8_t prio = classify(msg);
+    TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(MIMI_BUS_PUSH_WAIT_MS);
+
+    while (1) {
+        xSemaphoreTake(s_in_lock, portMAX_DELAY);
+        esp_err_t err = in_push_locked(msg, prio);
+        xSemaphoreGive(s_in_lock);
+
+        if (err == ESP_OK) {
+            xSemaphoreGive(s_in_ready);
+            return ESP_OK;
+        }
+
+        TickType_t now = xTaskGetTickCount();
+        if ((int32_t)(deadline - now) <= 0) {
+            xSemaphoreTake(s_in_lock, portMAX_DELAY);
+            s_stats.in_rejected++;
+            xSemaphoreGive(s_in_lock);
+            ESP_LOGW(TAG, "Inbound full for %s:%s (prio %d), backpressure",
+                     msg->channel, msg->chat_id, prio);
+            return ESP_ERR_NO_MEM;
+        }
+        /* Several producers may wait on one signal: re-check periodically */
+        TickType_t wait = deadline - now;
+        if (wait > pdMS_TO_TICKS(100)) wait = pdMS_TO_TICKS(100);
+        xSemaphoreTake(s_in_space, wait);
     }
-    return ESP_OK;
+}
+
+bool message_bus_inbound_congested(void)
+{
+    return s_in_count >= MIMI_BUS_HIGH_WATER;
 }
 
 esp_err_t message_bus_pop_inbound(mimi_msg_t *msg, uint32_t timeout_ms)
 {
-    TickType_t ticks = (timeout_ms == UINT32_MAX) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
-    if (xQueueReceive(s_inbound_queue, msg, ticks) != pdTRUE) {
-        return ESP_ERR_TIMEOUT;
+    TickType_t ticks = ms_to_ticks(timeout_ms);
+    TickType_t start = xTaskGetTickCount();
+
+    while (1) {
+        xSemaphoreTake(s_in_lock, portMAX_DELAY);
+        in_slot_t *s = in_pick_locked();
+        if (s) {
+            *msg = s->msg;
+            s->used = false;
+            s_in_count--;
+
+            int f = in_flight_free_slot();
+            if (f >= 0) {
+                strncpy(s_in_flight[f], msg->chat_id, sizeof(s_in_flight[f]) - 1);
+                s_stats.in_flight++;
+            }
+
+            uint32_t wait_ms = (uint32_t)((esp_timer_get_time() - s->enq_us) / 1000);
+            s_wait_total_ms += wait_ms;
+            s_stats.in_popped++;
+            if (wait_ms > s_stats.in_wait_max_ms) s_stats.in_wait_max_ms = wait_ms;
+            xSemaphoreGive(s_in_lock);
+            xSemaphoreGive(s_in_space);
+            return ESP_OK;
+        }
+        xSemaphoreGive(s_in_lock);
+
+        TickType_t left = portMAX_DELAY;
+        if (ticks != portMAX_DELAY) {
+            TickType_t elapsed = xTaskGetTickCount() - start;
+            if (elapsed >= ticks) return ESP_ERR_TIMEOUT;
+            left = ticks - elapsed;
+        }
+        xSemaphoreTake(s_in_ready, left);
+    }
+}
+
+void message_bus_inbound_done(const mimi_msg_t *msg)
+{
+    xSemaphoreTake(s_in_lock, portMAX_DELAY);
+    int f = in_flight_find(msg->chat_id);
+    if (f >= 0) {
+        s_in_flight[f][0] = '\0';
+        s_stats.in_flight--;
     }
+    xSemaphoreGive(s_in_lock);
+    xSemaphoreGive(s_in_ready);
+}
+
+/* ── Outbound ─────────────────────────────────────────────────── */
+
+static bool retryable(esp_err_t err)
+{
+    return err != ESP_ERR_NOT_FOUND && err != ESP_ERR_INVALID_STATE &&
+           err != ESP_ERR_INVALID_ARG;
+}
+
+static void outbound_task(void *arg)
+{
+    out_sub_t *sub = (out_sub_t *)arg;
+    ESP_LOGI(TAG, "Outbound delivery for %s started", sub->channel);
+
+    while (1) {
+        mimi_msg_t msg;
+        if (xQueueReceive(sub->queue, &msg, portMAX_DELAY) != pdTRUE) continue;
+
+        if (msg.kind == MIMI_MSG_DELTA) {
+            /* Partial reply: best-effort, never retried */
+            sub->cb(&msg, sub->opts.ctx);
+            free(msg.content);
+            continue;
+        }
+
+        ESP_LOGI(TAG, "Dispatching response to %s:%s", msg.channel, msg.chat_id);
+
+        uint32_t backoff = sub->opts.retry_base_ms;
+        esp_err_t err = sub->cb(&msg, sub->opts.ctx);
+        for (int attempt = 0; err != ESP_OK && retryable(err) &&
+                              attempt < sub->opts.max_retries; attempt++) {
+            ESP_LOGW(TAG, "%s delivery failed (%s), retry in %u ms",
+                     sub->channel, esp_err_to_name(err), (unsigned)backoff);
+            vTaskDelay(pdMS_TO_TICKS(backoff));
+            backoff *= 2;
+            if (backoff > sub->opts.retry_max_ms) backoff = sub->opts.retry_max_ms;
+            sub->stats.retried++;
+            err = sub->cb(&msg, sub->opts.ctx);
+        }
+
+        if (err == ESP_OK) {
+            sub->stats.sent++;
+        } else {
+            sub->stats.failed++;
+            ESP_LOGE(TAG, "Giving up on %s:%s: %s", msg.channel, msg.chat_id,
+                     esp_err_to_name(err));
+        }
+        free(msg.content);
+    }
+}
+
+esp_err_t message_bus_subscribe_outbound(const char *channel, mimi_outbound_cb_t cb,
+                                         const mimi_outbound_opts_t *opts)
+{
+    if (!channel || !cb) return ESP_ERR_INVALID_ARG;
+    if (s_sub_count >= MIMI_BUS_MAX_SUBSCRIBERS) return ESP_ERR_NO_MEM;
+
+    out_sub_t *sub = &s_subs[s_sub_count];
+    memset(sub, 0, sizeof(*sub));
+    strncpy(sub->channel, channel, sizeof(sub->channel) - 1);
+    strncpy(sub->stats.channel, channel, sizeof(sub->stats.channel) - 1);
+    sub->cb = cb;
+    if (opts) sub->opts = *opts;
+    if (sub->opts.queue_len <= 0) sub->opts.queue_len = MIMI_BUS_QUEUE_LEN;
+    if (!sub->opts.stack) sub->opts.stack = MIMI_OUTBOUND_STACK;
+    if (!sub->opts.retry_base_ms) sub->opts.retry_base_ms = 500;
+    if (sub->opts.retry_max_ms < sub->opts.retry_base_ms) {
+        sub->opts.retry_max_ms = sub->opts.retry_base_ms;
+    }
+
+    sub->queue = xQueueCreate(sub->opts.queue_len, sizeof(mimi_msg_t));
+    if (!sub->queue) return ESP_ERR_NO_MEM;
+
+    char name[16];
+    snprintf(name, sizeof(name), "out_%s", channel);
+    if (xTaskCreatePinnedToCoreWithCaps(outbound_task, name, sub->opts.stack, sub,
+                                        MIMI_OUTBOUND_PRIO, NULL, MIMI_OUTBOUND_CORE,
+                                        MALLOC_CAP_SPIRAM) != pdPASS) {
+        vQueueDelete(sub->queue);
+        return ESP_FAIL;
+    }
+
+    s_sub_count++;
     return ESP_OK;
 }
 
 esp_err_t message_bus_push_outbound(const mimi_msg_t *msg)
 {
-    if (xQueueSend(s_outbound_queue, msg, pdMS_TO_TICKS(1000)) != pdTRUE) {
-        ESP_LOGW(TAG, "Outbound queue full, dropping message");
+    out_sub_t *sub = NULL;
+    for (int i = 0; i < s_sub_count; i++) {
+        if (strcmp(s_subs[i].channel, msg->channel) == 0) {
+            sub = &s_subs[i];
+            break;
+        }
+    }
+    if (!sub) {
+        if (msg->kind != MIMI_MSG_DELTA) ESP_LOGW(TAG, "Unknown channel: %s", msg->channel);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    if (msg->kind == MIMI_MSG_DELTA) {
+        /* Deltas are best-effort; the final reply carries the full text */
+        if (sub->opts.deltas && xQueueSend(sub->queue, msg, 0) == pdTRUE) return ESP_OK;
+        sub->stats.deltas_dropped++;
+        return ESP_ERR_NO_MEM;
+    }
+    if (xQueueSend(sub->queue, msg, pdMS_TO_TICKS(1000)) != pdTRUE) {
+        ESP_LOGW(TAG, "Outbound queue for %s full, dropping message", sub->channel);
+        sub->stats.dropped++;
         return ESP_ERR_NO_MEM;
     }
     return ESP_OK;
 }
 
-esp_err_t message_bus_pop_outbound(mimi_msg_t *msg, uint32_t timeout_ms)
+void message_bus_get_stats(message_bus_stats_t *out)
 {
-    TickType_t ticks = (timeout_ms == UINT32_MAX) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
-    if (xQueueReceive(s_outbound_queue, msg, ticks) != pdTRUE) {
-        return ESP_ERR_TIMEOUT;
+    xSemaphoreTake(s_in_lock, portMAX_DELAY);
+    *out = s_stats;
+    out->in_depth = s_in_count;
+    out->in_wait_avg_ms = s_stats.in_popped ?
+        (uint32_t)(s_wait_total_ms / s_stats.in_popped) : 0;
+    xSemaphoreGive(s_in_lock);
+
+    out->out_channels = s_sub_count;
+    for (int i = 0; i < s_sub_count; i++) {
+        out->out[i] = s_subs[i].stats;
+        out->out[i].depth = (int)uxQueueMessagesWaiting(s_subs[i].queue);
     }
-    return ESP_OK;
 }
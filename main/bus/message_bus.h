@@ -1,47 +1,144 @@
 #pragma once
 
 #include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
 
+#include "mimi_config.h"
+
 /* Channel identifiers */
 #define MIMI_CHAN_TELEGRAM   "telegram"
 #define MIMI_CHAN_WEBSOCKET  "websocket"
 #define MIMI_CHAN_CLI        "cli"
 #define MIMI_CHAN_FEISHU     "feishu"
 
+/* Outbound message kinds. A reply may be preceded by any number of DELTA
+ * messages carrying newly generated text; the FINAL message always holds the
+ * complete reply, so channels that cannot stream simply ignore deltas. */
+typedef enum {
+    MIMI_MSG_FINAL = 0,
+    MIMI_MSG_DELTA,
+} mimi_msg_kind_t;
+
+/* Inbound priority classes. Higher classes are served first and may use
+ * more of the inbound queue, so a flood of group chat traffic cannot keep
+ * the CLI or a direct chat waiting. */
+typedef enum {
+    MIMI_PRIO_AUTO = 0,     /* derive from channel / chat id */
+    MIMI_PRIO_LOW,          /* group chats */
+    MIMI_PRIO_NORMAL,       /* direct chats, WebSocket */
+    MIMI_PRIO_HIGH,         /* CLI / admin */
+} mimi_prio_t;
+
 /* Message types on the bus */
 typedef struct {
     char channel[16];       /* "telegram", "websocket", "cli", "feishu" */
     char chat_id[96];       /* Telegram/Feishu chat_id or WS client id */
     char *content;          /* Heap-allocated message text (caller must free) */
+    uint8_t kind;           /* mimi_msg_kind_t, outbound only */
+    uint8_t prio;           /* mimi_prio_t, inbound only */
 } mimi_msg_t;
 
+/**
+ * Delivers one outbound message (FINAL or DELTA, see msg->kind) to a
+ * channel. Runs on the channel's own delivery task; msg->content stays
+ * owned by the bus. Return an error to apply the channel's retry policy
+ * (FINAL only; ESP_ERR_NOT_FOUND / ESP_ERR_INVALID_STATE are not retried).
+ * The task's stack is in PSRAM: the callback must not write flash (SPIFFS,
+ * NVS) or hand stack buffers to DMA.
+ */
+typedef esp_err_t (*mimi_outbound_cb_t)(const mimi_msg_t *msg, void *ctx);
+
+typedef struct {
+    void *ctx;                  /* passed to the callback */
+    bool deltas;                /* channel consumes DELTA messages */
+    int queue_len;              /* 0: MIMI_BUS_QUEUE_LEN */
+    int max_retries;            /* extra attempts for a FINAL message */
+    uint32_t retry_base_ms;     /* first backoff, doubled per attempt */
+    uint32_t retry_max_ms;
+    uint32_t stack;             /* delivery task stack (PSRAM), 0: MIMI_OUTBOUND_STACK */
+} mimi_outbound_opts_t;
+
+typedef struct {
+    char channel[16];
+    int depth;
+    uint32_t sent;
+    uint32_t retried;
+    uint32_t failed;            /* finals given up after the last retry */
+    uint32_t dropped;           /* finals refused by a full queue */
+    uint32_t deltas_dropped;
+} mimi_outbound_stats_t;
+
+typedef struct {
+    int in_depth;               /* inbound messages waiting now */
+    int in_peak;
+    int in_flight;              /* chats being processed */
+    uint32_t in_pushed;
+    uint32_t in_coalesced;      /* merged into a waiting message of the same chat */
+    uint32_t in_rejected;       /* refused with backpressure (producer kept it) */
+    uint32_t in_popped;
+    uint32_t in_wait_avg_ms;    /* push → pop latency */
+    uint32_t in_wait_max_ms;
+    int out_channels;
+    mimi_outbound_stats_t out[MIMI_BUS_MAX_SUBSCRIBERS];
+} message_bus_stats_t;
+
 /**
  * Initialize the message bus (inbound + outbound FreeRTOS queues).
  */
 esp_err_t message_bus_init(void);
 
 /**
- * Push a message to the inbound queue (towards Agent Loop).
- * The bus takes ownership of msg->content.
+ * Push a message to the inbound queue (towards Agent Loop). A message for a
+ * chat that already has one waiting is appended to it instead of taking a
+ * slot. Waits up to MIMI_BUS_PUSH_WAIT_MS for room in the message's class.
+ *
+ * On success msg->content belongs to the bus and may already have been
+ * merged into a waiting message and freed: do not read it after the call.
+ *
+ * @return ESP_OK if the bus took ownership of msg->content,
+ *         ESP_ERR_NO_MEM if the class is full (caller keeps content and
+ *         should retry later rather than drop it)
  */
 esp_err_t message_bus_push_inbound(const mimi_msg_t *msg);
 
 /**
- * Pop a message from the inbound queue (blocking).
+ * True while the inbound queue is above MIMI_BUS_HIGH_WATER. Producers that
+ * can defer intake (e.g. Telegram getUpdates) should hold off.
+ */
+bool message_bus_inbound_congested(void);
+
+/**
+ * Pop the highest-priority, oldest inbound message whose chat is not being
+ * processed (blocking). The chat stays busy until message_bus_inbound_done().
  * Caller must free msg->content when done.
  */
 esp_err_t message_bus_pop_inbound(mimi_msg_t *msg, uint32_t timeout_ms);
 
 /**
- * Push a message to the outbound queue (towards channels).
- * The bus takes ownership of msg->content.
+ * Mark the chat of a popped message as finished so its next message can be
+ * popped. Turns of one chat therefore never overlap.
  */
-esp_err_t message_bus_push_outbound(const mimi_msg_t *msg);
+void message_bus_inbound_done(const mimi_msg_t *msg);
 
 /**
- * Pop a message from the outbound queue (blocking).
- * Caller must free msg->content when done.
+ * Register the delivery callback for a channel. Each subscriber gets its
+ * own queue and task, so a slow or failing channel only delays itself.
+ *
+ * @param opts  Queue, retry and task settings, or NULL for defaults
  */
-esp_err_t message_bus_pop_outbound(mimi_msg_t *msg, uint32_t timeout_ms);
+esp_err_t message_bus_subscribe_outbound(const char *channel, mimi_outbound_cb_t cb,
+                                         const mimi_outbound_opts_t *opts);
+
+/**
+ * Push a message to its channel's outbound queue.
+ * The bus takes ownership of msg->content on success. DELTA messages never
+ * block: if the queue is full, or the channel does not stream, they are
+ * rejected and the caller keeps content. ESP_ERR_NOT_FOUND if no
+ * subscriber handles msg->channel.
+ */
+esp_err_t message_bus_push_outbound(const mimi_msg_t *msg);
+
+void message_bus_get_stats(message_bus_stats_t *out);
@@ -1,6 +1,7 @@
 #include "serial_cli.h"
 #include "mimi_config.h"
 #include "bus/message_bus.h"
+#include "agent/agent_loop.h"
 #include "wifi/wifi_manager.h"
 #include "telegram/telegram_bot.h"
 #include "feishu/feishu_bot.h"
@@ -8,7 +9,11 @@
 #include "memory/memory_store.h"
 #include "memory/session_mgr.h"
 #include "proxy/http_proxy.h"
+#include "proxy/conn_pool.h"
 #include "tools/tool_web_search.h"
+#include "tools/tool_cache.h"
+#include "ui/display_port.h"
+#include "audio/audio_service.h"
 
 #include <string.h>
 #include <stdio.h>
@@ -200,6 +205,7 @@ static int cmd_feishu_chat(int argc, char **argv)
     strncpy(msg.channel, MIMI_CHAN_FEISHU, sizeof(msg.channel) - 1);
     strncpy(msg.chat_id, chat_id, sizeof(msg.chat_id) - 1);
     msg.content = strdup(feishu_chat_args.text->sval[0]);
+    msg.prio = MIMI_PRIO_HIGH;      /* typed at the console */
     if (!msg.content) {
         printf("Out of memory.\n");
         return 1;
@@ -316,11 +322,127 @@ static int cmd_session_clear(int argc, char **argv)
     return 0;
 }
 
+/* --- session_stats command --- */
+static int cmd_session_stats(int argc, char **argv)
+{
+    session_cache_stats_t st;
+    session_cache_get_stats(&st);
+    printf("Cached chats: %d / %d\n", st.entries, MIMI_SESSION_CACHE_SLOTS);
+    printf("Cache bytes:  %d / %d\n", (int)st.bytes, MIMI_SESSION_CACHE_BYTES);
+    printf("Hits:         %u\n", (unsigned)st.hits);
+    printf("Misses:       %u\n", (unsigned)st.misses);
+    printf("Evictions:    %u\n", (unsigned)st.evictions);
+    return 0;
+}
+
+/* --- bus_stats command --- */
+static int cmd_bus_stats(int argc, char **argv)
+{
+    message_bus_stats_t st;
+    message_bus_get_stats(&st);
+    printf("Inbound depth:   %d / %d (peak %d)\n", st.in_depth, MIMI_BUS_INBOUND_SLOTS, st.in_peak);
+    printf("Chats in flight: %d\n", st.in_flight);
+    printf("Pushed:          %u (coalesced %u)\n", (unsigned)st.in_pushed, (unsigned)st.in_coalesced);
+    printf("Rejected:        %u\n", (unsigned)st.in_rejected);
+    printf("Queue wait:      avg %u ms, max %u ms over %u\n",
+           (unsigned)st.in_wait_avg_ms, (unsigned)st.in_wait_max_ms, (unsigned)st.in_popped);
+    for (int i = 0; i < st.out_channels; i++) {
+        const mimi_outbound_stats_t *o = &st.out[i];
+        printf("Out %-10s   depth %d, sent %u, retried %u, failed %u, dropped %u (deltas %u)\n",
+               o->channel, o->depth, (unsigned)o->sent, (unsigned)o->retried,
+               (unsigned)o->failed, (unsigned)o->dropped, (unsigned)o->deltas_dropped);
+    }
+    return 0;
+}
+
+/* --- cache_stats command --- */
+static int cmd_cache_stats(int argc, char **argv)
+{
+    tool_cache_stats_t st;
+    tool_cache_get_stats(&st);
+    uint32_t hits = st.ram_hits + st.sd_hits;
+    uint32_t lookups = hits + st.stale + st.misses;
+    printf("Hit rate:    %u%% (%u of %u)\n",
+           lookups ? (unsigned)(hits * 100 / lookups) : 0, (unsigned)hits, (unsigned)lookups);
+    printf("Hits:        %u PSRAM, %u SD\n", (unsigned)st.ram_hits, (unsigned)st.sd_hits);
+    printf("Stale:       %u (%u not modified)\n", (unsigned)st.stale, (unsigned)st.revalidated);
+    printf("Stores:      %u (evicted %u)\n", (unsigned)st.stores, (unsigned)st.evictions);
+    printf("PSRAM tier:  %d entries, %d KB\n", st.ram_entries, (int)(st.ram_bytes / 1024));
+    if (st.sd_entries >= 0) {
+        printf("SD tier:     %d entries, %d KB\n", st.sd_entries, (int)(st.sd_bytes / 1024));
+    } else {
+        printf("SD tier:     unavailable\n");
+    }
+    return 0;
+}
+
+/* --- agent_stats command --- */
+static int cmd_agent_stats(int argc, char **argv)
+{
+    agent_stats_t st;
+    agent_loop_get_stats(&st);
+    printf("Turns:        %u (failed %u)\n", (unsigned)st.turns, (unsigned)st.failed);
+    printf("%-12s %8s %8s %8s\n", "Stage", "count", "avg ms", "max ms");
+    for (int i = 0; i < AGENT_STAGE_COUNT; i++) {
+        const agent_stage_stats_t *sg = &st.stage[i];
+        printf("%-12s %8u %8u %8u\n", agent_loop_stage_name((agent_stage_t)i),
+               (unsigned)sg->count,
+               sg->count ? (unsigned)(sg->total_us / sg->count / 1000) : 0,
+               (unsigned)(sg->max_us / 1000));
+    }
+    printf("Arena allocs: %u per turn avg, %u max (spills %u)\n",
+           st.turns ? (unsigned)(st.allocs / st.turns) : 0,
+           (unsigned)st.allocs_max, (unsigned)st.spills);
+    printf("Arena peak:   %d KB\n", (int)(st.arena_peak / 1024));
+    printf("Min free:     %d KB PSRAM, %d KB internal\n",
+           (int)(st.psram_min_free / 1024), (int)(st.internal_min_free / 1024));
+    return 0;
+}
+
+/* --- lcd_stats command --- */
+static int cmd_lcd_stats(int argc, char **argv)
+{
+    display_stats_t st;
+    display_port_get_stats(&st);
+    printf("Frames:      %u (%u fps)\n", (unsigned)st.frames, (unsigned)st.fps);
+    printf("Frame time:  last %u ms, avg %u ms, max %u ms\n",
+           (unsigned)(st.last_frame_us / 1000), (unsigned)(st.avg_frame_us / 1000),
+           (unsigned)(st.max_frame_us / 1000));
+    printf("Bands sent:  %u (%u KB), %d lines each\n",
+           (unsigned)st.flushes, (unsigned)(st.bytes / 1024), st.buf_lines);
+    printf("SPI trans:   %u (%u window setups skipped)\n",
+           (unsigned)st.transactions, (unsigned)st.window_skips);
+    printf("Last frame:  %u transactions, %u KB\n",
+           (unsigned)st.last_frame_trans, (unsigned)(st.last_frame_bytes / 1024));
+    return 0;
+}
+
+/* --- rec_stats command --- */
+static int cmd_rec_stats(int argc, char **argv)
+{
+    audio_record_stats_t st;
+    audio_service_get_record_stats(&st);
+    printf("Recording:   %s\n", st.recording ? "yes" : "no (last take)");
+    printf("Ring:        %u / %u KB used, peak %u KB\n",
+           (unsigned)(st.ring_used / 1024), (unsigned)(st.ring_size / 1024),
+           (unsigned)(st.ring_high_water / 1024));
+    printf("Overruns:    %u (%u KB dropped)\n",
+           (unsigned)st.overruns, (unsigned)(st.dropped_bytes / 1024));
+    printf("SD writes:   %u (%u KB), slowest %u ms\n",
+           (unsigned)st.writes, (unsigned)(st.bytes_written / 1024),
+           (unsigned)(st.max_write_us / 1000));
+    return 0;
+}
+
 /* --- heap_info command --- */
 static int cmd_heap_info(int argc, char **argv)
 {
-    printf("Internal free: %d bytes\n",
-           (int)heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+    printf("Internal free: %d bytes (min %d, largest block %d)\n",
+           (int)heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+           (int)heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL),
+           (int)heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL));
+    printf("DMA free:      %d bytes\n",
+           (int)heap_caps_get_free_size(MALLOC_CAP_DMA));
     printf("PSRAM free:    %d bytes\n",
            (int)heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
     printf("Total free:    %d bytes\n",
@@ -328,6 +450,20 @@ static int cmd_heap_info(int argc, char **argv)
     return 0;
 }
 
+/* --- pool_stats command --- */
+static int cmd_pool_stats(int argc, char **argv)
+{
+    conn_pool_stats_t st;
+    conn_pool_get_stats(&st);
+    printf("Connections: %d idle, %d busy (max %d)\n", st.idle, st.busy, MIMI_CONN_POOL_MAX);
+    printf("Reuse hits:  %u\n", (unsigned)st.hits);
+    printf("New conns:   %u (TLS resumed: %u, failed: %u)\n",
+           (unsigned)st.misses, (unsigned)st.resumed, (unsigned)st.failures);
+    printf("Stale:       %u\n", (unsigned)st.stale);
+    printf("Evicted:     %u\n", (unsigned)st.evicted);
+    return 0;
+}
+
 /* --- set_proxy command --- */
 static struct {
     struct arg_str *host;
@@ -642,6 +778,30 @@ esp_err_t serial_cli_init(void)
     };
     esp_console_cmd_register(&sess_clear_cmd);
 
+    /* session_stats */
+    esp_console_cmd_t sess_stats_cmd = {
+        .command = "session_stats",
+        .help = "Show session history cache statistics",
+        .func = &cmd_session_stats,
+    };
+    esp_console_cmd_register(&sess_stats_cmd);
+
+    /* bus_stats */
+    esp_console_cmd_t bus_stats_cmd = {
+        .command = "bus_stats",
+        .help = "Show message bus depth, coalescing, drops and latency",
+        .func = &cmd_bus_stats,
+    };
+    esp_console_cmd_register(&bus_stats_cmd);
+
+    /* cache_stats */
+    esp_console_cmd_t cache_cmd = {
+        .command = "cache_stats",
+        .help = "Show web_search / web_fetch cache hit rate and size",
+        .func = &cmd_cache_stats,
+    };
+    esp_console_cmd_register(&cache_cmd);
+
     /* heap_info */
     esp_console_cmd_t heap_cmd = {
         .command = "heap_info",
@@ -650,6 +810,38 @@ esp_err_t serial_cli_init(void)
     };
     esp_console_cmd_register(&heap_cmd);
 
+    /* agent_stats */
+    esp_console_cmd_t agent_stats_cmd = {
+        .command = "agent_stats",
+        .help = "Show per-stage agent turn latency and memory peaks",
+        .func = &cmd_agent_stats,
+    };
+    esp_console_cmd_register(&agent_stats_cmd);
+
+    /* lcd_stats */
+    esp_console_cmd_t lcd_stats_cmd = {
+        .command = "lcd_stats",
+        .help = "Show display frame rate and frame time",
+        .func = &cmd_lcd_stats,
+    };
+    esp_console_cmd_register(&lcd_stats_cmd);
+
+    /* rec_stats */
+    esp_console_cmd_t rec_stats_cmd = {
+        .command = "rec_stats",
+        .help = "Show audio recording ring and SD writer statistics",
+        .func = &cmd_rec_stats,
+    };
+    esp_console_cmd_register(&rec_stats_cmd);
+
+    /* pool_stats */
+    esp_console_cmd_t pool_cmd = {
+        .command = "pool_stats",
+        .help = "Show HTTPS connection pool statistics",
+        .func = &cmd_pool_stats,
+    };
+    esp_console_cmd_register(&pool_cmd);
+
     /* set_search_key */
     search_key_args.key = arg_str1(NULL, NULL, "<key>", "Search API key (Brave or Tavily)");
     search_key_args.end = arg_end(1);
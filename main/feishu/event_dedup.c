@@ -0,0 +1,260 @@
+#include "feishu/event_dedup.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+
+static const char *TAG = "feishu_dedup";
+
+#define DEDUP_EMPTY  UINT16_MAX
+
+/* Log file: header, then event_dedup_record_t appended per new key */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t count;             /* unused */
+} dedup_file_header_t;
+
+static uint64_t dedup_fingerprint(const char *key)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    while (*key) {
+        h ^= (uint8_t)(*key++);
+        h *= 0x100000001b3ULL;
+    }
+    return h ? h : 1;
+}
+
+static uint32_t dedup_home(uint64_t fp)
+{
+    return (uint32_t)(fp ^ (fp >> 32)) & (FEISHU_EVENT_DEDUP_BUCKETS - 1);
+}
+
+/* Index bucket holding fp, or the empty bucket where it would go */
+static uint32_t dedup_probe(const event_dedup_t *d, uint64_t fp)
+{
+    uint32_t b = dedup_home(fp);
+    while (d->index[b] != DEDUP_EMPTY && d->ring[d->index[b]].fp != fp) {
+        b = (b + 1) & (FEISHU_EVENT_DEDUP_BUCKETS - 1);
+    }
+    return b;
+}
+
+/* Backward-shift delete keeps probe chains intact without tombstones */
+static void dedup_index_remove(event_dedup_t *d, uint32_t b)
+{
+    const uint32_t mask = FEISHU_EVENT_DEDUP_BUCKETS - 1;
+    uint32_t next = (b + 1) & mask;
+    while (d->index[next] != DEDUP_EMPTY) {
+        uint32_t home = dedup_home(d->ring[d->index[next]].fp);
+        /* Move next back into the hole unless its home lies in (b, next] */
+        if (((next - home) & mask) >= ((next - b) & mask)) {
+            d->index[b] = d->index[next];
+            b = next;
+        }
+        next = (next + 1) & mask;
+    }
+    d->index[b] = DEDUP_EMPTY;
+}
+
+/* Drop the oldest ring entry */
+static void dedup_pop_head(event_dedup_t *d)
+{
+    event_dedup_entry_t *e = &d->ring[d->head];
+    if (e->fp) {
+        uint32_t b = dedup_probe(d, e->fp);
+        if (d->index[b] != DEDUP_EMPTY) dedup_index_remove(d, b);
+    }
+    e->fp = 0;
+    d->head = (d->head + 1) % FEISHU_EVENT_DEDUP_MAX;
+    d->count--;
+}
+
+static void dedup_expire(event_dedup_t *d, int64_t t)
+{
+    while (d->count > 0) {
+        const event_dedup_entry_t *e = &d->ring[d->head];
+        if (e->fp && t - e->ts_ms <= FEISHU_EVENT_DEDUP_EXPIRE_MS) break;
+        dedup_pop_head(d);
+    }
+}
+
+/* Insert or refresh; a refreshed key moves to the tail to keep the ring
+ * ordered. ts_ms must not be older than the current tail. */
+static void dedup_insert(event_dedup_t *d, uint64_t fp, int64_t ts_ms, int64_t wall_ms)
+{
+    uint32_t b = dedup_probe(d, fp);
+    if (d->index[b] != DEDUP_EMPTY) {
+        d->ring[d->index[b]].fp = 0;    /* dead slot, skipped on expiry */
+        dedup_index_remove(d, b);
+    }
+    if (d->count == FEISHU_EVENT_DEDUP_MAX) dedup_pop_head(d);
+
+    uint16_t pos = (uint16_t)((d->head + d->count) % FEISHU_EVENT_DEDUP_MAX);
+    d->ring[pos] = (event_dedup_entry_t){ .fp = fp, .ts_ms = ts_ms, .wall_ms = wall_ms };
+    d->count++;
+    d->index[dedup_probe(d, fp)] = pos;
+}
+
+/* Rewrite the log with just the live entries, keeping their original times */
+static esp_err_t dedup_compact(event_dedup_t *d)
+{
+    FILE *f = fopen(d->tmp_path, "wb");
+    if (!f) return ESP_FAIL;
+
+    dedup_file_header_t header = {
+        .magic = FEISHU_EVENT_DEDUP_MAGIC,
+        .version = FEISHU_EVENT_DEDUP_FILE_VERSION,
+    };
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    uint32_t records = 0;
+    for (uint32_t i = 0; ok && i < d->count; i++) {
+        const event_dedup_entry_t *e = &d->ring[(d->head + i) % FEISHU_EVENT_DEDUP_MAX];
+        /* Entries without a wall time would be dropped on replay anyway */
+        if (!e->fp || e->wall_ms < FEISHU_EVENT_DEDUP_WALL_MIN_MS) continue;
+        event_dedup_record_t rec = { .fp = e->fp, .wall_ms = e->wall_ms };
+        ok = fwrite(&rec, sizeof(rec), 1, f) == 1;
+        records++;
+    }
+    ok = (fclose(f) == 0) && ok;
+    if (!ok) {
+        remove(d->tmp_path);
+        return ESP_FAIL;
+    }
+
+    remove(d->path);
+    if (rename(d->tmp_path, d->path) != 0) {
+        remove(d->tmp_path);
+        return ESP_FAIL;
+    }
+    d->log_records = records;
+    d->pending = 0;
+    d->need_compact = false;
+    return ESP_OK;
+}
+
+static esp_err_t dedup_append(event_dedup_t *d)
+{
+    FILE *f = fopen(d->path, "ab");
+    if (!f) return ESP_FAIL;
+    bool ok = fwrite(d->pend, sizeof(event_dedup_record_t), d->pending, f) == d->pending;
+    ok = (fclose(f) == 0) && ok;
+    if (!ok) return ESP_FAIL;
+    d->log_records += d->pending;
+    d->pending = 0;
+    return ESP_OK;
+}
+
+void event_dedup_init(event_dedup_t *d, const char *path, const char *tmp_path, int64_t now_ms)
+{
+    memset(d, 0, sizeof(*d));
+    memset(d->index, 0xFF, sizeof(d->index));
+    d->path = path;
+    d->tmp_path = tmp_path;
+    d->last_flush_ms = now_ms;
+}
+
+void event_dedup_flush(event_dedup_t *d, int64_t now_ms, bool force)
+{
+    if (!d->pending && !d->need_compact) return;
+
+    bool enough_writes = d->pending >= FEISHU_EVENT_DEDUP_FLUSH_WRITES;
+    bool time_due = (now_ms - d->last_flush_ms) >= FEISHU_EVENT_DEDUP_FLUSH_INTERVAL_MS;
+    if (!force && !enough_writes && !time_due) return;
+
+    /* Compact once the log holds twice what the table can */
+    esp_err_t err;
+    if (d->need_compact || d->log_records + d->pending > 2 * FEISHU_EVENT_DEDUP_MAX) {
+        err = dedup_compact(d);
+    } else {
+        err = dedup_append(d);
+    }
+    d->last_flush_ms = now_ms;
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Dedup log flush failed: %s", esp_err_to_name(err));
+        d->pending = 0;
+        d->need_compact = true;     /* the table is the truth; rewrite next time */
+    }
+}
+
+esp_err_t event_dedup_load(event_dedup_t *d, int64_t now_ms, int64_t wall_ms)
+{
+    FILE *f = fopen(d->path, "rb");
+    if (!f) {
+        d->need_compact = true;
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    dedup_file_header_t header = {0};
+    if (fread(&header, sizeof(header), 1, f) != 1 ||
+        header.magic != FEISHU_EVENT_DEDUP_MAGIC ||
+        header.version != FEISHU_EVENT_DEDUP_FILE_VERSION) {
+        fclose(f);
+        d->need_compact = true;
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    long body = ftell(f);
+
+    /* Without a clock the device was at least up until its newest record */
+    event_dedup_record_t rec;
+    int64_t ref = wall_ms >= FEISHU_EVENT_DEDUP_WALL_MIN_MS ? wall_ms : 0;
+    while (fread(&rec, sizeof(rec), 1, f) == 1) {
+        if (rec.fp && rec.wall_ms > ref) ref = rec.wall_ms;
+    }
+
+    /* Replay in append order; a torn last record is just ignored */
+    fseek(f, body, SEEK_SET);
+    uint32_t dropped = 0;
+    int64_t last_ts = INT64_MIN;
+    while (fread(&rec, sizeof(rec), 1, f) == 1) {
+        d->log_records++;
+        if (!rec.fp) continue;
+        int64_t age = ref - rec.wall_ms;
+        if (rec.wall_ms < FEISHU_EVENT_DEDUP_WALL_MIN_MS || age > FEISHU_EVENT_DEDUP_EXPIRE_MS) {
+            dropped++;
+            continue;
+        }
+        /* A clock step back can make a later record look newer; the ring
+         * must stay in order, so never go back in time */
+        int64_t ts = now_ms - (age > 0 ? age : 0);
+        if (ts < last_ts) ts = last_ts;
+        last_ts = ts;
+        dedup_insert(d, rec.fp, ts, rec.wall_ms);
+    }
+    fclose(f);
+
+    dedup_expire(d, now_ms);
+    if (dropped) d->need_compact = true;
+    ESP_LOGI(TAG, "Dedup log replayed: %d live of %d records (%d stale)",
+             (int)d->count, (int)d->log_records, (int)dropped);
+    return ESP_OK;
+}
+
+bool event_dedup_contains(event_dedup_t *d, const char *key, int64_t now_ms)
+{
+    if (!key || !key[0]) return false;
+    dedup_expire(d, now_ms);
+    return d->index[dedup_probe(d, dedup_fingerprint(key))] != DEDUP_EMPTY;
+}
+
+void event_dedup_mark_seen(event_dedup_t *d, const char *key, int64_t now_ms, int64_t wall_ms)
+{
+    if (!key || !key[0]) return;
+
+    if (wall_ms < FEISHU_EVENT_DEDUP_WALL_MIN_MS) wall_ms = 0;
+    dedup_expire(d, now_ms);
+    uint64_t fp = dedup_fingerprint(key);
+    dedup_insert(d, fp, now_ms, wall_ms);
+    if (!wall_ms) return;       /* nothing worth persisting */
+
+    if (d->pending == FEISHU_EVENT_DEDUP_FLUSH_WRITES) {
+        event_dedup_flush(d, now_ms, true);
+    }
+    if (d->pending < FEISHU_EVENT_DEDUP_FLUSH_WRITES) {
+        d->pend[d->pending++] = (event_dedup_record_t){ .fp = fp, .wall_ms = wall_ms };
+    } else {
+        d->need_compact = true;
+    }
+    event_dedup_flush(d, now_ms, false);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/*
+ * Seen-event table for Feishu redeliveries, persisted in an append-only log.
+ *
+ * Keys are reduced to a 64-bit FNV-1a fingerprint. Entries sit in a ring in
+ * arrival order, so expiry only ever looks at the head; an open-addressing
+ * index (linear probing, load <= 1/2) maps fingerprints to ring positions.
+ *
+ * Two clocks are involved. Expiry runs on uptime (ts_ms), which is monotonic
+ * within a boot. The log stores wall-clock time (wall_ms, Unix ms), since
+ * uptime restarts at every boot; records without a valid wall clock are not
+ * replayed. At load, ages are measured against the current wall clock, or
+ * the newest logged time when the clock has not been set yet, and rebased
+ * onto uptime.
+ *
+ * The caller provides both clocks and serializes all calls.
+ */
+
+#define FEISHU_EVENT_DEDUP_MAX                2048
+#define FEISHU_EVENT_DEDUP_BUCKETS            4096        /* power of two, 2x entries */
+#define FEISHU_EVENT_DEDUP_EXPIRE_MS          (24 * 60 * 60 * 1000)
+#define FEISHU_EVENT_DEDUP_FLUSH_INTERVAL_MS  5000
+#define FEISHU_EVENT_DEDUP_FLUSH_WRITES       16
+#define FEISHU_EVENT_DEDUP_MAGIC              0x46444450u /* FDDP */
+#define FEISHU_EVENT_DEDUP_FILE_VERSION       3
+#define FEISHU_EVENT_DEDUP_WALL_MIN_MS        1700000000000LL /* earlier = clock never set */
+
+typedef struct {
+    uint64_t fp;                /* key fingerprint, 0 = dead */
+    int64_t ts_ms;              /* uptime when seen (or rebased at load) */
+    int64_t wall_ms;            /* Unix ms when seen, 0 if unknown */
+} event_dedup_entry_t;
+
+/* On-disk record, appended to the log after its header */
+typedef struct {
+    uint64_t fp;
+    int64_t wall_ms;
+} event_dedup_record_t;
+
+typedef struct {
+    event_dedup_entry_t ring[FEISHU_EVENT_DEDUP_MAX];   /* oldest at head */
+    uint16_t index[FEISHU_EVENT_DEDUP_BUCKETS];         /* ring position or empty */
+    uint32_t head;
+    uint32_t count;
+    event_dedup_record_t pend[FEISHU_EVENT_DEDUP_FLUSH_WRITES];    /* not yet in the log */
+    uint32_t pending;
+    uint32_t log_records;
+    bool need_compact;
+    int64_t last_flush_ms;
+    const char *path;
+    const char *tmp_path;
+} event_dedup_t;
+
+/** Reset d to an empty table backed by the log at path (tmp_path for compaction). */
+void event_dedup_init(event_dedup_t *d, const char *path, const char *tmp_path, int64_t now_ms);
+
+/**
+ * Replay the log. wall_ms is the current wall clock, 0 if not set. Records
+ * with no wall time or older than the expiry window are dropped.
+ * ESP_ERR_NOT_FOUND: no log; ESP_ERR_INVALID_RESPONSE: unknown format.
+ * Either way the next flush writes a fresh log.
+ */
+esp_err_t event_dedup_load(event_dedup_t *d, int64_t now_ms, int64_t wall_ms);
+
+bool event_dedup_contains(event_dedup_t *d, const char *key, int64_t now_ms);
+
+/** Remember key; wall_ms is when it was seen (0 if unknown, never replayed). */
+void event_dedup_mark_seen(event_dedup_t *d, const char *key, int64_t now_ms, int64_t wall_ms);
+
+/**
+ * Write pending records once enough have accumulated or the flush interval
+ * has passed (always with force). Compacts when the log holds twice the
+ * table size.
+ */
+void event_dedup_flush(event_dedup_t *d, int64_t now_ms, bool force);
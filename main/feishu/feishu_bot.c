@@ -1,12 +1,15 @@
 #include "feishu_bot.h"
+#include "feishu/event_dedup.h"
 
 #include "mimi_config.h"
 #include "bus/message_bus.h"
+#include "proxy/conn_pool.h"
 
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <sys/time.h>
 
 #include "esp_log.h"
 #include "esp_http_client.h"
@@ -29,42 +32,43 @@ static const char *TAG = "feishu";
 #define FEISHU_AUTH_URL                       FEISHU_DOMAIN "/open-apis/auth/v3/tenant_access_token/internal"
 #define FEISHU_WS_ENDPOINT_URL                FEISHU_DOMAIN "/callback/ws/endpoint"
 #define FEISHU_SEND_MSG_URL                   FEISHU_DOMAIN "/open-apis/im/v1/messages?receive_id_type=chat_id"
+#define FEISHU_EDIT_MSG_URL_FMT               FEISHU_DOMAIN "/open-apis/im/v1/messages/%s"
+#define FEISHU_DRAFT_TEXT_MAX                 (8 * 1024)
 
 #define FEISHU_MAX_HEADERS                    16
-#define FEISHU_KEY_MAX                        32
-#define FEISHU_VAL_MAX                        128
 #define FEISHU_URL_MAX                        512
 
 #define FEISHU_CHUNK_CACHE_MAX                4
 #define FEISHU_CHUNK_MAX                      16
 #define FEISHU_CHUNK_EXPIRE_MS                10000
 #define FEISHU_WS_PAYLOAD_MAX                 (96 * 1024)
-#define FEISHU_EVENT_DEDUP_MAX                2048
-#define FEISHU_EVENT_DEDUP_EXPIRE_MS          (24 * 60 * 60 * 1000)
-#define FEISHU_EVENT_DEDUP_FLUSH_INTERVAL_MS  5000
-#define FEISHU_EVENT_DEDUP_FLUSH_WRITES       16
-#define FEISHU_EVENT_DEDUP_MAGIC              0x46444450u /* FDDP */
-#define FEISHU_EVENT_DEDUP_FILE_VERSION       1
-#define FEISHU_EVENT_DEDUP_FILE               MIMI_SPIFFS_BASE "/feishu_dedup.bin"
-#define FEISHU_EVENT_DEDUP_FILE_TMP           MIMI_SPIFFS_BASE "/feishu_dedup.bin.tmp"
+#define FEISHU_CHUNK_MERGED_MAX               (FEISHU_CHUNK_MAX * FEISHU_WS_PAYLOAD_MAX)
+#define FEISHU_EVENT_DEDUP_FILE               MIMI_SPIFFS_BASE "/feishu_dedup.log"
+#define FEISHU_EVENT_DEDUP_FILE_TMP           MIMI_SPIFFS_BASE "/feishu_dedup.log.tmp"
+#define FEISHU_EVENT_DEDUP_FILE_V1            MIMI_SPIFFS_BASE "/feishu_dedup.bin"
 
 #define FEISHU_EVENT_IM_RECEIVE               "im.message.receive_v1"
 #define FEISHU_MSG_TYPE_TEXT                  "text"
 
 #define FEISHU_HTTP_TIMEOUT_MS                15000
+#define FEISHU_RESP_MAX                       (32 * 1024)
 #define FEISHU_TOKEN_SKEW_MS                  120000
 
+/* Borrowed bytes: points into the receive buffer (or a literal), never owned */
 typedef struct {
-    char *buf;
+    const uint8_t *p;
     size_t len;
-    size_t cap;
-} http_resp_t;
+} pb_slice_t;
+
+#define PB_SLICE_LIT(s)  ((pb_slice_t){ (const uint8_t *)(s), sizeof(s) - 1 })
 
 typedef struct {
-    char key[FEISHU_KEY_MAX];
-    char value[FEISHU_VAL_MAX];
+    pb_slice_t key;
+    pb_slice_t value;
 } pb_header_t;
 
+/* Decoded in place: headers and payload stay valid only while the buffer
+ * they were decoded from is untouched */
 typedef struct {
     uint64_t seq_id;
     uint64_t log_id;
@@ -72,10 +76,11 @@ typedef struct {
     int32_t method;
     pb_header_t headers[FEISHU_MAX_HEADERS];
     size_t header_count;
-    uint8_t *payload;
-    size_t payload_len;
+    pb_slice_t payload;
 } pb_frame_t;
 
+/* Parts of a multi-frame event, copied once each into one slab in arrival
+ * order; the scatter list maps seq to its span. */
 typedef struct {
     bool used;
     char message_id[64];
@@ -83,8 +88,12 @@ typedef struct {
     int sum;
     int got;
     int64_t create_ms;
-    uint8_t *parts[FEISHU_CHUNK_MAX];
-    size_t part_lens[FEISHU_CHUNK_MAX];
+    uint8_t *slab;              /* PSRAM */
+    size_t slab_len;
+    size_t slab_cap;
+    uint32_t have;              /* bit per received seq */
+    uint32_t part_off[FEISHU_CHUNK_MAX];
+    uint32_t part_len[FEISHU_CHUNK_MAX];
 } chunk_cache_t;
 
 typedef struct {
@@ -93,24 +102,18 @@ typedef struct {
     size_t cap;
 } pb_writer_t;
 
+/* In-progress streamed reply (app-bot mode only). Touched only from the
+ * outbound dispatch task. */
 typedef struct {
     bool used;
-    char key[96];
-    int64_t ts_ms;
-} event_dedup_t;
-
-typedef struct {
-    uint32_t magic;
-    uint16_t version;
-    uint16_t reserved;
-    uint32_t count;
-} dedup_file_header_t;
-
-typedef struct {
-    uint8_t used;
-    int64_t ts_ms;
-    char key[96];
-} dedup_file_entry_t;
+    char chat_id[96];
+    char message_id[64];        /* empty until the first send succeeds */
+    char *text;                 /* PSRAM, FEISHU_DRAFT_TEXT_MAX + 1 */
+    size_t len;
+    int64_t last_edit_ms;
+    int edits;
+    bool frozen;
+} feishu_draft_t;
 
 static char s_webhook_url[320] = MIMI_SECRET_FEISHU_WEBHOOK;
 static char s_app_id[96] = MIMI_SECRET_FEISHU_APP_ID;
@@ -130,16 +133,15 @@ static int s_ws_reconnect_count = -1;
 static int s_ws_reconnect_interval_ms = 120000;
 static int s_ws_reconnect_nonce_ms = 30000;
 
-static uint8_t *s_ws_rx_buf = NULL;
-static size_t s_ws_rx_expected = 0;
+/* Frames are read straight into one PSRAM buffer and decoded there */
+static uint8_t *s_ws_rx_buf = NULL;             /* FEISHU_WS_PAYLOAD_MAX, kept across reconnects */
+static size_t s_ws_rx_expected = 0;             /* current frame's payload length, 0 = between frames */
 static size_t s_ws_rx_received = 0;
-static uint8_t s_ws_read_buf[4096];
+static bool s_ws_rx_discard = false;            /* oversized frame: drain without keeping */
 
 static chunk_cache_t s_chunk_cache[FEISHU_CHUNK_CACHE_MAX];
-static event_dedup_t *s_event_dedup = NULL;
-static bool s_event_dedup_dirty = false;
-static uint16_t s_event_dedup_dirty_writes = 0;
-static int64_t s_event_dedup_last_flush_ms = 0;
+static event_dedup_t *s_dedup = NULL;
+static feishu_draft_t s_drafts[MIMI_FEISHU_DRAFT_MAX];
 
 static void str_copy(char *dst, size_t dst_size, const char *src)
 {
@@ -170,227 +172,43 @@ static uint32_t fnv1a32_str(const char *s)
     return h;
 }
 
-static void event_dedup_mark_dirty(void)
-{
-    s_event_dedup_dirty = true;
-    if (s_event_dedup_dirty_writes < UINT16_MAX) {
-        s_event_dedup_dirty_writes++;
-    }
-}
+/* ── Event dedup ──────────────────────────────────────────────── */
 
-static esp_err_t event_dedup_save_to_disk(void)
+/* Unix ms for the dedup log. Until SNTP or get_time has set the clock, the
+ * event's own create_time (server clock) stands in; 0 if neither is known. */
+static int64_t dedup_wall_ms(const char *event_ms)
 {
-    if (!s_event_dedup) return ESP_ERR_INVALID_STATE;
-
-    FILE *f = fopen(FEISHU_EVENT_DEDUP_FILE_TMP, "wb");
-    if (!f) {
-        return ESP_FAIL;
-    }
-
-    dedup_file_header_t header = {
-        .magic = FEISHU_EVENT_DEDUP_MAGIC,
-        .version = FEISHU_EVENT_DEDUP_FILE_VERSION,
-        .reserved = 0,
-        .count = FEISHU_EVENT_DEDUP_MAX,
-    };
-    if (fwrite(&header, sizeof(header), 1, f) != 1) {
-        fclose(f);
-        remove(FEISHU_EVENT_DEDUP_FILE_TMP);
-        return ESP_FAIL;
-    }
-
-    for (int i = 0; i < FEISHU_EVENT_DEDUP_MAX; i++) {
-        dedup_file_entry_t entry = {0};
-        entry.used = s_event_dedup[i].used ? 1 : 0;
-        entry.ts_ms = s_event_dedup[i].ts_ms;
-        str_copy(entry.key, sizeof(entry.key), s_event_dedup[i].key);
-        if (fwrite(&entry, sizeof(entry), 1, f) != 1) {
-            fclose(f);
-            remove(FEISHU_EVENT_DEDUP_FILE_TMP);
-            return ESP_FAIL;
-        }
-    }
-
-    if (fclose(f) != 0) {
-        remove(FEISHU_EVENT_DEDUP_FILE_TMP);
-        return ESP_FAIL;
-    }
-
-    remove(FEISHU_EVENT_DEDUP_FILE);
-    if (rename(FEISHU_EVENT_DEDUP_FILE_TMP, FEISHU_EVENT_DEDUP_FILE) != 0) {
-        remove(FEISHU_EVENT_DEDUP_FILE_TMP);
-        return ESP_FAIL;
-    }
-
-    s_event_dedup_dirty = false;
-    s_event_dedup_dirty_writes = 0;
-    s_event_dedup_last_flush_ms = now_ms();
-    return ESP_OK;
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    int64_t t = (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+    if (t >= FEISHU_EVENT_DEDUP_WALL_MIN_MS) return t;
+    return event_ms ? strtoll(event_ms, NULL, 10) : 0;
 }
 
-static void event_dedup_maybe_flush(bool force)
+static bool dedup_contains(const char *key)
 {
-    if (!s_event_dedup || !s_event_dedup_dirty) return;
-
-    int64_t t = now_ms();
-    bool enough_writes = s_event_dedup_dirty_writes >= FEISHU_EVENT_DEDUP_FLUSH_WRITES;
-    bool time_due = (t - s_event_dedup_last_flush_ms) >= FEISHU_EVENT_DEDUP_FLUSH_INTERVAL_MS;
-
-    if (!force && !enough_writes && !time_due) {
-        return;
-    }
-
-    esp_err_t err = event_dedup_save_to_disk();
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Dedup cache flush failed: %s", esp_err_to_name(err));
-    }
+    return s_dedup && event_dedup_contains(s_dedup, key, now_ms());
 }
 
-static esp_err_t event_dedup_load_from_disk(void)
+static void dedup_mark_seen(const char *key, const char *event_ms)
 {
-    if (!s_event_dedup) return ESP_ERR_INVALID_STATE;
-
-    FILE *f = fopen(FEISHU_EVENT_DEDUP_FILE, "rb");
-    if (!f) {
-        return ESP_ERR_NOT_FOUND;
-    }
-
-    dedup_file_header_t header = {0};
-    if (fread(&header, sizeof(header), 1, f) != 1) {
-        fclose(f);
-        return ESP_FAIL;
-    }
-    if (header.magic != FEISHU_EVENT_DEDUP_MAGIC ||
-        header.version != FEISHU_EVENT_DEDUP_FILE_VERSION ||
-        header.count != FEISHU_EVENT_DEDUP_MAX) {
-        fclose(f);
-        return ESP_ERR_INVALID_RESPONSE;
-    }
-
-    memset(s_event_dedup, 0, FEISHU_EVENT_DEDUP_MAX * sizeof(event_dedup_t));
-    for (int i = 0; i < FEISHU_EVENT_DEDUP_MAX; i++) {
-        dedup_file_entry_t entry = {0};
-        if (fread(&entry, sizeof(entry), 1, f) != 1) {
-            fclose(f);
-            return ESP_FAIL;
-        }
-        s_event_dedup[i].used = (entry.used != 0);
-        s_event_dedup[i].ts_ms = entry.ts_ms;
-        str_copy(s_event_dedup[i].key, sizeof(s_event_dedup[i].key), entry.key);
-    }
-    fclose(f);
-
-    int64_t t = now_ms();
-    int expired = 0;
-    for (int i = 0; i < FEISHU_EVENT_DEDUP_MAX; i++) {
-        event_dedup_t *slot = &s_event_dedup[i];
-        if (!slot->used) continue;
-        if (t - slot->ts_ms > FEISHU_EVENT_DEDUP_EXPIRE_MS) {
-            memset(slot, 0, sizeof(*slot));
-            expired++;
-        }
-    }
-    if (expired > 0) {
-        event_dedup_mark_dirty();
-    }
-
-    return ESP_OK;
+    if (s_dedup) event_dedup_mark_seen(s_dedup, key, now_ms(), dedup_wall_ms(event_ms));
 }
 
-static bool event_dedup_contains(const char *key)
+static void dedup_flush(bool force)
 {
-    if (!s_event_dedup || !key || !key[0]) return false;
-    int64_t t = now_ms();
-    bool changed = false;
-
-    for (int i = 0; i < FEISHU_EVENT_DEDUP_MAX; i++) {
-        event_dedup_t *slot = &s_event_dedup[i];
-        if (!slot->used) continue;
-        if (t - slot->ts_ms > FEISHU_EVENT_DEDUP_EXPIRE_MS) {
-            memset(slot, 0, sizeof(*slot));
-            changed = true;
-            continue;
-        }
-        if (strcmp(slot->key, key) == 0) {
-            if (changed) {
-                event_dedup_mark_dirty();
-            }
-            return true;
-        }
-    }
-    if (changed) {
-        event_dedup_mark_dirty();
-    }
-    return false;
+    if (s_dedup) event_dedup_flush(s_dedup, now_ms(), force);
 }
 
-static void event_dedup_mark_seen(const char *key)
+static const char *http_method_name(esp_http_client_method_t method)
 {
-    if (!s_event_dedup || !key || !key[0]) return;
-
-    int64_t t = now_ms();
-    int free_idx = -1;
-    int oldest_idx = 0;
-    int64_t oldest_ts = INT64_MAX;
-
-    for (int i = 0; i < FEISHU_EVENT_DEDUP_MAX; i++) {
-        event_dedup_t *slot = &s_event_dedup[i];
-        if (!slot->used) {
-            if (free_idx < 0) free_idx = i;
-            continue;
-        }
-        if (t - slot->ts_ms > FEISHU_EVENT_DEDUP_EXPIRE_MS) {
-            memset(slot, 0, sizeof(*slot));
-            event_dedup_mark_dirty();
-            if (free_idx < 0) free_idx = i;
-            continue;
-        }
-        if (strcmp(slot->key, key) == 0) {
-            slot->ts_ms = t;
-            event_dedup_mark_dirty();
-            event_dedup_maybe_flush(false);
-            return;
-        }
-        if (slot->ts_ms < oldest_ts) {
-            oldest_ts = slot->ts_ms;
-            oldest_idx = i;
-        }
+    switch (method) {
+    case HTTP_METHOD_POST:   return "POST";
+    case HTTP_METHOD_PUT:    return "PUT";
+    case HTTP_METHOD_PATCH:  return "PATCH";
+    case HTTP_METHOD_DELETE: return "DELETE";
+    default:                 return "GET";
     }
-
-    int idx = (free_idx >= 0) ? free_idx : oldest_idx;
-    event_dedup_t *slot = &s_event_dedup[idx];
-    memset(slot, 0, sizeof(*slot));
-    slot->used = true;
-    str_copy(slot->key, sizeof(slot->key), key);
-    slot->ts_ms = t;
-    event_dedup_mark_dirty();
-    event_dedup_maybe_flush(false);
-}
-
-static esp_err_t http_event_handler(esp_http_client_event_t *evt)
-{
-    http_resp_t *resp = (http_resp_t *)evt->user_data;
-    if (!resp || evt->event_id != HTTP_EVENT_ON_DATA) {
-        return ESP_OK;
-    }
-
-    if (resp->len + evt->data_len + 1 > resp->cap) {
-        size_t new_cap = resp->cap ? resp->cap * 2 : 1024;
-        while (new_cap < resp->len + evt->data_len + 1) {
-            new_cap *= 2;
-        }
-        char *tmp = realloc(resp->buf, new_cap);
-        if (!tmp) {
-            return ESP_ERR_NO_MEM;
-        }
-        resp->buf = tmp;
-        resp->cap = new_cap;
-    }
-
-    memcpy(resp->buf + resp->len, evt->data, evt->data_len);
-    resp->len += evt->data_len;
-    resp->buf[resp->len] = '\0';
-    return ESP_OK;
 }
 
 static esp_err_t http_json_request(const char *url,
@@ -408,56 +226,28 @@ static esp_err_t http_json_request(const char *url,
     *resp_out = NULL;
     if (status_out) *status_out = 0;
 
-    http_resp_t resp = {
-        .buf = calloc(1, 1024),
-        .len = 0,
-        .cap = 1024,
-    };
-    if (!resp.buf) {
-        return ESP_ERR_NO_MEM;
+    char headers[768];
+    int off = snprintf(headers, sizeof(headers),
+                       "Content-Type: application/json; charset=utf-8\r\n");
+    if (bearer_token && bearer_token[0]) {
+        snprintf(headers + off, sizeof(headers) - off,
+                 "Authorization: Bearer %s\r\n", bearer_token);
     }
 
-    esp_http_client_config_t cfg = {
+    conn_pool_req_t req = {
+        .method = http_method_name(method),
         .url = url,
-        .method = method,
-        .event_handler = http_event_handler,
-        .user_data = &resp,
+        .headers = headers,
+        .body = body,
+        .body_len = body ? strlen(body) : 0,
         .timeout_ms = timeout_ms,
-        .buffer_size = 4096,
-        .buffer_size_tx = 4096,
-        .crt_bundle_attach = esp_crt_bundle_attach,
     };
 
-    esp_http_client_handle_t client = esp_http_client_init(&cfg);
-    if (!client) {
-        free(resp.buf);
-        return ESP_FAIL;
-    }
-
-    esp_http_client_set_header(client, "Content-Type", "application/json; charset=utf-8");
-    if (bearer_token && bearer_token[0]) {
-        char auth[720];
-        snprintf(auth, sizeof(auth), "Bearer %s", bearer_token);
-        esp_http_client_set_header(client, "Authorization", auth);
-    }
-
-    if (body) {
-        esp_http_client_set_post_field(client, body, (int)strlen(body));
-    }
-
-    esp_err_t err = esp_http_client_perform(client);
-    int status = esp_http_client_get_status_code(client);
-    esp_http_client_cleanup(client);
-
-    if (status_out) *status_out = status;
-
+    esp_err_t err = conn_pool_http_collect(&req, FEISHU_RESP_MAX, resp_out, NULL, status_out);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "HTTP request failed: %s url=%s", esp_err_to_name(err), url);
-        free(resp.buf);
         return err;
     }
-
-    *resp_out = resp.buf;
     return ESP_OK;
 }
 
@@ -537,11 +327,7 @@ static int parse_url_query_int(const char *url, const char *key, int fallback)
 static void chunk_slot_clear(chunk_cache_t *slot)
 {
     if (!slot) return;
-    for (int i = 0; i < FEISHU_CHUNK_MAX; i++) {
-        free(slot->parts[i]);
-        slot->parts[i] = NULL;
-        slot->part_lens[i] = 0;
-    }
+    free(slot->slab);
     memset(slot, 0, sizeof(*slot));
 }
 
@@ -591,27 +377,81 @@ static chunk_cache_t *chunk_cache_find_or_alloc(const char *message_id, int sum,
     return free_slot;
 }
 
+/* Copy one part into the slot's slab, growing it only if the estimate from
+ * the first part (sum x its length) was short. Every part fits one frame, so
+ * a complete event is at most FEISHU_CHUNK_MERGED_MAX. */
+static esp_err_t chunk_slab_append(chunk_cache_t *slot, int seq, const uint8_t *part, size_t part_len)
+{
+    if (slot->slab_len + part_len > slot->slab_cap) {
+        size_t cap = slot->slab_cap ? slot->slab_cap * 2 : (size_t)slot->sum * part_len;
+        if (cap < 256) cap = 256;
+        while (cap < slot->slab_len + part_len) cap *= 2;
+        if (cap > FEISHU_CHUNK_MERGED_MAX) cap = FEISHU_CHUNK_MERGED_MAX;
+        if (cap < slot->slab_len + part_len) {
+            ESP_LOGW(TAG, "Chunked event %s exceeds %d bytes, dropped",
+                     slot->message_id, FEISHU_CHUNK_MERGED_MAX);
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        uint8_t *slab = heap_caps_realloc(slot->slab, cap, MALLOC_CAP_SPIRAM);
+        if (!slab) return ESP_ERR_NO_MEM;
+        slot->slab = slab;
+        slot->slab_cap = cap;
+    }
+    memcpy(slot->slab + slot->slab_len, part, part_len);
+    slot->part_off[seq] = (uint32_t)slot->slab_len;
+    slot->part_len[seq] = (uint32_t)part_len;
+    slot->slab_len += part_len;
+    slot->have |= 1u << seq;
+    slot->got++;
+    return ESP_OK;
+}
+
+/* Put parts in seq order; only needed when they arrived out of order */
+static esp_err_t chunk_slab_order(chunk_cache_t *slot)
+{
+    size_t off = 0;
+    bool ordered = true;
+    for (int i = 0; i < slot->sum && ordered; i++) {
+        ordered = (slot->part_off[i] == off);
+        off += slot->part_len[i];
+    }
+    if (ordered) return ESP_OK;
+
+    uint8_t *buf = heap_caps_malloc(slot->slab_len, MALLOC_CAP_SPIRAM);
+    if (!buf) return ESP_ERR_NO_MEM;
+    off = 0;
+    for (int i = 0; i < slot->sum; i++) {
+        memcpy(buf + off, slot->slab + slot->part_off[i], slot->part_len[i]);
+        slot->part_off[i] = (uint32_t)off;
+        off += slot->part_len[i];
+    }
+    free(slot->slab);
+    slot->slab = buf;
+    slot->slab_cap = slot->slab_len;
+    return ESP_OK;
+}
+
+/*
+ * Collect a part. A single-part event is returned as is (still pointing into
+ * the receive buffer, *slot_out NULL). For multi-part events the merged bytes
+ * live in *slot_out's slab; release it with chunk_slot_clear() when done.
+ */
 static esp_err_t chunk_merge_payload(const char *message_id,
                                      int sum,
                                      int seq,
                                      const char *trace_id,
-                                     const uint8_t *part,
-                                     size_t part_len,
-                                     uint8_t **merged,
-                                     size_t *merged_len)
+                                     pb_slice_t part,
+                                     pb_slice_t *merged,
+                                     chunk_cache_t **slot_out)
 {
-    if (!message_id || !part || !merged || !merged_len) {
+    if (!message_id || !part.p || !merged || !slot_out) {
         return ESP_ERR_INVALID_ARG;
     }
-    *merged = NULL;
-    *merged_len = 0;
+    *slot_out = NULL;
 
     if (sum <= 1) {
-        uint8_t *buf = malloc(part_len);
-        if (!buf) return ESP_ERR_NO_MEM;
-        memcpy(buf, part, part_len);
-        *merged = buf;
-        *merged_len = part_len;
+        *merged = part;
         return ESP_OK;
     }
 
@@ -622,42 +462,26 @@ static esp_err_t chunk_merge_payload(const char *message_id,
     chunk_cache_t *slot = chunk_cache_find_or_alloc(message_id, sum, trace_id);
     if (!slot) return ESP_FAIL;
 
-    if (!slot->parts[seq]) {
-        slot->parts[seq] = malloc(part_len);
-        if (!slot->parts[seq]) {
-            return ESP_ERR_NO_MEM;
+    if (!(slot->have & (1u << seq))) {
+        esp_err_t err = chunk_slab_append(slot, seq, part.p, part.len);
+        if (err != ESP_OK) {
+            chunk_slot_clear(slot);
+            return err;
         }
-        memcpy(slot->parts[seq], part, part_len);
-        slot->part_lens[seq] = part_len;
-        slot->got++;
     }
 
     if (slot->got < slot->sum) {
         return ESP_ERR_NOT_FINISHED;
     }
 
-    size_t total = 0;
-    for (int i = 0; i < slot->sum; i++) {
-        if (!slot->parts[i]) {
-            return ESP_ERR_NOT_FOUND;
-        }
-        total += slot->part_lens[i];
-    }
-
-    uint8_t *buf = malloc(total);
-    if (!buf) {
-        return ESP_ERR_NO_MEM;
-    }
-
-    size_t off = 0;
-    for (int i = 0; i < slot->sum; i++) {
-        memcpy(buf + off, slot->parts[i], slot->part_lens[i]);
-        off += slot->part_lens[i];
+    esp_err_t err = chunk_slab_order(slot);
+    if (err != ESP_OK) {
+        chunk_slot_clear(slot);
+        return err;
     }
-
-    *merged = buf;
-    *merged_len = total;
-    chunk_slot_clear(slot);
+    merged->p = slot->slab;
+    merged->len = slot->slab_len;
+    *slot_out = slot;
     return ESP_OK;
 }
 
@@ -702,14 +526,6 @@ static bool pb_write_tag(pb_writer_t *w, uint32_t field, uint32_t wire_type)
     return pb_write_varint(w, tag);
 }
 
-static bool pb_write_string_field(pb_writer_t *w, uint32_t field, const char *str)
-{
-    if (!pb_write_tag(w, field, 2)) return false;
-    size_t len = str ? strlen(str) : 0;
-    if (!pb_write_varint(w, len)) return false;
-    return len ? pb_writer_put(w, str, len) : true;
-}
-
 static bool pb_write_bytes_field(pb_writer_t *w, uint32_t field, const uint8_t *bytes, size_t len)
 {
     if (!pb_write_tag(w, field, 2)) return false;
@@ -769,19 +585,6 @@ static bool pb_skip_field(const uint8_t *buf, size_t len, size_t *off, uint32_t
     }
 }
 
-static void pb_copy_string(char *dst, size_t dst_size, const uint8_t *src, size_t src_len)
-{
-    if (dst_size == 0) return;
-    if (!src || src_len == 0) {
-        dst[0] = '\0';
-        return;
-    }
-    size_t n = src_len;
-    if (n >= dst_size) n = dst_size - 1;
-    memcpy(dst, src, n);
-    dst[n] = '\0';
-}
-
 static bool pb_decode_header(const uint8_t *buf, size_t len, pb_header_t *header)
 {
     memset(header, 0, sizeof(*header));
@@ -799,12 +602,12 @@ static bool pb_decode_header(const uint8_t *buf, size_t len, pb_header_t *header
         size_t l = 0;
         if (!pb_read_len_delim(buf, len, &off, &p, &l)) return false;
         if (field == 1) {
-            pb_copy_string(header->key, sizeof(header->key), p, l);
+            header->key = (pb_slice_t){ p, l };
         } else if (field == 2) {
-            pb_copy_string(header->value, sizeof(header->value), p, l);
+            header->value = (pb_slice_t){ p, l };
         }
     }
-    return header->key[0] != '\0';
+    return header->key.len > 0;
 }
 
 static bool pb_decode_frame(const uint8_t *buf, size_t len, pb_frame_t *frame)
@@ -843,8 +646,8 @@ static bool pb_decode_frame(const uint8_t *buf, size_t len, pb_frame_t *frame)
             const uint8_t *sub = NULL;
             size_t sub_len = 0;
             if (!pb_read_len_delim(buf, len, &off, &sub, &sub_len)) return false;
-            if (frame->header_count < FEISHU_MAX_HEADERS) {
-                pb_decode_header(sub, sub_len, &frame->headers[frame->header_count]);
+            if (frame->header_count < FEISHU_MAX_HEADERS &&
+                pb_decode_header(sub, sub_len, &frame->headers[frame->header_count])) {
                 frame->header_count++;
             }
             continue;
@@ -855,12 +658,7 @@ static bool pb_decode_frame(const uint8_t *buf, size_t len, pb_frame_t *frame)
             const uint8_t *p = NULL;
             size_t l = 0;
             if (!pb_read_len_delim(buf, len, &off, &p, &l)) return false;
-            if (l > 0) {
-                frame->payload = malloc(l);
-                if (!frame->payload) return false;
-                memcpy(frame->payload, p, l);
-            }
-            frame->payload_len = l;
+            frame->payload = (pb_slice_t){ p, l };
             continue;
         }
 
@@ -872,14 +670,6 @@ static bool pb_decode_frame(const uint8_t *buf, size_t len, pb_frame_t *frame)
     return has_seq && has_log && has_service && has_method;
 }
 
-static void pb_frame_free(pb_frame_t *frame)
-{
-    if (!frame) return;
-    free(frame->payload);
-    frame->payload = NULL;
-    frame->payload_len = 0;
-}
-
 static bool pb_encode_frame(const pb_frame_t *frame, uint8_t **out, size_t *out_len)
 {
     *out = NULL;
@@ -895,16 +685,17 @@ static bool pb_encode_frame(const pb_frame_t *frame, uint8_t **out, size_t *out_
 
     for (size_t i = 0; ok && i < frame->header_count; i++) {
         pb_writer_t sub = {0};
-        ok = ok && pb_write_string_field(&sub, 1, frame->headers[i].key);
-        ok = ok && pb_write_string_field(&sub, 2, frame->headers[i].value);
+        const pb_header_t *h = &frame->headers[i];
+        ok = ok && pb_write_bytes_field(&sub, 1, h->key.p, h->key.len);
+        ok = ok && pb_write_bytes_field(&sub, 2, h->value.p, h->value.len);
         ok = ok && pb_write_tag(&w, 5, 2);
         ok = ok && pb_write_varint(&w, sub.len);
         ok = ok && pb_writer_put(&w, sub.buf, sub.len);
         free(sub.buf);
     }
 
-    if (ok && frame->payload && frame->payload_len > 0) {
-        ok = pb_write_bytes_field(&w, 8, frame->payload, frame->payload_len);
+    if (ok && frame->payload.len > 0) {
+        ok = pb_write_bytes_field(&w, 8, frame->payload.p, frame->payload.len);
     }
 
     if (!ok) {
@@ -917,17 +708,43 @@ static bool pb_encode_frame(const pb_frame_t *frame, uint8_t **out, size_t *out_
     return true;
 }
 
-static const char *frame_header_get(const pb_frame_t *frame, const char *key)
+static const pb_slice_t *frame_header_get(const pb_frame_t *frame, const char *key)
 {
     if (!frame || !key) return NULL;
+    size_t klen = strlen(key);
     for (size_t i = 0; i < frame->header_count; i++) {
-        if (strcmp(frame->headers[i].key, key) == 0) {
-            return frame->headers[i].value;
+        const pb_header_t *h = &frame->headers[i];
+        if (h->key.len == klen && memcmp(h->key.p, key, klen) == 0) {
+            return &h->value;
         }
     }
     return NULL;
 }
 
+static bool slice_eq(const pb_slice_t *s, const char *str)
+{
+    size_t n = strlen(str);
+    return s && s->len == n && memcmp(s->p, str, n) == 0;
+}
+
+/* NUL-terminated copy for the few short values that need one */
+static void slice_copy(char *dst, size_t dst_size, const pb_slice_t *s)
+{
+    if (dst_size == 0) return;
+    size_t n = s ? s->len : 0;
+    if (n >= dst_size) n = dst_size - 1;
+    if (n) memcpy(dst, s->p, n);
+    dst[n] = '\0';
+}
+
+static int slice_atoi(const pb_slice_t *s, int fallback)
+{
+    if (!s || s->len == 0) return fallback;
+    char tmp[16];
+    slice_copy(tmp, sizeof(tmp), s);
+    return atoi(tmp);
+}
+
 static esp_err_t ws_send_frame(const pb_frame_t *frame)
 {
     if (!s_ws_transport) {
@@ -957,8 +774,8 @@ static esp_err_t ws_send_ping(void)
     frame.service = s_ws_service_id;
     frame.method = 0;
     frame.header_count = 1;
-    str_copy(frame.headers[0].key, sizeof(frame.headers[0].key), "type");
-    str_copy(frame.headers[0].value, sizeof(frame.headers[0].value), "ping");
+    frame.headers[0].key = PB_SLICE_LIT("type");
+    frame.headers[0].value = PB_SLICE_LIT("ping");
     return ws_send_frame(&frame);
 }
 
@@ -983,12 +800,9 @@ static esp_err_t ws_send_event_ack(const pb_frame_t *req, int code)
     if (resp.header_count > FEISHU_MAX_HEADERS) {
         resp.header_count = FEISHU_MAX_HEADERS;
     }
-    for (size_t i = 0; i < resp.header_count; i++) {
-        str_copy(resp.headers[i].key, sizeof(resp.headers[i].key), req->headers[i].key);
-        str_copy(resp.headers[i].value, sizeof(resp.headers[i].value), req->headers[i].value);
-    }
-    resp.payload = (uint8_t *)ack_json;
-    resp.payload_len = strlen(ack_json);
+    /* Echo the request headers; they still point into the receive buffer */
+    memcpy(resp.headers, req->headers, resp.header_count * sizeof(pb_header_t));
+    resp.payload = (pb_slice_t){ (const uint8_t *)ack_json, strlen(ack_json) };
 
     esp_err_t err = ws_send_frame(&resp);
     free(ack_json);
@@ -1093,35 +907,11 @@ static esp_err_t feishu_get_tenant_token(char *out, size_t out_size)
     return ESP_OK;
 }
 
-static esp_err_t feishu_send_via_im(const char *chat_id, const char *text)
+/* Call an im/v1/messages endpoint with the tenant token, refreshing it once
+ * on 401. On success, data.message_id is copied to msg_id_out if given. */
+static esp_err_t feishu_im_request(const char *url, esp_http_client_method_t method,
+                                   const char *body, char *msg_id_out, size_t msg_id_size)
 {
-    if (!chat_id || !chat_id[0] || !text || !text[0]) {
-        return ESP_ERR_INVALID_ARG;
-    }
-    if (!s_app_id[0] || !s_app_secret[0]) {
-        return ESP_ERR_INVALID_STATE;
-    }
-
-    cJSON *content = cJSON_CreateObject();
-    cJSON_AddStringToObject(content, "text", text);
-    char *content_str = cJSON_PrintUnformatted(content);
-    cJSON_Delete(content);
-    if (!content_str) {
-        return ESP_ERR_NO_MEM;
-    }
-
-    cJSON *req = cJSON_CreateObject();
-    cJSON_AddStringToObject(req, "receive_id", chat_id);
-    cJSON_AddStringToObject(req, "msg_type", "text");
-    cJSON_AddStringToObject(req, "content", content_str);
-    free(content_str);
-
-    char *body = cJSON_PrintUnformatted(req);
-    cJSON_Delete(req);
-    if (!body) {
-        return ESP_ERR_NO_MEM;
-    }
-
     esp_err_t err = ESP_FAIL;
     for (int attempt = 0; attempt < 2; attempt++) {
         char token[640];
@@ -1132,7 +922,7 @@ static esp_err_t feishu_send_via_im(const char *chat_id, const char *text)
 
         char *resp = NULL;
         int status = 0;
-        err = http_json_request(FEISHU_SEND_MSG_URL, HTTP_METHOD_POST, token, body,
+        err = http_json_request(url, method, token, body,
                                 FEISHU_HTTP_TIMEOUT_MS, &resp, &status);
         if (err != ESP_OK) {
             free(resp);
@@ -1147,7 +937,7 @@ static esp_err_t feishu_send_via_im(const char *chat_id, const char *text)
         }
 
         if (status != 200) {
-            ESP_LOGE(TAG, "im/v1/messages HTTP %d chat=%s resp=%.200s", status, chat_id, resp ? resp : "");
+            ESP_LOGE(TAG, "im/v1/messages HTTP %d url=%s resp=%.200s", status, url, resp ? resp : "");
             free(resp);
             err = ESP_FAIL;
             break;
@@ -1169,14 +959,120 @@ static esp_err_t feishu_send_via_im(const char *chat_id, const char *text)
             err = ESP_FAIL;
             break;
         }
+        if (msg_id_out && msg_id_size) {
+            cJSON *data = cJSON_GetObjectItem(root, "data");
+            cJSON *mid = cJSON_GetObjectItem(data, "message_id");
+            str_copy(msg_id_out, msg_id_size, cJSON_IsString(mid) ? mid->valuestring : "");
+        }
         cJSON_Delete(root);
         err = ESP_OK;
         break;
     }
+    return err;
+}
+
+/* Build {"msg_type":"text","content":"{\"text\":...}"}, plus receive_id for sends */
+static char *feishu_text_body(const char *receive_id, const char *text)
+{
+    cJSON *content = cJSON_CreateObject();
+    cJSON_AddStringToObject(content, "text", text);
+    char *content_str = cJSON_PrintUnformatted(content);
+    cJSON_Delete(content);
+    if (!content_str) {
+        return NULL;
+    }
+
+    cJSON *req = cJSON_CreateObject();
+    if (receive_id) {
+        cJSON_AddStringToObject(req, "receive_id", receive_id);
+    }
+    cJSON_AddStringToObject(req, "msg_type", "text");
+    cJSON_AddStringToObject(req, "content", content_str);
+    free(content_str);
+
+    char *body = cJSON_PrintUnformatted(req);
+    cJSON_Delete(req);
+    return body;
+}
+
+static esp_err_t feishu_send_via_im(const char *chat_id, const char *text,
+                                    char *msg_id_out, size_t msg_id_size)
+{
+    if (!chat_id || !chat_id[0] || !text || !text[0]) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_app_id[0] || !s_app_secret[0]) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    char *body = feishu_text_body(chat_id, text);
+    if (!body) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t err = feishu_im_request(FEISHU_SEND_MSG_URL, HTTP_METHOD_POST, body,
+                                      msg_id_out, msg_id_size);
     free(body);
     return err;
 }
 
+static esp_err_t feishu_edit_via_im(const char *message_id, const char *text)
+{
+    if (!message_id || !message_id[0] || !text || !text[0]) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    char url[FEISHU_URL_MAX];
+    snprintf(url, sizeof(url), FEISHU_EDIT_MSG_URL_FMT, message_id);
+
+    char *body = feishu_text_body(NULL, text);
+    if (!body) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t err = feishu_im_request(url, HTTP_METHOD_PUT, body, NULL, 0);
+    free(body);
+    return err;
+}
+
+/* ── Streaming drafts ─────────────────────────────────────────── */
+
+static feishu_draft_t *feishu_draft_find(const char *chat_id)
+{
+    for (int i = 0; i < MIMI_FEISHU_DRAFT_MAX; i++) {
+        if (s_drafts[i].used && strcmp(s_drafts[i].chat_id, chat_id) == 0) {
+            return &s_drafts[i];
+        }
+    }
+    return NULL;
+}
+
+static feishu_draft_t *feishu_draft_claim(const char *chat_id)
+{
+    feishu_draft_t *slot = NULL;
+    for (int i = 0; i < MIMI_FEISHU_DRAFT_MAX; i++) {
+        feishu_draft_t *d = &s_drafts[i];
+        if (!d->used) {
+            slot = d;
+            break;
+        }
+        if (!slot || d->last_edit_ms < slot->last_edit_ms) {
+            slot = d;
+        }
+    }
+
+    char *text = slot->text;
+    if (!text) {
+        text = heap_caps_calloc(1, FEISHU_DRAFT_TEXT_MAX + 1, MALLOC_CAP_SPIRAM);
+        if (!text) {
+            return NULL;
+        }
+    }
+    memset(slot, 0, sizeof(*slot));
+    slot->used = true;
+    slot->text = text;
+    str_copy(slot->chat_id, sizeof(slot->chat_id), chat_id);
+    return slot;
+}
+
 static esp_err_t feishu_pull_ws_connect_config(char *url_out, size_t url_out_size)
 {
     if (!url_out || url_out_size == 0) return ESP_ERR_INVALID_ARG;
@@ -1279,7 +1175,7 @@ static esp_err_t feishu_event_to_bus(cJSON *root)
              chat_id ? chat_id : "", sender_key, create_time ? create_time : "",
              (unsigned long)content_hash);
 
-    if (event_dedup_contains(dedup_key) || event_dedup_contains(semantic_key)) {
+    if (dedup_contains(dedup_key) || dedup_contains(semantic_key)) {
         ESP_LOGI(TAG, "Drop duplicate Feishu event id=%s", dedup_key ? dedup_key : "");
         return ESP_OK;
     }
@@ -1320,7 +1216,11 @@ static esp_err_t feishu_event_to_bus(cJSON *root)
     str_copy(msg.channel, sizeof(msg.channel), MIMI_CHAN_FEISHU);
     str_copy(msg.chat_id, sizeof(msg.chat_id), chat_id);
     msg.content = owned_text;
+    const char *chat_type = json_obj_get_str(message, "chat_type");
+    if (chat_type && strcmp(chat_type, "group") == 0) msg.prio = MIMI_PRIO_LOW;
 
+    /* Log first: once pushed, the bus may merge and free msg.content */
+    ESP_LOGI(TAG, "Feishu inbound event -> bus chat=%s text=%.48s", msg.chat_id, msg.content);
     esp_err_t err = message_bus_push_inbound(&msg);
     if (err != ESP_OK) {
         free(owned_text);
@@ -1328,24 +1228,18 @@ static esp_err_t feishu_event_to_bus(cJSON *root)
         return err;
     }
 
-    event_dedup_mark_seen(dedup_key);
-    event_dedup_mark_seen(semantic_key);
-    ESP_LOGI(TAG, "Feishu inbound event -> bus chat=%s text=%.48s", msg.chat_id, msg.content);
+    dedup_mark_seen(dedup_key, create_time);
+    dedup_mark_seen(semantic_key, create_time);
     return ESP_OK;
 }
 
 static void feishu_ws_handle_control_frame(const pb_frame_t *frame)
 {
-    const char *type = frame_header_get(frame, "type");
+    const pb_slice_t *type = frame_header_get(frame, "type");
     if (!type) return;
 
-    if (strcmp(type, "pong") == 0 && frame->payload && frame->payload_len > 0) {
-        char *payload = calloc(1, frame->payload_len + 1);
-        if (!payload) return;
-        memcpy(payload, frame->payload, frame->payload_len);
-
-        cJSON *root = cJSON_Parse(payload);
-        free(payload);
+    if (slice_eq(type, "pong") && frame->payload.len > 0) {
+        cJSON *root = cJSON_ParseWithLength((const char *)frame->payload.p, frame->payload.len);
         if (!root) return;
 
         cJSON *ping = cJSON_GetObjectItem(root, "PingInterval");
@@ -1361,58 +1255,50 @@ static void feishu_ws_handle_control_frame(const pb_frame_t *frame)
         return;
     }
 
-    const char *hs = frame_header_get(frame, "handshake-status");
-    const char *hs_msg = frame_header_get(frame, "handshake-msg");
-    if (hs && strcmp(hs, "0") != 0) {
-        ESP_LOGW(TAG, "Feishu handshake status=%s msg=%s", hs, hs_msg ? hs_msg : "");
+    const pb_slice_t *hs = frame_header_get(frame, "handshake-status");
+    if (hs && !slice_eq(hs, "0")) {
+        char status[16], msg[128];
+        slice_copy(status, sizeof(status), hs);
+        slice_copy(msg, sizeof(msg), frame_header_get(frame, "handshake-msg"));
+        ESP_LOGW(TAG, "Feishu handshake status=%s msg=%s", status, msg);
     }
 }
 
 static void feishu_ws_handle_data_frame(const pb_frame_t *frame)
 {
-    const char *type = frame_header_get(frame, "type");
-    if (!type || strcmp(type, "event") != 0) {
+    if (!slice_eq(frame_header_get(frame, "type"), "event")) {
         return;
     }
 
-    const char *message_id = frame_header_get(frame, "message_id");
-    const char *sum_s = frame_header_get(frame, "sum");
-    const char *seq_s = frame_header_get(frame, "seq");
-    const char *trace_id = frame_header_get(frame, "trace_id");
-    int sum = sum_s ? atoi(sum_s) : 1;
-    int seq = seq_s ? atoi(seq_s) : 0;
+    const pb_slice_t *message_id_s = frame_header_get(frame, "message_id");
+    char message_id[64], trace_id[64];
+    slice_copy(message_id, sizeof(message_id), message_id_s);
+    slice_copy(trace_id, sizeof(trace_id), frame_header_get(frame, "trace_id"));
+    int sum = slice_atoi(frame_header_get(frame, "sum"), 1);
+    int seq = slice_atoi(frame_header_get(frame, "seq"), 0);
 
-    if (!message_id || !frame->payload) {
+    if (!message_id_s || !frame->payload.p) {
         ws_send_event_ack(frame, 500);
         return;
     }
 
-    uint8_t *merged = NULL;
-    size_t merged_len = 0;
+    pb_slice_t merged = {0};
+    chunk_cache_t *slot = NULL;
     esp_err_t merge_err = chunk_merge_payload(message_id, sum, seq, trace_id,
-                                              frame->payload, frame->payload_len,
-                                              &merged, &merged_len);
+                                              frame->payload, &merged, &slot);
     if (merge_err == ESP_ERR_NOT_FINISHED) {
         return;
     }
-    if (merge_err != ESP_OK || !merged || merged_len == 0) {
+    if (merge_err != ESP_OK || merged.len == 0) {
         ESP_LOGW(TAG, "Feishu chunk merge failed message_id=%s", message_id);
         ws_send_event_ack(frame, 500);
-        free(merged);
-        return;
-    }
-
-    char *json = calloc(1, merged_len + 1);
-    if (!json) {
-        free(merged);
-        ws_send_event_ack(frame, 500);
+        chunk_slot_clear(slot);
         return;
     }
-    memcpy(json, merged, merged_len);
-    free(merged);
 
-    cJSON *root = cJSON_Parse(json);
-    free(json);
+    /* Parsed where it lies: receive buffer or the slot's slab */
+    cJSON *root = cJSON_ParseWithLength((const char *)merged.p, merged.len);
+    chunk_slot_clear(slot);
     if (!root) {
         ws_send_event_ack(frame, 500);
         return;
@@ -1425,68 +1311,60 @@ static void feishu_ws_handle_data_frame(const pb_frame_t *frame)
 
 static void feishu_ws_process_binary(const uint8_t *data, size_t len)
 {
-    pb_frame_t *frame = calloc(1, sizeof(pb_frame_t));
-    if (!frame) {
-        ESP_LOGW(TAG, "No memory for Feishu protobuf frame");
-        return;
-    }
-
-    if (!pb_decode_frame(data, len, frame)) {
+    pb_frame_t frame;
+    if (!pb_decode_frame(data, len, &frame)) {
         ESP_LOGW(TAG, "Failed to decode Feishu protobuf frame");
-        free(frame);
         return;
     }
 
-    if (frame->method == 0) {
-        feishu_ws_handle_control_frame(frame);
-    } else if (frame->method == 1) {
-        feishu_ws_handle_data_frame(frame);
+    if (frame.method == 0) {
+        feishu_ws_handle_control_frame(&frame);
+    } else if (frame.method == 1) {
+        feishu_ws_handle_data_frame(&frame);
     }
-    pb_frame_free(frame);
-    free(frame);
 }
 
 static void feishu_ws_rx_reset(void)
 {
-    free(s_ws_rx_buf);
-    s_ws_rx_buf = NULL;
     s_ws_rx_expected = 0;
     s_ws_rx_received = 0;
+    s_ws_rx_discard = false;
 }
 
-static void feishu_ws_handle_read_chunk(const uint8_t *chunk, size_t chunk_len, int payload_len)
+/* Read the next piece of the current frame into place; returns <0 on error */
+static int feishu_ws_read(void)
 {
-    if (!chunk || chunk_len == 0) {
-        return;
+    /* Past the end of an oversized frame, keep overwriting the start */
+    size_t off = s_ws_rx_discard ? 0 : s_ws_rx_received;
+    size_t room = FEISHU_WS_PAYLOAD_MAX - off;
+    if (s_ws_rx_expected) {
+        size_t left = s_ws_rx_expected - s_ws_rx_received;
+        if (left < room) room = left;
     }
 
-    if (s_ws_rx_expected == 0) {
-        size_t expected = (payload_len > 0) ? (size_t)payload_len : chunk_len;
-        if (expected < chunk_len) expected = chunk_len;
-        if (expected > FEISHU_WS_PAYLOAD_MAX) {
-            ESP_LOGW(TAG, "Drop too large ws payload: %u", (unsigned)expected);
-            return;
-        }
-        s_ws_rx_buf = malloc(expected);
-        if (!s_ws_rx_buf) {
-            return;
-        }
-        s_ws_rx_expected = expected;
-        s_ws_rx_received = 0;
-    }
+    int r = esp_transport_read(s_ws_transport, (char *)s_ws_rx_buf + off, (int)room, 200);
+    if (r <= 0) return r;
 
-    if (!s_ws_rx_buf || s_ws_rx_received + chunk_len > s_ws_rx_expected) {
-        feishu_ws_rx_reset();
-        return;
+    ws_transport_opcodes_t op = esp_transport_ws_get_read_opcode(s_ws_transport);
+    if (op != WS_TRANSPORT_OPCODES_BINARY && op != WS_TRANSPORT_OPCODES_CONT) {
+        return r;       /* control frame: landed past the data, ignored */
     }
 
-    memcpy(s_ws_rx_buf + s_ws_rx_received, chunk, chunk_len);
-    s_ws_rx_received += chunk_len;
+    if (s_ws_rx_expected == 0) {
+        int payload_len = esp_transport_ws_get_read_payload_len(s_ws_transport);
+        s_ws_rx_expected = (payload_len > r) ? (size_t)payload_len : (size_t)r;
+        if (s_ws_rx_expected > FEISHU_WS_PAYLOAD_MAX) {
+            ESP_LOGW(TAG, "Drop too large ws payload: %u", (unsigned)s_ws_rx_expected);
+            s_ws_rx_discard = true;
+        }
+    }
+    s_ws_rx_received += (size_t)r;
 
     if (s_ws_rx_received >= s_ws_rx_expected) {
-        feishu_ws_process_binary(s_ws_rx_buf, s_ws_rx_expected);
+        if (!s_ws_rx_discard) feishu_ws_process_binary(s_ws_rx_buf, s_ws_rx_expected);
         feishu_ws_rx_reset();
     }
+    return r;
 }
 
 static bool ws_parse_url(const char *url, bool *use_ssl,
@@ -1566,6 +1444,14 @@ static bool ws_client_connect(const char *url)
         return false;
     }
 
+    if (!s_ws_rx_buf) {
+        s_ws_rx_buf = heap_caps_malloc(FEISHU_WS_PAYLOAD_MAX, MALLOC_CAP_SPIRAM);
+        if (!s_ws_rx_buf) {
+            ESP_LOGE(TAG, "No memory for ws receive buffer");
+            return false;
+        }
+    }
+
     esp_transport_handle_t base = use_ssl ? esp_transport_ssl_init() : esp_transport_tcp_init();
     if (!base) {
         return false;
@@ -1631,18 +1517,10 @@ static void feishu_longconn_task(void *arg)
         uint32_t loop = 0;
 
         while (s_longconn_should_run && s_ws_transport) {
-            int r = esp_transport_read(s_ws_transport, (char *)s_ws_read_buf, sizeof(s_ws_read_buf), 200);
-            if (r < 0) {
+            if (feishu_ws_read() < 0) {
                 ESP_LOGW(TAG, "Feishu WS read error, reconnecting");
                 break;
             }
-            if (r > 0) {
-                ws_transport_opcodes_t op = esp_transport_ws_get_read_opcode(s_ws_transport);
-                if (op == WS_TRANSPORT_OPCODES_BINARY || op == WS_TRANSPORT_OPCODES_CONT) {
-                    int payload_len = esp_transport_ws_get_read_payload_len(s_ws_transport);
-                    feishu_ws_handle_read_chunk(s_ws_read_buf, (size_t)r, payload_len);
-                }
-            }
 
             int64_t t = now_ms();
             if (t >= next_ping) {
@@ -1654,7 +1532,7 @@ static void feishu_longconn_task(void *arg)
             }
             if ((loop++ % 10) == 0) {
                 chunk_cache_clear_expired();
-                event_dedup_maybe_flush(false);
+                dedup_flush(false);
             }
         }
 
@@ -1696,29 +1574,26 @@ esp_err_t feishu_bot_init(void)
     s_tenant_token_expire_ms = 0;
 
     memset(s_chunk_cache, 0, sizeof(s_chunk_cache));
-    if (!s_event_dedup) {
-        s_event_dedup = heap_caps_calloc(FEISHU_EVENT_DEDUP_MAX, sizeof(event_dedup_t), MALLOC_CAP_SPIRAM);
-        if (!s_event_dedup) {
-            s_event_dedup = heap_caps_calloc(FEISHU_EVENT_DEDUP_MAX, sizeof(event_dedup_t), MALLOC_CAP_8BIT);
+    if (!s_dedup) {
+        s_dedup = heap_caps_malloc(sizeof(event_dedup_t), MALLOC_CAP_SPIRAM);
+        if (!s_dedup) {
+            s_dedup = heap_caps_malloc(sizeof(event_dedup_t), MALLOC_CAP_8BIT);
         }
-        if (!s_event_dedup) {
+        if (!s_dedup) {
             ESP_LOGW(TAG, "Failed to allocate dedup cache (%d), duplicate filtering disabled",
                      FEISHU_EVENT_DEDUP_MAX);
         }
-    } else {
-        memset(s_event_dedup, 0, FEISHU_EVENT_DEDUP_MAX * sizeof(event_dedup_t));
-    }
-    s_event_dedup_dirty = false;
-    s_event_dedup_dirty_writes = 0;
-    s_event_dedup_last_flush_ms = now_ms();
-    if (s_event_dedup) {
-        esp_err_t load_err = event_dedup_load_from_disk();
-        if (load_err == ESP_OK) {
-            ESP_LOGI(TAG, "Dedup cache loaded from disk (%d entries)", FEISHU_EVENT_DEDUP_MAX);
-        } else if (load_err != ESP_ERR_NOT_FOUND) {
-            ESP_LOGW(TAG, "Dedup cache load failed: %s", esp_err_to_name(load_err));
+    }
+    if (s_dedup) {
+        event_dedup_init(s_dedup, FEISHU_EVENT_DEDUP_FILE, FEISHU_EVENT_DEDUP_FILE_TMP, now_ms());
+        remove(FEISHU_EVENT_DEDUP_FILE_V1);
+
+        /* A log from before wall-clock records is discarded and rewritten */
+        esp_err_t load_err = event_dedup_load(s_dedup, now_ms(), dedup_wall_ms(NULL));
+        if (load_err != ESP_OK && load_err != ESP_ERR_NOT_FOUND) {
+            ESP_LOGW(TAG, "Dedup log load failed: %s", esp_err_to_name(load_err));
         }
-        event_dedup_maybe_flush(false);
+        dedup_flush(true);
     }
 
     ESP_LOGI(TAG, "Feishu init: webhook=%s app=%s default_chat=%s",
@@ -1753,7 +1628,7 @@ esp_err_t feishu_bot_start(void)
 
 esp_err_t feishu_bot_stop(void)
 {
-    event_dedup_maybe_flush(true);
+    dedup_flush(true);
     s_longconn_should_run = false;
     if (s_ws_transport) {
         esp_transport_close(s_ws_transport);
@@ -1882,7 +1757,17 @@ esp_err_t feishu_bot_send_message_to(const char *chat_id, const char *text)
             ESP_LOGW(TAG, "No chat_id provided for im/v1/messages");
             return ESP_ERR_INVALID_ARG;
         }
-        return feishu_send_via_im(target, text);
+
+        /* Replace a streamed draft in place; fall back to a new message */
+        feishu_draft_t *draft = feishu_draft_find(target);
+        if (draft) {
+            draft->used = false;
+            if (draft->message_id[0] &&
+                feishu_edit_via_im(draft->message_id, text) == ESP_OK) {
+                return ESP_OK;
+            }
+        }
+        return feishu_send_via_im(target, text, NULL, 0);
     }
 
     if (s_webhook_url[0]) {
@@ -1892,6 +1777,55 @@ esp_err_t feishu_bot_send_message_to(const char *chat_id, const char *text)
     return ESP_ERR_INVALID_STATE;
 }
 
+esp_err_t feishu_bot_send_delta(const char *chat_id, const char *text)
+{
+    if (!text || !text[0]) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    /* Webhooks cannot edit messages; the final reply is sent as usual */
+    if (!s_app_id[0] || !s_app_secret[0]) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    const char *target = (chat_id && chat_id[0]) ? chat_id : s_default_chat_id;
+    if (!target || !target[0]) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    feishu_draft_t *d = feishu_draft_find(target);
+    if (!d) d = feishu_draft_claim(target);
+    if (!d) return ESP_ERR_NO_MEM;
+    if (d->frozen) return ESP_OK;
+
+    size_t add = strlen(text);
+    if (d->len + add > FEISHU_DRAFT_TEXT_MAX) {
+        d->frozen = true;
+        return ESP_OK;
+    }
+    memcpy(d->text + d->len, text, add);
+    d->len += add;
+    d->text[d->len] = '\0';
+
+    int64_t t = now_ms();
+    if (d->message_id[0] && t - d->last_edit_ms < MIMI_FEISHU_EDIT_INTERVAL_MS) {
+        return ESP_OK;
+    }
+
+    esp_err_t err;
+    if (!d->message_id[0]) {
+        err = feishu_send_via_im(target, d->text, d->message_id, sizeof(d->message_id));
+    } else {
+        err = feishu_edit_via_im(d->message_id, d->text);
+        d->edits++;
+    }
+    d->last_edit_ms = t;
+
+    /* Keep the last edits in reserve for the final reply */
+    if (err != ESP_OK || !d->message_id[0] || d->edits >= MIMI_FEISHU_EDIT_MAX) {
+        d->frozen = true;
+    }
+    return err;
+}
+
 esp_err_t feishu_bot_send_message(const char *text)
 {
     return feishu_bot_send_message_to(s_default_chat_id, text);
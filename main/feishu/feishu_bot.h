@@ -29,3 +29,11 @@ const char *feishu_bot_get_default_chat_id(void);
 bool feishu_bot_is_configured(void);
 esp_err_t feishu_bot_send_message(const char *text);
 esp_err_t feishu_bot_send_message_to(const char *chat_id, const char *text);
+
+/*
+ * Append a partial-reply fragment to the chat's streaming draft (app-bot
+ * mode only). The draft message is edited at most once per
+ * MIMI_FEISHU_EDIT_INTERVAL_MS; feishu_bot_send_message_to() replaces it
+ * with the final text.
+ */
+esp_err_t feishu_bot_send_delta(const char *chat_id, const char *text);
@@ -131,8 +131,9 @@ static esp_err_t ws_handler(httpd_req_t *req)
         strncpy(msg.channel, MIMI_CHAN_WEBSOCKET, sizeof(msg.channel) - 1);
         strncpy(msg.chat_id, chat_id, sizeof(msg.chat_id) - 1);
         msg.content = strdup(content->valuestring);
-        if (msg.content) {
-            message_bus_push_inbound(&msg);
+        if (msg.content && message_bus_push_inbound(&msg) != ESP_OK) {
+            free(msg.content);
+            ws_server_send(chat_id, "Busy, please retry shortly.");
         }
     }
 
@@ -168,7 +169,7 @@ esp_err_t ws_server_start(void)
     return ESP_OK;
 }
 
-esp_err_t ws_server_send(const char *chat_id, const char *text)
+static esp_err_t ws_send_typed(const char *chat_id, const char *type, const char *text)
 {
     if (!s_server) return ESP_ERR_INVALID_STATE;
 
@@ -180,7 +181,7 @@ esp_err_t ws_server_send(const char *chat_id, const char *text)
 
     /* Build response JSON */
     cJSON *resp = cJSON_CreateObject();
-    cJSON_AddStringToObject(resp, "type", "response");
+    cJSON_AddStringToObject(resp, "type", type);
     cJSON_AddStringToObject(resp, "content", text);
     cJSON_AddStringToObject(resp, "chat_id", chat_id);
 
@@ -206,6 +207,16 @@ esp_err_t ws_server_send(const char *chat_id, const char *text)
     return ret;
 }
 
+esp_err_t ws_server_send(const char *chat_id, const char *text)
+{
+    return ws_send_typed(chat_id, "response", text);
+}
+
+esp_err_t ws_server_send_delta(const char *chat_id, const char *text)
+{
+    return ws_send_typed(chat_id, "delta", text);
+}
+
 esp_err_t ws_server_stop(void)
 {
     if (s_server) {
@@ -8,7 +8,8 @@
  *
  * Protocol:
  *   Inbound:  {"type":"message","content":"hello","chat_id":"ws_client1"}
- *   Outbound: {"type":"response","content":"Hi!","chat_id":"ws_client1"}
+ *   Outbound: {"type":"delta","content":"H","chat_id":"ws_client1"}     (zero or more)
+ *             {"type":"response","content":"Hi!","chat_id":"ws_client1"}  (full reply)
  */
 esp_err_t ws_server_start(void);
 
@@ -19,6 +20,12 @@ esp_err_t ws_server_start(void);
  */
 esp_err_t ws_server_send(const char *chat_id, const char *text);
 
+/**
+ * Send a partial-reply text fragment to a WebSocket client.
+ * The following "response" frame carries the complete text.
+ */
+esp_err_t ws_server_send_delta(const char *chat_id, const char *text);
+
 /**
  * Stop the WebSocket server.
  */
@@ -0,0 +1,226 @@
+#include "llm_body.h"
+#include "mimi_config.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+
+static const char *TAG = "llm_body";
+
+#define CACHE_MARK_FIELD ",\"cache_control\":{\"type\":\"ephemeral\"}"
+
+/* ── Growable PSRAM buffer ────────────────────────────────────── */
+
+static esp_err_t body_reserve(llm_body_t *b, size_t extra)
+{
+    if (b->len + extra + 1 <= b->cap) return ESP_OK;
+    size_t new_cap = b->cap ? b->cap : MIMI_LLM_BODY_INIT_SIZE;
+    while (b->len + extra + 1 > new_cap) new_cap *= 2;
+    if (new_cap > MIMI_LLM_BODY_MAX) {
+        ESP_LOGE(TAG, "Request body exceeds %d bytes", MIMI_LLM_BODY_MAX);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    char *tmp = heap_caps_realloc(b->buf, new_cap, MALLOC_CAP_SPIRAM);
+    if (!tmp) return ESP_ERR_NO_MEM;
+    b->buf = tmp;
+    b->cap = new_cap;
+    return ESP_OK;
+}
+
+static esp_err_t body_append(llm_body_t *b, const char *data, size_t len)
+{
+    esp_err_t err = body_reserve(b, len);
+    if (err != ESP_OK) return err;
+    memcpy(b->buf + b->len, data, len);
+    b->len += len;
+    b->buf[b->len] = '\0';
+    return ESP_OK;
+}
+
+static esp_err_t body_append_str(llm_body_t *b, const char *s)
+{
+    return body_append(b, s, strlen(s));
+}
+
+/* Print item in place at the end of the buffer, growing until it fits */
+static esp_err_t body_append_json(llm_body_t *b, cJSON *item)
+{
+    size_t want = 256;
+    while (1) {
+        esp_err_t err = body_reserve(b, want);
+        if (err != ESP_OK) return err;
+        size_t room = b->cap - b->len;
+        if (cJSON_PrintPreallocated(item, b->buf + b->len, (int)room, 0)) {
+            b->len += strlen(b->buf + b->len);
+            return ESP_OK;
+        }
+        want = room * 2;
+    }
+}
+
+/* ── Prompt caching ───────────────────────────────────────────── */
+
+/* The tools array, system prompt and history prefix are identical across
+ * turns and ReAct iterations. Ephemeral cache_control breakpoints on the
+ * last tool, the system block and the newest message let the API reuse
+ * them (3 of the 4 allowed breakpoints). */
+
+static void add_cache_mark(cJSON *block)
+{
+    cJSON *cc = cJSON_CreateObject();
+    cJSON_AddItemToObject(cc, "type", cJSON_CreateStringReference("ephemeral"));
+    cJSON_AddItemToObject(block, "cache_control", cc);
+}
+
+/* Text block that borrows text; freeing it leaves the string alone */
+static cJSON *text_block_ref(const char *text)
+{
+    cJSON *block = cJSON_CreateObject();
+    cJSON_AddItemToObject(block, "type", cJSON_CreateStringReference("text"));
+    cJSON_AddItemToObject(block, "text", cJSON_CreateStringReference(text));
+    return block;
+}
+
+/* Tools string verbatim; with caching, `...}]` becomes `...,"cache_control":{...}}]` */
+static esp_err_t append_tools(llm_body_t *b, const char *tools_json)
+{
+    size_t end = strlen(tools_json);
+#if MIMI_LLM_PROMPT_CACHE
+    while (end && isspace((unsigned char)tools_json[end - 1])) end--;
+    if (end >= 2 && tools_json[end - 1] == ']') {
+        size_t obj = end - 1;
+        while (obj && isspace((unsigned char)tools_json[obj - 1])) obj--;
+        if (obj && tools_json[obj - 1] == '}') {
+            esp_err_t err = body_append(b, tools_json, obj - 1);
+            if (err == ESP_OK) err = body_append_str(b, CACHE_MARK_FIELD);
+            if (err == ESP_OK) err = body_append(b, tools_json + obj - 1, end - obj + 1);
+            return err;
+        }
+    }
+#endif
+    return body_append(b, tools_json, end);
+}
+
+/* Newest message: encoded with the rolling breakpoint, caller's tree untouched */
+static esp_err_t append_last_message(llm_body_t *b, cJSON *msg)
+{
+#if MIMI_LLM_PROMPT_CACHE
+    cJSON *content = cJSON_GetObjectItem(msg, "content");
+    if (cJSON_IsString(content) && content->valuestring[0]) {
+        const char *role = cJSON_GetStringValue(cJSON_GetObjectItem(msg, "role"));
+        cJSON *tmp = cJSON_CreateObject();
+        cJSON_AddItemToObject(tmp, "role", cJSON_CreateStringReference(role ? role : "user"));
+        cJSON *arr = cJSON_AddArrayToObject(tmp, "content");
+        cJSON *block = text_block_ref(content->valuestring);
+        add_cache_mark(block);
+        cJSON_AddItemToArray(arr, block);
+        esp_err_t err = body_append_json(b, tmp);
+        cJSON_Delete(tmp);
+        return err;
+    }
+    if (cJSON_IsArray(content)) {
+        cJSON *last = cJSON_GetArrayItem(content, cJSON_GetArraySize(content) - 1);
+        if (cJSON_IsObject(last) && !cJSON_HasObjectItem(last, "cache_control")) {
+            add_cache_mark(last);
+            esp_err_t err = body_append_json(b, msg);
+            cJSON_DeleteItemFromObject(last, "cache_control");
+            return err;
+        }
+    }
+#endif
+    return body_append_json(b, msg);
+}
+
+/* ── Public API ───────────────────────────────────────────────── */
+
+void llm_body_init(llm_body_t *b)
+{
+    memset(b, 0, sizeof(*b));
+}
+
+esp_err_t llm_body_begin(llm_body_t *b, const char *model, int max_tokens,
+                         const char *system_prompt, const char *tools_json)
+{
+    b->len = 0;
+    b->head_len = 0;
+    b->committed_len = 0;
+    b->committed = 0;
+    b->messages = NULL;
+    b->last_encoded = 0;
+
+    cJSON *head = cJSON_CreateObject();
+    cJSON_AddItemToObject(head, "model", cJSON_CreateStringReference(model));
+    cJSON_AddNumberToObject(head, "max_tokens", max_tokens);
+    cJSON_AddBoolToObject(head, "stream", 1);
+#if MIMI_LLM_PROMPT_CACHE
+    if (system_prompt && system_prompt[0]) {
+        cJSON *system = cJSON_AddArrayToObject(head, "system");
+        cJSON *block = text_block_ref(system_prompt);
+        add_cache_mark(block);
+        cJSON_AddItemToArray(system, block);
+    }
+#else
+    cJSON_AddItemToObject(head, "system", cJSON_CreateStringReference(system_prompt));
+#endif
+    esp_err_t err = body_append_json(b, head);
+    cJSON_Delete(head);
+    if (err != ESP_OK) return err;
+
+    b->len--;   /* reopen the object: drop the closing brace */
+    if (tools_json) {
+        err = body_append_str(b, ",\"tools\":");
+        if (err == ESP_OK) err = append_tools(b, tools_json);
+    }
+    if (err == ESP_OK) err = body_append_str(b, ",\"messages\":[");
+    if (err != ESP_OK) return err;
+
+    b->head_len = b->len;
+    b->committed_len = b->len;
+    return ESP_OK;
+}
+
+esp_err_t llm_body_update(llm_body_t *b, cJSON *messages)
+{
+    if (!b->head_len) return ESP_ERR_INVALID_STATE;
+
+    if (messages != b->messages || cJSON_GetArraySize(messages) < b->committed) {
+        b->messages = messages;
+        b->committed = 0;
+        b->committed_len = b->head_len;
+    }
+
+    /* Drop the previous tail (marked newest message + closing) */
+    b->len = b->committed_len;
+    size_t start = b->len;
+
+    cJSON *item = messages->child;
+    for (int i = 0; i < b->committed && item; i++) item = item->next;
+
+    /* Everything but the newest message joins the prefix unmarked */
+    esp_err_t err = ESP_OK;
+    for (; item && item->next; item = item->next) {
+        if (b->committed) err = body_append(b, ",", 1);
+        if (err == ESP_OK) err = body_append_json(b, item);
+        if (err != ESP_OK) return err;
+        b->committed++;
+        b->committed_len = b->len;
+    }
+
+    if (item) {
+        if (b->committed) err = body_append(b, ",", 1);
+        if (err == ESP_OK) err = append_last_message(b, item);
+    }
+    if (err == ESP_OK) err = body_append(b, "]}", 2);
+    if (err != ESP_OK) return err;
+
+    b->last_encoded = b->len - start;
+    return ESP_OK;
+}
+
+void llm_body_free(llm_body_t *b)
+{
+    free(b->buf);
+    memset(b, 0, sizeof(*b));
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "esp_err.h"
+#include "cJSON.h"
+#include <stddef.h>
+
+/*
+ * Incremental writer for the Messages API request body.
+ *
+ * The head (model, system block, tools string spliced in verbatim) is
+ * written once per conversation. Messages are serialized straight into a
+ * reusable PSRAM buffer; on the next ReAct iteration only the messages
+ * appended since the previous call are serialized, the rest of the
+ * conversation is kept as already-encoded bytes. The messages array must
+ * therefore be append-only between llm_body_begin() calls.
+ */
+
+typedef struct {
+    char *buf;                  /* PSRAM, NUL-terminated after llm_body_update() */
+    size_t len;
+    size_t cap;
+    size_t head_len;            /* end of `..."messages":[` */
+    size_t committed_len;       /* end of the encoded message prefix */
+    int committed;              /* messages in the encoded prefix */
+    const cJSON *messages;      /* array the prefix was encoded from */
+    size_t last_encoded;        /* bytes serialized by the last update */
+} llm_body_t;
+
+void llm_body_init(llm_body_t *b);
+
+/**
+ * Start a new conversation: reset the message prefix and write the head.
+ *
+ * @param tools_json  Pre-built JSON array of tools, or NULL for no tools
+ */
+esp_err_t llm_body_begin(llm_body_t *b, const char *model, int max_tokens,
+                         const char *system_prompt, const char *tools_json);
+
+/**
+ * Bring the body up to date with messages. Encodes only messages not yet
+ * in the prefix; the newest message carries the rolling cache breakpoint.
+ */
+esp_err_t llm_body_update(llm_body_t *b, cJSON *messages);
+
+void llm_body_free(llm_body_t *b);
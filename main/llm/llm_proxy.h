@@ -3,9 +3,11 @@
 #include "esp_err.h"
 #include "cJSON.h"
 #include <stddef.h>
+#include <stdint.h>
 #include <stdbool.h>
 
 #include "mimi_config.h"
+#include "llm/llm_body.h"
 
 /**
  * Initialize the LLM proxy. Reads API key and model from build-time secrets, then NVS.
@@ -23,7 +25,8 @@ esp_err_t llm_set_api_key(const char *api_key);
 esp_err_t llm_set_model(const char *model);
 
 /**
- * Send a chat completion request to Anthropic Messages API (streaming).
+ * Send a chat completion request to Anthropic Messages API.
+ * Thin wrapper over llm_chat_tools() without tools.
  *
  * @param system_prompt  System prompt string
  * @param messages_json  JSON array of messages: [{"role":"user","content":"..."},...]
@@ -41,8 +44,16 @@ typedef struct {
     char name[32];      /* "web_search" */
     char *input;        /* heap-allocated JSON string */
     size_t input_len;
+    bool input_invalid; /* input was not valid JSON: report back, don't run */
 } llm_tool_call_t;
 
+typedef struct {
+    uint32_t input_tokens;                       /* uncached input */
+    uint32_t output_tokens;
+    uint32_t cache_creation_input_tokens;        /* written to the prompt cache */
+    uint32_t cache_read_input_tokens;            /* served from the prompt cache */
+} llm_usage_t;
+
 typedef struct {
     char *text;                                  /* accumulated text blocks */
     size_t text_len;
@@ -50,10 +61,17 @@ typedef struct {
     llm_tool_call_t calls[MIMI_MAX_TOOL_CALLS];
     int call_count;
     bool tool_use;                               /* stop_reason == "tool_use" */
+    llm_usage_t usage;
 } llm_response_t;
 
 void llm_response_free(llm_response_t *resp);
 
+/**
+ * Receives each text delta while the response is streaming.
+ * Runs in the caller's task; text is not NUL-terminated.
+ */
+typedef void (*llm_text_cb_t)(const char *text, size_t len, void *ctx);
+
 /**
  * Send a chat completion request with tools to Anthropic Messages API (streaming).
  *
@@ -61,9 +79,28 @@ void llm_response_free(llm_response_t *resp);
  * @param messages       cJSON array of messages (caller owns)
  * @param tools_json     Pre-built JSON string of tools array, or NULL for no tools
  * @param resp           Output: structured response with text and tool calls
+ * @param on_text        Optional text-delta callback, or NULL
+ * @param cb_ctx         Context passed to on_text
  * @return ESP_OK on success
  */
 esp_err_t llm_chat_tools(const char *system_prompt,
                          cJSON *messages,
                          const char *tools_json,
-                         llm_response_t *resp);
+                         llm_response_t *resp,
+                         llm_text_cb_t on_text, void *cb_ctx);
+
+/**
+ * Start a conversation on a reusable request body: writes the head (model,
+ * system prompt, tools) once. Pair with llm_chat_request() per iteration.
+ */
+esp_err_t llm_request_begin(llm_body_t *body, const char *system_prompt,
+                            const char *tools_json);
+
+/**
+ * Like llm_chat_tools(), but only encodes messages appended to the array
+ * since the previous call on the same body. messages must be append-only
+ * between llm_request_begin() calls.
+ */
+esp_err_t llm_chat_request(llm_body_t *body, cJSON *messages,
+                           llm_response_t *resp,
+                           llm_text_cb_t on_text, void *cb_ctx);
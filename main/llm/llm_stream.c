@@ -0,0 +1,325 @@
+#include "llm_stream.h"
+#include "mimi_config.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+
+static const char *TAG = "llm_sse";
+
+/* ── Growable PSRAM string ────────────────────────────────────── */
+
+static esp_err_t sbuf_append(llm_sbuf_t *b, const char *data, size_t len)
+{
+    if (b->len + len + 1 > b->cap) {
+        size_t new_cap = b->cap ? b->cap : 256;
+        while (b->len + len + 1 > new_cap) new_cap *= 2;
+        char *tmp = heap_caps_realloc(b->data, new_cap, MALLOC_CAP_SPIRAM);
+        if (!tmp) return ESP_ERR_NO_MEM;
+        b->data = tmp;
+        b->cap = new_cap;
+    }
+    memcpy(b->data + b->len, data, len);
+    b->len += len;
+    b->data[b->len] = '\0';
+    return ESP_OK;
+}
+
+/* Append into one of the stream's buffers; running out of memory fails the
+ * whole stream instead of silently truncating a block */
+static bool stream_append(llm_stream_t *s, llm_sbuf_t *b, const char *data, size_t len)
+{
+    if (sbuf_append(b, data, len) == ESP_OK) return true;
+    if (!s->error) {
+        s->error = true;
+        snprintf(s->error_msg, sizeof(s->error_msg),
+                 "out of memory growing %d-byte buffer by %d", (int)b->len, (int)len);
+        ESP_LOGE(TAG, "Stream error: %s", s->error_msg);
+    }
+    return false;
+}
+
+static void sbuf_reset(llm_sbuf_t *b)
+{
+    b->len = 0;
+    if (b->data) b->data[0] = '\0';
+}
+
+static void sbuf_free(llm_sbuf_t *b)
+{
+    free(b->data);
+    b->data = NULL;
+    b->len = 0;
+    b->cap = 0;
+}
+
+static const char *json_str(const cJSON *obj, const char *key)
+{
+    cJSON *item = cJSON_GetObjectItem(obj, key);
+    return (item && cJSON_IsString(item)) ? item->valuestring : NULL;
+}
+
+static void read_usage(llm_usage_t *u, const cJSON *usage)
+{
+    if (!usage) return;
+    const struct { const char *key; uint32_t *dst; } fields[] = {
+        { "input_tokens", &u->input_tokens },
+        { "output_tokens", &u->output_tokens },
+        { "cache_creation_input_tokens", &u->cache_creation_input_tokens },
+        { "cache_read_input_tokens", &u->cache_read_input_tokens },
+    };
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        cJSON *v = cJSON_GetObjectItem(usage, fields[i].key);
+        if (cJSON_IsNumber(v)) *fields[i].dst = (uint32_t)v->valuedouble;
+    }
+}
+
+static void set_block_string(cJSON *block, const char *key, const char *value)
+{
+    cJSON_DeleteItemFromObject(block, key);
+    cJSON_AddStringToObject(block, key, value ? value : "");
+}
+
+/* ── Event handlers ───────────────────────────────────────────── */
+
+static void on_block_start(llm_stream_t *s, cJSON *root)
+{
+    cJSON *cb = cJSON_DetachItemFromObject(root, "content_block");
+    if (!cb) return;
+
+    if (!s->resp->assistant_content) {
+        s->resp->assistant_content = cJSON_CreateArray();
+    }
+    cJSON_AddItemToArray(s->resp->assistant_content, cb);
+
+    s->block = cb;
+    s->call_idx = -1;
+    sbuf_reset(&s->block_buf);
+
+    const char *type = json_str(cb, "type");
+    strncpy(s->block_type, type ? type : "", sizeof(s->block_type) - 1);
+    s->block_type[sizeof(s->block_type) - 1] = '\0';
+
+    if (strcmp(s->block_type, "tool_use") == 0) {
+        if (s->resp->call_count >= MIMI_MAX_TOOL_CALLS) {
+            ESP_LOGW(TAG, "Too many tool calls, ignoring extra");
+            return;
+        }
+        s->call_idx = s->resp->call_count++;
+        llm_tool_call_t *call = &s->resp->calls[s->call_idx];
+        const char *id = json_str(cb, "id");
+        const char *name = json_str(cb, "name");
+        if (id) strncpy(call->id, id, sizeof(call->id) - 1);
+        if (name) strncpy(call->name, name, sizeof(call->name) - 1);
+    }
+}
+
+static void on_block_delta(llm_stream_t *s, cJSON *root)
+{
+    if (!s->block) return;
+    cJSON *delta = cJSON_GetObjectItem(root, "delta");
+    const char *dtype = json_str(delta, "type");
+    if (!dtype) return;
+
+    if (strcmp(dtype, "text_delta") == 0) {
+        const char *t = json_str(delta, "text");
+        if (!t) return;
+        size_t n = strlen(t);
+        if (!stream_append(s, &s->block_buf, t, n)) return;
+        if (!stream_append(s, &s->text, t, n)) return;
+        if (s->on_text && n) s->on_text(t, n, s->cb_ctx);
+    } else if (strcmp(dtype, "input_json_delta") == 0) {
+        const char *pj = json_str(delta, "partial_json");
+        if (pj) stream_append(s, &s->block_buf, pj, strlen(pj));
+    } else if (strcmp(dtype, "thinking_delta") == 0) {
+        const char *t = json_str(delta, "thinking");
+        if (t) stream_append(s, &s->block_buf, t, strlen(t));
+    } else if (strcmp(dtype, "signature_delta") == 0) {
+        set_block_string(s->block, "signature", json_str(delta, "signature"));
+    }
+}
+
+static void on_block_stop(llm_stream_t *s)
+{
+    if (!s->block) return;
+    const char *acc = s->block_buf.data ? s->block_buf.data : "";
+
+    if (strcmp(s->block_type, "text") == 0) {
+        set_block_string(s->block, "text", acc);
+    } else if (strcmp(s->block_type, "thinking") == 0) {
+        set_block_string(s->block, "thinking", acc);
+    } else if (strcmp(s->block_type, "tool_use") == 0) {
+        const char *raw = s->block_buf.len ? acc : "{}";
+        cJSON *input = cJSON_Parse(raw);
+        bool invalid = !input;
+        if (invalid) {
+            /* Never run a tool on made-up arguments; the round-trip copy
+             * still needs an object */
+            ESP_LOGW(TAG, "Bad tool input JSON (%d bytes), call not run", (int)s->block_buf.len);
+            input = cJSON_CreateObject();
+        }
+        cJSON_DeleteItemFromObject(s->block, "input");
+        cJSON_AddItemToObject(s->block, "input", input);
+
+        if (s->call_idx >= 0) {
+            llm_tool_call_t *call = &s->resp->calls[s->call_idx];
+            call->input_invalid = invalid;
+            if (!invalid) {
+                call->input_len = strlen(raw);
+                call->input = malloc(call->input_len + 1);
+                if (call->input) {
+                    memcpy(call->input, raw, call->input_len + 1);
+                } else {
+                    call->input_len = 0;
+                    s->error = true;
+                    snprintf(s->error_msg, sizeof(s->error_msg),
+                             "out of memory copying %d-byte tool input", (int)strlen(raw));
+                    ESP_LOGE(TAG, "Stream error: %s", s->error_msg);
+                }
+            }
+        }
+    }
+
+    s->block = NULL;
+    s->block_type[0] = '\0';
+    s->call_idx = -1;
+    sbuf_reset(&s->block_buf);
+}
+
+static void dispatch_data(llm_stream_t *s, const char *data, size_t len)
+{
+    cJSON *root = cJSON_ParseWithLength(data, len);
+    if (!root) {
+        ESP_LOGW(TAG, "Unparseable SSE data (%d bytes)", (int)len);
+        return;
+    }
+
+    const char *type = json_str(root, "type");
+    if (!type) {
+        cJSON_Delete(root);
+        return;
+    }
+
+    if (strcmp(type, "content_block_delta") == 0) {
+        on_block_delta(s, root);
+    } else if (strcmp(type, "content_block_start") == 0) {
+        on_block_start(s, root);
+    } else if (strcmp(type, "content_block_stop") == 0) {
+        on_block_stop(s);
+    } else if (strcmp(type, "message_start") == 0) {
+        s->got_message_start = true;
+        read_usage(&s->resp->usage,
+                   cJSON_GetObjectItem(cJSON_GetObjectItem(root, "message"), "usage"));
+    } else if (strcmp(type, "message_delta") == 0) {
+        cJSON *delta = cJSON_GetObjectItem(root, "delta");
+        const char *stop = json_str(delta, "stop_reason");
+        if (stop) s->resp->tool_use = (strcmp(stop, "tool_use") == 0);
+        /* Cumulative counts; output_tokens is final here */
+        read_usage(&s->resp->usage, cJSON_GetObjectItem(root, "usage"));
+    } else if (strcmp(type, "message_stop") == 0) {
+        s->got_message_stop = true;
+    } else if (strcmp(type, "error") == 0) {
+        cJSON *err = cJSON_GetObjectItem(root, "error");
+        const char *msg = json_str(err, "message");
+        s->error = true;
+        snprintf(s->error_msg, sizeof(s->error_msg), "%s", msg ? msg : "unknown");
+        ESP_LOGE(TAG, "Stream error: %s", s->error_msg);
+    }
+    /* "ping" and unknown events are ignored */
+
+    cJSON_Delete(root);
+}
+
+static void process_line(llm_stream_t *s)
+{
+    if (s->line_overflow) {
+        /* The lost event may carry text or tool input: fail rather than
+         * return a reply with a hole in it */
+        s->error = true;
+        snprintf(s->error_msg, sizeof(s->error_msg),
+                 "SSE line exceeded %d bytes", MIMI_LLM_SSE_LINE_MAX);
+        ESP_LOGE(TAG, "Stream error: %s", s->error_msg);
+        s->line_overflow = false;
+        s->line_len = 0;
+        return;
+    }
+
+    /* Anthropic sends one self-describing JSON object per data: line, so
+     * "event:" lines and blank event terminators carry nothing extra. */
+    if (s->line_len > 5 && memcmp(s->line, "data:", 5) == 0) {
+        const char *p = s->line + 5;
+        size_t n = s->line_len - 5;
+        if (n && *p == ' ') { p++; n--; }
+        dispatch_data(s, p, n);
+    }
+    s->line_len = 0;
+}
+
+/* ── Public API ───────────────────────────────────────────────── */
+
+esp_err_t llm_stream_init(llm_stream_t *s, llm_response_t *resp)
+{
+    memset(s, 0, sizeof(*s));
+    memset(resp, 0, sizeof(*resp));
+    s->resp = resp;
+    s->call_idx = -1;
+    s->line = heap_caps_calloc(1, MIMI_LLM_SSE_LINE_MAX, MALLOC_CAP_SPIRAM);
+    if (!s->line) return ESP_ERR_NO_MEM;
+    return ESP_OK;
+}
+
+esp_err_t llm_stream_feed(llm_stream_t *s, const char *data, size_t len)
+{
+    if (s->error) return ESP_FAIL;
+    for (size_t i = 0; i < len; i++) {
+        char c = data[i];
+        if (c == '\n' && s->skip_lf) {
+            s->skip_lf = false;
+            continue;
+        }
+        s->skip_lf = false;
+
+        if (c == '\r' || c == '\n') {
+            s->skip_lf = (c == '\r');
+            process_line(s);
+            if (s->error) return ESP_FAIL;
+            continue;
+        }
+
+        if (s->line_len < MIMI_LLM_SSE_LINE_MAX - 1) {
+            s->line[s->line_len++] = c;
+        } else {
+            s->line_overflow = true;
+        }
+    }
+    return s->error ? ESP_FAIL : ESP_OK;
+}
+
+esp_err_t llm_stream_finish(llm_stream_t *s)
+{
+    if (s->line_len) process_line(s);
+    if (s->block) on_block_stop(s);
+
+    llm_response_t *resp = s->resp;
+    resp->text = s->text.data;
+    resp->text_len = s->text.len;
+    s->text.data = NULL;
+    s->text.len = 0;
+    s->text.cap = 0;
+
+    if (s->error || !s->got_message_start) return ESP_FAIL;
+    if (!s->got_message_stop) {
+        ESP_LOGW(TAG, "Stream ended before message_stop");
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    return ESP_OK;
+}
+
+void llm_stream_free(llm_stream_t *s)
+{
+    free(s->line);
+    s->line = NULL;
+    sbuf_free(&s->block_buf);
+    sbuf_free(&s->text);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "esp_err.h"
+#include "cJSON.h"
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "llm/llm_proxy.h"
+
+/*
+ * Incremental parser for Anthropic Messages API server-sent events.
+ *
+ * Bytes are fed as they arrive from the socket; only one SSE line is
+ * buffered at a time. Text deltas, thinking deltas and input_json_delta
+ * fragments are assembled directly into an llm_response_t, including the
+ * assistant_content array used for tool-loop round-trips.
+ */
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} llm_sbuf_t;
+
+typedef struct {
+    llm_response_t *resp;
+    llm_text_cb_t on_text;      /* optional, set after init */
+    void *cb_ctx;
+
+    /* Current SSE line window (PSRAM, MIMI_LLM_SSE_LINE_MAX) */
+    char *line;
+    size_t line_len;
+    bool line_overflow;
+    bool skip_lf;
+
+    /* Current content block */
+    cJSON *block;               /* borrowed: last item of resp->assistant_content */
+    char block_type[16];
+    llm_sbuf_t block_buf;       /* text / thinking / partial_json accumulator */
+    int call_idx;               /* index into resp->calls, -1 if not tool_use */
+
+    /* Text accumulator backing resp->text */
+    llm_sbuf_t text;
+
+    bool got_message_start;
+    bool got_message_stop;
+    bool error;
+    char error_msg[160];
+} llm_stream_t;
+
+/**
+ * Initialize a stream parser that fills resp. resp is zeroed.
+ */
+esp_err_t llm_stream_init(llm_stream_t *s, llm_response_t *resp);
+
+/**
+ * Feed raw SSE bytes (already de-chunked). Safe to call with any split.
+ * Returns ESP_FAIL once an "error" event has been received, a line
+ * exceeded MIMI_LLM_SSE_LINE_MAX or an accumulator could not grow; later
+ * bytes are ignored. A tool_use block whose input is not valid JSON does
+ * not fail the stream: its call is marked input_invalid.
+ */
+esp_err_t llm_stream_feed(llm_stream_t *s, const char *data, size_t len);
+
+/**
+ * Flush a trailing line and finalize resp. Returns ESP_FAIL if the stream
+ * carried an error event or never started, ESP_ERR_INVALID_RESPONSE if it
+ * was cut before message_stop.
+ */
+esp_err_t llm_stream_finish(llm_stream_t *s);
+
+/**
+ * Release parser-owned buffers (resp keeps what was handed over).
+ */
+void llm_stream_free(llm_stream_t *s);
@@ -3,6 +3,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <stdbool.h>
 #include <time.h>
 #include <sys/stat.h>
 #include <stdarg.h>
@@ -10,6 +11,8 @@
 
 static const char *TAG = "memory";
 
+static uint32_t s_gen[MEMORY_GEN_COUNT];
+
 static size_t clamp_offset(size_t offset, size_t size)
 {
     if (size == 0) return 0;
@@ -44,6 +47,34 @@ static void get_date_str(char *buf, size_t size, int days_ago)
     strftime(buf, size, "%Y-%m-%d", &tm);
 }
 
+uint32_t memory_generation(memory_gen_t which)
+{
+    return __atomic_load_n(&s_gen[which], __ATOMIC_ACQUIRE);
+}
+
+static bool path_has_prefix(const char *path, const char *dir)
+{
+    size_t n = strlen(dir);
+    return strncmp(path, dir, n) == 0 && path[n] == '/';
+}
+
+void memory_notify_write(const char *path)
+{
+    if (!path) return;
+
+    memory_gen_t which;
+    if (strcmp(path, MIMI_MEMORY_FILE) == 0) {
+        which = MEMORY_GEN_LONG_TERM;
+    } else if (path_has_prefix(path, MIMI_SPIFFS_MEMORY_DIR)) {
+        which = MEMORY_GEN_DAILY;
+    } else if (path_has_prefix(path, MIMI_SPIFFS_CONFIG_DIR)) {
+        which = MEMORY_GEN_CONFIG;
+    } else {
+        return;
+    }
+    __atomic_add_fetch(&s_gen[which], 1, __ATOMIC_RELEASE);
+}
+
 esp_err_t memory_store_init(void)
 {
     /* SPIFFS is flat — no real directory creation needed.
@@ -75,6 +106,7 @@ esp_err_t memory_write_long_term(const char *content)
     }
     fputs(content, f);
     fclose(f);
+    memory_notify_write(MIMI_MEMORY_FILE);
     ESP_LOGI(TAG, "Long-term memory updated (%d bytes)", (int)strlen(content));
     return ESP_OK;
 }
@@ -100,6 +132,7 @@ esp_err_t memory_append_today(const char *note)
 
     fprintf(f, "%s\n", note);
     fclose(f);
+    memory_notify_write(path);
     return ESP_OK;
 }
 
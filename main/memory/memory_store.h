@@ -2,6 +2,15 @@
 
 #include "esp_err.h"
 #include <stddef.h>
+#include <stdint.h>
+
+/* Prompt-relevant file groups, each with its own change counter */
+typedef enum {
+    MEMORY_GEN_CONFIG = 0,      /* /spiffs/config/ (AGENTS.md, SOUL.md, USER.md) */
+    MEMORY_GEN_LONG_TERM,       /* MEMORY.md */
+    MEMORY_GEN_DAILY,           /* daily notes under /spiffs/memory/ */
+    MEMORY_GEN_COUNT,
+} memory_gen_t;
 
 /**
  * Initialize memory store. Ensures SPIFFS directories exist.
@@ -29,3 +38,15 @@ esp_err_t memory_append_today(const char *note);
  * @param days  Number of days to look back (default 3)
  */
 esp_err_t memory_read_recent(char *buf, size_t size, int days);
+
+/**
+ * Current change counter of a file group. Readers that cache file content
+ * compare it against the value they saw when they last read the files.
+ */
+uint32_t memory_generation(memory_gen_t which);
+
+/**
+ * Record that a file was written. Bumps the counter of the group that
+ * covers path; paths outside those groups are ignored.
+ */
+void memory_notify_write(const char *path);
@@ -5,13 +5,50 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <dirent.h>
+#include <sys/stat.h>
 #include <time.h>
 #include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
 #include "cJSON.h"
 
 static const char *TAG = "session";
 
+/* ── History cache ────────────────────────────────────────────── */
+
+/* Recent chats keep their last MIMI_SESSION_MAX_MSGS messages in PSRAM so a
+ * turn builds its messages array without touching SPIFFS or parsing JSON.
+ * The JSONL file stays the source of truth; the cache is write-through. */
+
+typedef struct {
+    char role[12];
+    char *content;              /* PSRAM */
+    size_t len;
+} sess_msg_t;
+
+typedef struct {
+    bool used;
+    char chat_id[96];
+    sess_msg_t msgs[MIMI_SESSION_MAX_MSGS];     /* ring, oldest at head */
+    int head;
+    int count;
+    size_t bytes;
+    uint32_t last_used;
+} sess_cache_t;
+
+static sess_cache_t *s_cache;   /* MIMI_SESSION_CACHE_SLOTS entries in PSRAM */
+static size_t s_cache_bytes;
+static uint32_t s_tick;
+static session_cache_stats_t s_stats;
+static SemaphoreHandle_t s_lock;
+static SemaphoreHandle_t s_file_lock;   /* serializes appends, tail reads, compaction */
+static QueueHandle_t s_compact_queue;
+
 static uint32_t fnv1a_32(const char *s)
 {
     uint32_t h = 2166136261u;
@@ -23,28 +60,310 @@ static uint32_t fnv1a_32(const char *s)
     return h;
 }
 
-static void session_relpath(const char *chat_id, char *buf, size_t size)
+static void session_relpath(const char *chat_id, const char *suffix, char *buf, size_t size)
 {
+    /* The .jsonl name decides whether the id is hashed, so the archive and
+     * temp files (shorter suffixes) always share the log's stem. */
     const char *id = chat_id ? chat_id : "";
     int n = snprintf(buf, size, "sessions/tg_%s.jsonl", id);
     if (n > 0 && (size_t)n < size && n < CONFIG_SPIFFS_OBJ_NAME_LEN) {
+        snprintf(buf, size, "sessions/tg_%s%s", id, suffix);
         return;
     }
 
     /* SPIFFS object-name limit is small (CONFIG_SPIFFS_OBJ_NAME_LEN), hash long ids. */
     uint32_t h = fnv1a_32(id);
-    snprintf(buf, size, "sessions/tg_%08lx.jsonl", (unsigned long)h);
+    snprintf(buf, size, "sessions/tg_%08lx%s", (unsigned long)h, suffix);
 }
 
-static void session_path(const char *chat_id, char *buf, size_t size)
+static void session_path_ext(const char *chat_id, const char *suffix, char *buf, size_t size)
 {
     char rel[48];
-    session_relpath(chat_id, rel, sizeof(rel));
+    session_relpath(chat_id, suffix, rel, sizeof(rel));
     snprintf(buf, size, "%s/%s", MIMI_SPIFFS_BASE, rel);
 }
 
+static void session_path(const char *chat_id, char *buf, size_t size)
+{
+    session_path_ext(chat_id, ".jsonl", buf, size);
+}
+
+static void file_lock(void)
+{
+    if (s_file_lock) xSemaphoreTake(s_file_lock, portMAX_DELAY);
+}
+
+static void file_unlock(void)
+{
+    if (s_file_lock) xSemaphoreGive(s_file_lock);
+}
+
+/* ── Tail reads and compaction ────────────────────────────────── */
+
+/* Offset where the last n records of a JSONL file start (0 if it holds
+ * fewer). Scans backwards in small chunks, so cost follows the tail size
+ * rather than the file size. */
+static long tail_offset(FILE *f, int n)
+{
+    if (fseek(f, 0, SEEK_END) != 0) return 0;
+    long end = ftell(f);
+    long pos = end;
+    char buf[512];
+    int newlines = 0;
+
+    while (pos > 0) {
+        size_t chunk = pos > (long)sizeof(buf) ? sizeof(buf) : (size_t)pos;
+        pos -= chunk;
+        if (fseek(f, pos, SEEK_SET) != 0 || fread(buf, 1, chunk, f) != chunk) return 0;
+        for (int i = (int)chunk - 1; i >= 0; i--) {
+            /* The terminator of the last record is not a boundary */
+            if (buf[i] != '\n' || pos + i == end - 1) continue;
+            if (++newlines == n) return pos + i + 1;
+        }
+    }
+    return 0;
+}
+
+static bool copy_range(FILE *src, long from, long to, FILE *dst)
+{
+    char buf[512];
+    if (fseek(src, from, SEEK_SET) != 0) return false;
+    while (from < to) {
+        size_t want = (to - from) > (long)sizeof(buf) ? sizeof(buf) : (size_t)(to - from);
+        size_t got = fread(buf, 1, want, src);
+        if (got == 0 || fwrite(buf, 1, got, dst) != got) return false;
+        from += got;
+    }
+    return true;
+}
+
+/* Move everything but the last MIMI_SESSION_MAX_MSGS records into the
+ * chat's .arc file. The archive is dropped once it outgrows
+ * MIMI_SESSION_ARCHIVE_MAX so SPIFFS cannot fill up. */
+static void session_compact(const char *chat_id)
+{
+    char path[64], arc_path[64], tmp_path[64];
+    session_path(chat_id, path, sizeof(path));
+    session_path_ext(chat_id, ".arc", arc_path, sizeof(arc_path));
+    session_path_ext(chat_id, ".tmp", tmp_path, sizeof(tmp_path));
+
+    file_lock();
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        file_unlock();
+        return;
+    }
+    fseek(f, 0, SEEK_END);
+    long end = ftell(f);
+    long keep = tail_offset(f, MIMI_SESSION_MAX_MSGS);
+    if (end < MIMI_SESSION_COMPACT_BYTES || keep <= 0) {
+        fclose(f);
+        file_unlock();
+        return;
+    }
+
+    struct stat st;
+    if (stat(arc_path, &st) == 0 && st.st_size + keep > MIMI_SESSION_ARCHIVE_MAX) {
+        ESP_LOGI(TAG, "Rotating archive for %s (%ld bytes)", chat_id, (long)st.st_size);
+        remove(arc_path);
+    }
+
+    FILE *arc = fopen(arc_path, "a");
+    FILE *tmp = fopen(tmp_path, "w");
+    bool ok = arc && tmp &&
+              copy_range(f, 0, keep, arc) &&
+              copy_range(f, keep, end, tmp);
+    if (arc) fclose(arc);
+    if (tmp) fclose(tmp);
+    fclose(f);
+
+    if (ok && remove(path) == 0 && rename(tmp_path, path) == 0) {
+        ESP_LOGI(TAG, "Compacted %s: %ld -> %ld bytes", chat_id, end, end - keep);
+    } else {
+        /* The log is still intact unless rename failed after remove */
+        ESP_LOGW(TAG, "Compaction of %s failed", chat_id);
+        remove(tmp_path);
+    }
+    file_unlock();
+}
+
+static void session_compact_task(void *arg)
+{
+    char chat_id[96];
+    while (1) {
+        if (xQueueReceive(s_compact_queue, chat_id, portMAX_DELAY) == pdTRUE) {
+            session_compact(chat_id);
+        }
+    }
+}
+
+static void cache_lock(void)
+{
+    if (s_lock) xSemaphoreTake(s_lock, portMAX_DELAY);
+}
+
+static void cache_unlock(void)
+{
+    if (s_lock) xSemaphoreGive(s_lock);
+}
+
+static size_t msg_cost(size_t len)
+{
+    return sizeof(sess_msg_t) + len + 1;
+}
+
+static void cache_entry_clear(sess_cache_t *e)
+{
+    for (int i = 0; i < e->count; i++) {
+        free(e->msgs[(e->head + i) % MIMI_SESSION_MAX_MSGS].content);
+    }
+    s_cache_bytes -= e->bytes;
+    memset(e, 0, sizeof(*e));
+}
+
+static sess_cache_t *cache_find(const char *chat_id)
+{
+    if (!s_cache) return NULL;
+    for (int i = 0; i < MIMI_SESSION_CACHE_SLOTS; i++) {
+        sess_cache_t *e = &s_cache[i];
+        if (e->used && strcmp(e->chat_id, chat_id) == 0) {
+            e->last_used = ++s_tick;
+            return e;
+        }
+    }
+    return NULL;
+}
+
+static sess_cache_t *cache_lru(const sess_cache_t *keep)
+{
+    sess_cache_t *victim = NULL;
+    for (int i = 0; i < MIMI_SESSION_CACHE_SLOTS; i++) {
+        sess_cache_t *e = &s_cache[i];
+        if (!e->used || e == keep) continue;
+        if (!victim || e->last_used < victim->last_used) victim = e;
+    }
+    return victim;
+}
+
+/* Evict least-recently-used chats until the byte budget holds */
+static void cache_enforce_cap(const sess_cache_t *keep)
+{
+    while (s_cache_bytes > MIMI_SESSION_CACHE_BYTES) {
+        sess_cache_t *victim = cache_lru(keep);
+        if (!victim) break;
+        ESP_LOGD(TAG, "Cache evict %s (%d bytes)", victim->chat_id, (int)victim->bytes);
+        cache_entry_clear(victim);
+        s_stats.evictions++;
+    }
+}
+
+static sess_cache_t *cache_claim(const char *chat_id)
+{
+    if (!s_cache) return NULL;
+    sess_cache_t *slot = NULL;
+    for (int i = 0; i < MIMI_SESSION_CACHE_SLOTS; i++) {
+        if (!s_cache[i].used) { slot = &s_cache[i]; break; }
+    }
+    if (!slot) {
+        slot = cache_lru(NULL);
+        cache_entry_clear(slot);
+        s_stats.evictions++;
+    }
+    slot->used = true;
+    strncpy(slot->chat_id, chat_id, sizeof(slot->chat_id) - 1);
+    slot->last_used = ++s_tick;
+    return slot;
+}
+
+static void cache_push(sess_cache_t *e, const char *role, const char *content)
+{
+    size_t len = strlen(content);
+    char *copy = heap_caps_malloc(len + 1, MALLOC_CAP_SPIRAM);
+    if (!copy) {
+        /* Cannot mirror the file any more; drop the entry and reload later */
+        ESP_LOGW(TAG, "Cache alloc failed, dropping %s", e->chat_id);
+        cache_entry_clear(e);
+        return;
+    }
+    memcpy(copy, content, len + 1);
+
+    if (e->count == MIMI_SESSION_MAX_MSGS) {
+        sess_msg_t *old = &e->msgs[e->head];
+        e->bytes -= msg_cost(old->len);
+        s_cache_bytes -= msg_cost(old->len);
+        free(old->content);
+        e->head = (e->head + 1) % MIMI_SESSION_MAX_MSGS;
+        e->count--;
+    }
+
+    sess_msg_t *m = &e->msgs[(e->head + e->count) % MIMI_SESSION_MAX_MSGS];
+    strncpy(m->role, role, sizeof(m->role) - 1);
+    m->role[sizeof(m->role) - 1] = '\0';
+    m->content = copy;
+    m->len = len;
+    e->count++;
+    e->bytes += msg_cost(len);
+    s_cache_bytes += msg_cost(len);
+}
+
+/* Fill a fresh entry from the JSONL file (missing file = empty history) */
+static void cache_load(sess_cache_t *e, const char *chat_id)
+{
+    char path[64];
+    session_path(chat_id, path, sizeof(path));
+
+    file_lock();
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        file_unlock();
+        return;
+    }
+
+    /* Only the records the ring can hold are read */
+    fseek(f, tail_offset(f, MIMI_SESSION_MAX_MSGS), SEEK_SET);
+
+    char line[2048];
+    while (fgets(line, sizeof(line), f) && e->used) {
+        /* Strip newline */
+        size_t len = strlen(line);
+        if (len > 0 && line[len - 1] == '\n') line[len - 1] = '\0';
+        if (line[0] == '\0') continue;
+
+        cJSON *obj = cJSON_Parse(line);
+        if (!obj) continue;
+
+        cJSON *role = cJSON_GetObjectItem(obj, "role");
+        cJSON *content = cJSON_GetObjectItem(obj, "content");
+        if (cJSON_IsString(role) && cJSON_IsString(content)) {
+            cache_push(e, role->valuestring, content->valuestring);
+        }
+        cJSON_Delete(obj);
+    }
+    fclose(f);
+    file_unlock();
+}
+
 esp_err_t session_mgr_init(void)
 {
+    s_file_lock = xSemaphoreCreateMutex();
+    s_compact_queue = xQueueCreate(4, 96);
+    if (!s_file_lock || !s_compact_queue ||
+        xTaskCreatePinnedToCore(session_compact_task, "sess_compact",
+                                MIMI_SESSION_COMPACT_STACK, NULL,
+                                MIMI_SESSION_COMPACT_PRIO, NULL,
+                                MIMI_SESSION_COMPACT_CORE) != pdPASS) {
+        ESP_LOGW(TAG, "Session compaction disabled");
+        if (s_compact_queue) vQueueDelete(s_compact_queue);
+        s_compact_queue = NULL;
+    }
+
+    s_lock = xSemaphoreCreateMutex();
+    s_cache = heap_caps_calloc(MIMI_SESSION_CACHE_SLOTS, sizeof(sess_cache_t), MALLOC_CAP_SPIRAM);
+    if (!s_lock || !s_cache) {
+        ESP_LOGW(TAG, "History cache unavailable, reading sessions from flash");
+        free(s_cache);
+        s_cache = NULL;
+    }
     ESP_LOGI(TAG, "Session manager initialized at %s", MIMI_SPIFFS_SESSION_DIR);
     return ESP_OK;
 }
@@ -54,8 +373,10 @@ esp_err_t session_append(const char *chat_id, const char *role, const char *cont
     char path[64];
     session_path(chat_id, path, sizeof(path));
 
+    file_lock();
     FILE *f = fopen(path, "a");
     if (!f) {
+        file_unlock();
         ESP_LOGE(TAG, "Cannot open session file %s", path);
         return ESP_FAIL;
     }
@@ -73,76 +394,95 @@ esp_err_t session_append(const char *chat_id, const char *role, const char *cont
         free(line);
     }
 
+    long size = ftell(f);
     fclose(f);
+    file_unlock();
+
+    /* Long logs are trimmed off the hot path by the compaction task */
+    if (size >= MIMI_SESSION_COMPACT_BYTES && s_compact_queue) {
+        char id[96] = {0};
+        strncpy(id, chat_id, sizeof(id) - 1);
+        xQueueSend(s_compact_queue, id, 0);
+    }
+
+    /* Write-through: only chats already cached are updated */
+    cache_lock();
+    sess_cache_t *e = cache_find(chat_id);
+    if (e) {
+        cache_push(e, role, content);
+        if (e->used) cache_enforce_cap(e);
+    }
+    cache_unlock();
     return ESP_OK;
 }
 
-esp_err_t session_get_history_json(const char *chat_id, char *buf, size_t size, int max_msgs)
+/* Without a cache: parse the file straight into a messages array */
+static cJSON *history_from_file(const char *chat_id, int max_msgs)
 {
-    if (!buf || size == 0) return ESP_ERR_INVALID_ARG;
-    if (max_msgs <= 0) max_msgs = 1;
-    if (max_msgs > MIMI_SESSION_MAX_MSGS) max_msgs = MIMI_SESSION_MAX_MSGS;
+    sess_cache_t tmp = { .used = true };
+    cache_load(&tmp, chat_id);
 
-    char path[64];
-    session_path(chat_id, path, sizeof(path));
-
-    FILE *f = fopen(path, "r");
-    if (!f) {
-        /* No history yet */
-        snprintf(buf, size, "[]");
-        return ESP_OK;
+    cJSON *arr = cJSON_CreateArray();
+    int skip = tmp.count > max_msgs ? tmp.count - max_msgs : 0;
+    for (int i = skip; i < tmp.count; i++) {
+        sess_msg_t *m = &tmp.msgs[(tmp.head + i) % MIMI_SESSION_MAX_MSGS];
+        cJSON *entry = cJSON_CreateObject();
+        cJSON_AddStringToObject(entry, "role", m->role);
+        cJSON_AddStringToObject(entry, "content", m->content);
+        cJSON_AddItemToArray(arr, entry);
     }
 
-    /* Read all lines into a ring buffer of cJSON objects */
-    cJSON *messages[MIMI_SESSION_MAX_MSGS];
-    int count = 0;
-    int write_idx = 0;
+    cache_entry_clear(&tmp);    /* balances the byte count cache_push added */
+    return arr;
+}
 
-    char line[2048];
-    while (fgets(line, sizeof(line), f)) {
-        /* Strip newline */
-        size_t len = strlen(line);
-        if (len > 0 && line[len - 1] == '\n') line[len - 1] = '\0';
-        if (line[0] == '\0') continue;
+cJSON *session_get_history(const char *chat_id, int max_msgs)
+{
+    if (max_msgs <= 0) max_msgs = 1;
+    if (max_msgs > MIMI_SESSION_MAX_MSGS) max_msgs = MIMI_SESSION_MAX_MSGS;
 
-        cJSON *obj = cJSON_Parse(line);
-        if (!obj) continue;
+    cache_lock();
+    if (!s_cache) {
+        cJSON *arr = history_from_file(chat_id, max_msgs);
+        cache_unlock();
+        return arr;
+    }
 
-        /* Ring buffer: overwrite oldest if full */
-        if (count >= max_msgs) {
-            cJSON_Delete(messages[write_idx]);
+    sess_cache_t *e = cache_find(chat_id);
+    if (e) {
+        s_stats.hits++;
+    } else {
+        s_stats.misses++;
+        e = cache_claim(chat_id);
+        cache_load(e, chat_id);
+        if (!e->used) {
+            /* Load ran out of PSRAM: serve this turn from the file */
+            cJSON *arr = history_from_file(chat_id, max_msgs);
+            cache_unlock();
+            return arr;
         }
-        messages[write_idx] = obj;
-        write_idx = (write_idx + 1) % max_msgs;
-        if (count < max_msgs) count++;
+        cache_enforce_cap(e);
     }
-    fclose(f);
 
-    /* Build JSON array with only role + content */
     cJSON *arr = cJSON_CreateArray();
-    int start = (count < max_msgs) ? 0 : write_idx;
-    for (int i = 0; i < count; i++) {
-        int idx = (start + i) % max_msgs;
-        cJSON *src = messages[idx];
-
+    int skip = e->count > max_msgs ? e->count - max_msgs : 0;
+    for (int i = skip; i < e->count; i++) {
+        sess_msg_t *m = &e->msgs[(e->head + i) % MIMI_SESSION_MAX_MSGS];
         cJSON *entry = cJSON_CreateObject();
-        cJSON *role = cJSON_GetObjectItem(src, "role");
-        cJSON *content = cJSON_GetObjectItem(src, "content");
-        if (role && content) {
-            cJSON_AddStringToObject(entry, "role", role->valuestring);
-            cJSON_AddStringToObject(entry, "content", content->valuestring);
-        }
+        cJSON_AddStringToObject(entry, "role", m->role);
+        cJSON_AddStringToObject(entry, "content", m->content);
         cJSON_AddItemToArray(arr, entry);
     }
+    cache_unlock();
+    return arr;
+}
 
-    /* Cleanup ring buffer */
-    int cleanup_start = (count < max_msgs) ? 0 : write_idx;
-    for (int i = 0; i < count; i++) {
-        int idx = (cleanup_start + i) % max_msgs;
-        cJSON_Delete(messages[idx]);
-    }
+esp_err_t session_get_history_json(const char *chat_id, char *buf, size_t size, int max_msgs)
+{
+    if (!buf || size == 0) return ESP_ERR_INVALID_ARG;
 
-    char *json_str = cJSON_PrintUnformatted(arr);
+    cJSON *arr = session_get_history(chat_id, max_msgs);
+    char *json_str = arr ? cJSON_PrintUnformatted(arr) : NULL;
     cJSON_Delete(arr);
 
     if (json_str) {
@@ -161,7 +501,20 @@ esp_err_t session_clear(const char *chat_id)
     char path[64];
     session_path(chat_id, path, sizeof(path));
 
-    if (remove(path) == 0) {
+    char arc_path[64];
+    session_path_ext(chat_id, ".arc", arc_path, sizeof(arc_path));
+
+    cache_lock();
+    sess_cache_t *e = cache_find(chat_id);
+    if (e) cache_entry_clear(e);
+    cache_unlock();
+
+    file_lock();
+    int rc = remove(path);
+    remove(arc_path);
+    file_unlock();
+
+    if (rc == 0) {
         ESP_LOGI(TAG, "Session %s cleared", chat_id);
         return ESP_OK;
     }
@@ -194,3 +547,15 @@ void session_list(void)
         ESP_LOGI(TAG, "  No sessions found");
     }
 }
+
+void session_cache_get_stats(session_cache_stats_t *out)
+{
+    cache_lock();
+    *out = s_stats;
+    out->bytes = s_cache_bytes;
+    out->entries = 0;
+    for (int i = 0; s_cache && i < MIMI_SESSION_CACHE_SLOTS; i++) {
+        if (s_cache[i].used) out->entries++;
+    }
+    cache_unlock();
+}
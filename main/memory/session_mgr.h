@@ -2,6 +2,16 @@
 
 #include "esp_err.h"
 #include <stddef.h>
+#include <stdint.h>
+#include "cJSON.h"
+
+typedef struct {
+    uint32_t hits;          /* history served from the PSRAM cache */
+    uint32_t misses;        /* history loaded from SPIFFS */
+    uint32_t evictions;     /* chats dropped for slots or byte budget */
+    size_t bytes;           /* cached message bytes (incl. bookkeeping) */
+    int entries;            /* chats currently cached */
+} session_cache_stats_t;
 
 /**
  * Initialize session manager.
@@ -16,6 +26,13 @@ esp_err_t session_mgr_init(void);
  */
 esp_err_t session_append(const char *chat_id, const char *role, const char *content);
 
+/**
+ * Get the last max_msgs messages as a new cJSON array of
+ * {"role","content"} objects (caller deletes). Recent chats are served from
+ * a PSRAM LRU cache without reading flash or parsing JSON.
+ */
+cJSON *session_get_history(const char *chat_id, int max_msgs);
+
 /**
  * Load session history as a JSON array string suitable for LLM messages.
  * Returns the last max_msgs messages as:
@@ -29,7 +46,7 @@ esp_err_t session_append(const char *chat_id, const char *role, const char *cont
 esp_err_t session_get_history_json(const char *chat_id, char *buf, size_t size, int max_msgs);
 
 /**
- * Clear a session (delete the file).
+ * Clear a session (delete the file and its cache entry).
  */
 esp_err_t session_clear(const char *chat_id);
 
@@ -37,3 +54,8 @@ esp_err_t session_clear(const char *chat_id);
  * List all session files (prints to log).
  */
 void session_list(void);
+
+/**
+ * Snapshot history cache counters.
+ */
+void session_cache_get_stats(session_cache_stats_t *out);
@@ -21,6 +21,7 @@
 #include "gateway/ws_server.h"
 #include "cli/serial_cli.h"
 #include "proxy/http_proxy.h"
+#include "proxy/conn_pool.h"
 #include "tools/tool_registry.h"
 #include "ui/config_ui.h"
 
@@ -59,29 +60,47 @@ static esp_err_t init_spiffs(void)
     return ESP_OK;
 }
 
-/* Outbound dispatch task: reads from outbound queue and routes to channels */
-static void outbound_dispatch_task(void *arg)
+/* ── Outbound delivery (one subscriber per channel) ─────────── */
+
+static esp_err_t deliver_telegram(const mimi_msg_t *msg, void *ctx)
 {
-    ESP_LOGI(TAG, "Outbound dispatch started");
+    if (msg->kind == MIMI_MSG_DELTA) return telegram_send_delta(msg->chat_id, msg->content);
+    return telegram_send_message(msg->chat_id, msg->content);
+}
 
-    while (1) {
-        mimi_msg_t msg;
-        if (message_bus_pop_outbound(&msg, UINT32_MAX) != ESP_OK) continue;
+static esp_err_t deliver_feishu(const mimi_msg_t *msg, void *ctx)
+{
+    if (msg->kind == MIMI_MSG_DELTA) return feishu_bot_send_delta(msg->chat_id, msg->content);
+    return feishu_bot_send_message_to(msg->chat_id, msg->content);
+}
 
-        ESP_LOGI(TAG, "Dispatching response to %s:%s", msg.channel, msg.chat_id);
+static esp_err_t deliver_websocket(const mimi_msg_t *msg, void *ctx)
+{
+    if (msg->kind == MIMI_MSG_DELTA) return ws_server_send_delta(msg->chat_id, msg->content);
+    return ws_server_send(msg->chat_id, msg->content);
+}
 
-        if (strcmp(msg.channel, MIMI_CHAN_TELEGRAM) == 0) {
-            telegram_send_message(msg.chat_id, msg.content);
-        } else if (strcmp(msg.channel, MIMI_CHAN_FEISHU) == 0) {
-            feishu_bot_send_message_to(msg.chat_id, msg.content);
-        } else if (strcmp(msg.channel, MIMI_CHAN_WEBSOCKET) == 0) {
-            ws_server_send(msg.chat_id, msg.content);
-        } else {
-            ESP_LOGW(TAG, "Unknown channel: %s", msg.channel);
-        }
+static esp_err_t outbound_subscribe_all(void)
+{
+    /* Telegram: the callback only queues the reply; tg_send owns 429
+     * pauses and network retries (MIMI_TG_SEND_RETRIES), so none here */
+    mimi_outbound_opts_t tg = {
+        .deltas = true, .max_retries = 0,
+    };
+    /* Feishu: token refresh or a brief outage */
+    mimi_outbound_opts_t fs = {
+        .deltas = true, .max_retries = 2,
+        .retry_base_ms = 1000, .retry_max_ms = 4000,
+    };
+    /* WebSocket: a failed send means the client is gone */
+    mimi_outbound_opts_t ws = {
+        .deltas = true, .max_retries = 0, .stack = 4 * 1024,
+    };
 
-        free(msg.content);
-    }
+    esp_err_t err = message_bus_subscribe_outbound(MIMI_CHAN_TELEGRAM, deliver_telegram, &tg);
+    if (err == ESP_OK) err = message_bus_subscribe_outbound(MIMI_CHAN_FEISHU, deliver_feishu, &fs);
+    if (err == ESP_OK) err = message_bus_subscribe_outbound(MIMI_CHAN_WEBSOCKET, deliver_websocket, &ws);
+    return err;
 }
 
 static void serial_cli_bootstrap_task(void *arg)
@@ -120,6 +139,7 @@ void app_main(void)
     ESP_ERROR_CHECK(session_mgr_init());
     ESP_ERROR_CHECK(wifi_manager_init());
     ESP_ERROR_CHECK(http_proxy_init());
+    ESP_ERROR_CHECK(conn_pool_init());
     ESP_ERROR_CHECK(telegram_bot_init());
     ESP_ERROR_CHECK(feishu_bot_init());
     ESP_ERROR_CHECK(llm_proxy_init());
@@ -152,15 +172,11 @@ void app_main(void)
             } else if (feishu_err != ESP_OK) {
                 ESP_LOGW(TAG, "Feishu long connection start failed: %s", esp_err_to_name(feishu_err));
             }
+            /* Outbound delivery tasks, before anything can produce replies */
+            ESP_ERROR_CHECK(outbound_subscribe_all());
             ESP_ERROR_CHECK(agent_loop_start());
             ESP_ERROR_CHECK(ws_server_start());
 
-            /* Outbound dispatch task */
-            xTaskCreatePinnedToCore(
-                outbound_dispatch_task, "outbound",
-                MIMI_OUTBOUND_STACK, NULL,
-                MIMI_OUTBOUND_PRIO, NULL, MIMI_OUTBOUND_CORE);
-
             ESP_LOGI(TAG, "All services started!");
         } else {
             ESP_LOGW(TAG, "WiFi connection timeout. Check MIMI_SECRET_WIFI_SSID in mimi_secrets.h");
@@ -55,14 +55,60 @@
 #define MIMI_TG_POLL_STACK           (12 * 1024)
 #define MIMI_TG_POLL_PRIO            5
 #define MIMI_TG_POLL_CORE            0
+#define MIMI_TG_EDIT_INTERVAL_MS     1500        /* min gap between draft edits */
+#define MIMI_TG_DRAFT_MAX            4
+#define MIMI_TG_BACKOFF_MS           1000        /* poll delay while the bus pushes back */
+#define MIMI_TG_POLL_TIMEOUT_MIN_S   5           /* floor after connections drop mid-poll */
+#define MIMI_TG_POLL_LIMIT_MIN       4           /* getUpdates limit, idle or congested */
+#define MIMI_TG_POLL_LIMIT_MAX       32          /* getUpdates limit under sustained traffic */
+#define MIMI_TG_POLL_BACKOFF_MAX_MS  30000
+#define MIMI_TG_UPDATE_MAX           (16 * 1024) /* largest single update parsed */
+#define MIMI_TG_OFFSET_SAVE_EVERY    16          /* updates between NVS offset writes */
+#define MIMI_TG_OFFSET_SAVE_MS       (60 * 1000)
+#define MIMI_TG_OFFSET_WINDOW        100000      /* ids below the saved offset treated as replays */
+#define MIMI_TG_SEND_STACK           (8 * 1024)  /* PSRAM */
+#define MIMI_TG_SEND_PRIO            5
+#define MIMI_TG_SEND_CORE            0
+#define MIMI_TG_SEND_CHATS           8           /* chats with their own queue and rate bucket */
+#define MIMI_TG_SEND_QUEUE_LEN       8           /* pending replies per chat */
+#define MIMI_TG_SEND_PIPELINE        3           /* segments in flight on one connection */
+#define MIMI_TG_SEND_RETRIES         4           /* network failures before a reply is dropped */
+#define MIMI_TG_RATE_GLOBAL          30          /* messages/s across all chats */
+#define MIMI_TG_RATE_CHAT            1           /* messages/s per chat, sustained */
+#define MIMI_TG_RATE_CHAT_BURST      3
 
-/* Agent Loop */
-#define MIMI_AGENT_STACK             (16 * 1024)
+/* Agent Loop (a dispatcher feeding a pool of workers) */
+#define MIMI_AGENT_WORKERS           2
+#define MIMI_AGENT_PSRAM_BUDGET      (1024 * 1024) /* caps workers x per-turn buffers */
+#define MIMI_AGENT_DISPATCH_STACK    (3 * 1024)  /* PSRAM */
+#define MIMI_AGENT_STACK             (16 * 1024) /* per worker */
 #define MIMI_AGENT_PRIO              6
 #define MIMI_AGENT_CORE              1
 #define MIMI_AGENT_MAX_HISTORY       20
 #define MIMI_AGENT_MAX_TOOL_ITER     10
 #define MIMI_MAX_TOOL_CALLS          4
+#define MIMI_STREAM_FLUSH_MS         300         /* partial reply coalescing */
+#define MIMI_STREAM_FLUSH_BYTES      256
+#define MIMI_AGENT_ARENA_SIZE        (256 * 1024) /* per-turn cJSON arena (PSRAM) */
+#define MIMI_AGENT_ARENA_MAX         4           /* one per worker: >= MIMI_AGENT_WORKERS */
+_Static_assert(MIMI_AGENT_ARENA_MAX >= MIMI_AGENT_WORKERS,
+               "each agent worker needs its own turn arena");
+
+/* Tool Workers (parallel tool calls; the agent task runs one more) */
+#define MIMI_TOOL_WORKERS            2
+#define MIMI_TOOL_WORKER_STACK       (12 * 1024)
+#define MIMI_TOOL_WORKER_PRIO        5
+#define MIMI_TOOL_WORKER_CORE        1
+
+/* Tool Response Cache (web_search / web_fetch) */
+#define MIMI_TOOL_CACHE_RAM_ENTRIES  16
+#define MIMI_TOOL_CACHE_RAM_BYTES    (128 * 1024) /* PSRAM hot tier */
+#define MIMI_TOOL_CACHE_SD_DIR       "/sdcard/cache"
+#define MIMI_TOOL_CACHE_SD_ENTRIES   256
+#define MIMI_TOOL_CACHE_SD_BYTES     (4 * 1024 * 1024)
+#define MIMI_TOOL_CACHE_SEARCH_TTL_S 600
+#define MIMI_TOOL_CACHE_FETCH_TTL_S  600         /* when the server sends no max-age */
+#define MIMI_TOOL_CACHE_FETCH_TTL_MAX_S (24 * 3600)
 
 /* Timezone (POSIX TZ format) */
 #define MIMI_TIMEZONE                "PST8PDT,M3.2.0,M11.1.0"
@@ -73,24 +119,51 @@
 #define MIMI_LLM_API_URL             "https://open.bigmodel.cn/api/anthropic/v1/messages"
 #define MIMI_LLM_API_VERSION         "2023-06-01"
 #define MIMI_LLM_STREAM_BUF_SIZE     (32 * 1024)
+#define MIMI_LLM_SSE_LINE_MAX        (16 * 1024)
+#define MIMI_LLM_ERR_SNIPPET         512
+#define MIMI_LLM_PROMPT_CACHE        1           /* cache_control breakpoints */
+#define MIMI_LLM_BODY_INIT_SIZE      (16 * 1024) /* request body, grows in PSRAM */
+#define MIMI_LLM_BODY_MAX            (512 * 1024)
+
+/* HTTPS Connection Pool */
+#define MIMI_CONN_POOL_MAX           6           /* parked + active TLS sockets */
+#define MIMI_CONN_POOL_HOSTS         6           /* cached TLS session tickets */
+#define MIMI_CONN_POOL_IDLE_MS       (50 * 1000) /* below typical server keep-alive */
 
 /* Message Bus */
-#define MIMI_BUS_QUEUE_LEN           8
-#define MIMI_OUTBOUND_STACK          (8 * 1024)
+#define MIMI_BUS_QUEUE_LEN           8           /* outbound, per channel */
+#define MIMI_BUS_INBOUND_SLOTS       12
+#define MIMI_BUS_LOW_SLOTS           6           /* group chats may fill at most this many */
+#define MIMI_BUS_HIGH_RESERVED       2           /* slots only CLI / admin may take */
+#define MIMI_BUS_HIGH_WATER          8           /* producers that can defer should */
+#define MIMI_BUS_PUSH_WAIT_MS        1000
+#define MIMI_BUS_COALESCE_MAX        4096        /* merged burst text per chat */
+#define MIMI_BUS_INFLIGHT_MAX        8           /* chats processed at once, >= agent workers */
+#define MIMI_BUS_MAX_SUBSCRIBERS     4           /* outbound channels */
+#define MIMI_OUTBOUND_STACK          (8 * 1024)  /* per channel delivery task, PSRAM */
 #define MIMI_OUTBOUND_PRIO           5
 #define MIMI_OUTBOUND_CORE           0
 
-/* Memory / SPIFFS */
+/* Memory / SPIFFS (the host build mounts it elsewhere) */
+#ifndef MIMI_SPIFFS_BASE
 #define MIMI_SPIFFS_BASE             "/spiffs"
-#define MIMI_SPIFFS_CONFIG_DIR       "/spiffs/config"
-#define MIMI_SPIFFS_MEMORY_DIR       "/spiffs/memory"
-#define MIMI_SPIFFS_SESSION_DIR      "/spiffs/sessions"
-#define MIMI_MEMORY_FILE             "/spiffs/memory/MEMORY.md"
-#define MIMI_AGENTS_FILE             "/spiffs/config/AGENTS.md"
-#define MIMI_SOUL_FILE               "/spiffs/config/SOUL.md"
-#define MIMI_USER_FILE               "/spiffs/config/USER.md"
+#endif
+#define MIMI_SPIFFS_CONFIG_DIR       MIMI_SPIFFS_BASE "/config"
+#define MIMI_SPIFFS_MEMORY_DIR       MIMI_SPIFFS_BASE "/memory"
+#define MIMI_SPIFFS_SESSION_DIR      MIMI_SPIFFS_BASE "/sessions"
+#define MIMI_MEMORY_FILE             MIMI_SPIFFS_BASE "/memory/MEMORY.md"
+#define MIMI_AGENTS_FILE             MIMI_SPIFFS_BASE "/config/AGENTS.md"
+#define MIMI_SOUL_FILE               MIMI_SPIFFS_BASE "/config/SOUL.md"
+#define MIMI_USER_FILE               MIMI_SPIFFS_BASE "/config/USER.md"
 #define MIMI_CONTEXT_BUF_SIZE        (16 * 1024)
 #define MIMI_SESSION_MAX_MSGS        20
+#define MIMI_SESSION_CACHE_SLOTS     8           /* chats kept in PSRAM */
+#define MIMI_SESSION_CACHE_BYTES     (128 * 1024)
+#define MIMI_SESSION_COMPACT_BYTES   (32 * 1024) /* log size that triggers archiving */
+#define MIMI_SESSION_ARCHIVE_MAX     (128 * 1024)
+#define MIMI_SESSION_COMPACT_STACK   (4 * 1024)
+#define MIMI_SESSION_COMPACT_PRIO    2
+#define MIMI_SESSION_COMPACT_CORE    0
 
 /* WebSocket Gateway */
 #define MIMI_WS_PORT                 18789
@@ -105,6 +178,9 @@
 #define MIMI_FEISHU_WS_STACK         (16 * 1024)
 #define MIMI_FEISHU_WS_PRIO          5
 #define MIMI_FEISHU_WS_CORE          0
+#define MIMI_FEISHU_EDIT_INTERVAL_MS 2000        /* min gap between draft edits */
+#define MIMI_FEISHU_EDIT_MAX         18          /* server allows ~20 edits/message */
+#define MIMI_FEISHU_DRAFT_MAX        4
 
 /* NVS Namespaces */
 #define MIMI_NVS_WIFI                "wifi_config"
@@ -118,6 +194,7 @@
 #define MIMI_NVS_KEY_SSID            "ssid"
 #define MIMI_NVS_KEY_PASS            "password"
 #define MIMI_NVS_KEY_TG_TOKEN        "bot_token"
+#define MIMI_NVS_KEY_TG_OFFSET       "upd_offset"
 #define MIMI_NVS_KEY_API_KEY         "api_key"
 #define MIMI_NVS_KEY_MODEL           "model"
 #define MIMI_NVS_KEY_PROXY_HOST      "host"
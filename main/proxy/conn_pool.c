@@ -0,0 +1,909 @@
+#include "conn_pool.h"
+#include "http_proxy.h"
+#include "mimi_config.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <unistd.h>
+
+#include "esp_log.h"
+#include "esp_tls.h"
+#include "esp_crt_bundle.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "conn_pool";
+
+#define POOL_HOST_MAX       64
+#define POOL_HDR_MAX        2048
+#define POOL_IO_BUF         4096
+
+struct pool_conn {
+    bool used;              /* slot holds a live connection */
+    bool busy;              /* checked out by a caller */
+    bool transient;         /* heap-allocated overflow, never parked */
+    bool reused;            /* handed out from the idle set */
+    bool via_proxy;
+    char host[POOL_HOST_MAX];
+    int port;
+    esp_tls_t *tls;
+    int sock;
+    int rcv_timeout_ms;     /* last SO_RCVTIMEO applied */
+    int64_t last_used_ms;
+    uint32_t gen;           /* s_gen when opened */
+};
+
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+typedef struct {
+    char host[POOL_HOST_MAX];
+    int port;
+    esp_tls_client_session_t *session;
+    bool in_use;            /* a handshake is reading this session */
+    int64_t stored_ms;
+} tls_session_slot_t;
+
+static tls_session_slot_t s_sessions[MIMI_CONN_POOL_HOSTS];
+#endif
+
+static struct pool_conn s_conns[MIMI_CONN_POOL_MAX];
+static SemaphoreHandle_t s_lock;
+static conn_pool_stats_t s_stats;
+static uint32_t s_gen;          /* bumped by conn_pool_flush() */
+
+static int64_t now_ms(void)
+{
+    return esp_timer_get_time() / 1000;
+}
+
+static void pool_lock(void)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+}
+
+static void pool_unlock(void)
+{
+    xSemaphoreGive(s_lock);
+}
+
+/* ── TLS session cache ────────────────────────────────────────── */
+
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+static tls_session_slot_t *session_find_locked(const char *host, int port)
+{
+    for (int i = 0; i < MIMI_CONN_POOL_HOSTS; i++) {
+        tls_session_slot_t *s = &s_sessions[i];
+        if (s->host[0] && s->port == port && strcmp(s->host, host) == 0) return s;
+    }
+    return NULL;
+}
+
+/* Borrow the cached session for a handshake. Only one handshake per host
+ * holds it at a time, so it cannot be replaced while mbedTLS reads it. */
+static tls_session_slot_t *session_checkout(const char *host, int port)
+{
+    pool_lock();
+    tls_session_slot_t *s = session_find_locked(host, port);
+    if (s && (!s->session || s->in_use)) s = NULL;
+    if (s) {
+        s->in_use = true;
+        s_stats.resumed++;
+    }
+    pool_unlock();
+    return s;
+}
+
+/* Store the session of a finished handshake (tls == NULL on failure) */
+static void session_checkin(const char *host, int port, tls_session_slot_t *held, esp_tls_t *tls)
+{
+    esp_tls_client_session_t *fresh = tls ? esp_tls_get_client_session(tls) : NULL;
+    esp_tls_client_session_t *drop = NULL;
+
+    pool_lock();
+    tls_session_slot_t *s = held ? held : session_find_locked(host, port);
+    if (!s && fresh) {
+        /* Claim an empty slot, else the oldest one not being read */
+        for (int i = 0; i < MIMI_CONN_POOL_HOSTS; i++) {
+            tls_session_slot_t *c = &s_sessions[i];
+            if (c->in_use) continue;
+            if (!c->host[0]) { s = c; break; }
+            if (!s || c->stored_ms < s->stored_ms) s = c;
+        }
+        if (s) {
+            drop = s->session;
+            s->session = NULL;
+            strncpy(s->host, host, sizeof(s->host) - 1);
+            s->host[sizeof(s->host) - 1] = '\0';
+            s->port = port;
+        }
+    }
+
+    if (s && (held == s || !s->in_use)) {
+        if (fresh || held) {
+            /* A failed resumed handshake invalidates the ticket */
+            if (!drop) drop = s->session;
+            s->session = fresh;
+            s->stored_ms = now_ms();
+            fresh = NULL;
+        }
+    }
+    if (held) held->in_use = false;
+    pool_unlock();
+
+    if (drop) esp_tls_free_client_session(drop);
+    if (fresh) esp_tls_free_client_session(fresh);
+}
+#endif
+
+/* ── Connection lifecycle ─────────────────────────────────────── */
+
+static esp_err_t conn_open(struct pool_conn *c, const char *host, int port, int timeout_ms)
+{
+    bool via_proxy = http_proxy_is_enabled();
+    int sock = -1;
+
+    pool_lock();
+    uint32_t gen = s_gen;
+    pool_unlock();
+
+    if (via_proxy) {
+        sock = http_proxy_open_tunnel(host, port, timeout_ms);
+        if (sock < 0) return ESP_FAIL;
+    }
+
+    esp_tls_t *tls = esp_tls_init();
+    if (!tls) {
+        if (sock >= 0) close(sock);
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (via_proxy) {
+        /* Inject the CONNECT-tunnel socket and skip the TCP connect phase */
+        esp_tls_set_conn_sockfd(tls, sock);
+        esp_tls_set_conn_state(tls, ESP_TLS_CONNECTING);
+    }
+
+    esp_tls_cfg_t cfg = {
+        .crt_bundle_attach = esp_crt_bundle_attach,
+        .timeout_ms = timeout_ms,
+    };
+
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    tls_session_slot_t *held = session_checkout(host, port);
+    if (held) cfg.client_session = held->session;
+#endif
+
+    int ret = esp_tls_conn_new_sync(host, strlen(host), port, &cfg, tls);
+
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    session_checkin(host, port, held, ret > 0 ? tls : NULL);
+#endif
+
+    if (ret <= 0) {
+        ESP_LOGE(TAG, "TLS connect to %s:%d failed%s", host, port, via_proxy ? " (proxy)" : "");
+        /* esp_tls_conn_destroy also closes an injected socket */
+        esp_tls_conn_destroy(tls);
+        return ESP_FAIL;
+    }
+
+    if (!via_proxy) {
+        esp_tls_get_conn_sockfd(tls, &sock);
+    }
+
+    strncpy(c->host, host, sizeof(c->host) - 1);
+    c->host[sizeof(c->host) - 1] = '\0';
+    c->port = port;
+    c->via_proxy = via_proxy;
+    c->gen = gen;
+    c->tls = tls;
+    c->sock = sock;
+    c->rcv_timeout_ms = -1;
+    ESP_LOGI(TAG, "Connected to %s:%d%s", host, port, via_proxy ? " via proxy" : "");
+    return ESP_OK;
+}
+
+/* Tear down TLS and free the slot. Slot bookkeeping is done under the lock. */
+static void conn_destroy(struct pool_conn *c)
+{
+    if (c->tls) {
+        esp_tls_conn_destroy(c->tls);
+        c->tls = NULL;
+    }
+    if (c->transient) {
+        free(c);
+        return;
+    }
+    pool_lock();
+    c->used = false;
+    c->busy = false;
+    pool_unlock();
+}
+
+/* An idle TLS socket should have nothing to read; readable means the peer
+ * sent close_notify / FIN (or garbage) and the connection is unusable. */
+static bool conn_is_dead(struct pool_conn *c)
+{
+    if (esp_tls_get_bytes_avail(c->tls) > 0) return true;
+
+    fd_set rfds;
+    FD_ZERO(&rfds);
+    FD_SET(c->sock, &rfds);
+    struct timeval tv = { 0 };
+    return select(c->sock + 1, &rfds, NULL, NULL, &tv) != 0;
+}
+
+/* Close parked connections older than the idle timeout. Caller holds lock;
+ * returns the slots to close after unlocking. */
+static int reap_idle_locked(struct pool_conn **out, int max)
+{
+    int n = 0;
+    int64_t t = now_ms();
+    for (int i = 0; i < MIMI_CONN_POOL_MAX && n < max; i++) {
+        struct pool_conn *c = &s_conns[i];
+        if (c->used && !c->busy && t - c->last_used_ms > MIMI_CONN_POOL_IDLE_MS) {
+            c->busy = true;
+            out[n++] = c;
+            s_stats.evicted++;
+        }
+    }
+    return n;
+}
+
+/* ── Public API ───────────────────────────────────────────────── */
+
+esp_err_t conn_pool_init(void)
+{
+    s_lock = xSemaphoreCreateMutex();
+    if (!s_lock) return ESP_ERR_NO_MEM;
+    ESP_LOGI(TAG, "Connection pool initialized (%d slots, idle %d s)",
+             MIMI_CONN_POOL_MAX, MIMI_CONN_POOL_IDLE_MS / 1000);
+    return ESP_OK;
+}
+
+pool_conn_t *conn_pool_acquire(const char *host, int port, int timeout_ms)
+{
+    if (!host || !host[0] || strlen(host) >= POOL_HOST_MAX) return NULL;
+
+    bool via_proxy = http_proxy_is_enabled();
+    struct pool_conn *expired[MIMI_CONN_POOL_MAX];
+
+    while (1) {
+        struct pool_conn *found = NULL;
+
+        pool_lock();
+        int n_expired = reap_idle_locked(expired, MIMI_CONN_POOL_MAX);
+        for (int i = 0; i < MIMI_CONN_POOL_MAX; i++) {
+            struct pool_conn *c = &s_conns[i];
+            if (!c->used || c->busy || c->port != port || c->via_proxy != via_proxy) continue;
+            if (c->gen != s_gen) continue;
+            if (strcmp(c->host, host) != 0) continue;
+            if (!found || c->last_used_ms > found->last_used_ms) found = c;
+        }
+        if (found) found->busy = true;
+        pool_unlock();
+
+        for (int i = 0; i < n_expired; i++) conn_destroy(expired[i]);
+
+        if (!found) break;
+
+        if (conn_is_dead(found)) {
+            ESP_LOGD(TAG, "Parked connection to %s closed by peer", host);
+            pool_lock();
+            s_stats.stale++;
+            pool_unlock();
+            conn_destroy(found);
+            continue;
+        }
+
+        pool_lock();
+        s_stats.hits++;
+        pool_unlock();
+        found->reused = true;
+        return found;
+    }
+
+    /* Miss: reserve a slot, evicting the oldest idle connection if full */
+    struct pool_conn *slot = NULL;
+    struct pool_conn *victim = NULL;
+    pool_lock();
+    s_stats.misses++;
+    for (int i = 0; i < MIMI_CONN_POOL_MAX; i++) {
+        struct pool_conn *c = &s_conns[i];
+        if (!c->used) { slot = c; break; }
+        if (!c->busy && (!victim || c->last_used_ms < victim->last_used_ms)) victim = c;
+    }
+    if (!slot && victim) {
+        victim->busy = true;
+        s_stats.evicted++;
+    }
+    if (slot) {
+        slot->used = true;
+        slot->busy = true;
+    }
+    pool_unlock();
+
+    if (!slot && victim) {
+        if (victim->tls) esp_tls_conn_destroy(victim->tls);
+        victim->tls = NULL;
+        slot = victim;  /* keep used/busy: reserved for us */
+    }
+
+    if (!slot) {
+        /* Every slot is checked out: use an unpooled connection */
+        slot = calloc(1, sizeof(*slot));
+        if (!slot) return NULL;
+        slot->transient = true;
+        slot->used = true;
+        slot->busy = true;
+    }
+
+    if (conn_open(slot, host, port, timeout_ms) != ESP_OK) {
+        pool_lock();
+        s_stats.failures++;
+        pool_unlock();
+        conn_destroy(slot);
+        return NULL;
+    }
+    slot->reused = false;
+    return slot;
+}
+
+void conn_pool_release(pool_conn_t *conn, bool keep_alive)
+{
+    if (!conn) return;
+
+    if (keep_alive && !conn->transient && conn->via_proxy == http_proxy_is_enabled()) {
+        pool_lock();
+        /* Connections opened before a flush are not parked again */
+        bool park = conn->gen == s_gen;
+        if (park) {
+            conn->busy = false;
+            conn->last_used_ms = now_ms();
+        }
+        pool_unlock();
+        if (park) return;
+    }
+    conn_destroy(conn);
+}
+
+int conn_pool_write(pool_conn_t *conn, const char *data, int len)
+{
+    int written = 0;
+    while (written < len) {
+        ssize_t ret = esp_tls_conn_write(conn->tls, data + written, len - written);
+        if (ret > 0) {
+            written += (int)ret;
+        } else if (ret == ESP_TLS_ERR_SSL_WANT_WRITE) {
+            continue;
+        } else {
+            ESP_LOGW(TAG, "write to %s failed: %d", conn->host, (int)ret);
+            return -1;
+        }
+    }
+    return written;
+}
+
+int conn_pool_read(pool_conn_t *conn, char *buf, int len, int timeout_ms)
+{
+    if (conn->rcv_timeout_ms != timeout_ms) {
+        struct timeval tv = { .tv_sec = timeout_ms / 1000, .tv_usec = (timeout_ms % 1000) * 1000 };
+        setsockopt(conn->sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        conn->rcv_timeout_ms = timeout_ms;
+    }
+
+    int64_t deadline = now_ms() + timeout_ms;
+    while (1) {
+        ssize_t ret = esp_tls_conn_read(conn->tls, buf, len);
+        if (ret > 0) return (int)ret;
+        if (ret == 0) return 0;
+        if (ret != ESP_TLS_ERR_SSL_WANT_READ && ret != ESP_TLS_ERR_SSL_WANT_WRITE) {
+            ESP_LOGW(TAG, "read from %s failed: %d", conn->host, (int)ret);
+            return -1;
+        }
+        /* WANT_READ: socket timeout, or a non-application record (e.g. a
+         * TLS 1.3 session ticket) was consumed */
+        if (now_ms() >= deadline) return -1;
+    }
+}
+
+/* ── HTTP/1.1 exchange ────────────────────────────────────────── */
+
+typedef enum {
+    CHUNK_SIZE = 0,
+    CHUNK_DATA,
+    CHUNK_DATA_END,
+    CHUNK_TRAILER,
+    CHUNK_DONE,
+} chunk_state_t;
+
+typedef struct {
+    const conn_pool_req_t *req;
+    bool chunked;
+    bool has_length;
+    size_t remaining;           /* Content-Length or current chunk */
+    chunk_state_t state;
+    char size_line[24];
+    size_t size_len;
+    bool line_empty;            /* trailer: current line has no bytes yet */
+    bool done;
+    bool aborted;
+} body_dec_t;
+
+static void body_emit(body_dec_t *d, const char *p, size_t n)
+{
+    if (d->aborted || n == 0 || !d->req->on_data) return;
+    if (d->req->on_data(p, n, d->req->ctx) != ESP_OK) d->aborted = true;
+}
+
+/* Decode body bytes; sets d->done once the message is complete. Returns the
+ * bytes consumed: anything past the end belongs to the next response. */
+static size_t body_feed(body_dec_t *d, const char *p, size_t len)
+{
+    if (!d->chunked) {
+        if (d->has_length) {
+            size_t n = len < d->remaining ? len : d->remaining;
+            body_emit(d, p, n);
+            d->remaining -= n;
+            if (d->remaining == 0) d->done = true;
+            return n;
+        }
+        body_emit(d, p, len);
+        return len;
+    }
+
+    const char *start = p;
+
+    while (len > 0 && d->state != CHUNK_DONE) {
+        switch (d->state) {
+        case CHUNK_SIZE:
+            if (*p == '\n') {
+                d->size_line[d->size_len] = '\0';
+                d->remaining = strtoul(d->size_line, NULL, 16);
+                d->size_len = 0;
+                d->state = d->remaining ? CHUNK_DATA : CHUNK_TRAILER;
+                d->line_empty = true;
+            } else if (*p != '\r' && d->size_len < sizeof(d->size_line) - 1) {
+                d->size_line[d->size_len++] = *p;
+            }
+            p++; len--;
+            break;
+        case CHUNK_DATA: {
+            size_t n = len < d->remaining ? len : d->remaining;
+            body_emit(d, p, n);
+            p += n; len -= n;
+            d->remaining -= n;
+            if (d->remaining == 0) d->state = CHUNK_DATA_END;
+            break;
+        }
+        case CHUNK_DATA_END:
+            if (*p == '\n') d->state = CHUNK_SIZE;
+            p++; len--;
+            break;
+        case CHUNK_TRAILER:
+            /* Trailer lines end with an empty line */
+            if (*p == '\n') {
+                if (d->line_empty) d->state = CHUNK_DONE;
+                d->line_empty = true;
+            } else if (*p != '\r') {
+                d->line_empty = false;
+            }
+            p++; len--;
+            break;
+        default:
+            break;
+        }
+    }
+    if (d->state == CHUNK_DONE) d->done = true;
+    return (size_t)(p - start);
+}
+
+/* Find a header value (case-insensitive name) in a NUL-terminated block */
+static bool header_value(const char *hdr, const char *name, char *out, size_t out_size)
+{
+    size_t nlen = strlen(name);
+    const char *line = strstr(hdr, "\r\n");
+    while (line) {
+        line += 2;
+        if (strncasecmp(line, name, nlen) == 0 && line[nlen] == ':') {
+            const char *v = line + nlen + 1;
+            while (*v == ' ' || *v == '\t') v++;
+            const char *end = strstr(v, "\r\n");
+            size_t vlen = end ? (size_t)(end - v) : strlen(v);
+            if (vlen >= out_size) vlen = out_size - 1;
+            memcpy(out, v, vlen);
+            out[vlen] = '\0';
+            return true;
+        }
+        line = strstr(line, "\r\n");
+    }
+    return false;
+}
+
+static bool parse_url(const char *url, char *host, size_t host_size, int *port, const char **path)
+{
+    if (strncmp(url, "https://", 8) != 0) return false;
+    const char *h = url + 8;
+    const char *slash = strchr(h, '/');
+    const char *colon = strchr(h, ':');
+    const char *host_end = slash ? slash : h + strlen(h);
+    *port = 443;
+    if (colon && colon < host_end) {
+        *port = atoi(colon + 1);
+        host_end = colon;
+    }
+    size_t hlen = host_end - h;
+    if (hlen == 0 || hlen >= host_size) return false;
+    memcpy(host, h, hlen);
+    host[hlen] = '\0';
+    *path = slash ? slash : "/";
+    return true;
+}
+
+static esp_err_t resolve_target(const conn_pool_req_t *req, char *host_buf, size_t host_size,
+                                const char **host, int *port, const char **path)
+{
+    *host = req->host;
+    *path = req->path ? req->path : "/";
+    *port = req->port ? req->port : 443;
+    if (req->url) {
+        if (!parse_url(req->url, host_buf, host_size, port, path)) {
+            ESP_LOGE(TAG, "Unsupported URL: %s", req->url);
+            return ESP_ERR_INVALID_ARG;
+        }
+        *host = host_buf;
+    }
+    return *host ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+static esp_err_t http_send_request(pool_conn_t *conn, const conn_pool_req_t *req,
+                                   const char *host, int port, const char *path)
+{
+    const char *method = req->method ? req->method : "GET";
+
+    /* RFC 7230 5.4: the port goes in Host unless it is the scheme default */
+    char host_hdr[POOL_HOST_MAX + 8];
+    if (port == 443) {
+        snprintf(host_hdr, sizeof(host_hdr), "%s", host);
+    } else {
+        snprintf(host_hdr, sizeof(host_hdr), "%s:%d", host, port);
+    }
+
+    /* Request head; GET without a body carries no Content-Length */
+    char clen[40] = "";
+    if (req->body || strcmp(method, "GET") != 0) {
+        snprintf(clen, sizeof(clen), "Content-Length: %d\r\n", (int)req->body_len);
+    }
+    const char *extra = req->headers ? req->headers : "";
+    int head_len = snprintf(NULL, 0,
+        "%s %s HTTP/1.1\r\nHost: %s\r\nConnection: keep-alive\r\n%s%s\r\n",
+        method, path, host_hdr, clen, extra);
+    char *head = malloc(head_len + 1);
+    if (!head) return ESP_ERR_NO_MEM;
+    snprintf(head, head_len + 1,
+        "%s %s HTTP/1.1\r\nHost: %s\r\nConnection: keep-alive\r\n%s%s\r\n",
+        method, path, host_hdr, clen, extra);
+
+    int wret = conn_pool_write(conn, head, head_len);
+    free(head);
+    if (wret < 0 || (req->body_len &&
+                     conn_pool_write(conn, req->body, (int)req->body_len) < 0)) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+/* Read the response to req. io[0..*carry) holds bytes already received past
+ * the previous response on this connection (pipelining); on return it holds
+ * whatever arrived past this one. *keep tells whether the connection may be
+ * parked; *stale is set when nothing at all came back (dead parked
+ * connection). */
+static esp_err_t http_read_response(pool_conn_t *conn, const conn_pool_req_t *req,
+                                    const char *host, char *io, size_t *carry,
+                                    int *status_out, bool *keep, bool *stale)
+{
+    const char *method = req->method ? req->method : "GET";
+    *keep = false;
+    *stale = false;
+
+    char *hdr = io + POOL_IO_BUF;
+    size_t hdr_len = 0;
+    bool in_body = false;
+    bool got_any = false;
+    body_dec_t dec = { .req = req };
+    bool conn_close = false;
+    esp_err_t err = ESP_OK;
+
+    while (!dec.done && !dec.aborted) {
+        int n;
+        if (*carry) {
+            n = (int)*carry;
+            *carry = 0;
+        } else {
+            n = conn_pool_read(conn, io, POOL_IO_BUF, req->timeout_ms);
+        }
+        if (n < 0) {
+            err = ESP_ERR_TIMEOUT;
+            break;
+        }
+        if (n == 0) {
+            /* Peer closed: completes a read-until-close body only */
+            if (in_body && !dec.chunked && !dec.has_length) {
+                dec.done = true;
+            } else {
+                err = ESP_ERR_INVALID_RESPONSE;
+                *stale = !got_any;
+            }
+            break;
+        }
+        got_any = true;
+
+        const char *p = io;
+        size_t left = n;
+
+        if (!in_body) {
+            size_t room = POOL_HDR_MAX - 1 - hdr_len;
+            size_t copy = left < room ? left : room;
+            memcpy(hdr + hdr_len, p, copy);
+            size_t prev_len = hdr_len;
+            hdr_len += copy;
+            hdr[hdr_len] = '\0';
+
+            char *end = strstr(hdr, "\r\n\r\n");
+            if (!end) {
+                if (hdr_len >= POOL_HDR_MAX - 1) {
+                    ESP_LOGE(TAG, "Response headers from %s too large", host);
+                    err = ESP_ERR_INVALID_RESPONSE;
+                    break;
+                }
+                continue;
+            }
+            end[2] = '\0';  /* keep the final CRLF for header_value() */
+
+            size_t consumed = (size_t)(end + 4 - hdr) - prev_len;
+            p += consumed;
+            left -= consumed;
+
+            int status = 0;
+            bool http10 = strncmp(hdr, "HTTP/1.0", 8) == 0;
+            const char *sp = strchr(hdr, ' ');
+            if (sp) status = atoi(sp + 1);
+            if (status_out) *status_out = status;
+
+            char val[32];
+            if (header_value(hdr, "Transfer-Encoding", val, sizeof(val)) &&
+                strcasestr(val, "chunked")) {
+                dec.chunked = true;
+            } else if (header_value(hdr, "Content-Length", val, sizeof(val))) {
+                dec.has_length = true;
+                dec.remaining = strtoul(val, NULL, 10);
+            }
+            conn_close = http10 ||
+                (header_value(hdr, "Connection", val, sizeof(val)) && strcasecmp(val, "close") == 0);
+
+            if (status == 204 || status == 304 || strcmp(method, "HEAD") == 0 ||
+                (dec.has_length && dec.remaining == 0)) {
+                dec.done = true;
+            }
+            in_body = true;
+        }
+
+        if (left && !dec.done) {
+            size_t used = body_feed(&dec, p, left);
+            p += used;
+            left -= used;
+        }
+        if (dec.done && left) {
+            memmove(io, p, left);
+            *carry = left;
+        }
+    }
+
+    if (dec.aborted) return ESP_ERR_INVALID_STATE;
+    if (err != ESP_OK) return err;
+
+    *keep = dec.done && !conn_close && (dec.chunked || dec.has_length || !in_body);
+    return ESP_OK;
+}
+
+esp_err_t conn_pool_http(const conn_pool_req_t *req, int *status_out)
+{
+    if (status_out) *status_out = 0;
+
+    char host_buf[POOL_HOST_MAX];
+    const char *host, *path;
+    int port;
+    esp_err_t err = resolve_target(req, host_buf, sizeof(host_buf), &host, &port, &path);
+    if (err != ESP_OK) return err;
+
+    char *io = heap_caps_malloc(POOL_IO_BUF + POOL_HDR_MAX, MALLOC_CAP_SPIRAM);
+    if (!io) return ESP_ERR_NO_MEM;
+
+    err = ESP_FAIL;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        pool_conn_t *conn = conn_pool_acquire(host, port, req->timeout_ms);
+        if (!conn) {
+            err = ESP_FAIL;
+            break;
+        }
+
+        bool keep = false, stale = true;
+        bool reused = conn->reused;
+        size_t carry = 0;
+        err = http_send_request(conn, req, host, port, path);
+        if (err == ESP_OK) {
+            err = http_read_response(conn, req, host, io, &carry, status_out, &keep, &stale);
+        }
+        /* Bytes past the response would corrupt the next exchange */
+        conn_pool_release(conn, keep && carry == 0);
+
+        if (err != ESP_OK && stale && reused) {
+            /* Server dropped the parked connection; the request was not seen */
+            pool_lock();
+            s_stats.stale++;
+            pool_unlock();
+            continue;
+        }
+        break;
+    }
+
+    free(io);
+    return err;
+}
+
+esp_err_t conn_pool_http_pipeline(const conn_pool_req_t *reqs, int n,
+                                  int *status_out, int *done_out)
+{
+    *done_out = 0;
+    for (int i = 0; i < n; i++) status_out[i] = 0;
+    if (n <= 0) return ESP_OK;
+
+    char host_buf[POOL_HOST_MAX];
+    const char *host, *path;
+    int port;
+    esp_err_t err = resolve_target(&reqs[0], host_buf, sizeof(host_buf), &host, &port, &path);
+    if (err != ESP_OK) return err;
+    for (int i = 1; i < n; i++) {
+        if (reqs[i].url || !reqs[i].host || strcmp(reqs[i].host, host) != 0 ||
+            (reqs[i].port ? reqs[i].port : 443) != port) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    char *io = heap_caps_malloc(POOL_IO_BUF + POOL_HDR_MAX, MALLOC_CAP_SPIRAM);
+    if (!io) return ESP_ERR_NO_MEM;
+
+    err = ESP_FAIL;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        pool_conn_t *conn = conn_pool_acquire(host, port, reqs[0].timeout_ms);
+        if (!conn) {
+            err = ESP_FAIL;
+            break;
+        }
+
+        /* All requests go out before the first response is read */
+        bool reused = conn->reused;
+        bool keep = false, stale = true;
+        err = ESP_OK;
+        for (int i = 0; i < n && err == ESP_OK; i++) {
+            err = http_send_request(conn, &reqs[i], host, port,
+                                    reqs[i].path ? reqs[i].path : "/");
+        }
+
+        size_t carry = 0;
+        for (int i = 0; i < n && err == ESP_OK; i++) {
+            err = http_read_response(conn, &reqs[i], host, io, &carry,
+                                     &status_out[i], &keep, &stale);
+            if (err == ESP_OK) *done_out = i + 1;
+            /* A response that ends the connection strands the rest */
+            if (err == ESP_OK && !keep && i + 1 < n) err = ESP_ERR_INVALID_RESPONSE;
+        }
+        conn_pool_release(conn, err == ESP_OK && keep && carry == 0);
+
+        if (err != ESP_OK && *done_out == 0 && stale && reused) {
+            pool_lock();
+            s_stats.stale++;
+            pool_unlock();
+            continue;
+        }
+        break;
+    }
+
+    free(io);
+    return err;
+}
+
+/* ── Collecting sink ──────────────────────────────────────────── */
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+    size_t max;
+} collect_buf_t;
+
+static esp_err_t collect_sink(const char *data, size_t len, void *ctx)
+{
+    collect_buf_t *b = (collect_buf_t *)ctx;
+    if (b->len + len > b->max) len = b->max - b->len;
+    if (len == 0) return ESP_OK;  /* truncate, keep draining */
+
+    if (b->len + len + 1 > b->cap) {
+        size_t new_cap = b->cap ? b->cap : 1024;
+        while (b->len + len + 1 > new_cap) new_cap *= 2;
+        char *tmp = heap_caps_realloc(b->data, new_cap, MALLOC_CAP_SPIRAM);
+        if (!tmp) return ESP_ERR_NO_MEM;
+        b->data = tmp;
+        b->cap = new_cap;
+    }
+    memcpy(b->data + b->len, data, len);
+    b->len += len;
+    b->data[b->len] = '\0';
+    return ESP_OK;
+}
+
+esp_err_t conn_pool_http_collect(const conn_pool_req_t *req, size_t max_len,
+                                 char **body_out, size_t *len_out, int *status_out)
+{
+    *body_out = NULL;
+    if (len_out) *len_out = 0;
+
+    collect_buf_t b = { .max = max_len };
+    conn_pool_req_t r = *req;
+    r.on_data = collect_sink;
+    r.ctx = &b;
+
+    esp_err_t err = conn_pool_http(&r, status_out);
+    if (err != ESP_OK) {
+        free(b.data);
+        return err;
+    }
+    if (!b.data) {
+        b.data = calloc(1, 1);
+        if (!b.data) return ESP_ERR_NO_MEM;
+    }
+    *body_out = b.data;
+    if (len_out) *len_out = b.len;
+    return ESP_OK;
+}
+
+/* ── Maintenance ──────────────────────────────────────────────── */
+
+void conn_pool_flush(void)
+{
+    struct pool_conn *idle[MIMI_CONN_POOL_MAX];
+    int n = 0;
+
+    if (!s_lock) return;
+
+    pool_lock();
+    s_gen++;
+    for (int i = 0; i < MIMI_CONN_POOL_MAX; i++) {
+        struct pool_conn *c = &s_conns[i];
+        if (c->used && !c->busy) {
+            c->busy = true;
+            idle[n++] = c;
+        }
+    }
+    pool_unlock();
+
+    for (int i = 0; i < n; i++) conn_destroy(idle[i]);
+}
+
+void conn_pool_get_stats(conn_pool_stats_t *out)
+{
+    pool_lock();
+    *out = s_stats;
+    out->idle = 0;
+    out->busy = 0;
+    for (int i = 0; i < MIMI_CONN_POOL_MAX; i++) {
+        if (!s_conns[i].used) continue;
+        if (s_conns[i].busy) out->busy++;
+        else out->idle++;
+    }
+    pool_unlock();
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Keep-alive HTTPS connection pool shared by the LLM, search, Telegram and
+ * Feishu clients. Connections are opened directly or through the configured
+ * CONNECT proxy, parked per host:port when a response has been fully read,
+ * and evicted after MIMI_CONN_POOL_IDLE_MS. New handshakes offer the last
+ * TLS session ticket seen for the host so reconnects skip the full handshake.
+ */
+
+typedef struct pool_conn pool_conn_t;
+
+typedef struct {
+    uint32_t hits;          /* requests served on a parked connection */
+    uint32_t misses;        /* requests that had to open a connection */
+    uint32_t resumed;       /* new handshakes offered a cached TLS session */
+    uint32_t stale;         /* parked connections found closed by the peer */
+    uint32_t evicted;       /* idle connections closed for age or capacity */
+    uint32_t failures;      /* connect / handshake failures */
+    int idle;               /* connections parked right now */
+    int busy;               /* connections checked out right now */
+} conn_pool_stats_t;
+
+/**
+ * Receives response body bytes (already de-chunked) as they arrive.
+ * Return anything but ESP_OK to abort the transfer.
+ */
+typedef esp_err_t (*conn_pool_data_cb_t)(const char *data, size_t len, void *ctx);
+
+typedef struct {
+    const char *method;             /* "GET", "POST", "PUT"; default "GET" */
+    const char *url;                /* https://host[:port]/path, or use host/path */
+    const char *host;
+    int port;                       /* default 443 */
+    const char *path;
+    const char *headers;            /* extra "Name: value\r\n" lines, or NULL */
+    const char *body;               /* request body, or NULL */
+    size_t body_len;
+    int timeout_ms;
+    conn_pool_data_cb_t on_data;    /* body sink; NULL discards the body */
+    void *ctx;
+} conn_pool_req_t;
+
+/**
+ * Initialize the pool (mutex, session cache).
+ */
+esp_err_t conn_pool_init(void);
+
+/**
+ * Check out a TLS connection to host:port, reusing a parked one if possible.
+ * Returns NULL on failure.
+ */
+pool_conn_t *conn_pool_acquire(const char *host, int port, int timeout_ms);
+
+/**
+ * Return a connection. Parked for reuse only if keep_alive is true and the
+ * previous response was read completely; destroyed otherwise.
+ */
+void conn_pool_release(pool_conn_t *conn, bool keep_alive);
+
+/** Write all bytes. Returns bytes written or -1. */
+int conn_pool_write(pool_conn_t *conn, const char *data, int len);
+
+/** Read up to len bytes. Returns bytes read, 0 on peer close, -1 on error/timeout. */
+int conn_pool_read(pool_conn_t *conn, char *buf, int len, int timeout_ms);
+
+/**
+ * Perform one HTTP/1.1 request on a pooled connection and stream the
+ * response body to req->on_data. Handles Content-Length, chunked and
+ * read-until-close bodies, and retries once on a fresh connection if a
+ * parked one turns out to be dead.
+ *
+ * @param status_out  HTTP status code (0 if no response); written before the
+ *                    first on_data call so the sink may branch on it
+ */
+esp_err_t conn_pool_http(const conn_pool_req_t *req, int *status_out);
+
+/**
+ * Pipeline n requests to one host: all are written on a single connection
+ * before the responses are read back in order. Each response is streamed to
+ * its own request's on_data.
+ *
+ * @param status_out  n status codes, 0 for responses never read
+ * @param done_out    responses read completely; requests past it may or may
+ *                    not have been processed by the server
+ */
+esp_err_t conn_pool_http_pipeline(const conn_pool_req_t *reqs, int n,
+                                  int *status_out, int *done_out);
+
+/**
+ * Convenience wrapper that collects the body into a heap buffer
+ * (NUL-terminated, caller frees). Bodies larger than max_len are truncated.
+ */
+esp_err_t conn_pool_http_collect(const conn_pool_req_t *req, size_t max_len,
+                                 char **body_out, size_t *len_out, int *status_out);
+
+/**
+ * Close every parked connection and stop reusing the ones currently checked
+ * out; they are closed on release. Called when the proxy settings change so
+ * no request keeps going through a tunnel to the old proxy.
+ */
+void conn_pool_flush(void);
+
+void conn_pool_get_stats(conn_pool_stats_t *out);
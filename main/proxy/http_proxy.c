@@ -1,4 +1,5 @@
 #include "http_proxy.h"
+#include "conn_pool.h"
 #include "mimi_config.h"
 
 #include <string.h>
@@ -66,6 +67,7 @@ esp_err_t http_proxy_set(const char *host, uint16_t port)
 
     strncpy(s_proxy_host, host, sizeof(s_proxy_host) - 1);
     s_proxy_port = port;
+    conn_pool_flush();
     ESP_LOGI(TAG, "Proxy set to %s:%d", s_proxy_host, s_proxy_port);
     return ESP_OK;
 }
@@ -81,6 +83,7 @@ esp_err_t http_proxy_clear(void)
 
     s_proxy_host[0] = '\0';
     s_proxy_port = 0;
+    conn_pool_flush();
     ESP_LOGI(TAG, "Proxy cleared");
     return ESP_OK;
 }
@@ -115,8 +118,7 @@ static int sock_read_line(int fd, char *buf, int max, int timeout_ms)
     return pos;
 }
 
-/* Open TCP + CONNECT tunnel, returns socket fd or -1 */
-static int open_connect_tunnel(const char *host, int port, int timeout_ms)
+int http_proxy_open_tunnel(const char *host, int port, int timeout_ms)
 {
     struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM };
     struct addrinfo *res = NULL;
@@ -172,7 +174,7 @@ proxy_conn_t *proxy_conn_open(const char *host, int port, int timeout_ms)
         return NULL;
     }
 
-    int sock = open_connect_tunnel(host, port, timeout_ms);
+    int sock = http_proxy_open_tunnel(host, port, timeout_ms);
     if (sock < 0) return NULL;
 
     proxy_conn_t *conn = calloc(1, sizeof(*conn));
@@ -24,6 +24,12 @@ esp_err_t http_proxy_set(const char *host, uint16_t port);
  */
 esp_err_t http_proxy_clear(void);
 
+/**
+ * TCP connect to the proxy and establish a CONNECT tunnel to host:port.
+ * Returns the raw socket fd (caller owns it) or -1.
+ */
+int http_proxy_open_tunnel(const char *host, int port, int timeout_ms);
+
 /* ── Proxied HTTPS connection ─────────────────────────────────── */
 
 typedef struct proxy_conn proxy_conn_t;
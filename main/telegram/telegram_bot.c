@@ -1,13 +1,16 @@
 #include "telegram_bot.h"
 #include "mimi_config.h"
 #include "bus/message_bus.h"
-#include "proxy/http_proxy.h"
+#include "proxy/conn_pool.h"
 
 #include <string.h>
 #include <stdlib.h>
 #include "esp_log.h"
-#include "esp_http_client.h"
-#include "esp_crt_bundle.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "nvs.h"
 #include "cJSON.h"
 
@@ -15,242 +18,856 @@ static const char *TAG = "telegram";
 
 static char s_bot_token[128] = MIMI_SECRET_TG_TOKEN;
 static int64_t s_update_offset = 0;
+static int64_t s_saved_offset = 0;     /* last offset committed to NVS */
 
-/* HTTP response accumulator */
+/* In-progress streamed replies, one per chat. Only touched from the
+ * outbound dispatch task, so no locking. */
 typedef struct {
-    char *buf;
+    bool used;
+    char chat_id[32];
+    int64_t message_id;     /* 0 until the first sendMessage succeeds */
+    char *text;             /* PSRAM, MIMI_TG_MAX_MSG_LEN + 1 */
     size_t len;
-    size_t cap;
-} http_resp_t;
+    int64_t last_edit_ms;
+    bool frozen;            /* too long or send failed: wait for final */
+} tg_draft_t;
 
-static esp_err_t http_event_handler(esp_http_client_event_t *evt)
+static tg_draft_t s_drafts[MIMI_TG_DRAFT_MAX];
+
+#define TG_RESP_MAX         (64 * 1024)
+#define TG_SEND_TIMEOUT_MS  15000
+
+/* ── Bot API call over the shared connection pool ─────────────── */
+
+static char *tg_api_call(const char *method, const char *post_data)
 {
-    http_resp_t *resp = (http_resp_t *)evt->user_data;
-    if (evt->event_id == HTTP_EVENT_ON_DATA) {
-        if (resp->len + evt->data_len >= resp->cap) {
-            size_t new_cap = resp->cap * 2;
-            if (new_cap < resp->len + evt->data_len + 1) {
-                new_cap = resp->len + evt->data_len + 1;
-            }
-            char *tmp = realloc(resp->buf, new_cap);
-            if (!tmp) return ESP_ERR_NO_MEM;
-            resp->buf = tmp;
-            resp->cap = new_cap;
-        }
-        memcpy(resp->buf + resp->len, evt->data, evt->data_len);
-        resp->len += evt->data_len;
-        resp->buf[resp->len] = '\0';
+    char path[256];
+    snprintf(path, sizeof(path), "/bot%s/%s", s_bot_token, method);
+
+    conn_pool_req_t req = {
+        .method = post_data ? "POST" : "GET",
+        .host = "api.telegram.org",
+        .path = path,
+        .headers = post_data ? "Content-Type: application/json\r\n" : NULL,
+        .body = post_data,
+        .body_len = post_data ? strlen(post_data) : 0,
+        .timeout_ms = TG_SEND_TIMEOUT_MS,
+    };
+
+    char *body = NULL;
+    esp_err_t err = conn_pool_http_collect(&req, TG_RESP_MAX, &body, NULL, NULL);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "HTTP request failed: %s", esp_err_to_name(err));
+        return NULL;
     }
-    return ESP_OK;
+    return body;
 }
 
-/* ── Proxy path: manual HTTP over CONNECT tunnel ────────────── */
+/* ── Update handling ──────────────────────────────────────────── */
 
-static char *tg_api_call_via_proxy(const char *path, const char *post_data)
+/* Returns false if the bus pushed back; the offset then stops at the
+ * refused update so the next getUpdates delivers it again. */
+static bool tg_handle_update(int64_t uid, cJSON *update)
 {
-    proxy_conn_t *conn = proxy_conn_open("api.telegram.org", 443,
-                                          (MIMI_TG_POLL_TIMEOUT_S + 5) * 1000);
-    if (!conn) return NULL;
+    /* Already processed before a reboot cut off the confirming poll */
+    if (uid >= 0 && uid < s_saved_offset && s_saved_offset - uid <= MIMI_TG_OFFSET_WINDOW) {
+        return true;
+    }
 
-    /* Build HTTP request */
-    char header[512];
-    int hlen;
-    if (post_data) {
-        hlen = snprintf(header, sizeof(header),
-            "POST /bot%s/%s HTTP/1.1\r\n"
-            "Host: api.telegram.org\r\n"
-            "Content-Type: application/json\r\n"
-            "Content-Length: %d\r\n"
-            "Connection: close\r\n\r\n",
-            s_bot_token, path, (int)strlen(post_data));
-    } else {
-        hlen = snprintf(header, sizeof(header),
-            "GET /bot%s/%s HTTP/1.1\r\n"
-            "Host: api.telegram.org\r\n"
-            "Connection: close\r\n\r\n",
-            s_bot_token, path);
+    cJSON *message = cJSON_GetObjectItem(update, "message");
+    cJSON *text = cJSON_GetObjectItem(message, "text");
+    cJSON *chat_id = cJSON_GetObjectItem(cJSON_GetObjectItem(message, "chat"), "id");
+    if (!cJSON_IsString(text) || !cJSON_IsNumber(chat_id)) return true;
+
+    char chat_id_str[32];
+    snprintf(chat_id_str, sizeof(chat_id_str), "%.0f", chat_id->valuedouble);
+
+    ESP_LOGI(TAG, "Message from chat %s: %.40s...", chat_id_str, text->valuestring);
+
+    /* Push to inbound bus */
+    mimi_msg_t msg = {0};
+    strncpy(msg.channel, MIMI_CHAN_TELEGRAM, sizeof(msg.channel) - 1);
+    strncpy(msg.chat_id, chat_id_str, sizeof(msg.chat_id) - 1);
+    msg.content = strdup(text->valuestring);
+    if (msg.content && message_bus_push_inbound(&msg) != ESP_OK) {
+        free(msg.content);
+        return false;
     }
+    return true;
+}
 
-    if (proxy_conn_write(conn, header, hlen) < 0) {
-        proxy_conn_close(conn);
-        return NULL;
+/* ── Incremental getUpdates parsing ───────────────────────────── */
+
+/* Splits the response into the objects of its top-level "result" array as
+ * bytes arrive; each update is parsed on its own from a fixed buffer, so
+ * the whole body is never held in memory. */
+typedef struct {
+    char *obj;                  /* current update, MIMI_TG_UPDATE_MAX bytes */
+    size_t obj_len;
+    bool obj_overflow;
+    int depth;
+    bool in_str;
+    bool esc;
+    bool in_result;
+    char head[160];             /* start of the body, for error logs */
+    size_t head_len;
+    int updates;
+    bool refused;               /* bus pushed back: skip the rest */
+} tg_poll_parser_t;
+
+static void tg_poll_update_done(tg_poll_parser_t *p)
+{
+    p->updates++;
+    if (p->refused) return;
+
+    /* update_id always leads the object, so it survives an overflow */
+    int64_t uid = -1;
+    const char *id = strstr(p->obj, "\"update_id\":");
+    if (id) uid = strtoll(id + 12, NULL, 10);
+
+    bool accepted = true;
+    if (p->obj_overflow) {
+        ESP_LOGW(TAG, "Update %" PRId64 " larger than %d bytes, skipped",
+                 uid, MIMI_TG_UPDATE_MAX);
+    } else {
+        cJSON *update = cJSON_ParseWithLength(p->obj, p->obj_len);
+        if (update) {
+            accepted = tg_handle_update(uid, update);
+            cJSON_Delete(update);
+        }
     }
-    if (post_data && proxy_conn_write(conn, post_data, strlen(post_data)) < 0) {
-        proxy_conn_close(conn);
-        return NULL;
+
+    if (!accepted) {
+        p->refused = true;
+        if (uid >= 0) s_update_offset = uid;
+    } else if (uid >= s_update_offset) {
+        s_update_offset = uid + 1;
     }
+}
 
-    /* Read response — accumulate until connection close */
-    size_t cap = 4096, len = 0;
-    char *buf = calloc(1, cap);
-    if (!buf) { proxy_conn_close(conn); return NULL; }
+static esp_err_t tg_poll_sink(const char *data, size_t len, void *ctx)
+{
+    tg_poll_parser_t *p = (tg_poll_parser_t *)ctx;
 
-    int timeout = (MIMI_TG_POLL_TIMEOUT_S + 5) * 1000;
-    while (1) {
-        if (len + 1024 >= cap) {
-            cap *= 2;
-            char *tmp = realloc(buf, cap);
-            if (!tmp) break;
-            buf = tmp;
+    for (size_t i = 0; i < len; i++) {
+        char c = data[i];
+        if (p->head_len < sizeof(p->head) - 1) {
+            p->head[p->head_len++] = c;
+            p->head[p->head_len] = '\0';
+        }
+
+        if (!p->in_str && (c == '{' || c == '[')) {
+            p->depth++;
+            if (p->depth == 2 && c == '[') p->in_result = true;
+            if (p->in_result && p->depth == 3) {
+                p->obj_len = 0;
+                p->obj_overflow = false;
+            }
+        }
+
+        if (p->in_result && p->depth >= 3) {
+            if (p->obj_len < MIMI_TG_UPDATE_MAX - 1) p->obj[p->obj_len++] = c;
+            else p->obj_overflow = true;
+        }
+
+        if (p->in_str) {
+            if (p->esc) p->esc = false;
+            else if (c == '\\') p->esc = true;
+            else if (c == '"') p->in_str = false;
+        } else if (c == '"') {
+            p->in_str = true;
+        } else if (c == '}' || c == ']') {
+            if (p->in_result && p->depth == 3 && c == '}') {
+                p->obj[p->obj_len] = '\0';
+                tg_poll_update_done(p);
+            }
+            if (p->depth > 0) p->depth--;
+            if (p->depth < 2) p->in_result = false;
         }
-        int n = proxy_conn_read(conn, buf + len, cap - len - 1, timeout);
-        if (n <= 0) break;
-        len += n;
     }
-    buf[len] = '\0';
-    proxy_conn_close(conn);
+    return ESP_OK;
+}
 
-    /* Skip HTTP headers — find \r\n\r\n */
-    char *body = strstr(buf, "\r\n\r\n");
-    if (!body) { free(buf); return NULL; }
-    body += 4;
+/* ── Offset persistence ───────────────────────────────────────── */
 
-    /* Return just the body */
-    char *result = strdup(body);
-    free(buf);
-    return result;
+static void tg_offset_load(void)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(MIMI_NVS_TG, NVS_READONLY, &nvs) != ESP_OK) return;
+    int64_t off = 0;
+    if (nvs_get_i64(nvs, MIMI_NVS_KEY_TG_OFFSET, &off) == ESP_OK) s_saved_offset = off;
+    nvs_close(nvs);
 }
 
-/* ── Direct path: esp_http_client ───────────────────────────── */
+static void tg_offset_save(void)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(MIMI_NVS_TG, NVS_READWRITE, &nvs) != ESP_OK) return;
+    if (nvs_set_i64(nvs, MIMI_NVS_KEY_TG_OFFSET, s_update_offset) == ESP_OK &&
+        nvs_commit(nvs) == ESP_OK) {
+        s_saved_offset = s_update_offset;
+    }
+    nvs_close(nvs);
+}
+
+/* ── Polling ──────────────────────────────────────────────────── */
 
-static char *tg_api_call_direct(const char *method, const char *post_data)
+static void telegram_poll_task(void *arg)
 {
-    char url[256];
-    snprintf(url, sizeof(url), "https://api.telegram.org/bot%s/%s", s_bot_token, method);
+    ESP_LOGI(TAG, "Telegram polling task started");
 
-    http_resp_t resp = {
-        .buf = calloc(1, 4096),
-        .len = 0,
-        .cap = 4096,
-    };
-    if (!resp.buf) return NULL;
-
-    esp_http_client_config_t config = {
-        .url = url,
-        .event_handler = http_event_handler,
-        .user_data = &resp,
-        .timeout_ms = (MIMI_TG_POLL_TIMEOUT_S + 5) * 1000,
-        .buffer_size = 2048,
-        .buffer_size_tx = 2048,
-        .crt_bundle_attach = esp_crt_bundle_attach,
+    tg_poll_parser_t parser = {
+        .obj = heap_caps_malloc(MIMI_TG_UPDATE_MAX, MALLOC_CAP_SPIRAM),
     };
+    if (!parser.obj) {
+        ESP_LOGE(TAG, "No memory for update buffer");
+        vTaskDelete(NULL);
+        return;
+    }
 
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    if (!client) {
-        free(resp.buf);
-        return NULL;
+    int timeout_s = MIMI_TG_POLL_TIMEOUT_S;
+    int limit = MIMI_TG_POLL_LIMIT_MIN;
+    int backoff_ms = MIMI_TG_BACKOFF_MS;
+    int64_t last_save_ms = esp_timer_get_time() / 1000;
+
+    while (1) {
+        if (s_bot_token[0] == '\0') {
+            ESP_LOGW(TAG, "No bot token configured, waiting...");
+            vTaskDelay(pdMS_TO_TICKS(5000));
+            continue;
+        }
+
+        /* Backpressure: leave updates on Telegram's side while the agent
+         * is behind instead of fetching more than the bus can hold */
+        if (message_bus_inbound_congested()) {
+            limit = MIMI_TG_POLL_LIMIT_MIN;
+            vTaskDelay(pdMS_TO_TICKS(MIMI_TG_BACKOFF_MS));
+            continue;
+        }
+
+        /* Only messages are handled; don't download other update types */
+        char path[256];
+        snprintf(path, sizeof(path),
+                 "/bot%s/getUpdates?offset=%" PRId64 "&timeout=%d&limit=%d"
+                 "&allowed_updates=%%5B%%22message%%22%%5D",
+                 s_bot_token, s_update_offset, timeout_s, limit);
+
+        conn_pool_req_t req = {
+            .host = "api.telegram.org",
+            .path = path,
+            .timeout_ms = (timeout_s + 5) * 1000,
+            .on_data = tg_poll_sink,
+            .ctx = &parser,
+        };
+        parser.depth = 0;
+        parser.in_str = parser.esc = parser.in_result = false;
+        parser.head_len = 0;
+        parser.head[0] = '\0';
+        parser.updates = 0;
+        parser.refused = false;
+
+        int status = 0;
+        esp_err_t err = conn_pool_http(&req, &status);
+
+        if (err != ESP_OK || status != 200) {
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "getUpdates failed: %s", esp_err_to_name(err));
+            } else {
+                ESP_LOGE(TAG, "getUpdates HTTP %d: %s", status, parser.head);
+            }
+            /* An idle connection dropped mid-poll usually means a NAT or
+             * proxy timeout: ask for shorter polls */
+            if (err == ESP_ERR_TIMEOUT || err == ESP_ERR_INVALID_RESPONSE) {
+                timeout_s = timeout_s / 2 > MIMI_TG_POLL_TIMEOUT_MIN_S
+                          ? timeout_s / 2 : MIMI_TG_POLL_TIMEOUT_MIN_S;
+            }
+            vTaskDelay(pdMS_TO_TICKS(backoff_ms));
+            backoff_ms = backoff_ms * 2 < MIMI_TG_POLL_BACKOFF_MAX_MS
+                       ? backoff_ms * 2 : MIMI_TG_POLL_BACKOFF_MAX_MS;
+            continue;
+        }
+        backoff_ms = MIMI_TG_BACKOFF_MS;
+
+        /* Traffic: a full batch widens the next one; an empty poll lets the
+         * limit decay and stretches the poll back toward the maximum */
+        if (parser.updates >= limit && !parser.refused) {
+            limit = limit * 2 < MIMI_TG_POLL_LIMIT_MAX ? limit * 2 : MIMI_TG_POLL_LIMIT_MAX;
+        } else if (parser.updates == 0) {
+            limit = limit / 2 > MIMI_TG_POLL_LIMIT_MIN ? limit / 2 : MIMI_TG_POLL_LIMIT_MIN;
+            timeout_s = timeout_s + 5 < MIMI_TG_POLL_TIMEOUT_S ? timeout_s + 5 : MIMI_TG_POLL_TIMEOUT_S;
+        }
+
+        /* Persist the offset in batches, and whenever traffic goes quiet */
+        int64_t now = esp_timer_get_time() / 1000;
+        int64_t unsaved = s_update_offset - s_saved_offset;
+        if (s_update_offset > 0 && s_update_offset != s_saved_offset &&
+            (unsaved < 0 || unsaved >= MIMI_TG_OFFSET_SAVE_EVERY || parser.updates == 0 ||
+             now - last_save_ms >= MIMI_TG_OFFSET_SAVE_MS)) {
+            tg_offset_save();
+            last_save_ms = now;
+        }
+
+        if (parser.refused) {
+            limit = MIMI_TG_POLL_LIMIT_MIN;
+            vTaskDelay(pdMS_TO_TICKS(MIMI_TG_BACKOFF_MS));
+        }
     }
+}
+
+/* ── Markdown-safe splitting ──────────────────────────────────── */
+
+/* Legacy Telegram Markdown: entities do not nest, so one state is enough */
+typedef enum {
+    MD_TEXT = 0,
+    MD_BOLD,
+    MD_ITALIC,
+    MD_CODE,
+    MD_PRE,
+    MD_LINK_TEXT,
+    MD_LINK_URL,
+} md_state_t;
+
+typedef struct {
+    uint32_t off;
+    uint16_t len;
+    bool markdown;          /* entities balanced: send with parse_mode */
+} tg_seg_t;
 
-    if (post_data) {
-        esp_http_client_set_method(client, HTTP_METHOD_POST);
-        esp_http_client_set_header(client, "Content-Type", "application/json");
-        esp_http_client_set_post_field(client, post_data, strlen(post_data));
+/* Advance the entity state over s[i]; returns the bytes consumed */
+static size_t md_step(md_state_t *st, const char *s, size_t i, size_t len)
+{
+    char c = s[i];
+    bool fence = c == '`' && i + 2 < len && s[i + 1] == '`' && s[i + 2] == '`';
+
+    switch (*st) {
+    case MD_TEXT:
+        if (c == '\\' && i + 1 < len) return 2;
+        if (fence) { *st = MD_PRE; return 3; }
+        if (c == '`') *st = MD_CODE;
+        else if (c == '*') *st = MD_BOLD;
+        else if (c == '_') *st = MD_ITALIC;
+        else if (c == '[') *st = MD_LINK_TEXT;
+        return 1;
+    case MD_PRE:
+        if (fence) { *st = MD_TEXT; return 3; }
+        return 1;
+    case MD_CODE:
+        if (c == '`') *st = MD_TEXT;
+        return 1;
+    case MD_BOLD:
+        if (c == '*') *st = MD_TEXT;
+        return 1;
+    case MD_ITALIC:
+        if (c == '_') *st = MD_TEXT;
+        return 1;
+    case MD_LINK_TEXT:
+        if (c == ']') {
+            if (i + 1 < len && s[i + 1] == '(') { *st = MD_LINK_URL; return 2; }
+            *st = MD_TEXT;
+        }
+        return 1;
+    case MD_LINK_URL:
+        if (c == ')') *st = MD_TEXT;
+        return 1;
     }
+    return 1;
+}
 
-    esp_err_t err = esp_http_client_perform(client);
-    esp_http_client_cleanup(client);
+/* Length of the next segment of s (len bytes left). Cuts where no entity is
+ * open, preferring paragraph, then line, then word breaks; a cut inside an
+ * entity (e.g. a code block longer than a message) sends both halves plain. */
+static size_t tg_split_next(const char *s, size_t len, bool *markdown)
+{
+    const size_t max = MIMI_TG_MAX_MSG_LEN;
+    const size_t min = max / 4;     /* don't trade a clean cut for a stub */
+    size_t para = 0, line = 0, word = 0, clean = 0;
+    size_t any_line = 0, any_word = 0, any_char = 0;
+    md_state_t st = MD_TEXT;
+    size_t i = 0;
+
+    while (i < len && i <= max) {
+        if (i > 0 && ((uint8_t)s[i] & 0xC0) != 0x80) {
+            char prev = s[i - 1];
+            any_char = i;
+            if (prev == '\n') any_line = i;
+            if (prev == ' ') any_word = i;
+            if (st == MD_TEXT) {
+                clean = i;
+                if (prev == '\n' && i > 1 && s[i - 2] == '\n') para = i;
+                else if (prev == '\n') line = i;
+                else if (prev == ' ') word = i;
+            }
+        }
+        if (i == max) break;
+        i += md_step(&st, s, i, len);
+    }
 
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "HTTP request failed: %s", esp_err_to_name(err));
-        free(resp.buf);
-        return NULL;
+    if (len <= max) {
+        *markdown = st == MD_TEXT;
+        return len;
     }
 
-    return resp.buf;
+    *markdown = true;
+    if (para >= min) return para;
+    if (line >= min) return line;
+    if (word >= min) return word;
+    if (clean >= min) return clean;
+
+    *markdown = false;
+    if (any_line >= min) return any_line;
+    if (any_word >= min) return any_word;
+    return any_char ? any_char : max;
 }
 
-static char *tg_api_call(const char *method, const char *post_data)
+/* ── Rate limiting ────────────────────────────────────────────── */
+
+typedef struct {
+    int32_t milli;              /* tokens × 1000 */
+    int32_t per_s;
+    int32_t burst;
+    int64_t stamp_ms;
+    int64_t paused_until_ms;    /* retry_after from a 429 */
+} tg_bucket_t;
+
+static void bucket_init(tg_bucket_t *b, int per_s, int burst, int64_t now)
+{
+    b->per_s = per_s;
+    b->burst = burst;
+    b->milli = burst * 1000;
+    b->stamp_ms = now;
+    b->paused_until_ms = 0;
+}
+
+/* Whole tokens available now (0 while paused) */
+static int bucket_tokens(tg_bucket_t *b, int64_t now)
+{
+    int64_t milli = b->milli + (now - b->stamp_ms) * b->per_s;
+    if (milli > (int64_t)b->burst * 1000) milli = (int64_t)b->burst * 1000;
+    b->milli = (int32_t)milli;
+    b->stamp_ms = now;
+    return now < b->paused_until_ms ? 0 : b->milli / 1000;
+}
+
+/* Milliseconds until one token is available */
+static int64_t bucket_wait_ms(tg_bucket_t *b, int64_t now)
+{
+    int64_t wait = 0;
+    if (bucket_tokens(b, now) < 1) wait = (1000 - b->milli + b->per_s - 1) / b->per_s;
+    if (now + wait < b->paused_until_ms) wait = b->paused_until_ms - now;
+    return wait;
+}
+
+static void bucket_take(tg_bucket_t *b, int n)
+{
+    b->milli -= n * 1000;
+}
+
+static void bucket_pause(tg_bucket_t *b, int64_t now, int64_t ms)
+{
+    b->milli = 0;
+    b->stamp_ms = now;
+    if (now + ms > b->paused_until_ms) b->paused_until_ms = now + ms;
+}
+
+/* ── Per-chat send queue ──────────────────────────────────────── */
+
+/* One reply, split up front. Text and segment table share one PSRAM block. */
+typedef struct tg_job {
+    struct tg_job *next;
+    int64_t edit_id;            /* streamed draft replaced by the first segment */
+    int n_segs;
+    int next_seg;
+    int failures;
+    tg_seg_t *segs;
+    char *text;
+} tg_job_t;
+
+typedef struct {
+    bool used;
+    char chat_id[32];
+    tg_job_t *head;             /* appended by producers, popped by tg_send */
+    tg_job_t *tail;
+    int depth;
+    tg_bucket_t bucket;
+    int64_t last_send_ms;
+} tg_chat_q_t;
+
+typedef struct {
+    char body[1024];            /* head of the response: enough for errors */
+    size_t len;
+} tg_resp_t;
+
+static tg_chat_q_t s_chats[MIMI_TG_SEND_CHATS];
+static tg_bucket_t s_global_bucket;
+static SemaphoreHandle_t s_send_lock;
+static SemaphoreHandle_t s_send_wake;
+static tg_resp_t *s_send_resp;
+
+static int64_t now_ms(void)
+{
+    return esp_timer_get_time() / 1000;
+}
+
+static tg_chat_q_t *chat_q_find(const char *chat_id)
 {
-    if (http_proxy_is_enabled()) {
-        return tg_api_call_via_proxy(method, post_data);
+    for (int i = 0; i < MIMI_TG_SEND_CHATS; i++) {
+        if (s_chats[i].used && strcmp(s_chats[i].chat_id, chat_id) == 0) return &s_chats[i];
     }
-    return tg_api_call_direct(method, post_data);
+    return NULL;
 }
 
-static void process_updates(const char *json_str)
+/* Find or claim a queue; an idle chat's slot (and rate state) is recycled
+ * least recently used first. Call with s_send_lock held. */
+static tg_chat_q_t *chat_q_get(const char *chat_id)
 {
-    cJSON *root = cJSON_Parse(json_str);
-    if (!root) return;
+    tg_chat_q_t *q = chat_q_find(chat_id);
+    if (q) return q;
 
-    cJSON *ok = cJSON_GetObjectItem(root, "ok");
-    if (!cJSON_IsTrue(ok)) {
-        cJSON_Delete(root);
-        return;
+    for (int i = 0; i < MIMI_TG_SEND_CHATS; i++) {
+        tg_chat_q_t *c = &s_chats[i];
+        if (!c->used) { q = c; break; }
+        if (!c->head && (!q || c->last_send_ms < q->last_send_ms)) q = c;
     }
+    if (!q) return NULL;
 
-    cJSON *result = cJSON_GetObjectItem(root, "result");
-    if (!cJSON_IsArray(result)) {
-        cJSON_Delete(root);
-        return;
+    memset(q, 0, sizeof(*q));
+    q->used = true;
+    strncpy(q->chat_id, chat_id, sizeof(q->chat_id) - 1);
+    bucket_init(&q->bucket, MIMI_TG_RATE_CHAT, MIMI_TG_RATE_CHAT_BURST, now_ms());
+    return q;
+}
+
+static tg_job_t *tg_job_create(const char *text, int64_t edit_id)
+{
+    size_t len = strlen(text);
+    int n = 0;
+    bool md;
+    for (size_t off = 0; off < len; n++) off += tg_split_next(text + off, len - off, &md);
+    if (n == 0) return NULL;
+
+    tg_job_t *job = heap_caps_calloc(1, sizeof(*job) + n * sizeof(tg_seg_t) + len + 1,
+                                     MALLOC_CAP_SPIRAM);
+    if (!job) return NULL;
+    job->segs = (tg_seg_t *)(job + 1);
+    job->text = (char *)(job->segs + n);
+    memcpy(job->text, text, len + 1);
+    job->edit_id = edit_id;
+    job->n_segs = n;
+
+    size_t off = 0;
+    for (int i = 0; i < n; i++) {
+        size_t seg = tg_split_next(job->text + off, len - off, &md);
+        job->segs[i] = (tg_seg_t){ .off = off, .len = (uint16_t)seg, .markdown = md };
+        off += seg;
     }
+    return job;
+}
 
-    cJSON *update;
-    cJSON_ArrayForEach(update, result) {
-        /* Track offset */
-        cJSON *update_id = cJSON_GetObjectItem(update, "update_id");
-        if (cJSON_IsNumber(update_id)) {
-            int64_t uid = (int64_t)update_id->valuedouble;
-            if (uid >= s_update_offset) {
-                s_update_offset = uid + 1;
-            }
-        }
+static esp_err_t tg_resp_sink(const char *data, size_t len, void *ctx)
+{
+    tg_resp_t *r = (tg_resp_t *)ctx;
+    size_t room = sizeof(r->body) - 1 - r->len;
+    if (len > room) len = room;
+    memcpy(r->body + r->len, data, len);
+    r->len += len;
+    r->body[r->len] = '\0';
+    return ESP_OK;
+}
 
-        /* Extract message */
-        cJSON *message = cJSON_GetObjectItem(update, "message");
-        if (!message) continue;
+/* Numeric field from a (possibly truncated) response head */
+static int64_t tg_resp_number(const char *body, const char *key)
+{
+    char pat[32];
+    snprintf(pat, sizeof(pat), "\"%s\":", key);
+    const char *p = strstr(body, pat);
+    return p ? strtoll(p + strlen(pat), NULL, 10) : 0;
+}
 
-        cJSON *text = cJSON_GetObjectItem(message, "text");
-        if (!text || !cJSON_IsString(text)) continue;
+typedef enum {
+    TG_SENT = 0,
+    TG_RATE_LIMITED,
+    TG_BAD_MARKUP,              /* Telegram could not parse the entities */
+    TG_EDIT_FAILED,             /* draft gone or too old: send a new message */
+    TG_REJECTED,                /* chat not found, bot blocked, ... */
+    TG_NET_ERROR,
+} tg_outcome_t;
 
-        cJSON *chat = cJSON_GetObjectItem(message, "chat");
-        if (!chat) continue;
+static tg_outcome_t tg_classify(int status, const char *body, bool edit, bool markdown)
+{
+    if (status == 200) return TG_SENT;
+    if (status == 0 || status >= 500) return TG_NET_ERROR;
+    if (status == 429) return TG_RATE_LIMITED;
+    if (edit && strstr(body, "not modified")) return TG_SENT;
+    if (markdown && strstr(body, "can't parse entities")) return TG_BAD_MARKUP;
+    if (edit) return TG_EDIT_FAILED;
+    return TG_REJECTED;
+}
 
-        cJSON *chat_id = cJSON_GetObjectItem(chat, "id");
-        if (!chat_id) continue;
+static void tg_delete_message(const char *chat_id, int64_t message_id)
+{
+    char body[96];
+    snprintf(body, sizeof(body), "{\"chat_id\":\"%s\",\"message_id\":%" PRId64 "}",
+             chat_id, message_id);
+    char *resp = tg_api_call("deleteMessage", body);
+    free(resp);
+}
 
-        char chat_id_str[32];
-        snprintf(chat_id_str, sizeof(chat_id_str), "%.0f", chat_id->valuedouble);
+/* Send segments [next_seg, next_seg + n) of job back to back on one
+ * connection. Returns the delay before the chat may send again; *drop is set
+ * when the job should be abandoned. */
+static int64_t tg_send_window(tg_chat_q_t *q, tg_job_t *job, int n, bool *drop)
+{
+    conn_pool_req_t reqs[MIMI_TG_SEND_PIPELINE];
+    char *bodies[MIMI_TG_SEND_PIPELINE] = {0};
+    int status[MIMI_TG_SEND_PIPELINE];
+    char path_send[192], path_edit[192];
+    snprintf(path_send, sizeof(path_send), "/bot%s/sendMessage", s_bot_token);
+    snprintf(path_edit, sizeof(path_edit), "/bot%s/editMessageText", s_bot_token);
+    *drop = false;
+
+    int built = 0;
+    for (; built < n; built++) {
+        tg_seg_t *seg = &job->segs[job->next_seg + built];
+        bool edit = built == 0 && job->edit_id;
+
+        /* Terminate the segment in place instead of copying it */
+        char *end = job->text + seg->off + seg->len;
+        char saved = *end;
+        *end = '\0';
+        cJSON *body = cJSON_CreateObject();
+        cJSON_AddStringToObject(body, "chat_id", q->chat_id);
+        if (edit) cJSON_AddNumberToObject(body, "message_id", (double)job->edit_id);
+        cJSON_AddStringToObject(body, "text", job->text + seg->off);
+        if (seg->markdown) cJSON_AddStringToObject(body, "parse_mode", "Markdown");
+        *end = saved;
+        bodies[built] = cJSON_PrintUnformatted(body);
+        cJSON_Delete(body);
+        if (!bodies[built]) break;
+
+        s_send_resp[built].len = 0;
+        s_send_resp[built].body[0] = '\0';
+        reqs[built] = (conn_pool_req_t){
+            .method = "POST",
+            .host = "api.telegram.org",
+            .path = edit ? path_edit : path_send,
+            .headers = "Content-Type: application/json\r\n",
+            .body = bodies[built],
+            .body_len = strlen(bodies[built]),
+            .timeout_ms = TG_SEND_TIMEOUT_MS,
+            .on_data = tg_resp_sink,
+            .ctx = &s_send_resp[built],
+        };
+    }
 
-        ESP_LOGI(TAG, "Message from chat %s: %.40s...", chat_id_str, text->valuestring);
+    int done = 0;
+    esp_err_t err = built ? conn_pool_http_pipeline(reqs, built, status, &done) : ESP_ERR_NO_MEM;
+    for (int i = 0; i < built; i++) free(bodies[i]);
+    if (err != ESP_OK && done == 0) {
+        ESP_LOGW(TAG, "Send to %s failed: %s", q->chat_id, esp_err_to_name(err));
+    }
 
-        /* Push to inbound bus */
-        mimi_msg_t msg = {0};
-        strncpy(msg.channel, MIMI_CHAN_TELEGRAM, sizeof(msg.channel) - 1);
-        strncpy(msg.chat_id, chat_id_str, sizeof(msg.chat_id) - 1);
-        msg.content = strdup(text->valuestring);
-        if (msg.content) {
-            message_bus_push_inbound(&msg);
-        }
+    tg_outcome_t out[MIMI_TG_SEND_PIPELINE];
+    for (int i = 0; i < n; i++) {
+        tg_seg_t *seg = &job->segs[job->next_seg + i];
+        out[i] = i < done ? tg_classify(status[i], s_send_resp[i].body,
+                                        i == 0 && job->edit_id, seg->markdown)
+                          : TG_NET_ERROR;
     }
 
-    cJSON_Delete(root);
+    int k = 0;
+    while (k < n && out[k] == TG_SENT) k++;
+    if (k > 0) {
+        job->next_seg += k;
+        job->edit_id = 0;
+        job->failures = 0;
+    }
+    if (k == n) return 0;
+
+    /* Segments past the failed one arrived out of order: take them back so
+     * the reply reads correctly once the failed one is resent. Responses
+     * never read are unknown and may show up as duplicates. */
+    for (int j = k + 1; j < done; j++) {
+        if (out[j] != TG_SENT) continue;
+        int64_t mid = tg_resp_number(s_send_resp[j].body, "message_id");
+        if (mid > 0) tg_delete_message(q->chat_id, mid);
+    }
+
+    tg_seg_t *seg = &job->segs[job->next_seg];
+    switch (out[k]) {
+    case TG_RATE_LIMITED: {
+        int64_t retry_s = tg_resp_number(s_send_resp[k].body, "retry_after");
+        ESP_LOGW(TAG, "Rate limited in chat %s, retry after %ds", q->chat_id, (int)retry_s);
+        return (retry_s > 0 ? retry_s : 1) * 1000;
+    }
+    case TG_BAD_MARKUP:
+        ESP_LOGW(TAG, "Markdown rejected, resending segment plain");
+        seg->markdown = false;
+        return 0;
+    case TG_EDIT_FAILED:
+        job->edit_id = 0;
+        return 0;
+    case TG_REJECTED:
+        ESP_LOGE(TAG, "Telegram rejected message to %s (HTTP %d): %.120s",
+                 q->chat_id, status[k], s_send_resp[k].body);
+        *drop = true;
+        return 0;
+    default:
+        if (++job->failures > MIMI_TG_SEND_RETRIES) {
+            ESP_LOGE(TAG, "Giving up on reply to %s after %d failures", q->chat_id, job->failures);
+            *drop = true;
+            return 0;
+        }
+        return 1000LL << (job->failures - 1);
+    }
 }
 
-static void telegram_poll_task(void *arg)
+static void telegram_send_task(void *arg)
 {
-    ESP_LOGI(TAG, "Telegram polling task started");
+    ESP_LOGI(TAG, "Telegram send task started");
 
     while (1) {
-        if (s_bot_token[0] == '\0') {
-            ESP_LOGW(TAG, "No bot token configured, waiting...");
-            vTaskDelay(pdMS_TO_TICKS(5000));
+        /* Pick the ready chat that sent least recently */
+        tg_chat_q_t *q = NULL;
+        int64_t wait = -1;
+        int n = 0;
+
+        xSemaphoreTake(s_send_lock, portMAX_DELAY);
+        int64_t now = now_ms();
+        int64_t global_wait = bucket_wait_ms(&s_global_bucket, now);
+        for (int i = 0; i < MIMI_TG_SEND_CHATS; i++) {
+            tg_chat_q_t *c = &s_chats[i];
+            if (!c->used || !c->head) continue;
+            int64_t w = bucket_wait_ms(&c->bucket, now);
+            if (w < global_wait) w = global_wait;
+            if (wait < 0 || w < wait || (w == wait && c->last_send_ms < q->last_send_ms)) {
+                q = c;
+                wait = w;
+            }
+        }
+        tg_job_t *job = q ? q->head : NULL;
+        if (job && wait == 0) {
+            n = job->n_segs - job->next_seg;
+            int tokens = bucket_tokens(&q->bucket, now);
+            int global = bucket_tokens(&s_global_bucket, now);
+            if (n > tokens) n = tokens;
+            if (n > global) n = global;
+            if (n > MIMI_TG_SEND_PIPELINE) n = MIMI_TG_SEND_PIPELINE;
+            if (job->edit_id) n = 1;    /* the edit may fall back to a new message */
+            bucket_take(&q->bucket, n);
+            bucket_take(&s_global_bucket, n);
+            q->last_send_ms = now;
+        }
+        xSemaphoreGive(s_send_lock);
+
+        if (n == 0) {
+            xSemaphoreTake(s_send_wake, wait < 0 ? portMAX_DELAY : pdMS_TO_TICKS(wait) + 1);
             continue;
         }
 
-        char params[128];
-        snprintf(params, sizeof(params),
-                 "getUpdates?offset=%" PRId64 "&timeout=%d",
-                 s_update_offset, MIMI_TG_POLL_TIMEOUT_S);
+        bool drop = false;
+        int64_t pause = tg_send_window(q, job, n, &drop);
 
-        char *resp = tg_api_call(params, NULL);
-        if (resp) {
-            process_updates(resp);
-            free(resp);
+        xSemaphoreTake(s_send_lock, portMAX_DELAY);
+        if (pause > 0) bucket_pause(&q->bucket, now_ms(), pause);
+        if (drop || job->next_seg >= job->n_segs) {
+            q->head = job->next;
+            if (!q->head) q->tail = NULL;
+            q->depth--;
         } else {
-            /* Back off on error */
-            vTaskDelay(pdMS_TO_TICKS(3000));
+            job = NULL;
+        }
+        xSemaphoreGive(s_send_lock);
+        free(job);
+    }
+}
+
+/* ── Streaming drafts ─────────────────────────────────────────── */
+
+/* Take a rate token for a draft update. Drafts are best effort: they yield
+ * to queued replies and are skipped rather than delayed. */
+static bool tg_draft_may_send(const char *chat_id)
+{
+    bool ok = false;
+    xSemaphoreTake(s_send_lock, portMAX_DELAY);
+    int64_t now = now_ms();
+    tg_chat_q_t *q = chat_q_get(chat_id);
+    if ((!q || !q->head) && bucket_tokens(&s_global_bucket, now) > 0 &&
+        (!q || bucket_tokens(&q->bucket, now) > 0)) {
+        bucket_take(&s_global_bucket, 1);
+        if (q) {
+            bucket_take(&q->bucket, 1);
+            q->last_send_ms = now;
+        }
+        ok = true;
+    }
+    xSemaphoreGive(s_send_lock);
+    return ok;
+}
+
+/* Send a new plain-text draft (edit_id == 0) or edit an existing one.
+ * Returns the message_id on success, 0 on failure. */
+static int64_t tg_post_draft(const char *chat_id, int64_t edit_id, const char *text)
+{
+    cJSON *body = cJSON_CreateObject();
+    cJSON_AddStringToObject(body, "chat_id", chat_id);
+    if (edit_id) cJSON_AddNumberToObject(body, "message_id", (double)edit_id);
+    cJSON_AddStringToObject(body, "text", text);
+    char *json_str = cJSON_PrintUnformatted(body);
+    cJSON_Delete(body);
+    if (!json_str) return 0;
+
+    char *resp = tg_api_call(edit_id ? "editMessageText" : "sendMessage", json_str);
+    free(json_str);
+    if (!resp) return 0;
+
+    int64_t result_id = 0;
+    cJSON *root = cJSON_Parse(resp);
+    free(resp);
+    if (!root) return 0;
+
+    if (cJSON_IsTrue(cJSON_GetObjectItem(root, "ok"))) {
+        cJSON *result = cJSON_GetObjectItem(root, "result");
+        cJSON *mid = cJSON_GetObjectItem(result, "message_id");
+        result_id = cJSON_IsNumber(mid) ? (int64_t)mid->valuedouble : edit_id;
+    } else {
+        cJSON *desc = cJSON_GetObjectItem(root, "description");
+        if (edit_id && cJSON_IsString(desc) && strstr(desc->valuestring, "not modified")) {
+            result_id = edit_id;
+        }
+    }
+    cJSON_Delete(root);
+    return result_id;
+}
+
+static tg_draft_t *tg_draft_find(const char *chat_id)
+{
+    for (int i = 0; i < MIMI_TG_DRAFT_MAX; i++) {
+        if (s_drafts[i].used && strcmp(s_drafts[i].chat_id, chat_id) == 0) {
+            return &s_drafts[i];
         }
     }
+    return NULL;
+}
+
+static tg_draft_t *tg_draft_claim(const char *chat_id)
+{
+    tg_draft_t *slot = NULL;
+    for (int i = 0; i < MIMI_TG_DRAFT_MAX; i++) {
+        tg_draft_t *d = &s_drafts[i];
+        if (!d->used) { slot = d; break; }
+        if (!slot || d->last_edit_ms < slot->last_edit_ms) slot = d;
+    }
+
+    char *text = slot->text;
+    if (!text) {
+        text = heap_caps_calloc(1, MIMI_TG_MAX_MSG_LEN + 1, MALLOC_CAP_SPIRAM);
+        if (!text) return NULL;
+    }
+    memset(slot, 0, sizeof(*slot));
+    slot->used = true;
+    slot->text = text;
+    strncpy(slot->chat_id, chat_id, sizeof(slot->chat_id) - 1);
+    return slot;
 }
 
 /* --- Public API --- */
@@ -270,6 +887,14 @@ esp_err_t telegram_bot_init(void)
 
     /* s_bot_token is already initialized from MIMI_SECRET_TG_TOKEN as fallback */
 
+    tg_offset_load();
+
+    s_send_lock = xSemaphoreCreateMutex();
+    s_send_wake = xSemaphoreCreateBinary();
+    s_send_resp = heap_caps_calloc(MIMI_TG_SEND_PIPELINE, sizeof(tg_resp_t), MALLOC_CAP_SPIRAM);
+    if (!s_send_lock || !s_send_wake || !s_send_resp) return ESP_ERR_NO_MEM;
+    bucket_init(&s_global_bucket, MIMI_TG_RATE_GLOBAL, MIMI_TG_RATE_GLOBAL, now_ms());
+
     if (s_bot_token[0]) {
         ESP_LOGI(TAG, "Telegram bot token loaded (len=%d)", (int)strlen(s_bot_token));
     } else {
@@ -280,7 +905,15 @@ esp_err_t telegram_bot_init(void)
 
 esp_err_t telegram_bot_start(void)
 {
-    BaseType_t ret = xTaskCreatePinnedToCore(
+    /* tg_send never touches NVS (offsets are saved by tg_poll), so its
+     * stack can live in PSRAM */
+    BaseType_t ret = xTaskCreatePinnedToCoreWithCaps(
+        telegram_send_task, "tg_send",
+        MIMI_TG_SEND_STACK, NULL,
+        MIMI_TG_SEND_PRIO, NULL, MIMI_TG_SEND_CORE, MALLOC_CAP_SPIRAM);
+    if (ret != pdPASS) return ESP_FAIL;
+
+    ret = xTaskCreatePinnedToCore(
         telegram_poll_task, "tg_poll",
         MIMI_TG_POLL_STACK, NULL,
         MIMI_TG_POLL_PRIO, NULL, MIMI_TG_POLL_CORE);
@@ -288,86 +921,76 @@ esp_err_t telegram_bot_start(void)
     return (ret == pdPASS) ? ESP_OK : ESP_FAIL;
 }
 
-esp_err_t telegram_send_message(const char *chat_id, const char *text)
+esp_err_t telegram_send_delta(const char *chat_id, const char *text)
 {
-    if (s_bot_token[0] == '\0') {
-        ESP_LOGW(TAG, "Cannot send: no bot token");
-        return ESP_ERR_INVALID_STATE;
+    if (s_bot_token[0] == '\0') return ESP_ERR_INVALID_STATE;
+
+    tg_draft_t *d = tg_draft_find(chat_id);
+    if (!d) d = tg_draft_claim(chat_id);
+    if (!d) return ESP_ERR_NO_MEM;
+    if (d->frozen) return ESP_OK;
+
+    size_t add = strlen(text);
+    if (add == 0) return ESP_OK;
+    if (d->len + add > MIMI_TG_MAX_MSG_LEN) {
+        /* Draft would need splitting; leave it as is until the final reply */
+        d->frozen = true;
+        return ESP_OK;
     }
+    memcpy(d->text + d->len, text, add);
+    d->len += add;
+    d->text[d->len] = '\0';
 
-    /* Split long messages at 4096-char boundary */
-    size_t text_len = strlen(text);
-    size_t offset = 0;
-
-    while (offset < text_len) {
-        size_t chunk = text_len - offset;
-        if (chunk > MIMI_TG_MAX_MSG_LEN) {
-            chunk = MIMI_TG_MAX_MSG_LEN;
-        }
+    int64_t now = esp_timer_get_time() / 1000;
+    if (d->message_id && now - d->last_edit_ms < MIMI_TG_EDIT_INTERVAL_MS) {
+        return ESP_OK;
+    }
 
-        /* Build JSON body */
-        cJSON *body = cJSON_CreateObject();
-        cJSON_AddStringToObject(body, "chat_id", chat_id);
+    if (!tg_draft_may_send(chat_id)) return ESP_OK;
 
-        /* Create null-terminated chunk */
-        char *segment = malloc(chunk + 1);
-        if (!segment) {
-            cJSON_Delete(body);
-            return ESP_ERR_NO_MEM;
-        }
-        memcpy(segment, text + offset, chunk);
-        segment[chunk] = '\0';
+    /* Drafts go out as plain text: partial Markdown is rarely valid */
+    int64_t id = tg_post_draft(chat_id, d->message_id, d->text);
+    d->last_edit_ms = now;
+    if (!id) {
+        d->frozen = true;
+        return ESP_FAIL;
+    }
+    d->message_id = id;
+    return ESP_OK;
+}
 
-        cJSON_AddStringToObject(body, "text", segment);
-        cJSON_AddStringToObject(body, "parse_mode", "Markdown");
+esp_err_t telegram_send_message(const char *chat_id, const char *text)
+{
+    if (s_bot_token[0] == '\0') {
+        ESP_LOGW(TAG, "Cannot send: no bot token");
+        return ESP_ERR_INVALID_STATE;
+    }
 
-        char *json_str = cJSON_PrintUnformatted(body);
-        cJSON_Delete(body);
-        free(segment);
-
-        if (json_str) {
-            char *resp = tg_api_call("sendMessage", json_str);
-            free(json_str);
-            if (resp) {
-                /* Check for Markdown parse error, retry as plain text */
-                cJSON *root = cJSON_Parse(resp);
-                if (root) {
-                    cJSON *ok_field = cJSON_GetObjectItem(root, "ok");
-                    if (!cJSON_IsTrue(ok_field)) {
-                        ESP_LOGW(TAG, "Markdown send failed, retrying plain");
-                        cJSON_Delete(root);
-                        free(resp);
-
-                        /* Retry without parse_mode */
-                        cJSON *body2 = cJSON_CreateObject();
-                        cJSON_AddStringToObject(body2, "chat_id", chat_id);
-                        char *seg2 = malloc(chunk + 1);
-                        if (seg2) {
-                            memcpy(seg2, text + offset, chunk);
-                            seg2[chunk] = '\0';
-                            cJSON_AddStringToObject(body2, "text", seg2);
-                            free(seg2);
-                        }
-                        char *json2 = cJSON_PrintUnformatted(body2);
-                        cJSON_Delete(body2);
-                        if (json2) {
-                            char *resp2 = tg_api_call("sendMessage", json2);
-                            free(json2);
-                            free(resp2);
-                        }
-                    } else {
-                        cJSON_Delete(root);
-                        free(resp);
-                    }
-                } else {
-                    free(resp);
-                }
-            }
-        }
+    /* A streamed draft is replaced in place by the first segment */
+    tg_draft_t *draft = tg_draft_find(chat_id);
+    tg_job_t *job = tg_job_create(text, draft ? draft->message_id : 0);
+    if (!job) return text[0] ? ESP_ERR_NO_MEM : ESP_OK;
 
-        offset += chunk;
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(s_send_lock, portMAX_DELAY);
+    tg_chat_q_t *q = chat_q_get(chat_id);
+    if (!q || q->depth >= MIMI_TG_SEND_QUEUE_LEN) {
+        err = ESP_ERR_NO_MEM;
+    } else {
+        if (q->tail) q->tail->next = job;
+        else q->head = job;
+        q->tail = job;
+        q->depth++;
     }
+    xSemaphoreGive(s_send_lock);
 
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Send queue for %s full", chat_id);
+        free(job);
+        return err;
+    }
+    if (draft) draft->used = false;
+    xSemaphoreGive(s_send_wake);
     return ESP_OK;
 }
 
@@ -376,10 +999,13 @@ esp_err_t telegram_set_token(const char *token)
     nvs_handle_t nvs;
     ESP_ERROR_CHECK(nvs_open(MIMI_NVS_TG, NVS_READWRITE, &nvs));
     ESP_ERROR_CHECK(nvs_set_str(nvs, MIMI_NVS_KEY_TG_TOKEN, token));
+    nvs_erase_key(nvs, MIMI_NVS_KEY_TG_OFFSET);     /* update ids are per bot */
     ESP_ERROR_CHECK(nvs_commit(nvs));
     nvs_close(nvs);
 
     strncpy(s_bot_token, token, sizeof(s_bot_token) - 1);
+    s_update_offset = 0;
+    s_saved_offset = 0;
     ESP_LOGI(TAG, "Telegram bot token saved");
     return ESP_OK;
 }
@@ -8,18 +8,30 @@
 esp_err_t telegram_bot_init(void);
 
 /**
- * Start the Telegram polling task (long polling on Core 0).
+ * Start the Telegram polling and send tasks (Core 0).
  */
 esp_err_t telegram_bot_start(void);
 
 /**
- * Send a text message to a Telegram chat.
- * Automatically splits messages longer than 4096 chars.
+ * Queue a text message for a Telegram chat. It is split at Markdown-safe
+ * boundaries into 4096-byte segments and sent by the tg_send task within
+ * the per-chat and global rate limits. tg_send handles 429 pauses and
+ * retries network failures (MIMI_TG_SEND_RETRIES); the outcome is logged,
+ * not reported back, so callers should not retry.
  * @param chat_id  Telegram chat ID (numeric string)
  * @param text     Message text (supports Markdown)
+ * @return ESP_ERR_NO_MEM if the chat's queue is full
  */
 esp_err_t telegram_send_message(const char *chat_id, const char *text);
 
+/**
+ * Append a partial-reply fragment to the chat's streaming draft.
+ * The draft is sent on the first delta and edited at most once per
+ * MIMI_TG_EDIT_INTERVAL_MS; telegram_send_message() replaces it with the
+ * final text.
+ */
+esp_err_t telegram_send_delta(const char *chat_id, const char *text);
+
 /**
  * Save the Telegram bot token to NVS.
  */
@@ -0,0 +1,363 @@
+#include "html_text.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+enum { MODE_SNIFF = 0, MODE_HTML, MODE_PLAIN };
+
+enum {
+    ST_TEXT = 0,
+    ST_TAG_OPEN,        /* after '<' */
+    ST_TAG_NAME,
+    ST_TAG_ATTRS,       /* until the closing '>' */
+    ST_BANG,            /* after "<!" */
+    ST_COMMENT,
+    ST_DECL,            /* <!DOCTYPE ...>, <?xml ...?> */
+    ST_ENTITY,          /* after '&' */
+    ST_RAW,             /* script / style body, until its end tag */
+};
+
+/* Bodies are never page text; skipped until the matching end tag */
+static const char *const RAW_TAGS[] = { "script", "style", "textarea", NULL };
+static const char *const RAW_ENDS[] = { "</script", "</style", "</textarea", NULL };
+
+/* Page chrome and form controls, dropped with everything inside. <form>
+ * itself is not listed: its labels and prose are visible text. */
+static const char *const SKIP_TAGS[] = {
+    "nav", "footer", "aside", "svg", "noscript", "iframe", "template",
+    "select", "button", NULL,
+};
+
+/* Paragraph-level blocks get a blank line, these a single line break */
+static const char *const PARA_TAGS[] = {
+    "p", "div", "section", "article", "main", "header", "table", "ul", "ol",
+    "blockquote", "pre", "h1", "h2", "h3", "h4", "h5", "h6", "title", "hr",
+    "figure", "dl", NULL,
+};
+static const char *const LINE_TAGS[] = { "br", "li", "tr", "dt", "dd", "figcaption", NULL };
+
+static const struct {
+    const char *name;
+    uint32_t cp;
+} ENTITIES[] = {
+    { "amp", '&' }, { "lt", '<' }, { "gt", '>' }, { "quot", '"' }, { "apos", '\'' },
+    { "nbsp", ' ' }, { "ndash", 0x2013 }, { "mdash", 0x2014 }, { "hellip", 0x2026 },
+    { "lsquo", 0x2018 }, { "rsquo", 0x2019 }, { "ldquo", 0x201C }, { "rdquo", 0x201D },
+    { "laquo", 0x00AB }, { "raquo", 0x00BB }, { "middot", 0x00B7 }, { "bull", 0x2022 },
+    { "copy", 0x00A9 }, { "reg", 0x00AE }, { "trade", 0x2122 }, { "deg", 0x00B0 },
+    { "times", 0x00D7 }, { "euro", 0x20AC }, { "yen", 0x00A5 }, { "pound", 0x00A3 },
+};
+
+static bool in_list(const char *const *list, const char *name)
+{
+    for (int i = 0; list[i]; i++) {
+        if (strcmp(list[i], name) == 0) return true;
+    }
+    return false;
+}
+
+/* ── Output ───────────────────────────────────────────────────── */
+
+/* Drop a UTF-8 sequence cut in half by the budget */
+static void trim_partial_utf8(html_text_t *h)
+{
+    size_t i = h->len;
+    int cont = 0;
+    while (i > 0 && ((unsigned char)h->out[i - 1] & 0xC0) == 0x80 && cont < 3) {
+        i--;
+        cont++;
+    }
+    if (i == 0) return;
+    unsigned char lead = (unsigned char)h->out[i - 1];
+    int need = (lead >= 0xF0) ? 3 : (lead >= 0xE0) ? 2 : (lead >= 0xC0) ? 1 : 0;
+    if (need > cont) {
+        h->len = i - 1;
+        h->out[h->len] = '\0';
+    }
+}
+
+static void emit(html_text_t *h, char c)
+{
+    if (h->full) return;
+    if (h->len + 1 >= h->cap) {
+        h->full = true;
+        trim_partial_utf8(h);
+        return;
+    }
+    h->out[h->len++] = c;
+    h->out[h->len] = '\0';
+}
+
+/* Visible character: settle pending whitespace first */
+static void put_char(html_text_t *h, char c)
+{
+    if (h->skip_depth) return;
+
+    if (h->pending_nl && h->len) {
+        int have = 0;
+        while (have < 2 && have < (int)h->len && h->out[h->len - 1 - have] == '\n') have++;
+        /* A space right before the break is noise */
+        if (!have && h->out[h->len - 1] == ' ') h->len--;
+        for (int i = have; i < h->pending_nl; i++) emit(h, '\n');
+    } else if (h->pending_space && h->len) {
+        char last = h->out[h->len - 1];
+        if (last != ' ' && last != '\n') emit(h, ' ');
+    }
+    h->pending_nl = 0;
+    h->pending_space = false;
+    emit(h, c);
+}
+
+static void text_char(html_text_t *h, char c)
+{
+    unsigned char u = (unsigned char)c;
+    if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f') {
+        h->pending_space = true;
+    } else if (u >= 0x20) {
+        put_char(h, c);
+    }
+}
+
+static void put_codepoint(html_text_t *h, uint32_t cp)
+{
+    if (cp == ' ' || cp == 0xA0) {
+        text_char(h, ' ');
+    } else if (cp < 0x20 || cp > 0x10FFFF) {
+        return;
+    } else if (cp < 0x80) {
+        put_char(h, (char)cp);
+    } else if (cp < 0x800) {
+        put_char(h, (char)(0xC0 | (cp >> 6)));
+        put_char(h, (char)(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        put_char(h, (char)(0xE0 | (cp >> 12)));
+        put_char(h, (char)(0x80 | ((cp >> 6) & 0x3F)));
+        put_char(h, (char)(0x80 | (cp & 0x3F)));
+    } else {
+        put_char(h, (char)(0xF0 | (cp >> 18)));
+        put_char(h, (char)(0x80 | ((cp >> 12) & 0x3F)));
+        put_char(h, (char)(0x80 | ((cp >> 6) & 0x3F)));
+        put_char(h, (char)(0x80 | (cp & 0x3F)));
+    }
+}
+
+/* ── Tokenizer ────────────────────────────────────────────────── */
+
+static void entity_end(html_text_t *h)
+{
+    h->entity[h->ent_len] = '\0';
+    const char *e = h->entity;
+
+    if (e[0] == '#') {
+        char *end = NULL;
+        unsigned long cp = (e[1] == 'x' || e[1] == 'X') ? strtoul(e + 2, &end, 16)
+                                                        : strtoul(e + 1, &end, 10);
+        if (end && *end == '\0' && end != e + 1) {
+            put_codepoint(h, (uint32_t)cp);
+            return;
+        }
+    } else {
+        for (size_t i = 0; i < sizeof(ENTITIES) / sizeof(ENTITIES[0]); i++) {
+            if (strcmp(ENTITIES[i].name, e) == 0) {
+                put_codepoint(h, ENTITIES[i].cp);
+                return;
+            }
+        }
+    }
+
+    /* Unknown: keep it as written */
+    put_char(h, '&');
+    for (const char *p = e; *p; p++) put_char(h, *p);
+    put_char(h, ';');
+}
+
+static void tag_end(html_text_t *h, bool self_closing)
+{
+    h->tag[h->tag_len] = '\0';
+    h->state = ST_TEXT;
+    const char *t = h->tag;
+
+    for (int i = 0; !h->closing && RAW_TAGS[i]; i++) {
+        if (strcmp(RAW_TAGS[i], t) == 0) {
+            h->raw_end = RAW_ENDS[i];
+            h->raw_match = 0;
+            h->state = ST_RAW;
+            return;
+        }
+    }
+    if (in_list(SKIP_TAGS, t)) {
+        if (self_closing) return;
+        if (h->closing) {
+            if (h->skip_depth) h->skip_depth--;
+        } else if (h->skip_depth < UINT8_MAX) {
+            h->skip_depth++;
+        }
+        h->pending_space = true;
+        return;
+    }
+
+    if (in_list(PARA_TAGS, t)) {
+        h->pending_nl = 2;
+    } else if (in_list(LINE_TAGS, t)) {
+        if (h->pending_nl < 1) h->pending_nl = 1;
+        if (!h->closing && strcmp(t, "li") == 0) {
+            put_char(h, '-');
+            h->pending_space = true;
+        }
+    } else if (strcmp(t, "td") == 0 || strcmp(t, "th") == 0) {
+        h->pending_space = true;
+    }
+}
+
+static void html_byte(html_text_t *h, char c)
+{
+    unsigned char u = (unsigned char)c;
+
+    switch (h->state) {
+    case ST_TEXT:
+        if (c == '<') {
+            h->state = ST_TAG_OPEN;
+            h->tag_len = 0;
+            h->closing = false;
+        } else if (c == '&') {
+            h->state = ST_ENTITY;
+            h->ent_len = 0;
+        } else {
+            text_char(h, c);
+        }
+        break;
+
+    case ST_TAG_OPEN:
+        if (c == '/' && !h->closing) {
+            h->closing = true;
+        } else if (c == '!' && !h->closing) {
+            h->state = ST_BANG;
+            h->dashes = 0;
+        } else if (c == '?') {
+            h->state = ST_DECL;
+        } else if (isalpha(u)) {
+            h->tag[0] = (char)tolower(u);
+            h->tag_len = 1;
+            h->state = ST_TAG_NAME;
+        } else {
+            /* A bare '<' in text, e.g. "a < b" */
+            h->state = ST_TEXT;
+            put_char(h, '<');
+            if (h->closing) put_char(h, '/');
+            html_byte(h, c);
+        }
+        break;
+
+    case ST_TAG_NAME:
+        if (isalnum(u)) {
+            if (h->tag_len < sizeof(h->tag) - 1) h->tag[h->tag_len++] = (char)tolower(u);
+        } else if (c == '>') {
+            tag_end(h, false);
+        } else {
+            h->quote = 0;
+            h->dashes = (c == '/');     /* reused: last significant char was '/' */
+            h->state = ST_TAG_ATTRS;
+        }
+        break;
+
+    case ST_TAG_ATTRS:
+        if (h->quote) {
+            if (c == h->quote) h->quote = 0;
+        } else if (c == '"' || c == '\'') {
+            h->quote = c;
+            h->dashes = 0;
+        } else if (c == '>') {
+            tag_end(h, h->dashes);
+        } else if (!isspace(u)) {
+            h->dashes = (c == '/');
+        }
+        break;
+
+    case ST_BANG:
+        if (c == '-' && ++h->dashes == 2) {
+            h->state = ST_COMMENT;
+            h->dashes = 0;
+        } else if (c == '>') {
+            h->state = ST_TEXT;
+        } else if (c != '-') {
+            h->state = ST_DECL;
+        }
+        break;
+
+    case ST_COMMENT:
+        if (c == '>' && h->dashes >= 2) {
+            h->state = ST_TEXT;
+        } else {
+            h->dashes = (c == '-') ? h->dashes + 1 : 0;
+        }
+        break;
+
+    case ST_DECL:
+        if (c == '>') h->state = ST_TEXT;
+        break;
+
+    case ST_ENTITY:
+        if ((isalnum(u) || c == '#') && h->ent_len < sizeof(h->entity) - 1) {
+            h->entity[h->ent_len++] = c;
+        } else if (c == ';' && h->ent_len) {
+            h->state = ST_TEXT;
+            entity_end(h);
+        } else {
+            /* Not an entity after all: replay what was swallowed */
+            h->state = ST_TEXT;
+            put_char(h, '&');
+            for (int i = 0; i < h->ent_len; i++) put_char(h, h->entity[i]);
+            html_byte(h, c);
+        }
+        break;
+
+    case ST_RAW:
+        if ((char)tolower(u) == h->raw_end[h->raw_match]) {
+            if (h->raw_end[++h->raw_match] == '\0') {
+                /* Consume the rest of the end tag */
+                h->tag_len = (uint8_t)(h->raw_match - 2);
+                memcpy(h->tag, h->raw_end + 2, h->tag_len);
+                h->closing = true;
+                h->quote = 0;
+                h->dashes = 0;
+                h->state = ST_TAG_ATTRS;
+            }
+        } else {
+            h->raw_match = (c == '<') ? 1 : 0;
+        }
+        break;
+    }
+}
+
+/* ── Public API ───────────────────────────────────────────────── */
+
+void html_text_init(html_text_t *h, char *out, size_t cap)
+{
+    memset(h, 0, sizeof(*h));
+    h->out = out;
+    h->cap = cap;
+    if (cap) out[0] = '\0';
+    if (cap <= 1) h->full = true;
+}
+
+bool html_text_feed(html_text_t *h, const char *data, size_t len)
+{
+    for (size_t i = 0; i < len && !h->full; i++) {
+        char c = data[i];
+        unsigned char u = (unsigned char)c;
+
+        if (h->mode == MODE_SNIFF) {
+            /* Skip leading blanks and a UTF-8 BOM, then decide */
+            if (isspace(u) || u == 0xEF || u == 0xBB || u == 0xBF) continue;
+            h->mode = (c == '<') ? MODE_HTML : MODE_PLAIN;
+        }
+
+        if (h->mode == MODE_PLAIN) {
+            if (c == '\n' || c == '\t' || u >= 0x20) emit(h, c);
+        } else {
+            html_byte(h, c);
+        }
+    }
+    return !h->full;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Streaming HTML → readable text extractor for web_fetch.
+ *
+ * Bytes are fed as they arrive from the socket, in any split. Markup is
+ * removed, <script>/<style> bodies, page chrome (nav, footer, aside, ...)
+ * and form controls are dropped, entities are decoded and whitespace is
+ * collapsed, with block elements turned into line breaks. Text is written
+ * straight into the caller's buffer; once it is full, feed() returns false
+ * so the transfer can be aborted early.
+ *
+ * A body whose first non-blank byte is not '<' is treated as plain text
+ * and only stripped of control characters.
+ */
+
+typedef struct {
+    char *out;
+    size_t cap;
+    size_t len;
+    bool full;                  /* output budget reached */
+
+    uint8_t mode;               /* undecided / html / plain */
+    uint8_t state;
+    char tag[12];               /* lower-cased tag name being read */
+    uint8_t tag_len;
+    bool closing;
+    char quote;                 /* inside a quoted attribute value */
+    uint8_t dashes;             /* comment terminator tracking */
+    char entity[12];
+    uint8_t ent_len;
+    const char *raw_end;        /* end tag sought while skipping raw text */
+    uint8_t raw_match;
+    uint8_t skip_depth;         /* nesting inside dropped containers */
+    bool pending_space;
+    uint8_t pending_nl;         /* 1 = line break, 2 = paragraph break */
+} html_text_t;
+
+/** Start extracting into out (cap bytes, always NUL-terminated). */
+void html_text_init(html_text_t *h, char *out, size_t cap);
+
+/** Feed body bytes. Returns false once the output is full. */
+bool html_text_feed(html_text_t *h, const char *data, size_t len);
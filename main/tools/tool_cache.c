@@ -0,0 +1,439 @@
+#include "tool_cache.h"
+#include "mimi_config.h"
+#include "audio/audio_service.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+
+static const char *TAG = "tool_cache";
+
+#define CLOCK_VALID_EPOCH   1700000000  /* earlier means SNTP / HTTP time never ran */
+#define SD_HEADER_MAX       128
+
+typedef struct {
+    uint64_t key;
+    time_t expires;
+    uint32_t last_used;
+    char etag[TOOL_CACHE_ETAG_LEN];
+    char *text;                 /* PSRAM, NUL-terminated; NULL = free slot */
+    size_t len;
+} ram_entry_t;
+
+typedef struct {
+    uint64_t key;
+    time_t expires;
+    uint32_t last_used;
+    uint32_t size;              /* file bytes, header included */
+} sd_entry_t;
+
+enum { SD_UNTRIED = 0, SD_READY, SD_UNAVAILABLE };
+
+static SemaphoreHandle_t s_lock = NULL;
+static uint32_t s_tick = 0;     /* LRU clock */
+static tool_cache_stats_t s_stats;
+
+static ram_entry_t s_ram[MIMI_TOOL_CACHE_RAM_ENTRIES];
+static size_t s_ram_bytes = 0;
+
+static int s_sd_state = SD_UNTRIED;
+static sd_entry_t *s_sd = NULL; /* PSRAM index of files on the card */
+static int s_sd_count = 0;
+static size_t s_sd_bytes = 0;
+
+/* ── Keys ─────────────────────────────────────────────────────── */
+
+#define FNV_OFFSET  0xcbf29ce484222325ULL
+#define FNV_PRIME   0x100000001b3ULL
+
+static uint64_t fnv_byte(uint64_t h, unsigned char c)
+{
+    return (h ^ c) * FNV_PRIME;
+}
+
+static uint64_t fnv_str(uint64_t h, const char *s)
+{
+    while (*s) h = fnv_byte(h, (unsigned char)*s++);
+    return fnv_byte(h, 0);
+}
+
+uint64_t tool_cache_key_query(const char *ns, const char *query)
+{
+    uint64_t h = fnv_str(FNV_OFFSET, ns);
+    bool space = false, any = false;
+    for (const char *p = query; *p; p++) {
+        unsigned char c = (unsigned char)*p;
+        if (isspace(c)) {
+            space = any;
+            continue;
+        }
+        if (space) h = fnv_byte(h, ' ');
+        h = fnv_byte(h, (unsigned char)tolower(c));
+        space = false;
+        any = true;
+    }
+    return h;
+}
+
+uint64_t tool_cache_key_url(const char *url)
+{
+    uint64_t h = fnv_str(FNV_OFFSET, "url");
+    const char *p = url;
+    while (isspace((unsigned char)*p)) p++;
+
+    /* scheme://host[:port] is case-insensitive, the rest is not */
+    const char *sep = strstr(p, "://");
+    const char *host_end = NULL;
+    if (sep) {
+        host_end = sep + 3;
+        while (*host_end && *host_end != '/' && *host_end != '?' && *host_end != '#') host_end++;
+    }
+
+    for (; *p && *p != '#'; p++) {
+        unsigned char c = (unsigned char)*p;
+        if (isspace(c)) break;
+        h = fnv_byte(h, (host_end && p < host_end) ? (unsigned char)tolower(c) : c);
+    }
+    return h;
+}
+
+/* ── PSRAM tier ───────────────────────────────────────────────── */
+
+static ram_entry_t *ram_find(uint64_t key)
+{
+    for (int i = 0; i < MIMI_TOOL_CACHE_RAM_ENTRIES; i++) {
+        if (s_ram[i].text && s_ram[i].key == key) return &s_ram[i];
+    }
+    return NULL;
+}
+
+static void ram_drop(ram_entry_t *e)
+{
+    s_ram_bytes -= e->len + 1;
+    free(e->text);
+    memset(e, 0, sizeof(*e));
+}
+
+static ram_entry_t *ram_victim(void)
+{
+    ram_entry_t *lru = NULL;
+    for (int i = 0; i < MIMI_TOOL_CACHE_RAM_ENTRIES; i++) {
+        if (!s_ram[i].text) return &s_ram[i];
+        if (!lru || s_ram[i].last_used < lru->last_used) lru = &s_ram[i];
+    }
+    return lru;
+}
+
+static void ram_store(uint64_t key, const char *text, size_t len, time_t expires, const char *etag)
+{
+    ram_entry_t *e = ram_find(key);
+    if (e) ram_drop(e);
+    if (len + 1 > MIMI_TOOL_CACHE_RAM_BYTES / 4) return;
+
+    while (s_ram_bytes + len + 1 > MIMI_TOOL_CACHE_RAM_BYTES) {
+        ram_entry_t *v = ram_victim();
+        if (!v || !v->text) break;
+        ram_drop(v);
+        s_stats.evictions++;
+    }
+
+    e = ram_victim();
+    if (e->text) {
+        ram_drop(e);
+        s_stats.evictions++;
+    }
+
+    e->text = heap_caps_malloc(len + 1, MALLOC_CAP_SPIRAM);
+    if (!e->text) return;
+    memcpy(e->text, text, len);
+    e->text[len] = '\0';
+    e->len = len;
+    e->key = key;
+    e->expires = expires;
+    e->last_used = ++s_tick;
+    strncpy(e->etag, etag ? etag : "", sizeof(e->etag) - 1);
+    s_ram_bytes += len + 1;
+}
+
+/* ── SD tier ──────────────────────────────────────────────────── */
+
+/* 8.3 name from the low half of the key; the full key is in the header */
+static void sd_path(uint64_t key, char *path, size_t size)
+{
+    snprintf(path, size, MIMI_TOOL_CACHE_SD_DIR "/%08lX.C", (unsigned long)(uint32_t)key);
+}
+
+/* Header line: "<key hex> <expires> <etag or ->" */
+static bool sd_read_header(FILE *f, uint64_t *key, time_t *expires, char *etag, size_t etag_size)
+{
+    char line[SD_HEADER_MAX];
+    if (!fgets(line, sizeof(line), f)) return false;
+    line[strcspn(line, "\n")] = '\0';
+
+    unsigned long long k = 0;
+    long long exp = 0;
+    int pos = 0;
+    if (sscanf(line, "%llx %lld %n", &k, &exp, &pos) < 2 || pos == 0) return false;
+    *key = k;
+    *expires = (time_t)exp;
+    if (etag && etag_size) {
+        const char *tag = line + pos;
+        snprintf(etag, etag_size, "%s", strcmp(tag, "-") == 0 ? "" : tag);
+    }
+    return true;
+}
+
+static int sd_find(uint64_t key)
+{
+    for (int i = 0; i < s_sd_count; i++) {
+        if (s_sd[i].key == key) return i;
+    }
+    return -1;
+}
+
+static void sd_drop(int idx)
+{
+    char path[64];
+    sd_path(s_sd[idx].key, path, sizeof(path));
+    unlink(path);
+    s_sd_bytes -= s_sd[idx].size;
+    s_sd[idx] = s_sd[--s_sd_count];
+}
+
+static void sd_scan(void)
+{
+    DIR *dir = opendir(MIMI_TOOL_CACHE_SD_DIR);
+    if (!dir) return;
+
+    time_t now = time(NULL);
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+        char path[300];
+        snprintf(path, sizeof(path), MIMI_TOOL_CACHE_SD_DIR "/%s", ent->d_name);
+
+        struct stat st;
+        if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) continue;
+
+        uint64_t key = 0;
+        time_t expires = 0;
+        char etag[TOOL_CACHE_ETAG_LEN];
+        bool ok = false;
+        FILE *f = fopen(path, "r");
+        if (f) {
+            ok = sd_read_header(f, &key, &expires, etag, sizeof(etag));
+            fclose(f);
+        }
+
+        /* Corrupt, dead (expired with nothing to revalidate) or over capacity */
+        if (!ok || (expires <= now && !etag[0]) || s_sd_count >= MIMI_TOOL_CACHE_SD_ENTRIES ||
+            s_sd_bytes + st.st_size > MIMI_TOOL_CACHE_SD_BYTES) {
+            unlink(path);
+            continue;
+        }
+        s_sd[s_sd_count++] = (sd_entry_t){
+            .key = key, .expires = expires, .last_used = 0, .size = (uint32_t)st.st_size,
+        };
+        s_sd_bytes += st.st_size;
+    }
+    closedir(dir);
+}
+
+/* Bring the SD tier up on first use; needs a real clock for absolute expiry */
+static bool sd_ready(void)
+{
+    if (s_sd_state != SD_UNTRIED) return s_sd_state == SD_READY;
+    if (time(NULL) < CLOCK_VALID_EPOCH) return false;
+
+    s_sd_state = SD_UNAVAILABLE;
+    if (audio_service_mount_sd() != ESP_OK) {
+        ESP_LOGW(TAG, "No SD card, cache is PSRAM only");
+        return false;
+    }
+    s_sd = heap_caps_calloc(MIMI_TOOL_CACHE_SD_ENTRIES, sizeof(sd_entry_t), MALLOC_CAP_SPIRAM);
+    if (!s_sd) return false;
+
+    mkdir(MIMI_TOOL_CACHE_SD_DIR, 0775);
+    sd_scan();
+    s_sd_state = SD_READY;
+    ESP_LOGI(TAG, "SD tier: %d entries, %d KB", s_sd_count, (int)(s_sd_bytes / 1024));
+    return true;
+}
+
+static size_t sd_load(int idx, char *out, size_t out_size, char *etag, size_t etag_size)
+{
+    char path[64];
+    sd_path(s_sd[idx].key, path, sizeof(path));
+    FILE *f = fopen(path, "r");
+    if (!f) return 0;
+
+    uint64_t key = 0;
+    time_t expires = 0;
+    size_t n = 0;
+    if (sd_read_header(f, &key, &expires, etag, etag_size) && key == s_sd[idx].key) {
+        n = fread(out, 1, out_size - 1, f);
+        if (!feof(f) && fgetc(f) != EOF) n = 0;     /* does not fit the caller's buffer */
+    }
+    fclose(f);
+    out[n] = '\0';
+    return n;
+}
+
+static void sd_store(uint64_t key, const char *text, size_t len, time_t expires, const char *etag)
+{
+    if (!sd_ready()) return;
+
+    /* Same key, or another key sharing its file name */
+    for (int i = s_sd_count - 1; i >= 0; i--) {
+        if ((uint32_t)s_sd[i].key == (uint32_t)key) sd_drop(i);
+    }
+
+    size_t size = len + SD_HEADER_MAX;
+    if (size > MIMI_TOOL_CACHE_SD_BYTES / 16) return;
+    while (s_sd_count > 0 && (s_sd_count >= MIMI_TOOL_CACHE_SD_ENTRIES ||
+                              s_sd_bytes + size > MIMI_TOOL_CACHE_SD_BYTES)) {
+        int lru = 0;
+        for (int i = 1; i < s_sd_count; i++) {
+            if (s_sd[i].last_used < s_sd[lru].last_used) lru = i;
+        }
+        sd_drop(lru);
+        s_stats.evictions++;
+    }
+
+    char path[64];
+    sd_path(key, path, sizeof(path));
+    FILE *f = fopen(path, "w");
+    if (!f) return;
+    int hlen = fprintf(f, "%016llx %lld %s\n", (unsigned long long)key, (long long)expires,
+                       (etag && etag[0]) ? etag : "-");
+    bool ok = hlen > 0 && fwrite(text, 1, len, f) == len;
+    ok = (fclose(f) == 0) && ok;
+    if (!ok) {
+        unlink(path);
+        return;
+    }
+
+    s_sd[s_sd_count++] = (sd_entry_t){
+        .key = key, .expires = expires, .last_used = ++s_tick, .size = (uint32_t)(hlen + len),
+    };
+    s_sd_bytes += hlen + len;
+}
+
+/* ── Public API ───────────────────────────────────────────────── */
+
+esp_err_t tool_cache_init(void)
+{
+    if (s_lock) return ESP_OK;
+    s_lock = xSemaphoreCreateMutex();
+    if (!s_lock) return ESP_ERR_NO_MEM;
+    ESP_LOGI(TAG, "Tool cache: %d x PSRAM (%d KB), SD %d KB",
+             MIMI_TOOL_CACHE_RAM_ENTRIES, MIMI_TOOL_CACHE_RAM_BYTES / 1024,
+             MIMI_TOOL_CACHE_SD_BYTES / 1024);
+    return ESP_OK;
+}
+
+tool_cache_result_t tool_cache_get(uint64_t key, char *out, size_t out_size,
+                                   char *etag, size_t etag_size)
+{
+    if (!s_lock || !out || out_size == 0) return TOOL_CACHE_MISS;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    time_t now = time(NULL);
+    tool_cache_result_t res = TOOL_CACHE_MISS;
+    time_t expires = 0;
+    bool from_sd = false;
+    char tag[TOOL_CACHE_ETAG_LEN] = "";
+
+    ram_entry_t *e = ram_find(key);
+    if (e && e->len < out_size) {
+        memcpy(out, e->text, e->len + 1);
+        strncpy(tag, e->etag, sizeof(tag) - 1);
+        expires = e->expires;
+        e->last_used = ++s_tick;
+        res = TOOL_CACHE_HIT;
+    } else if (!e && sd_ready()) {
+        int idx = sd_find(key);
+        size_t n = (idx >= 0) ? sd_load(idx, out, out_size, tag, sizeof(tag)) : 0;
+        if (n > 0) {
+            expires = s_sd[idx].expires;
+            s_sd[idx].last_used = ++s_tick;
+            ram_store(key, out, n, expires, tag);   /* promote */
+            from_sd = true;
+            res = TOOL_CACHE_HIT;
+        }
+    }
+
+    if (res == TOOL_CACHE_HIT && expires <= now) {
+        res = (tag[0] && etag) ? TOOL_CACHE_STALE : TOOL_CACHE_MISS;
+    }
+
+    switch (res) {
+    case TOOL_CACHE_HIT:
+        if (from_sd) s_stats.sd_hits++;
+        else s_stats.ram_hits++;
+        break;
+    case TOOL_CACHE_STALE:
+        snprintf(etag, etag_size, "%s", tag);
+        s_stats.stale++;
+        break;
+    default:
+        s_stats.misses++;
+        break;
+    }
+    xSemaphoreGive(s_lock);
+    return res;
+}
+
+void tool_cache_put(uint64_t key, const char *text, uint32_t ttl_s, const char *etag)
+{
+    if (!s_lock || !text) return;
+    if (ttl_s == 0 && !(etag && etag[0])) return;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    time_t expires = time(NULL) + ttl_s;
+    size_t len = strlen(text);
+    ram_store(key, text, len, expires, etag);
+    sd_store(key, text, len, expires, etag);
+    s_stats.stores++;
+    xSemaphoreGive(s_lock);
+}
+
+void tool_cache_refresh(uint64_t key, uint32_t ttl_s)
+{
+    if (!s_lock) return;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    ram_entry_t *e = ram_find(key);
+    if (e) {
+        e->expires = time(NULL) + ttl_s;
+        e->last_used = ++s_tick;
+        /* Rewrite the SD copy so the new expiry survives a reboot */
+        sd_store(key, e->text, e->len, e->expires, e->etag);
+        s_stats.revalidated++;
+    }
+    xSemaphoreGive(s_lock);
+}
+
+void tool_cache_get_stats(tool_cache_stats_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (!s_lock) return;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *out = s_stats;
+    for (int i = 0; i < MIMI_TOOL_CACHE_RAM_ENTRIES; i++) {
+        if (s_ram[i].text) out->ram_entries++;
+    }
+    out->ram_bytes = s_ram_bytes;
+    out->sd_entries = (s_sd_state == SD_READY) ? s_sd_count : -1;
+    out->sd_bytes = s_sd_bytes;
+    xSemaphoreGive(s_lock);
+}
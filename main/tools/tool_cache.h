@@ -0,0 +1,69 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * TTL'd response cache for web_search and web_fetch.
+ *
+ * Entries are the final tool output text, keyed by a 64-bit hash of the
+ * normalized query or URL. A small hot tier lives in PSRAM; every entry is
+ * also written to the SD card (when present and the clock is set) so results
+ * survive a reboot. Both tiers are capped in bytes and evict least recently
+ * used first. Expired entries that carry an ETag are returned as STALE so the
+ * caller can revalidate with If-None-Match instead of refetching.
+ */
+
+#define TOOL_CACHE_ETAG_LEN  64
+
+typedef enum {
+    TOOL_CACHE_MISS = 0,
+    TOOL_CACHE_HIT,             /* fresh: serve as is */
+    TOOL_CACHE_STALE,           /* expired but revalidatable: text and etag filled */
+} tool_cache_result_t;
+
+typedef struct {
+    uint32_t ram_hits;
+    uint32_t sd_hits;
+    uint32_t misses;
+    uint32_t stale;             /* expired entries handed out for revalidation */
+    uint32_t revalidated;       /* of those, confirmed unchanged (304) */
+    uint32_t stores;
+    uint32_t evictions;
+    int ram_entries;
+    size_t ram_bytes;
+    int sd_entries;             /* -1 while the SD tier is unavailable */
+    size_t sd_bytes;
+} tool_cache_stats_t;
+
+/**
+ * Initialize the cache. The SD tier is brought up lazily on first use.
+ */
+esp_err_t tool_cache_init(void);
+
+/** Key for a free-text query: case-folded, whitespace collapsed. */
+uint64_t tool_cache_key_query(const char *ns, const char *query);
+
+/** Key for a URL: scheme and host case-folded, fragment dropped. */
+uint64_t tool_cache_key_url(const char *url);
+
+/**
+ * Look up an entry and copy its text into out. On STALE, etag receives the
+ * validator to send as If-None-Match (etag may be NULL for callers that
+ * cannot revalidate; STALE is then reported as MISS).
+ */
+tool_cache_result_t tool_cache_get(uint64_t key, char *out, size_t out_size,
+                                   char *etag, size_t etag_size);
+
+/**
+ * Store text for ttl_s seconds. etag may be NULL. A ttl of 0 keeps the entry
+ * only as a revalidation candidate and is dropped without an etag.
+ */
+void tool_cache_put(uint64_t key, const char *text, uint32_t ttl_s, const char *etag);
+
+/** Extend an entry after the origin answered 304 Not Modified. */
+void tool_cache_refresh(uint64_t key, uint32_t ttl_s);
+
+void tool_cache_get_stats(tool_cache_stats_t *out);
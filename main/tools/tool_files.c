@@ -1,5 +1,6 @@
 #include "tools/tool_files.h"
 #include "mimi_config.h"
+#include "memory/memory_store.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -19,7 +20,7 @@ static const char *TAG = "tool_files";
 static bool validate_path(const char *path)
 {
     if (!path) return false;
-    if (strncmp(path, "/spiffs/", 8) != 0) return false;
+    if (strncmp(path, MIMI_SPIFFS_BASE "/", sizeof(MIMI_SPIFFS_BASE)) != 0) return false;
     if (strstr(path, "..") != NULL) return false;
     return true;
 }
@@ -94,6 +95,7 @@ esp_err_t tool_write_file_execute(const char *input_json, char *output, size_t o
     size_t len = strlen(content);
     size_t written = fwrite(content, 1, len, f);
     fclose(f);
+    memory_notify_write(path);
 
     if (written != len) {
         snprintf(output, output_size, "Error: wrote %d of %d bytes to %s", (int)written, (int)len, path);
@@ -203,6 +205,7 @@ esp_err_t tool_edit_file_execute(const char *input_json, char *output, size_t ou
     fwrite(result, 1, total, f);
     fclose(f);
     free(result);
+    memory_notify_write(path);
 
     snprintf(output, output_size, "OK: edited %s (replaced %d bytes with %d bytes)", path, (int)old_len, (int)new_len);
     ESP_LOGI(TAG, "edit_file: %s", path);
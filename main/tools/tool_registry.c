@@ -1,11 +1,21 @@
 #include "tool_registry.h"
+#include "mimi_config.h"
 #include "tools/tool_web_search.h"
 #include "tools/tool_web_fetch.h"
+#include "tools/tool_cache.h"
 #include "tools/tool_get_time.h"
 #include "tools/tool_files.h"
 
 #include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "cJSON.h"
 
 static const char *TAG = "tools";
@@ -15,6 +25,8 @@ static const char *TAG = "tools";
 static mimi_tool_t s_tools[MAX_TOOLS];
 static int s_tool_count = 0;
 static char *s_tools_json = NULL;  /* cached JSON array string */
+static QueueHandle_t s_job_queue = NULL;
+static SemaphoreHandle_t s_serial_lock = NULL;  /* serial tools across agent workers */
 
 static void register_tool(const mimi_tool_t *tool)
 {
@@ -50,9 +62,62 @@ static void build_tools_json(void)
     ESP_LOGI(TAG, "Tools JSON built (%d tools)", s_tool_count);
 }
 
+/* ── Worker pool ──────────────────────────────────────────────── */
+
+static const mimi_tool_t *find_tool(const char *name)
+{
+    for (int i = 0; i < s_tool_count; i++) {
+        if (strcmp(s_tools[i].name, name) == 0) return &s_tools[i];
+    }
+    return NULL;
+}
+
+static void run_job(tool_job_t *job)
+{
+    job->output[0] = '\0';
+    job->err = tool_registry_execute(job->name, job->input_json,
+                                     job->output, job->output_size);
+}
+
+static void tool_worker_task(void *arg)
+{
+    tool_job_t *job;
+    while (1) {
+        if (xQueueReceive(s_job_queue, &job, portMAX_DELAY) != pdTRUE) continue;
+        run_job(job);
+        xSemaphoreGive((SemaphoreHandle_t)job->done);
+    }
+}
+
+/* Worker stacks are in PSRAM, which must not be in use while flash writes
+ * disable the cache, so only tools that stay off SPIFFS/NVS go there */
+static bool worker_safe(const mimi_tool_t *tool)
+{
+    return tool && !(tool->flags & (MIMI_TOOL_F_SERIAL | MIMI_TOOL_F_FLASH));
+}
+
+static void start_workers(void)
+{
+    if (!s_serial_lock) s_serial_lock = xSemaphoreCreateMutex();
+    if (s_job_queue) return;
+    s_job_queue = xQueueCreate(MIMI_MAX_TOOL_CALLS * 2, sizeof(tool_job_t *));
+    if (!s_job_queue) {
+        ESP_LOGE(TAG, "Tool job queue alloc failed, tools will run sequentially");
+        return;
+    }
+    for (int i = 0; i < MIMI_TOOL_WORKERS; i++) {
+        if (xTaskCreatePinnedToCoreWithCaps(tool_worker_task, "tool_wk", MIMI_TOOL_WORKER_STACK,
+                                            NULL, MIMI_TOOL_WORKER_PRIO, NULL,
+                                            MIMI_TOOL_WORKER_CORE, MALLOC_CAP_SPIRAM) != pdPASS) {
+            ESP_LOGW(TAG, "Tool worker %d not started", i);
+        }
+    }
+}
+
 esp_err_t tool_registry_init(void)
 {
     s_tool_count = 0;
+    tool_cache_init();
 
     /* Register web_search */
     tool_web_search_init();
@@ -101,6 +166,7 @@ esp_err_t tool_registry_init(void)
             "\"properties\":{\"path\":{\"type\":\"string\",\"description\":\"Absolute path starting with /spiffs/\"}},"
             "\"required\":[\"path\"]}",
         .execute = tool_read_file_execute,
+        .flags = MIMI_TOOL_F_FLASH,
     };
     register_tool(&rf);
 
@@ -114,6 +180,7 @@ esp_err_t tool_registry_init(void)
             "\"content\":{\"type\":\"string\",\"description\":\"File content to write\"}},"
             "\"required\":[\"path\",\"content\"]}",
         .execute = tool_write_file_execute,
+        .flags = MIMI_TOOL_F_SERIAL | MIMI_TOOL_F_FLASH,
     };
     register_tool(&wf);
 
@@ -128,6 +195,7 @@ esp_err_t tool_registry_init(void)
             "\"new_string\":{\"type\":\"string\",\"description\":\"Replacement text\"}},"
             "\"required\":[\"path\",\"old_string\",\"new_string\"]}",
         .execute = tool_edit_file_execute,
+        .flags = MIMI_TOOL_F_SERIAL | MIMI_TOOL_F_FLASH,
     };
     register_tool(&ef);
 
@@ -140,10 +208,12 @@ esp_err_t tool_registry_init(void)
             "\"properties\":{\"prefix\":{\"type\":\"string\",\"description\":\"Optional path prefix filter, e.g. /spiffs/memory/\"}},"
             "\"required\":[]}",
         .execute = tool_list_dir_execute,
+        .flags = MIMI_TOOL_F_FLASH,
     };
     register_tool(&ld);
 
     build_tools_json();
+    start_workers();
 
     ESP_LOGI(TAG, "Tool registry initialized");
     return ESP_OK;
@@ -168,3 +238,58 @@ esp_err_t tool_registry_execute(const char *name, const char *input_json,
     snprintf(output, output_size, "Error: unknown tool '%s'", name);
     return ESP_ERR_NOT_FOUND;
 }
+
+esp_err_t tool_registry_execute_batch(tool_job_t *jobs, int count)
+{
+    int n_offload = 0;
+    for (int i = 0; i < count; i++) {
+        jobs[i].done = NULL;
+        if (worker_safe(find_tool(jobs[i].name))) n_offload++;
+    }
+
+    /* Hand worker-safe jobs to the workers; the caller runs the rest, and
+     * keeps one worker-safe job if it has nothing else to do (done == NULL
+     * means inline). */
+    int64_t start_us = esp_timer_get_time();
+    SemaphoreHandle_t done = NULL;
+    int queued = 0;
+    int to_queue = (n_offload == count) ? n_offload - 1 : n_offload;
+    if (to_queue > 0 && s_job_queue) {
+        done = xSemaphoreCreateCounting(to_queue, 0);
+    }
+    if (done) {
+        int left = to_queue;
+        for (int i = 0; i < count && left > 0; i++) {
+            if (!worker_safe(find_tool(jobs[i].name))) continue;
+            left--;
+            tool_job_t *job = &jobs[i];
+            job->done = done;
+            if (xQueueSend(s_job_queue, &job, 0) == pdTRUE) {
+                queued++;
+            } else {
+                job->done = NULL;
+            }
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (jobs[i].done) continue;
+        const mimi_tool_t *tool = find_tool(jobs[i].name);
+        bool serial = tool && (tool->flags & MIMI_TOOL_F_SERIAL) && s_serial_lock;
+        if (serial) xSemaphoreTake(s_serial_lock, portMAX_DELAY);
+        run_job(&jobs[i]);
+        if (serial) xSemaphoreGive(s_serial_lock);
+    }
+
+    for (int i = 0; i < queued; i++) {
+        xSemaphoreTake(done, portMAX_DELAY);
+    }
+    if (done) vSemaphoreDelete(done);
+    for (int i = 0; i < count; i++) jobs[i].done = NULL;
+
+    if (count > 1) {
+        ESP_LOGI(TAG, "Ran %d tools (%d on workers) in %d ms", count, queued,
+                 (int)((esp_timer_get_time() - start_us) / 1000));
+    }
+    return ESP_OK;
+}
@@ -2,14 +2,30 @@
 
 #include "esp_err.h"
 #include <stddef.h>
+#include <stdint.h>
+
+/* Tool flags */
+#define MIMI_TOOL_F_SERIAL  (1u << 0)   /* mutates shared state: never run concurrently */
+#define MIMI_TOOL_F_FLASH   (1u << 1)   /* touches SPIFFS: kept off the PSRAM-stack workers */
 
 typedef struct {
     const char *name;
     const char *description;
     const char *input_schema_json;  /* JSON Schema string for input */
     esp_err_t (*execute)(const char *input_json, char *output, size_t output_size);
+    uint32_t flags;                 /* MIMI_TOOL_F_* */
 } mimi_tool_t;
 
+/* One call in a batch; output is owned by the caller */
+typedef struct {
+    const char *name;
+    const char *input_json;
+    char *output;
+    size_t output_size;
+    esp_err_t err;                  /* set on completion */
+    void *done;                     /* internal: batch completion semaphore */
+} tool_job_t;
+
 /**
  * Initialize tool registry and register all built-in tools.
  */
@@ -32,3 +48,12 @@ const char *tool_registry_get_tools_json(void);
  */
 esp_err_t tool_registry_execute(const char *name, const char *input_json,
                                 char *output, size_t output_size);
+
+/**
+ * Execute a batch of tool calls, running independent ones concurrently on
+ * the tool worker pool. MIMI_TOOL_F_SERIAL and MIMI_TOOL_F_FLASH tools run
+ * on the calling task in batch order; serial ones one at a time across all
+ * callers. Returns once every job has finished; each job's output and err
+ * are filled in place, so results keep the original order.
+ */
+esp_err_t tool_registry_execute_batch(tool_job_t *jobs, int count);
@@ -1,28 +1,37 @@
 #include "tool_web_fetch.h"
+#include "mimi_config.h"
+#include "tools/html_text.h"
+#include "tools/tool_cache.h"
 #include "proxy/http_proxy.h"
 
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <ctype.h>
 #include "esp_log.h"
 #include "esp_http_client.h"
 #include "esp_crt_bundle.h"
-#include "esp_heap_caps.h"
 #include "cJSON.h"
 
 static const char *TAG = "web_fetch";
 
-#define FETCH_BUF_SIZE       (16 * 1024)
 #define FETCH_TIMEOUT_MS     15000
 #define FETCH_MAX_URL_LEN    1024
+#define FETCH_CHUNK_SIZE     2048
+#define FETCH_MAX_REDIRECTS  5
+
+#define TRUNC_NOTE           "\n\n[truncated]"
 
 typedef struct {
-    char *data;
-    size_t len;
-    size_t cap;
-    bool overflow;
-} fetch_buf_t;
+    html_text_t text;
+    size_t body_len;            /* raw body bytes consumed */
+    const char *if_none_match;  /* validator for a conditional GET, or NULL */
+    char etag[TOOL_CACHE_ETAG_LEN];
+    int max_age;                /* Cache-Control max-age, -1 if absent */
+    bool no_store;
+} fetch_sink_t;
 
 typedef struct {
     bool https;
@@ -31,18 +40,43 @@ typedef struct {
     char path[768];
 } parsed_url_t;
 
+/* Body bytes go straight into the extractor; false once the output is full */
+static bool sink_feed(fetch_sink_t *sink, const char *data, size_t len)
+{
+    sink->body_len += len;
+    return html_text_feed(&sink->text, data, len);
+}
+
+static void sink_reset_meta(fetch_sink_t *sink)
+{
+    sink->etag[0] = '\0';
+    sink->max_age = -1;
+    sink->no_store = false;
+}
+
+/* Pick up the cache validators from a response header */
+static void sink_header(fetch_sink_t *sink, const char *key, const char *value)
+{
+    if (!key || !value) return;
+    if (strcasecmp(key, "ETag") == 0) {
+        if (strlen(value) < sizeof(sink->etag)) strcpy(sink->etag, value);
+    } else if (strcasecmp(key, "Cache-Control") == 0) {
+        char lc[128];
+        size_t i = 0;
+        for (; value[i] && i < sizeof(lc) - 1; i++) lc[i] = (char)tolower((unsigned char)value[i]);
+        lc[i] = '\0';
+
+        if (strstr(lc, "no-store")) sink->no_store = true;
+        const char *ma = strstr(lc, "max-age=");
+        if (ma) sink->max_age = atoi(ma + 8);
+        if (strstr(lc, "no-cache")) sink->max_age = 0;
+    }
+}
+
 static esp_err_t http_event_handler(esp_http_client_event_t *evt)
 {
-    fetch_buf_t *fb = (fetch_buf_t *)evt->user_data;
-    if (evt->event_id == HTTP_EVENT_ON_DATA) {
-        size_t needed = fb->len + evt->data_len;
-        if (needed < fb->cap) {
-            memcpy(fb->data + fb->len, evt->data, evt->data_len);
-            fb->len += evt->data_len;
-            fb->data[fb->len] = '\0';
-        } else {
-            fb->overflow = true;
-        }
+    if (evt->event_id == HTTP_EVENT_ON_HEADER) {
+        sink_header((fetch_sink_t *)evt->user_data, evt->header_key, evt->header_value);
     }
     return ESP_OK;
 }
@@ -137,12 +171,25 @@ static bool parse_url(const char *url, parsed_url_t *out)
     return true;
 }
 
-static esp_err_t fetch_direct(const char *url, fetch_buf_t *fb, int *status_out)
+/* Honour max-age, within bounds; no-cache leaves only the validator */
+static uint32_t fetch_ttl(const fetch_sink_t *sink)
+{
+    if (sink->max_age < 0) return MIMI_TOOL_CACHE_FETCH_TTL_S;
+    if (sink->max_age > MIMI_TOOL_CACHE_FETCH_TTL_MAX_S) return MIMI_TOOL_CACHE_FETCH_TTL_MAX_S;
+    return (uint32_t)sink->max_age;
+}
+
+static bool is_redirect(int status)
+{
+    return status == 301 || status == 302 || status == 303 || status == 307 || status == 308;
+}
+
+static esp_err_t fetch_direct(const char *url, fetch_sink_t *sink, int *status_out)
 {
     esp_http_client_config_t config = {
         .url = url,
         .event_handler = http_event_handler,
-        .user_data = fb,
+        .user_data = sink,
         .timeout_ms = FETCH_TIMEOUT_MS,
         .buffer_size = 4096,
         .crt_bundle_attach = esp_crt_bundle_attach,
@@ -154,18 +201,56 @@ static esp_err_t fetch_direct(const char *url, fetch_buf_t *fb, int *status_out)
     esp_http_client_set_header(client, "Accept", "text/html, text/plain;q=0.9,*/*;q=0.1");
     esp_http_client_set_header(client, "Accept-Encoding", "identity");
     esp_http_client_set_header(client, "User-Agent", "MimiClaw/1.0");
+    if (sink->if_none_match) {
+        esp_http_client_set_header(client, "If-None-Match", sink->if_none_match);
+    }
+
+    esp_err_t err = ESP_OK;
+    int status = 0;
+    for (int hop = 0; ; hop++) {
+        sink_reset_meta(sink);
+        err = esp_http_client_open(client, 0);
+        if (err != ESP_OK) break;
+        if (esp_http_client_fetch_headers(client) < 0) {
+            err = ESP_FAIL;
+            break;
+        }
+        status = esp_http_client_get_status_code(client);
+        if (!is_redirect(status) || hop >= FETCH_MAX_REDIRECTS) break;
 
-    esp_err_t err = esp_http_client_perform(client);
-    int status = esp_http_client_get_status_code(client);
+        esp_http_client_flush_response(client, NULL);
+        err = esp_http_client_set_redirection(client);
+        esp_http_client_close(client);
+        if (err != ESP_OK) break;
+    }
+
+    if (err == ESP_OK && status >= 200 && status < 300) {
+        char tmp[FETCH_CHUNK_SIZE];
+        while (1) {
+            int n = esp_http_client_read(client, tmp, sizeof(tmp));
+            if (n < 0) {
+                err = ESP_FAIL;
+                break;
+            }
+            if (n == 0) break;
+            if (!sink_feed(sink, tmp, (size_t)n)) {
+                ESP_LOGI(TAG, "Output budget reached, dropping rest of body");
+                break;
+            }
+        }
+    }
+
+    esp_http_client_close(client);
     esp_http_client_cleanup(client);
 
     if (status_out) *status_out = status;
     if (err != ESP_OK) return err;
+    if (status == 304 && sink->if_none_match) return ESP_OK;
     if (status < 200 || status >= 300) return ESP_FAIL;
     return ESP_OK;
 }
 
-static esp_err_t fetch_via_proxy(const parsed_url_t *url, fetch_buf_t *fb, int *status_out)
+static esp_err_t fetch_via_proxy(const parsed_url_t *url, fetch_sink_t *sink, int *status_out)
 {
     proxy_conn_t *conn = proxy_conn_open(url->host, url->port, FETCH_TIMEOUT_MS);
     if (!conn) return ESP_ERR_HTTP_CONNECT;
@@ -177,8 +262,12 @@ static esp_err_t fetch_via_proxy(const parsed_url_t *url, fetch_buf_t *fb, int *
         "Accept: text/html, text/plain;q=0.9,*/*;q=0.1\r\n"
         "Accept-Encoding: identity\r\n"
         "User-Agent: MimiClaw/1.0\r\n"
+        "%s%s%s"
         "Connection: close\r\n\r\n",
-        url->path, url->host);
+        url->path, url->host,
+        sink->if_none_match ? "If-None-Match: " : "",
+        sink->if_none_match ? sink->if_none_match : "",
+        sink->if_none_match ? "\r\n" : "");
 
     if (hlen <= 0 || hlen >= (int)sizeof(header)) {
         proxy_conn_close(conn);
@@ -190,66 +279,62 @@ static esp_err_t fetch_via_proxy(const parsed_url_t *url, fetch_buf_t *fb, int *
         return ESP_ERR_HTTP_WRITE_DATA;
     }
 
-    char tmp[2048];
-    size_t total = 0;
+    /* Parse the response head line by line, whatever the read split */
+    char line[256];
+    size_t line_len = 0;
+    int lines = 0;
+    bool in_body = false;
+    int status = 0;
+    sink_reset_meta(sink);
+
+    char tmp[FETCH_CHUNK_SIZE];
     while (1) {
         int n = proxy_conn_read(conn, tmp, sizeof(tmp), FETCH_TIMEOUT_MS);
         if (n <= 0) break;
 
-        size_t copy = (total + (size_t)n < fb->cap - 1) ? (size_t)n : (fb->cap - 1 - total);
-        if (copy > 0) {
-            memcpy(fb->data + total, tmp, copy);
-            total += copy;
+        int i = 0;
+        if (!in_body) {
+            for (; i < n && !in_body; i++) {
+                char c = tmp[i];
+                if (c != '\n') {
+                    if (c != '\r' && line_len < sizeof(line) - 1) line[line_len++] = c;
+                    continue;
+                }
+                line[line_len] = '\0';
+                if (line_len == 0) {
+                    in_body = true;
+                } else if (lines++ == 0) {
+                    const char *sp = strchr(line, ' ');
+                    if (strncmp(line, "HTTP/", 5) == 0 && sp) status = atoi(sp + 1);
+                } else {
+                    char *colon = strchr(line, ':');
+                    if (colon) {
+                        *colon = '\0';
+                        const char *value = colon + 1;
+                        while (*value == ' ' || *value == '\t') value++;
+                        sink_header(sink, line, value);
+                    }
+                }
+                line_len = 0;
+            }
+            if (!in_body) continue;
+            if (status < 200 || status >= 300) break;
         }
-        if (copy < (size_t)n) {
-            fb->overflow = true;
+
+        if (i < n && !sink_feed(sink, tmp + i, (size_t)(n - i))) {
+            ESP_LOGI(TAG, "Output budget reached, dropping rest of body");
+            break;
         }
     }
-    fb->data[total] = '\0';
-    fb->len = total;
     proxy_conn_close(conn);
 
-    int status = 0;
-    if (total > 5 && strncmp(fb->data, "HTTP/", 5) == 0) {
-        const char *sp = strchr(fb->data, ' ');
-        if (sp) status = atoi(sp + 1);
-    }
     if (status_out) *status_out = status;
-
-    char *body = strstr(fb->data, "\r\n\r\n");
-    if (!body) return ESP_FAIL;
-
-    body += 4;
-    size_t body_len = total - (size_t)(body - fb->data);
-    memmove(fb->data, body, body_len);
-    fb->len = body_len;
-    fb->data[fb->len] = '\0';
-
+    if (!in_body) return ESP_FAIL;
+    if (status == 304 && sink->if_none_match) return ESP_OK;
     if (status < 200 || status >= 300) return ESP_FAIL;
     return ESP_OK;
 }
 
-static size_t copy_text_sanitized(char *dst, size_t dst_size, const char *src, size_t src_len)
-{
-    if (!dst || dst_size == 0 || !src) return 0;
-
-    size_t pos = 0;
-    for (size_t i = 0; i < src_len && pos < dst_size - 1; i++) {
-        unsigned char c = (unsigned char)src[i];
-
-        if (c == '\r') {
-            continue;
-        }
-
-        if (c == '\n' || c == '\t' || c >= 0x20) {
-            dst[pos++] = (char)c;
-        }
-    }
-
-    dst[pos] = '\0';
-    return pos;
-}
-
 esp_err_t tool_web_fetch_execute(const char *input_json, char *output, size_t output_size)
 {
     if (!output || output_size == 0) return ESP_ERR_INVALID_ARG;
@@ -285,29 +370,49 @@ esp_err_t tool_web_fetch_execute(const char *input_json, char *output, size_t ou
         return ESP_ERR_INVALID_ARG;
     }
 
-    fetch_buf_t fb = {0};
-    fb.data = heap_caps_calloc(1, FETCH_BUF_SIZE, MALLOC_CAP_SPIRAM);
-    if (!fb.data) {
-        fb.data = calloc(1, FETCH_BUF_SIZE);
+    uint64_t cache_key = tool_cache_key_url(url);
+    char etag[TOOL_CACHE_ETAG_LEN] = "";
+    tool_cache_result_t cached = tool_cache_get(cache_key, output, output_size, etag, sizeof(etag));
+    if (cached == TOOL_CACHE_HIT) {
+        ESP_LOGI(TAG, "Served from cache: %s", url);
+        return ESP_OK;
     }
-    if (!fb.data) {
-        snprintf(output, output_size, "Error: out of memory");
-        return ESP_ERR_NO_MEM;
+
+    size_t off = snprintf(output, output_size, "Source: %s\n\n", url);
+    if (off + sizeof(TRUNC_NOTE) + 1 >= output_size) {
+        snprintf(output, output_size, "Error: output buffer too small");
+        return ESP_ERR_INVALID_SIZE;
     }
-    fb.cap = FETCH_BUF_SIZE;
 
-    ESP_LOGI(TAG, "Fetching URL: %s", url);
+    ESP_LOGI(TAG, "Fetching URL: %s%s", url, cached == TOOL_CACHE_STALE ? " (revalidating)" : "");
 
+    fetch_sink_t sink;
     int status = 0;
     esp_err_t err;
-    if (http_proxy_is_enabled() && parsed.https) {
-        err = fetch_via_proxy(&parsed, &fb, &status);
-    } else {
-        err = fetch_direct(url, &fb, &status);
+    for (int attempt = 0; ; attempt++) {
+        /* Extract straight into the tool output, leaving room for the note */
+        memset(&sink, 0, sizeof(sink));
+        html_text_init(&sink.text, output + off, output_size - off - (sizeof(TRUNC_NOTE) - 1));
+        sink.if_none_match = (cached == TOOL_CACHE_STALE && attempt == 0) ? etag : NULL;
+
+        if (http_proxy_is_enabled() && parsed.https) {
+            err = fetch_via_proxy(&parsed, &sink, &status);
+        } else {
+            err = fetch_direct(url, &sink, &status);
+        }
+        if (err != ESP_OK || status != 304) break;
+
+        /* Not modified: extend and serve the cached copy */
+        tool_cache_refresh(cache_key, fetch_ttl(&sink));
+        if (tool_cache_get(cache_key, output, output_size, NULL, 0) == TOOL_CACHE_HIT) {
+            ESP_LOGI(TAG, "Not modified, served from cache: %s", url);
+            return ESP_OK;
+        }
+        /* Evicted meanwhile: fetch again unconditionally */
+        snprintf(output, output_size, "Source: %s\n\n", url);
     }
 
     if (err != ESP_OK) {
-        free(fb.data);
         if (status > 0) {
             snprintf(output, output_size, "Error: failed to fetch URL (HTTP %d)", status);
         } else {
@@ -316,34 +421,24 @@ esp_err_t tool_web_fetch_execute(const char *input_json, char *output, size_t ou
         return err;
     }
 
-    if (fb.len == 0) {
-        free(fb.data);
+    if (sink.body_len == 0) {
         snprintf(output, output_size, "Error: fetch succeeded but response body is empty");
         return ESP_FAIL;
     }
 
-    size_t off = snprintf(output, output_size, "Source: %s\n\n", url);
-    if (off >= output_size) {
-        off = output_size - 1;
-        output[off] = '\0';
-    }
-
-    size_t copied = copy_text_sanitized(output + off, output_size - off, fb.data, fb.len);
-    bool truncated = fb.overflow || (copied < fb.len && copied + off < output_size - 1);
-    free(fb.data);
-
-    if (copied == 0) {
+    if (sink.text.len == 0) {
         snprintf(output, output_size, "Error: fetched content is not readable text");
         return ESP_FAIL;
     }
 
-    if (truncated) {
-        size_t cur = strlen(output);
-        if (cur + 15 < output_size) {
-            strcat(output, "\n\n[truncated]");
-        }
+    if (sink.text.full) {
+        strcat(output, TRUNC_NOTE);
+    }
+    if (!sink.no_store) {
+        tool_cache_put(cache_key, output, fetch_ttl(&sink), sink.etag);
     }
 
-    ESP_LOGI(TAG, "Fetch complete: %d bytes", (int)strlen(output));
+    ESP_LOGI(TAG, "Fetch complete: %d bytes of text from %d bytes of body",
+             (int)strlen(output), (int)sink.body_len);
     return ESP_OK;
 }
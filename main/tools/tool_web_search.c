@@ -1,14 +1,12 @@
 #include "tool_web_search.h"
 #include "mimi_config.h"
-#include "proxy/http_proxy.h"
+#include "tools/tool_cache.h"
+#include "proxy/conn_pool.h"
 
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include "esp_log.h"
-#include "esp_http_client.h"
-#include "esp_crt_bundle.h"
-#include "esp_heap_caps.h"
 #include "nvs.h"
 #include "cJSON.h"
 
@@ -24,28 +22,6 @@ typedef enum {
     SEARCH_PROVIDER_TAVILY = 1,
 } search_provider_t;
 
-/* ── Response accumulator ─────────────────────────────────────── */
-
-typedef struct {
-    char *data;
-    size_t len;
-    size_t cap;
-} search_buf_t;
-
-static esp_err_t http_event_handler(esp_http_client_event_t *evt)
-{
-    search_buf_t *sb = (search_buf_t *)evt->user_data;
-    if (evt->event_id == HTTP_EVENT_ON_DATA) {
-        size_t needed = sb->len + evt->data_len;
-        if (needed < sb->cap) {
-            memcpy(sb->data + sb->len, evt->data, evt->data_len);
-            sb->len += evt->data_len;
-            sb->data[sb->len] = '\0';
-        }
-    }
-    return ESP_OK;
-}
-
 static bool is_tavily_key(const char *key)
 {
     return key && strncmp(key, "tvly-", 5) == 0;
@@ -111,7 +87,7 @@ static size_t url_encode(const char *src, char *dst, size_t dst_size)
 
 /* ── Format results as readable text ──────────────────────────── */
 
-static void format_results(cJSON *root, char *output, size_t output_size)
+static bool format_results(cJSON *root, char *output, size_t output_size)
 {
     cJSON *web = cJSON_GetObjectItem(root, "web");
     cJSON *results = NULL;
@@ -124,7 +100,7 @@ static void format_results(cJSON *root, char *output, size_t output_size)
     }
     if (!results || !cJSON_IsArray(results) || cJSON_GetArraySize(results) == 0) {
         snprintf(output, output_size, "No web results found.");
-        return;
+        return false;
     }
 
     size_t off = 0;
@@ -147,183 +123,48 @@ static void format_results(cJSON *root, char *output, size_t output_size)
         if (off >= output_size - 1) break;
         idx++;
     }
+    return true;
 }
 
-/* ── Direct HTTPS request ─────────────────────────────────────── */
-
-static esp_err_t brave_search_direct(const char *url, search_buf_t *sb, int *status_out)
-{
-    esp_http_client_config_t config = {
-        .url = url,
-        .event_handler = http_event_handler,
-        .user_data = sb,
-        .timeout_ms = 15000,
-        .buffer_size = 4096,
-        .crt_bundle_attach = esp_crt_bundle_attach,
-    };
-
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    if (!client) return ESP_FAIL;
-
-    esp_http_client_set_header(client, "Accept", "application/json");
-    esp_http_client_set_header(client, "X-Subscription-Token", s_search_key);
-
-    esp_err_t err = esp_http_client_perform(client);
-    int status = esp_http_client_get_status_code(client);
-    esp_http_client_cleanup(client);
-    if (status_out) *status_out = status;
-
-    if (err != ESP_OK) return err;
-    return ESP_OK;
-}
-
-/* ── Proxy HTTPS request ──────────────────────────────────────── */
+/* ── HTTPS requests (pooled connections) ────────────────────── */
 
-static esp_err_t brave_search_via_proxy(const char *path, search_buf_t *sb, int *status_out)
+static esp_err_t brave_search(const char *path, char **body_out, int *status_out)
 {
-    proxy_conn_t *conn = proxy_conn_open("api.search.brave.com", 443, 15000);
-    if (!conn) return ESP_ERR_HTTP_CONNECT;
-
-    char header[512];
-    int hlen = snprintf(header, sizeof(header),
-        "GET %s HTTP/1.1\r\n"
-        "Host: api.search.brave.com\r\n"
+    char headers[224];
+    snprintf(headers, sizeof(headers),
         "Accept: application/json\r\n"
-        "X-Subscription-Token: %s\r\n"
-        "Connection: close\r\n\r\n",
-        path, s_search_key);
-
-    if (proxy_conn_write(conn, header, hlen) < 0) {
-        proxy_conn_close(conn);
-        return ESP_ERR_HTTP_WRITE_DATA;
-    }
-
-    /* Read full response */
-    char tmp[4096];
-    size_t total = 0;
-    while (1) {
-        int n = proxy_conn_read(conn, tmp, sizeof(tmp), 15000);
-        if (n <= 0) break;
-        size_t copy = (total + n < sb->cap - 1) ? (size_t)n : sb->cap - 1 - total;
-        if (copy > 0) {
-            memcpy(sb->data + total, tmp, copy);
-            total += copy;
-        }
-    }
-    sb->data[total] = '\0';
-    sb->len = total;
-    proxy_conn_close(conn);
-
-    /* Check status */
-    int status = 0;
-    if (total > 5 && strncmp(sb->data, "HTTP/", 5) == 0) {
-        const char *sp = strchr(sb->data, ' ');
-        if (sp) status = atoi(sp + 1);
-    }
-    if (status_out) *status_out = status;
-
-    /* Strip headers */
-    char *body = strstr(sb->data, "\r\n\r\n");
-    if (body) {
-        body += 4;
-        size_t blen = total - (body - sb->data);
-        memmove(sb->data, body, blen);
-        sb->len = blen;
-        sb->data[sb->len] = '\0';
-    }
-
-    return ESP_OK;
-}
-
-static esp_err_t tavily_search_direct(const char *body, search_buf_t *sb, int *status_out)
-{
-    esp_http_client_config_t config = {
-        .url = "https://api.tavily.com/search",
-        .event_handler = http_event_handler,
-        .user_data = sb,
+        "X-Subscription-Token: %s\r\n",
+        s_search_key);
+
+    conn_pool_req_t req = {
+        .method = "GET",
+        .host = "api.search.brave.com",
+        .path = path,
+        .headers = headers,
         .timeout_ms = 15000,
-        .buffer_size = 4096,
-        .crt_bundle_attach = esp_crt_bundle_attach,
     };
-
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    if (!client) return ESP_FAIL;
-
-    char auth[180];
-    snprintf(auth, sizeof(auth), "Bearer %s", s_search_key);
-
-    esp_http_client_set_method(client, HTTP_METHOD_POST);
-    esp_http_client_set_header(client, "Accept", "application/json");
-    esp_http_client_set_header(client, "Content-Type", "application/json");
-    esp_http_client_set_header(client, "Authorization", auth);
-    esp_http_client_set_post_field(client, body, (int)strlen(body));
-
-    esp_err_t err = esp_http_client_perform(client);
-    int status = esp_http_client_get_status_code(client);
-    esp_http_client_cleanup(client);
-    if (status_out) *status_out = status;
-
-    return err;
+    return conn_pool_http_collect(&req, SEARCH_BUF_SIZE, body_out, NULL, status_out);
 }
 
-static esp_err_t tavily_search_via_proxy(const char *body, search_buf_t *sb, int *status_out)
+static esp_err_t tavily_search(const char *body, char **body_out, int *status_out)
 {
-    proxy_conn_t *conn = proxy_conn_open("api.tavily.com", 443, 15000);
-    if (!conn) return ESP_ERR_HTTP_CONNECT;
-
-    char auth[180];
-    snprintf(auth, sizeof(auth), "Bearer %s", s_search_key);
-
-    char header[768];
-    int body_len = (int)strlen(body);
-    int hlen = snprintf(header, sizeof(header),
-        "POST /search HTTP/1.1\r\n"
-        "Host: api.tavily.com\r\n"
+    char headers[256];
+    snprintf(headers, sizeof(headers),
         "Accept: application/json\r\n"
         "Content-Type: application/json\r\n"
-        "Authorization: %s\r\n"
-        "Content-Length: %d\r\n"
-        "Connection: close\r\n\r\n",
-        auth, body_len);
-
-    if (proxy_conn_write(conn, header, hlen) < 0 ||
-        proxy_conn_write(conn, body, body_len) < 0) {
-        proxy_conn_close(conn);
-        return ESP_ERR_HTTP_WRITE_DATA;
-    }
-
-    char tmp[4096];
-    size_t total = 0;
-    while (1) {
-        int n = proxy_conn_read(conn, tmp, sizeof(tmp), 15000);
-        if (n <= 0) break;
-        size_t copy = (total + n < sb->cap - 1) ? (size_t)n : sb->cap - 1 - total;
-        if (copy > 0) {
-            memcpy(sb->data + total, tmp, copy);
-            total += copy;
-        }
-    }
-    sb->data[total] = '\0';
-    sb->len = total;
-    proxy_conn_close(conn);
-
-    int status = 0;
-    if (total > 5 && strncmp(sb->data, "HTTP/", 5) == 0) {
-        const char *sp = strchr(sb->data, ' ');
-        if (sp) status = atoi(sp + 1);
-    }
-    if (status_out) *status_out = status;
-
-    char *resp_body = strstr(sb->data, "\r\n\r\n");
-    if (resp_body) {
-        resp_body += 4;
-        size_t blen = total - (resp_body - sb->data);
-        memmove(sb->data, resp_body, blen);
-        sb->len = blen;
-        sb->data[sb->len] = '\0';
-    }
-
-    return ESP_OK;
+        "Authorization: Bearer %s\r\n",
+        s_search_key);
+
+    conn_pool_req_t req = {
+        .method = "POST",
+        .host = "api.tavily.com",
+        .path = "/search",
+        .headers = headers,
+        .body = body,
+        .body_len = strlen(body),
+        .timeout_ms = 15000,
+    };
+    return conn_pool_http_collect(&req, SEARCH_BUF_SIZE, body_out, NULL, status_out);
 }
 
 /* ── Execute ──────────────────────────────────────────────────── */
@@ -352,10 +193,17 @@ esp_err_t tool_web_search_execute(const char *input_json, char *output, size_t o
     ESP_LOGI(TAG, "Searching: %s", query->valuestring);
 
     search_provider_t provider = get_search_provider();
+    uint64_t cache_key = tool_cache_key_query(
+        provider == SEARCH_PROVIDER_TAVILY ? "tavily" : "brave", query->valuestring);
+    if (tool_cache_get(cache_key, output, output_size, NULL, 0) == TOOL_CACHE_HIT) {
+        cJSON_Delete(input);
+        ESP_LOGI(TAG, "Search served from cache, %d bytes", (int)strlen(output));
+        return ESP_OK;
+    }
+
     cJSON *tavily_req = NULL;
     char *tavily_body = NULL;
     char path[384] = {0};
-    char url[512] = {0};
 
     if (provider == SEARCH_PROVIDER_TAVILY) {
         tavily_req = cJSON_CreateObject();
@@ -379,39 +227,21 @@ esp_err_t tool_web_search_execute(const char *input_json, char *output, size_t o
         url_encode(query->valuestring, encoded_query, sizeof(encoded_query));
         snprintf(path, sizeof(path),
                  "/res/v1/web/search?q=%s&count=%d", encoded_query, SEARCH_RESULT_COUNT);
-        snprintf(url, sizeof(url), "https://api.search.brave.com%s", path);
     }
     cJSON_Delete(input);
 
-    /* Allocate response buffer from PSRAM */
-    search_buf_t sb = {0};
-    sb.data = heap_caps_calloc(1, SEARCH_BUF_SIZE, MALLOC_CAP_SPIRAM);
-    if (!sb.data) {
-        snprintf(output, output_size, "Error: Out of memory");
-        return ESP_ERR_NO_MEM;
-    }
-    sb.cap = SEARCH_BUF_SIZE;
-
     /* Make HTTP request */
+    char *resp = NULL;
     esp_err_t err = ESP_FAIL;
     int status = 0;
     if (provider == SEARCH_PROVIDER_TAVILY) {
-        if (http_proxy_is_enabled()) {
-            err = tavily_search_via_proxy(tavily_body, &sb, &status);
-        } else {
-            err = tavily_search_direct(tavily_body, &sb, &status);
-        }
+        err = tavily_search(tavily_body, &resp, &status);
     } else {
-        if (http_proxy_is_enabled()) {
-            err = brave_search_via_proxy(path, &sb, &status);
-        } else {
-            err = brave_search_direct(url, &sb, &status);
-        }
+        err = brave_search(path, &resp, &status);
     }
     free(tavily_body);
 
     if (err != ESP_OK) {
-        free(sb.data);
         snprintf(output, output_size, "Error: Search request failed");
         return err;
     }
@@ -419,22 +249,24 @@ esp_err_t tool_web_search_execute(const char *input_json, char *output, size_t o
         ESP_LOGE(TAG, "Search API returned %d (provider=%s) body=%.240s",
                  status,
                  provider == SEARCH_PROVIDER_TAVILY ? "tavily" : "brave",
-                 sb.data ? sb.data : "");
+                 resp);
         snprintf(output, output_size, "Error: Search API returned HTTP %d", status);
-        free(sb.data);
+        free(resp);
         return ESP_FAIL;
     }
 
     /* Parse and format results */
-    cJSON *root = cJSON_Parse(sb.data);
-    free(sb.data);
+    cJSON *root = cJSON_Parse(resp);
+    free(resp);
 
     if (!root) {
         snprintf(output, output_size, "Error: Failed to parse search results");
         return ESP_FAIL;
     }
 
-    format_results(root, output, output_size);
+    if (format_results(root, output, output_size)) {
+        tool_cache_put(cache_key, output, MIMI_TOOL_CACHE_SEARCH_TTL_S, NULL);
+    }
     cJSON_Delete(root);
 
     ESP_LOGI(TAG, "Search complete, %d bytes result", (int)strlen(output));
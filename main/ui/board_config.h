@@ -18,3 +18,19 @@
 
 #define MIMI_LCD_HOR_RES  320
 #define MIMI_LCD_VER_RES  240
+
+/* Lines per LVGL draw buffer. Two are allocated in DMA-capable RAM, so one
+ * band renders while the previous one is transferred; 2 x 10 lines take the
+ * same 12.8 KB as a single 20-line buffer. Keep it >= MIMI_LCD_ROUND_Y. */
+#ifndef MIMI_LCD_BUF_LINES
+#define MIMI_LCD_BUF_LINES 10
+#endif
+
+/* Dirty areas are widened to this grid (powers of two) so LVGL can join
+ * neighbouring ones into a single flush */
+#ifndef MIMI_LCD_ROUND_X
+#define MIMI_LCD_ROUND_X   16
+#endif
+#ifndef MIMI_LCD_ROUND_Y
+#define MIMI_LCD_ROUND_Y   4
+#endif
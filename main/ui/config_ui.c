@@ -73,6 +73,16 @@ static lv_obj_t *s_audio_vol_label = NULL;
 
 static char s_audio_files[AUDIO_SERVICE_MAX_FILES][AUDIO_SERVICE_MAX_NAME_LEN];
 static size_t s_audio_file_count = 0;
+static bool s_audio_list_valid = false;     /* list widget mirrors s_audio_files */
+
+/* Last status shown on the home screen; refreshes only touch what moved */
+typedef struct {
+    bool valid;
+    bool wifi_connected;
+    char ip[16];
+} ui_home_state_t;
+
+static ui_home_state_t s_home_state;
 
 #define UI_MARGIN               6
 #define HOME_TOP_Y              4
@@ -106,18 +116,34 @@ static void open_audio(void);
 static void audio_list_item_cb(lv_obj_t *btn, lv_event_t event);
 static void audio_vol_slider_cb(lv_obj_t *obj, lv_event_t event);
 
+/* Setting a label or text area invalidates it and costs a flush even when
+ * the text is the same, so compare first */
+static void ui_label_update(lv_obj_t *label, const char *text)
+{
+    const char *cur = lv_label_get_text(label);
+    if (cur && strcmp(cur, text) == 0) return;
+    lv_label_set_text(label, text);
+}
+
+static void ui_textarea_update(lv_obj_t *ta, const char *text)
+{
+    const char *cur = lv_textarea_get_text(ta);
+    if (cur && strcmp(cur, text) == 0) return;
+    lv_textarea_set_text(ta, text);
+}
+
 static void audio_update_volume_label(int vol_percent)
 {
     if (!s_audio_vol_label) return;
     char buf[32];
     snprintf(buf, sizeof(buf), "Play Vol: %d%%", vol_percent);
-    lv_label_set_text(s_audio_vol_label, buf);
+    ui_label_update(s_audio_vol_label, buf);
 }
 
 static void ui_set_status(const char *msg)
 {
     if (s_current_status_label) {
-        lv_label_set_text(s_current_status_label, msg);
+        ui_label_update(s_current_status_label, msg);
     }
     ESP_LOGI(TAG, "%s", msg);
 }
@@ -233,19 +259,23 @@ static void show_screen(lv_obj_t *scr, lv_obj_t *status_label, lv_obj_t *form_pa
 
 static void update_home_status_labels(void)
 {
-    if (!s_home_ip_label || !s_home_machine_label) {
+    if (!s_home_ip_label) {
         return;
     }
 
-    char ip_line[48];
-    if (wifi_manager_is_connected()) {
-        snprintf(ip_line, sizeof(ip_line), "IP: %s", wifi_manager_get_ip());
-    } else {
-        snprintf(ip_line, sizeof(ip_line), "IP: 0.0.0.0");
+    ui_home_state_t now = { .valid = true, .wifi_connected = wifi_manager_is_connected() };
+    if (now.wifi_connected) {
+        strncpy(now.ip, wifi_manager_get_ip(), sizeof(now.ip) - 1);
+    }
+    if (s_home_state.valid && s_home_state.wifi_connected == now.wifi_connected &&
+        strcmp(s_home_state.ip, now.ip) == 0) {
+        return;
     }
-    lv_label_set_text(s_home_ip_label, ip_line);
+    s_home_state = now;
 
-    lv_label_set_text(s_home_machine_label, "Machine: RUNNING");
+    char ip_line[48];
+    snprintf(ip_line, sizeof(ip_line), "IP: %s", now.wifi_connected ? now.ip : "0.0.0.0");
+    ui_label_update(s_home_ip_label, ip_line);
 }
 
 static void load_values_to_widgets(void)
@@ -254,15 +284,15 @@ static void load_values_to_widgets(void)
 
     if (s_ta_wifi_ssid) {
         ui_load_nvs_str(MIMI_NVS_WIFI, MIMI_NVS_KEY_SSID, MIMI_SECRET_WIFI_SSID, tmp, sizeof(tmp));
-        lv_textarea_set_text(s_ta_wifi_ssid, tmp);
+        ui_textarea_update(s_ta_wifi_ssid, tmp);
     }
     if (s_ta_wifi_pass) {
         ui_load_nvs_str(MIMI_NVS_WIFI, MIMI_NVS_KEY_PASS, MIMI_SECRET_WIFI_PASS, tmp, sizeof(tmp));
-        lv_textarea_set_text(s_ta_wifi_pass, tmp);
+        ui_textarea_update(s_ta_wifi_pass, tmp);
     }
     if (s_ta_proxy_host) {
         ui_load_nvs_str(MIMI_NVS_PROXY, MIMI_NVS_KEY_PROXY_HOST, MIMI_SECRET_PROXY_HOST, tmp, sizeof(tmp));
-        lv_textarea_set_text(s_ta_proxy_host, tmp);
+        ui_textarea_update(s_ta_proxy_host, tmp);
     }
     if (s_ta_proxy_port) {
         uint16_t port = ui_load_nvs_u16(MIMI_NVS_PROXY, MIMI_NVS_KEY_PROXY_PORT,
@@ -272,11 +302,11 @@ static void load_values_to_widgets(void)
         } else {
             snprintf(tmp, sizeof(tmp), "%u", (unsigned)port);
         }
-        lv_textarea_set_text(s_ta_proxy_port, tmp);
+        ui_textarea_update(s_ta_proxy_port, tmp);
     }
     if (s_ta_api_key) {
         ui_load_nvs_str(MIMI_NVS_LLM, MIMI_NVS_KEY_API_KEY, MIMI_SECRET_API_KEY, tmp, sizeof(tmp));
-        lv_textarea_set_text(s_ta_api_key, tmp);
+        ui_textarea_update(s_ta_api_key, tmp);
     }
     if (s_ta_model) {
         ui_load_nvs_str(MIMI_NVS_LLM, MIMI_NVS_KEY_MODEL, MIMI_SECRET_MODEL, tmp, sizeof(tmp));
@@ -284,26 +314,26 @@ static void load_values_to_widgets(void)
             strncpy(tmp, MIMI_LLM_DEFAULT_MODEL, sizeof(tmp) - 1);
             tmp[sizeof(tmp) - 1] = '\0';
         }
-        lv_textarea_set_text(s_ta_model, tmp);
+        ui_textarea_update(s_ta_model, tmp);
     }
     if (s_ta_feishu_app_id) {
         ui_load_nvs_str(MIMI_NVS_FEISHU, MIMI_NVS_KEY_FEISHU_APP_ID,
                         MIMI_SECRET_FEISHU_APP_ID, tmp, sizeof(tmp));
-        lv_textarea_set_text(s_ta_feishu_app_id, tmp);
+        ui_textarea_update(s_ta_feishu_app_id, tmp);
     }
     if (s_ta_feishu_app_secret) {
         ui_load_nvs_str(MIMI_NVS_FEISHU, MIMI_NVS_KEY_FEISHU_APP_SECRET,
                         MIMI_SECRET_FEISHU_APP_SECRET, tmp, sizeof(tmp));
-        lv_textarea_set_text(s_ta_feishu_app_secret, tmp);
+        ui_textarea_update(s_ta_feishu_app_secret, tmp);
     }
     if (s_ta_feishu_chat_id) {
         ui_load_nvs_str(MIMI_NVS_FEISHU, MIMI_NVS_KEY_FEISHU_DEF_CHAT,
                         MIMI_SECRET_FEISHU_DEFAULT_CHAT_ID, tmp, sizeof(tmp));
-        lv_textarea_set_text(s_ta_feishu_chat_id, tmp);
+        ui_textarea_update(s_ta_feishu_chat_id, tmp);
     }
     if (s_ta_search_key) {
         ui_load_nvs_str(MIMI_NVS_SEARCH, MIMI_NVS_KEY_API_KEY, MIMI_SECRET_SEARCH_KEY, tmp, sizeof(tmp));
-        lv_textarea_set_text(s_ta_search_key, tmp);
+        ui_textarea_update(s_ta_search_key, tmp);
     }
 }
 
@@ -439,15 +469,30 @@ static void audio_refresh_file_list(void)
 {
     if (!s_audio_list) return;
 
-    s_audio_file_count = 0;
-    lv_list_clean(s_audio_list);
-
-    esp_err_t ret = audio_service_list_files(s_audio_files, AUDIO_SERVICE_MAX_FILES, &s_audio_file_count);
+    static char names[AUDIO_SERVICE_MAX_FILES][AUDIO_SERVICE_MAX_NAME_LEN];
+    size_t count = 0;
+    esp_err_t ret = audio_service_list_files(names, AUDIO_SERVICE_MAX_FILES, &count);
     if (ret != ESP_OK) {
+        if (s_audio_list_valid) {
+            lv_list_clean(s_audio_list);
+            s_audio_list_valid = false;
+        }
+        s_audio_file_count = 0;
         ui_set_status("SD not ready or no card");
         return;
     }
 
+    /* Rebuilding the list redraws the whole panel: skip it if nothing moved */
+    if (s_audio_list_valid && count == s_audio_file_count &&
+        memcmp(names, s_audio_files, count * AUDIO_SERVICE_MAX_NAME_LEN) == 0) {
+        ui_set_status("File list up to date");
+        return;
+    }
+    memcpy(s_audio_files, names, count * AUDIO_SERVICE_MAX_NAME_LEN);
+    s_audio_file_count = count;
+    s_audio_list_valid = true;
+    lv_list_clean(s_audio_list);
+
     if (s_audio_file_count == 0) {
         lv_list_add_btn(s_audio_list, NULL, "(No WAV files)");
         ui_set_status("Audio folder empty");
@@ -791,12 +836,14 @@ static void config_ui_task(void *arg)
     create_ui();
     open_home();
 
+    /* Status changes are applied just before the handler runs, so they
+     * land in the same refresh as any other pending redraw */
     uint32_t loop = 0;
     while (1) {
-        lv_task_handler();
-        if ((loop++ % 100) == 0) {
+        if ((loop++ % 100) == 0 && lv_scr_act() == s_scr_home) {
             update_home_status_labels();
         }
+        lv_task_handler();
         vTaskDelay(pdMS_TO_TICKS(10));
     }
 }
@@ -1,67 +1,123 @@
 #include "display_port.h"
 
 #include <stdbool.h>
+#include <string.h>
 #include "driver/gpio.h"
 #include "driver/spi_master.h"
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
 #include "esp_log.h"
 #include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "lvgl/lvgl.h"
 #include "ui/board_config.h"
 #include "ui/xpt2046.h"
 
 static const char *TAG = "display_port";
 
+/* spi_transaction_t.user flags, read by the SPI callbacks */
+#define LCD_TRANS_DATA       (1 << 0)   /* D/C high */
+#define LCD_TRANS_FLUSHED    (1 << 1)   /* last transfer of a flush */
+#define LCD_TRANS_FRAME_END  (1 << 2)   /* last flush of a frame */
+
+/* Queued per flush at most: CASET, data, RASET, data, RAMWR, pixels */
+#define LCD_FLUSH_TRANS      6
+
+#define LCD_WIN_UNSET        0xFFFF
+
 static spi_device_handle_t s_lcd_spi = NULL;
 static esp_timer_handle_t s_lvgl_tick_timer = NULL;
 
 static lv_disp_buf_t s_disp_buf;
-static lv_color_t s_disp_line_buf[MIMI_LCD_HOR_RES * 20];
+static lv_disp_drv_t *s_disp_drv = NULL;
+static lv_color_t *s_draw_buf[2];
+
+static spi_transaction_t s_flush_trans[LCD_FLUSH_TRANS];
+static int s_trans_pending = 0;
+static uint16_t s_win_col[2] = { LCD_WIN_UNSET, LCD_WIN_UNSET };   /* last CASET sent */
+static uint16_t s_win_row[2] = { LCD_WIN_UNSET, LCD_WIN_UNSET };   /* last RASET sent */
+static SemaphoreHandle_t s_flush_done = NULL;
+
+/* Frame timing, updated from the SPI post-transfer callback */
+static portMUX_TYPE s_stats_mux = portMUX_INITIALIZER_UNLOCKED;
+static display_stats_t s_stats;
+static uint64_t s_frame_total_us = 0;
+static int64_t s_frame_start_us = 0;    /* 0 while no frame is being drawn */
+static uint32_t s_frame_trans = 0;      /* accumulated for the frame in progress */
+static uint32_t s_frame_bytes = 0;
+static int64_t s_fps_window_us = 0;
+static uint32_t s_fps_frames = 0;
+static int64_t s_last_frame_end_us = 0;
 
 static bool s_inited = false;
 
+/* Drive D/C for each transfer, so command and pixel transfers can sit in
+ * the same queue */
+static IRAM_ATTR void lcd_spi_pre_cb(spi_transaction_t *t)
+{
+    gpio_set_level(MIMI_LCD_DC, ((uintptr_t)t->user & LCD_TRANS_DATA) ? 1 : 0);
+}
+
+static IRAM_ATTR void lcd_spi_post_cb(spi_transaction_t *t)
+{
+    uint32_t flags = (uintptr_t)t->user;
+    if (!(flags & LCD_TRANS_FLUSHED)) return;
+
+    if (flags & LCD_TRANS_FRAME_END) {
+        int64_t now = esp_timer_get_time();
+        portENTER_CRITICAL_ISR(&s_stats_mux);
+        if (s_frame_start_us) {
+            uint32_t us = (uint32_t)(now - s_frame_start_us);
+            s_stats.frames++;
+            s_stats.last_frame_us = us;
+            if (us > s_stats.max_frame_us) s_stats.max_frame_us = us;
+            s_frame_total_us += us;
+            s_frame_start_us = 0;
+        }
+        s_stats.last_frame_trans = s_frame_trans;
+        s_stats.last_frame_bytes = s_frame_bytes;
+        s_frame_trans = 0;
+        s_frame_bytes = 0;
+        s_fps_frames++;
+        if (now - s_fps_window_us >= 1000000) {
+            s_stats.fps = (uint32_t)((uint64_t)s_fps_frames * 1000000 / (now - s_fps_window_us));
+            s_fps_window_us = now;
+            s_fps_frames = 0;
+        }
+        s_last_frame_end_us = now;
+        portEXIT_CRITICAL_ISR(&s_stats_mux);
+    }
+
+    /* LVGL may render into this buffer again */
+    lv_disp_flush_ready(s_disp_drv);
+
+    BaseType_t woken = pdFALSE;
+    xSemaphoreGiveFromISR(s_flush_done, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
 static void lcd_cmd(uint8_t cmd)
 {
-    gpio_set_level(MIMI_LCD_DC, 0);
     spi_transaction_t t = {
         .length = 8,
         .tx_buffer = &cmd,
+        .user = (void *)0,
     };
     spi_device_transmit(s_lcd_spi, &t);
 }
 
 static void lcd_data(const uint8_t *data, uint16_t len)
 {
-    gpio_set_level(MIMI_LCD_DC, 1);
     spi_transaction_t t = {
         .length = len * 8,
         .tx_buffer = data,
+        .user = (void *)LCD_TRANS_DATA,
     };
     spi_device_transmit(s_lcd_spi, &t);
 }
 
-static void ili9341_set_window(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1)
-{
-    uint8_t data[4];
-
-    lcd_cmd(0x2A);
-    data[0] = (x0 >> 8);
-    data[1] = x0 & 0xFF;
-    data[2] = (x1 >> 8);
-    data[3] = x1 & 0xFF;
-    lcd_data(data, 4);
-
-    lcd_cmd(0x2B);
-    data[0] = (y0 >> 8);
-    data[1] = y0 & 0xFF;
-    data[2] = (y1 >> 8);
-    data[3] = y1 & 0xFF;
-    lcd_data(data, 4);
-
-    lcd_cmd(0x2C);
-}
-
 static esp_err_t lcd_init(void)
 {
     gpio_config_t io_cfg = {
@@ -76,7 +132,7 @@ static esp_err_t lcd_init(void)
         .sclk_io_num = MIMI_LCD_SCK,
         .quadwp_io_num = -1,
         .quadhd_io_num = -1,
-        .max_transfer_sz = MIMI_LCD_HOR_RES * MIMI_LCD_VER_RES * 2,
+        .max_transfer_sz = MIMI_LCD_HOR_RES * MIMI_LCD_BUF_LINES * sizeof(lv_color_t),
     };
 
     esp_err_t ret = spi_bus_initialize(MIMI_LCD_SPI_HOST, &bus_cfg, SPI_DMA_CH_AUTO);
@@ -88,7 +144,9 @@ static esp_err_t lcd_init(void)
         .clock_speed_hz = 40 * 1000 * 1000,
         .mode = 0,
         .spics_io_num = MIMI_LCD_CS,
-        .queue_size = 7,
+        .queue_size = LCD_FLUSH_TRANS,
+        .pre_cb = lcd_spi_pre_cb,
+        .post_cb = lcd_spi_post_cb,
     };
     ESP_ERROR_CHECK(spi_bus_add_device(MIMI_LCD_SPI_HOST, &dev_cfg, &s_lcd_spi));
 
@@ -117,21 +175,107 @@ static esp_err_t lcd_init(void)
     return ESP_OK;
 }
 
+/* Collect the finished transactions of the previous flush so their
+ * descriptors can be reused */
+static void lcd_flush_reclaim(void)
+{
+    while (s_trans_pending > 0) {
+        spi_transaction_t *done;
+        if (spi_device_get_trans_result(s_lcd_spi, &done, portMAX_DELAY) != ESP_OK) break;
+        s_trans_pending--;
+    }
+}
+
+static spi_transaction_t *lcd_batch_cmd(spi_transaction_t *t, uint8_t cmd)
+{
+    t->flags = SPI_TRANS_USE_TXDATA;
+    t->length = 8;
+    t->tx_data[0] = cmd;
+    return t + 1;
+}
+
+/* CASET/RASET, skipped when the panel already holds this range */
+static spi_transaction_t *lcd_batch_range(spi_transaction_t *t, uint8_t cmd,
+                                          uint16_t cache[2], uint16_t a, uint16_t b)
+{
+    if (cache[0] == a && cache[1] == b) return t;
+    cache[0] = a;
+    cache[1] = b;
+
+    t = lcd_batch_cmd(t, cmd);
+    t->flags = SPI_TRANS_USE_TXDATA;
+    t->length = 32;
+    t->tx_data[0] = a >> 8;
+    t->tx_data[1] = a & 0xFF;
+    t->tx_data[2] = b >> 8;
+    t->tx_data[3] = b & 0xFF;
+    t->user = (void *)LCD_TRANS_DATA;
+    return t + 1;
+}
+
+/* Queue the band and return at once: LVGL renders the next band into the
+ * other buffer while this one is clocked out by DMA. The window setup and
+ * the pixel burst go out as one back-to-back batch; the post-transfer
+ * callback of the burst signals flush-ready. */
 static void lvgl_flush(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map)
 {
     uint32_t w = area->x2 - area->x1 + 1;
     uint32_t h = area->y2 - area->y1 + 1;
+    uint32_t bytes = w * h * sizeof(lv_color_t);
+
+    lcd_flush_reclaim();
+
+    spi_transaction_t *t = s_flush_trans;
+    memset(s_flush_trans, 0, sizeof(s_flush_trans));
+    t = lcd_batch_range(t, 0x2A, s_win_col, area->x1, area->x2);
+    t = lcd_batch_range(t, 0x2B, s_win_row, area->y1, area->y2);
+    t = lcd_batch_cmd(t, 0x2C);
+    uint32_t last = lv_disp_flush_is_last(drv) ? LCD_TRANS_FRAME_END : 0;
+    t->length = bytes * 8;
+    t->tx_buffer = color_map;
+    t->user = (void *)(uintptr_t)(LCD_TRANS_DATA | LCD_TRANS_FLUSHED | last);
+    int n = (int)(t + 1 - s_flush_trans);
+
+    portENTER_CRITICAL(&s_stats_mux);
+    if (!s_frame_start_us) s_frame_start_us = esp_timer_get_time();
+    s_stats.flushes++;
+    s_stats.bytes += bytes;
+    s_stats.transactions += n;
+    s_stats.window_skips += LCD_FLUSH_TRANS - n;
+    s_frame_trans += n;
+    s_frame_bytes += bytes;
+    portEXIT_CRITICAL(&s_stats_mux);
+
+    for (int i = 0; i < n; i++) {
+        if (spi_device_queue_trans(s_lcd_spi, &s_flush_trans[i], portMAX_DELAY) != ESP_OK) {
+            ESP_LOGE(TAG, "LCD queue failed");
+            lcd_flush_reclaim();
+            s_win_col[0] = s_win_row[0] = LCD_WIN_UNSET;
+            lv_disp_flush_ready(drv);
+            return;
+        }
+        s_trans_pending++;
+    }
+}
 
-    ili9341_set_window(area->x1, area->y1, area->x2, area->y2);
-    gpio_set_level(MIMI_LCD_DC, 1);
-
-    spi_transaction_t t = {
-        .length = w * h * 16,
-        .tx_buffer = color_map,
-    };
-    spi_device_transmit(s_lcd_spi, &t);
+/* Widen dirty areas to a coarse grid. Neighbouring small areas then touch
+ * or overlap, and LVGL's invalidation join merges them into one flush. */
+static void lvgl_rounder(lv_disp_drv_t *drv, lv_area_t *area)
+{
+    (void)drv;
+    area->x1 &= ~(MIMI_LCD_ROUND_X - 1);
+    area->x2 |= (MIMI_LCD_ROUND_X - 1);
+    area->y1 &= ~(MIMI_LCD_ROUND_Y - 1);
+    area->y2 |= (MIMI_LCD_ROUND_Y - 1);
+    if (area->x2 >= MIMI_LCD_HOR_RES) area->x2 = MIMI_LCD_HOR_RES - 1;
+    if (area->y2 >= MIMI_LCD_VER_RES) area->y2 = MIMI_LCD_VER_RES - 1;
+}
 
-    lv_disp_flush_ready(drv);
+/* Called by LVGL while it waits for a buffer: sleep instead of spinning */
+static void lvgl_flush_wait(lv_disp_drv_t *drv)
+{
+    (void)drv;
+    xSemaphoreTake(s_flush_done, pdMS_TO_TICKS(20));
 }
 
 static void lvgl_tick_cb(void *arg)
@@ -164,15 +308,30 @@ esp_err_t display_port_init(void)
     lv_init();
     ESP_ERROR_CHECK(lvgl_tick_init());
 
-    lv_disp_buf_init(&s_disp_buf, s_disp_line_buf, NULL, MIMI_LCD_HOR_RES * 20);
+    /* Two DMA-capable bands: one rendered while the other is transferred */
+    size_t buf_px = MIMI_LCD_HOR_RES * MIMI_LCD_BUF_LINES;
+    for (int i = 0; i < 2; i++) {
+        s_draw_buf[i] = heap_caps_malloc(buf_px * sizeof(lv_color_t), MALLOC_CAP_DMA);
+        if (!s_draw_buf[i]) {
+            ESP_LOGE(TAG, "No DMA memory for %d-line draw buffers", MIMI_LCD_BUF_LINES);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    s_flush_done = xSemaphoreCreateBinary();
+    if (!s_flush_done) return ESP_ERR_NO_MEM;
+    lv_disp_buf_init(&s_disp_buf, s_draw_buf[0], s_draw_buf[1], buf_px);
 
-    lv_disp_drv_t disp_drv;
+    static lv_disp_drv_t disp_drv;
     lv_disp_drv_init(&disp_drv);
     disp_drv.hor_res = MIMI_LCD_HOR_RES;
     disp_drv.ver_res = MIMI_LCD_VER_RES;
     disp_drv.flush_cb = lvgl_flush;
+    disp_drv.rounder_cb = lvgl_rounder;
+    disp_drv.wait_cb = lvgl_flush_wait;
     disp_drv.buffer = &s_disp_buf;
+    s_disp_drv = &disp_drv;
     lv_disp_drv_register(&disp_drv);
+    s_fps_window_us = esp_timer_get_time();
 
     esp_err_t touch_ret = xpt2046_init(MIMI_LCD_SPI_HOST, MIMI_TOUCH_CS, MIMI_TOUCH_IRQ);
     if (touch_ret == ESP_OK) {
@@ -188,3 +347,14 @@ esp_err_t display_port_init(void)
     s_inited = true;
     return ESP_OK;
 }
+
+void display_port_get_stats(display_stats_t *out)
+{
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_stats_mux);
+    *out = s_stats;
+    out->avg_frame_us = s_stats.frames ? (uint32_t)(s_frame_total_us / s_stats.frames) : 0;
+    if (now - s_last_frame_end_us > 1000000) out->fps = 0;   /* idle: nothing redrawn */
+    portEXIT_CRITICAL(&s_stats_mux);
+    out->buf_lines = MIMI_LCD_BUF_LINES;
+}
@@ -1,5 +1,23 @@
 #pragma once
 
+#include <stdint.h>
 #include "esp_err.h"
 
+typedef struct {
+    uint32_t frames;            /* LVGL refreshes fully sent to the panel */
+    uint32_t fps;               /* over the last second; 0 while idle */
+    uint32_t last_frame_us;     /* first band queued to last band sent */
+    uint32_t avg_frame_us;
+    uint32_t max_frame_us;
+    uint32_t flushes;           /* bands sent */
+    uint64_t bytes;
+    uint32_t transactions;      /* SPI transactions queued, setup included */
+    uint32_t window_skips;      /* setup transactions saved by the window cache */
+    uint32_t last_frame_trans;
+    uint32_t last_frame_bytes;
+    int buf_lines;              /* height of each draw buffer */
+} display_stats_t;
+
 esp_err_t display_port_init(void);
+
+void display_port_get_stats(display_stats_t *out);
@@ -0,0 +1,67 @@
+#include "touch_filter.h"
+
+#include <string.h>
+
+#if (TOUCH_FILTER_MEDIAN % 2) == 0 || TOUCH_FILTER_MEDIAN > 9
+#error "TOUCH_FILTER_MEDIAN must be odd and at most 9"
+#endif
+
+void touch_filter_reset(touch_filter_t *f)
+{
+    memset(f, 0, sizeof(*f));
+}
+
+static int16_t median(const int16_t *ring, int n)
+{
+    int16_t v[TOUCH_FILTER_MEDIAN];
+    memcpy(v, ring, n * sizeof(v[0]));
+
+    /* Insertion sort: n is tiny */
+    for (int i = 1; i < n; i++) {
+        int16_t cur = v[i];
+        int j = i - 1;
+        while (j >= 0 && v[j] > cur) {
+            v[j + 1] = v[j];
+            j--;
+        }
+        v[j + 1] = cur;
+    }
+    /* Even counts (while filling) take the lower middle */
+    return v[(n - 1) / 2];
+}
+
+bool touch_filter_push(touch_filter_t *f, int16_t x, int16_t y,
+                       int16_t *out_x, int16_t *out_y)
+{
+    f->x[f->head] = x;
+    f->y[f->head] = y;
+    f->head = (f->head + 1) % TOUCH_FILTER_MEDIAN;
+    if (f->count < TOUCH_FILTER_MEDIAN) {
+        f->count++;
+    }
+
+    /* The first samples after pen-down are the noisiest; wait until the
+     * median has a majority before seeding the IIR */
+    int min = TOUCH_FILTER_MIN_SAMPLES < TOUCH_FILTER_MEDIAN ?
+              TOUCH_FILTER_MIN_SAMPLES : TOUCH_FILTER_MEDIAN;
+    if (f->count < min) {
+        return false;
+    }
+
+    /* Order inside the ring does not matter for a median */
+    int32_t mx = (int32_t)median(f->x, f->count) << 4;
+    int32_t my = (int32_t)median(f->y, f->count) << 4;
+
+    if (!f->seeded) {
+        f->iir_x = mx;
+        f->iir_y = my;
+        f->seeded = true;
+    } else {
+        f->iir_x += (mx - f->iir_x) / (1 << TOUCH_FILTER_IIR_SHIFT);
+        f->iir_y += (my - f->iir_y) / (1 << TOUCH_FILTER_IIR_SHIFT);
+    }
+
+    *out_x = (int16_t)((f->iir_x + 8) >> 4);
+    *out_y = (int16_t)((f->iir_y + 8) >> 4);
+    return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Touch coordinate filter: median over the last TOUCH_FILTER_MEDIAN raw
+ * samples (drops single-sample spikes from a bouncing contact), followed by
+ * a first-order IIR low-pass (smooths jitter while the pen rests). Samples
+ * go into a ring, so adding one is O(1). Pure C, no ESP-IDF dependencies.
+ */
+
+#ifndef TOUCH_FILTER_MEDIAN
+#define TOUCH_FILTER_MEDIAN     5       /* odd, <= 9 */
+#endif
+
+/* IIR weight of a new median as a power of two: out += (in - out) >> shift */
+#ifndef TOUCH_FILTER_IIR_SHIFT
+#define TOUCH_FILTER_IIR_SHIFT  1
+#endif
+
+/* Samples needed after pen-down before a point is reported */
+#ifndef TOUCH_FILTER_MIN_SAMPLES
+#define TOUCH_FILTER_MIN_SAMPLES 3
+#endif
+
+typedef struct {
+    int16_t x[TOUCH_FILTER_MEDIAN];
+    int16_t y[TOUCH_FILTER_MEDIAN];
+    uint8_t head;               /* next slot to overwrite */
+    uint8_t count;              /* valid samples, saturates at MEDIAN */
+    bool seeded;                /* IIR state holds a value */
+    int32_t iir_x;              /* Q4 fixed point */
+    int32_t iir_y;
+} touch_filter_t;
+
+/** Forget all samples (pen lifted). */
+void touch_filter_reset(touch_filter_t *f);
+
+/**
+ * Add a raw sample. Returns true and writes the filtered point once enough
+ * samples have been seen since the last reset.
+ */
+bool touch_filter_push(touch_filter_t *f, int16_t x, int16_t y,
+                       int16_t *out_x, int16_t *out_y);
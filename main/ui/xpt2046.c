@@ -1,18 +1,31 @@
 #include "xpt2046.h"
 
+#include <stdatomic.h>
 #include <string.h>
 #include "driver/gpio.h"
+#include "esp_attr.h"
 #include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "ui/board_config.h"
+#include "ui/touch_filter.h"
 
 static const char *TAG = "xpt2046";
 
 static spi_device_handle_t s_spi = NULL;
 static int s_irq_pin = -1;
-
-static int16_t s_avg_buf_x[XPT2046_AVG];
-static int16_t s_avg_buf_y[XPT2046_AVG];
-static uint8_t s_avg_last = 0;
+static TaskHandle_t s_touch_task = NULL;
+static touch_filter_t s_filter;
+
+/*
+ * Latest point, published by the touch task and read by LVGL without a lock:
+ * bit 31 = pressed, bits 16..30 = y, bits 0..15 = x. s_presses counts
+ * pen-down events so a tap that starts and ends between two indev reads is
+ * still reported as one press.
+ */
+#define TOUCH_PRESSED_BIT   0x80000000u
+static atomic_uint_fast32_t s_point;
+static atomic_uint_fast32_t s_presses;
 
 static int16_t xpt2046_cmd(uint8_t cmd)
 {
@@ -73,28 +86,63 @@ static void xpt2046_corr(int16_t *x, int16_t *y)
     if (*y >= MIMI_LCD_VER_RES) *y = MIMI_LCD_VER_RES - 1;
 }
 
-static void xpt2046_avg(int16_t *x, int16_t *y)
+static void publish(bool pressed, int16_t x, int16_t y)
 {
-    for (int i = XPT2046_AVG - 1; i > 0; i--) {
-        s_avg_buf_x[i] = s_avg_buf_x[i - 1];
-        s_avg_buf_y[i] = s_avg_buf_y[i - 1];
-    }
+    uint32_t v = ((uint32_t)(y & 0x7FFF) << 16) | (uint16_t)x;
+    if (pressed) v |= TOUCH_PRESSED_BIT;
+    atomic_store_explicit(&s_point, v, memory_order_release);
+}
 
-    s_avg_buf_x[0] = *x;
-    s_avg_buf_y[0] = *y;
-    if (s_avg_last < XPT2046_AVG) {
-        s_avg_last++;
-    }
+static void IRAM_ATTR touch_isr(void *arg)
+{
+    /* PENIRQ toggles during conversions; the task re-arms it once released */
+    gpio_intr_disable(s_irq_pin);
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(s_touch_task, &woken);
+    if (woken) portYIELD_FROM_ISR(woken);
+}
 
-    int32_t x_sum = 0;
-    int32_t y_sum = 0;
-    for (int i = 0; i < s_avg_last; i++) {
-        x_sum += s_avg_buf_x[i];
-        y_sum += s_avg_buf_y[i];
+/* Sample while the pen is down, then go back to sleep until the next IRQ.
+ * Without an IRQ pin the task polls at XPT2046_IDLE_POLL_MS instead. */
+static void touch_task(void *arg)
+{
+    TickType_t idle_wait = s_irq_pin >= 0 ? portMAX_DELAY : pdMS_TO_TICKS(XPT2046_IDLE_POLL_MS);
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, idle_wait);
+
+        bool down = false;
+        touch_filter_reset(&s_filter);
+        while (xpt2046_is_touch_detected()) {
+            int16_t x = xpt2046_cmd(XPT2046_CMD_X_READ);
+            int16_t y = xpt2046_cmd(XPT2046_CMD_Y_READ);
+            if (touch_filter_push(&s_filter, x, y, &x, &y)) {
+                xpt2046_corr(&x, &y);
+                publish(true, x, y);
+                if (!down) {
+                    down = true;
+                    atomic_fetch_add_explicit(&s_presses, 1, memory_order_release);
+                }
+            }
+            vTaskDelay(pdMS_TO_TICKS(XPT2046_SAMPLE_MS));
+        }
+
+        if (down) {
+            uint32_t last = atomic_load_explicit(&s_point, memory_order_relaxed);
+            publish(false, (int16_t)(last & 0xFFFF), (int16_t)((last >> 16) & 0x7FFF));
+        }
+
+        if (s_irq_pin >= 0) {
+            /* Drop a notification raised by our own conversions, then re-arm.
+             * A pen already down again is caught by the level check. */
+            ulTaskNotifyTake(pdTRUE, 0);
+            gpio_intr_enable(s_irq_pin);
+            if (gpio_get_level(s_irq_pin) == 0) {
+                gpio_intr_disable(s_irq_pin);
+                xTaskNotifyGive(s_touch_task);
+            }
+        }
     }
-
-    *x = x_sum / s_avg_last;
-    *y = y_sum / s_avg_last;
 }
 
 esp_err_t xpt2046_init(spi_host_device_t host, int cs_pin, int irq_pin)
@@ -107,7 +155,7 @@ esp_err_t xpt2046_init(spi_host_device_t host, int cs_pin, int irq_pin)
             .mode = GPIO_MODE_INPUT,
             .pull_up_en = GPIO_PULLUP_ENABLE,
             .pull_down_en = GPIO_PULLDOWN_DISABLE,
-            .intr_type = GPIO_INTR_DISABLE,
+            .intr_type = GPIO_INTR_NEGEDGE,
         };
         ESP_ERROR_CHECK(gpio_config(&irq_cfg));
     }
@@ -137,7 +185,30 @@ esp_err_t xpt2046_init(spi_host_device_t host, int cs_pin, int irq_pin)
         return ret;
     }
 
+    /* Also leaves the controller in PD=00, which keeps PENIRQ enabled */
     xpt2046_cmd(XPT2046_CMD_X_READ);
+
+    if (xTaskCreatePinnedToCore(touch_task, "touch", XPT2046_TASK_STACK, NULL,
+                                XPT2046_TASK_PRIO, &s_touch_task,
+                                XPT2046_TASK_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "touch task create failed");
+        return ESP_FAIL;
+    }
+
+    if (s_irq_pin >= 0) {
+        /* Another driver may already have installed the shared ISR service */
+        ret = gpio_install_isr_service(0);
+        if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
+            ESP_LOGE(TAG, "ISR service install failed: %s", esp_err_to_name(ret));
+            return ret;
+        }
+        ESP_ERROR_CHECK(gpio_isr_handler_add(s_irq_pin, touch_isr, NULL));
+        if (gpio_get_level(s_irq_pin) == 0) {
+            gpio_intr_disable(s_irq_pin);
+            xTaskNotifyGive(s_touch_task);
+        }
+    }
+
     ESP_LOGI(TAG, "Touch initialized on SPI%d, CS=%d IRQ=%d", host + 1, cs_pin, s_irq_pin);
     return ESP_OK;
 }
@@ -146,29 +217,16 @@ bool xpt2046_read(lv_indev_drv_t *drv, lv_indev_data_t *data)
 {
     (void)drv;
 
-    static int16_t last_x = 0;
-    static int16_t last_y = 0;
+    static uint32_t seen_presses = 0;
 
-    bool valid = false;
-    int16_t x = last_x;
-    int16_t y = last_y;
-
-    if (xpt2046_is_touch_detected()) {
-        valid = true;
-        x = xpt2046_cmd(XPT2046_CMD_X_READ);
-        y = xpt2046_cmd(XPT2046_CMD_Y_READ);
-
-        xpt2046_corr(&x, &y);
-        xpt2046_avg(&x, &y);
-
-        last_x = x;
-        last_y = y;
-    } else {
-        s_avg_last = 0;
-    }
+    /* No SPI here: the indev callback only picks up what the task published */
+    uint32_t presses = atomic_load_explicit(&s_presses, memory_order_acquire);
+    uint32_t v = atomic_load_explicit(&s_point, memory_order_acquire);
+    bool pressed = (v & TOUCH_PRESSED_BIT) != 0 || presses != seen_presses;
+    seen_presses = presses;
 
-    data->point.x = x;
-    data->point.y = y;
-    data->state = valid ? LV_INDEV_STATE_PR : LV_INDEV_STATE_REL;
+    data->point.x = (int16_t)(v & 0xFFFF);
+    data->point.y = (int16_t)((v >> 16) & 0x7FFF);
+    data->state = pressed ? LV_INDEV_STATE_PR : LV_INDEV_STATE_REL;
     return false;
 }
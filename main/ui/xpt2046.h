@@ -18,8 +18,21 @@
 #define XPT2046_SWAP_XY      0
 #define XPT2046_X_INV        1
 #define XPT2046_Y_INV        0
-#define XPT2046_AVG          4
 #define XPT2046_THRESHOLD    400
 
+/* The touch task samples every XPT2046_SAMPLE_MS while the pen is down and
+ * sleeps on PENIRQ otherwise; without an IRQ pin it polls instead. */
+#define XPT2046_SAMPLE_MS    8
+#define XPT2046_IDLE_POLL_MS 30
+#define XPT2046_TASK_STACK   3072
+#define XPT2046_TASK_PRIO    5
+#define XPT2046_TASK_CORE    1
+
+/**
+ * Add the touch controller to the LCD's SPI bus and start the sampling task.
+ * With irq_pin >= 0 the bus is only used while the pen is down.
+ */
 esp_err_t xpt2046_init(spi_host_device_t host, int cs_pin, int irq_pin);
+
+/** LVGL indev read callback: returns the last filtered point, no SPI access. */
 bool xpt2046_read(lv_indev_drv_t *drv, lv_indev_data_t *data);
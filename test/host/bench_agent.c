@@ -0,0 +1,186 @@
+/* Agent loop benchmark: N chats drive the real bus → agent → LLM → tools →
+ * session path against a mock Anthropic server and a mock Brave search API.
+ * Every third turn asks for read_file + web_search so the tool batch and
+ * the second LLM round are part of the numbers.
+ *
+ *   bench_agent [--chats N] [--turns T] [--llm-delay-ms MS]
+ */
+
+#include "host_test.h"
+#include "mock_http.h"
+#include "mock_llm.h"
+#include "shim_alloc.h"
+#include "shim_net.h"
+
+#include "agent/agent_loop.h"
+#include "bus/message_bus.h"
+#include "llm/llm_proxy.h"
+#include "memory/memory_store.h"
+#include "memory/session_mgr.h"
+#include "proxy/conn_pool.h"
+#include "proxy/http_proxy.h"
+#include "tools/tool_registry.h"
+#include "tools/tool_web_search.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BENCH_CHANNEL   MIMI_CHAN_WEBSOCKET
+#define MAX_CHATS       64
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int replies[MAX_CHATS];
+    int64_t sent_us[MAX_CHATS];
+    int64_t *latency_us;
+    int samples;
+} bench_t;
+
+static bench_t s_bench = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+static esp_err_t collect_reply(const mimi_msg_t *msg, void *ctx)
+{
+    int chat = atoi(msg->chat_id + strlen("chat"));
+    if (chat < 0 || chat >= MAX_CHATS) return ESP_OK;
+    pthread_mutex_lock(&s_bench.lock);
+    s_bench.latency_us[s_bench.samples++] = host_now_us() - s_bench.sent_us[chat];
+    s_bench.replies[chat]++;
+    pthread_cond_broadcast(&s_bench.cond);
+    pthread_mutex_unlock(&s_bench.lock);
+    return ESP_OK;
+}
+
+static void search_handler(mock_http_conn_t *c, const mock_http_req_t *req, void *ctx)
+{
+    static const char body[] =
+        "{\"web\":{\"results\":["
+        "{\"title\":\"PSRAM task stacks\",\"url\":\"https://example.com/a\","
+        "\"description\":\"xTaskCreatePinnedToCoreWithCaps with MALLOC_CAP_SPIRAM.\"},"
+        "{\"title\":\"ESP32-S3 memory map\",\"url\":\"https://example.com/b\","
+        "\"description\":\"Internal SRAM, PSRAM and cache.\"}]}}";
+    mock_http_reply(c, 200, "application/json", body, sizeof(body) - 1);
+}
+
+static void push_turn(int chat, int turn)
+{
+    mimi_msg_t msg = {0};
+    strncpy(msg.channel, BENCH_CHANNEL, sizeof(msg.channel) - 1);
+    snprintf(msg.chat_id, sizeof(msg.chat_id), "chat%d", chat);
+    char text[128];
+    snprintf(text, sizeof(text), "turn %d of chat %d%s", turn, chat,
+             turn % 3 == 2 ? " [read_file] [web_search]" : "");
+
+    pthread_mutex_lock(&s_bench.lock);
+    s_bench.sent_us[chat] = host_now_us();
+    pthread_mutex_unlock(&s_bench.lock);
+
+    msg.content = strdup(text);
+    while (message_bus_push_inbound(&msg) == ESP_ERR_NO_MEM) {
+        usleep(1000);   /* backpressure: keep the message and retry */
+    }
+}
+
+static void print_stage(const agent_stats_t *st, agent_stage_t s)
+{
+    const agent_stage_stats_t *a = &st->stage[s];
+    printf("  %-12s %7u  avg %8.2f ms  max %8.2f ms\n", agent_loop_stage_name(s), a->count,
+           a->count ? (double)a->total_us / a->count / 1000.0 : 0.0, a->max_us / 1000.0);
+}
+
+int main(int argc, char **argv)
+{
+    int chats = 8, turns = 3, llm_delay_ms = 5;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--chats") == 0) chats = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--turns") == 0) turns = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--llm-delay-ms") == 0) llm_delay_ms = atoi(argv[i + 1]);
+    }
+    CHECK(chats > 0 && chats <= MAX_CHATS && turns > 0);
+
+    host_spiffs_reset();
+    host_write_file(MIMI_SPIFFS_BASE "/memory/MEMORY.md",
+                    "# Memory\n- The user prefers short answers.\n");
+
+    mock_llm_cfg_t llm_cfg = {
+        .first_token_ms = llm_delay_ms,
+        .delta_ms = 1,
+        .text_deltas = 16,
+    };
+    mock_llm_t *llm = mock_llm_start(&llm_cfg);
+    CHECK(llm);
+    mock_http_t *search = mock_http_start(search_handler, NULL);
+    CHECK(search);
+    shim_net_route("api.search.brave.com", 0, mock_http_port(search));
+
+    CHECK(message_bus_init() == ESP_OK);
+    CHECK(memory_store_init() == ESP_OK);
+    CHECK(session_mgr_init() == ESP_OK);
+    CHECK(http_proxy_init() == ESP_OK);
+    CHECK(conn_pool_init() == ESP_OK);
+    CHECK(llm_proxy_init() == ESP_OK);
+    CHECK(llm_set_api_key("sk-bench") == ESP_OK);
+    CHECK(tool_registry_init() == ESP_OK);
+    CHECK(tool_web_search_set_key("BSA-bench") == ESP_OK);
+    CHECK(agent_loop_init() == ESP_OK);
+    mimi_outbound_opts_t opts = { .queue_len = MAX_CHATS };
+    CHECK(message_bus_subscribe_outbound(BENCH_CHANNEL, collect_reply, &opts) == ESP_OK);
+    CHECK(agent_loop_start() == ESP_OK);
+
+    s_bench.latency_us = calloc((size_t)chats * turns, sizeof(int64_t));
+    shim_alloc_stats_t a0;
+    shim_alloc_reset_peak();
+    shim_alloc_get(&a0);
+    int64_t t0 = host_now_us();
+
+    /* Each chat sends its next turn once the previous reply arrived */
+    for (int c = 0; c < chats; c++) push_turn(c, 0);
+    for (int t = 1; t <= turns; t++) {
+        for (int c = 0; c < chats; c++) {
+            pthread_mutex_lock(&s_bench.lock);
+            while (s_bench.replies[c] < t) {
+                struct timespec dl;
+                clock_gettime(CLOCK_REALTIME, &dl);
+                dl.tv_sec += 60;
+                if (pthread_cond_timedwait(&s_bench.cond, &s_bench.lock, &dl) != 0) {
+                    fprintf(stderr, "chat%d: no reply to turn %d\n", c, t - 1);
+                    exit(1);
+                }
+            }
+            pthread_mutex_unlock(&s_bench.lock);
+            if (t < turns) push_turn(c, t);
+        }
+    }
+
+    int64_t wall_us = host_now_us() - t0;
+    shim_alloc_stats_t a1;
+    shim_alloc_get(&a1);
+    /* A worker records the turn just after it pushes the reply */
+    agent_stats_t st;
+    int64_t settle = host_now_us() + 1000000;
+    do {
+        agent_loop_get_stats(&st);
+    } while (st.turns < (uint32_t)(chats * turns) && host_now_us() < settle && !usleep(1000));
+    int n = s_bench.samples;
+
+    printf("bench_agent: %d chats x %d turns, LLM first token %d ms, %d LLM calls\n",
+           chats, turns, llm_delay_ms, mock_llm_calls(llm));
+    printf("  wall %.1f ms, %.1f turns/s\n", wall_us / 1000.0, n * 1e6 / wall_us);
+    printf("  end-to-end p50 %.2f ms  p99 %.2f ms\n",
+           host_percentile(s_bench.latency_us, n, 50) / 1000.0,
+           host_percentile(s_bench.latency_us, n, 99) / 1000.0);
+    for (int s = 0; s < AGENT_STAGE_COUNT; s++) print_stage(&st, (agent_stage_t)s);
+    printf("  heap: %.1f allocs/turn, peak %zu bytes live\n",
+           (double)(a1.allocs - a0.allocs) / n, a1.peak_bytes);
+    printf("  arena: %llu allocs, %u max/turn, %u spills, peak %zu bytes\n",
+           (unsigned long long)st.allocs, st.allocs_max, st.spills, st.arena_peak);
+
+    CHECK_EQ_INT(n, chats * turns);
+    CHECK_EQ_INT(st.turns, chats * turns);
+    CHECK_EQ_INT(st.failed, 0);
+    return 0;
+}
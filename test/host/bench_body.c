@@ -0,0 +1,176 @@
+/* Request body cost per ReAct iteration: llm_body (incremental encode into a
+ * reusable buffer) against the previous per-call path, which duplicated the
+ * whole conversation, parsed the tools JSON and printed everything again.
+ * Each iteration appends a tool_use turn and an 8 KB tool result. */
+
+#include "host_test.h"
+#include "shim_alloc.h"
+
+#include "mimi_config.h"
+#include "llm/llm_body.h"
+#include "tools/tool_registry.h"
+
+#include <string.h>
+
+#define ITERATIONS  MIMI_AGENT_MAX_TOOL_ITER
+#define RESULT_SIZE (8 * 1024)
+
+static const char *SYSTEM_PROMPT = "You are Mimi, a pocket assistant running on an ESP32-S3.";
+
+typedef struct {
+    uint64_t allocs;
+    uint64_t bytes;     /* bytes serialized or copied */
+    int64_t us;
+} cost_t;
+
+static void append_round(cJSON *messages, int i, const char *result_text)
+{
+    char id[32];
+    snprintf(id, sizeof(id), "toolu_%04d", i);
+    cJSON *assistant = cJSON_CreateObject();
+    cJSON_AddStringToObject(assistant, "role", "assistant");
+    cJSON *blocks = cJSON_AddArrayToObject(assistant, "content");
+    cJSON *use = cJSON_CreateObject();
+    cJSON_AddStringToObject(use, "type", "tool_use");
+    cJSON_AddStringToObject(use, "id", id);
+    cJSON_AddStringToObject(use, "name", "web_fetch");
+    cJSON_AddItemToObject(use, "input", cJSON_Parse("{\"url\":\"https://example.com/page\"}"));
+    cJSON_AddItemToArray(blocks, use);
+    cJSON_AddItemToArray(messages, assistant);
+
+    cJSON *user = cJSON_CreateObject();
+    cJSON_AddStringToObject(user, "role", "user");
+    cJSON *results = cJSON_AddArrayToObject(user, "content");
+    cJSON *result = cJSON_CreateObject();
+    cJSON_AddStringToObject(result, "type", "tool_result");
+    cJSON_AddStringToObject(result, "tool_use_id", id);
+    cJSON_AddStringToObject(result, "content", result_text);
+    cJSON_AddItemToArray(results, result);
+    cJSON_AddItemToArray(messages, user);
+}
+
+static cJSON *new_conversation(void)
+{
+    cJSON *messages = cJSON_CreateArray();
+    cJSON *m = cJSON_CreateObject();
+    cJSON_AddStringToObject(m, "role", "user");
+    cJSON_AddStringToObject(m, "content", "Summarize the three pages for me.");
+    cJSON_AddItemToArray(messages, m);
+    return messages;
+}
+
+/* The path llm_chat_tools used before the body builder */
+static char *old_body(cJSON *messages, const char *tools_json, size_t *copied)
+{
+    cJSON *body = cJSON_CreateObject();
+    cJSON_AddStringToObject(body, "model", MIMI_LLM_DEFAULT_MODEL);
+    cJSON_AddNumberToObject(body, "max_tokens", MIMI_LLM_MAX_TOKENS);
+    cJSON_AddBoolToObject(body, "stream", 1);
+    cJSON_AddStringToObject(body, "system", SYSTEM_PROMPT);
+    cJSON_AddItemToObject(body, "messages", cJSON_Duplicate(messages, 1));
+    cJSON_AddItemToObject(body, "tools", cJSON_Parse(tools_json));
+    char *out = cJSON_PrintUnformatted(body);
+    cJSON_Delete(body);
+    /* duplicate copies the conversation's strings, print writes it all out */
+    char *msgs = cJSON_PrintUnformatted(messages);
+    *copied = strlen(msgs) + strlen(tools_json) + strlen(out);
+    free(msgs);
+    return out;
+}
+
+/* Drop the cache marks so bodies can be compared with the old encoding */
+static void strip_marks(cJSON *item)
+{
+    for (cJSON *c = item ? item->child : NULL; c; c = c->next) strip_marks(c);
+    if (cJSON_IsObject(item)) cJSON_DeleteItemFromObject(item, "cache_control");
+}
+
+static void run(bool incremental, const char *tools, const char *result_text, cost_t *per_iter)
+{
+    cJSON *messages = new_conversation();
+    llm_body_t body;
+    llm_body_init(&body);
+    if (incremental) {
+        CHECK(llm_body_begin(&body, MIMI_LLM_DEFAULT_MODEL, MIMI_LLM_MAX_TOKENS,
+                             SYSTEM_PROMPT, tools) == ESP_OK);
+    }
+
+    for (int i = 0; i < ITERATIONS; i++) {
+        if (i) append_round(messages, i, result_text);
+        shim_alloc_stats_t a0, a1;
+        shim_alloc_get(&a0);
+        int64_t t0 = host_now_us();
+        size_t copied = 0;
+        char *old = NULL;
+        if (incremental) {
+            CHECK(llm_body_update(&body, messages) == ESP_OK);
+            copied = body.last_encoded;
+        } else {
+            old = old_body(messages, tools, &copied);
+            CHECK(old);
+        }
+        int64_t dt = host_now_us() - t0;
+        shim_alloc_get(&a1);
+        per_iter[i].allocs = a1.allocs - a0.allocs;
+        per_iter[i].bytes = copied;
+        per_iter[i].us = dt;
+
+        if (incremental) {
+            /* Same messages as the old encoding, marks aside */
+            cJSON *parsed = cJSON_Parse(body.buf);
+            CHECK(parsed);
+            cJSON *sent = cJSON_GetObjectItem(parsed, "messages");
+            strip_marks(sent);
+            if (i) CHECK(cJSON_Compare(sent, messages, 1));
+            CHECK_EQ_INT(cJSON_GetArraySize(sent), cJSON_GetArraySize(messages));
+            cJSON_Delete(parsed);
+        }
+        free(old);
+    }
+    llm_body_free(&body);
+    cJSON_Delete(messages);
+}
+
+int main(void)
+{
+    host_spiffs_reset();
+    CHECK(tool_registry_init() == ESP_OK);
+    const char *tools = tool_registry_get_tools_json();
+    CHECK(tools);
+
+    char *result_text = malloc(RESULT_SIZE + 1);
+    for (int i = 0; i < RESULT_SIZE; i++) result_text[i] = "lorem ipsum \"dolor\" sit\n"[i % 24];
+    result_text[RESULT_SIZE] = '\0';
+
+    cost_t old_cost[ITERATIONS], new_cost[ITERATIONS];
+    run(false, tools, result_text, old_cost);
+    run(true, tools, result_text, new_cost);
+
+    printf("bench_body: %d iterations, %d-byte tool results, tools JSON %zu bytes\n",
+           ITERATIONS, RESULT_SIZE, strlen(tools));
+    printf("  iter   old allocs   old bytes   old us  |  new allocs   new bytes   new us\n");
+    cost_t old_sum = {0}, new_sum = {0};
+    for (int i = 0; i < ITERATIONS; i++) {
+        printf("  %4d %12llu %11llu %8lld  | %11llu %11llu %8lld\n", i,
+               (unsigned long long)old_cost[i].allocs, (unsigned long long)old_cost[i].bytes,
+               (long long)old_cost[i].us, (unsigned long long)new_cost[i].allocs,
+               (unsigned long long)new_cost[i].bytes, (long long)new_cost[i].us);
+        old_sum.allocs += old_cost[i].allocs;
+        old_sum.bytes += old_cost[i].bytes;
+        new_sum.allocs += new_cost[i].allocs;
+        new_sum.bytes += new_cost[i].bytes;
+    }
+    printf("  total %11llu %11llu           | %11llu %11llu\n",
+           (unsigned long long)old_sum.allocs, (unsigned long long)old_sum.bytes,
+           (unsigned long long)new_sum.allocs, (unsigned long long)new_sum.bytes);
+
+    /* Later iterations only encode what was appended, plus the previous
+     * newest message again without its cache mark */
+    for (int i = 1; i < ITERATIONS; i++) {
+        CHECK(new_cost[i].bytes < 3 * RESULT_SIZE);
+        CHECK(new_cost[i].allocs * 4 < old_cost[i].allocs);
+    }
+    CHECK(new_sum.bytes * 4 < old_sum.bytes);
+    free(result_text);
+    return 0;
+}
@@ -0,0 +1,223 @@
+/* Feishu event dedup at full table load.
+ *
+ * A stream of event ids (fresh ones, recent redeliveries and redeliveries
+ * of long-evicted events) runs through event_dedup and, as the reference,
+ * through the linear 2048-slot table it replaced, which is rebuilt below.
+ * Every contains() answer must match. The bench reports time per event
+ * once the table is full and bytes written to flash per event (append log
+ * vs rewriting the whole table every 16 marks), then reloads the log and
+ * checks that the live set survives a reboot. */
+
+#include "host_test.h"
+
+#include "feishu/event_dedup.h"
+
+#include <string.h>
+#include <sys/stat.h>
+
+#define EVENTS      200000
+#define STEP_MS     10
+#define WALL0_MS    1760000000000LL
+#define LOG_PATH    MIMI_SPIFFS_BASE "/dedup.log"
+#define TMP_PATH    MIMI_SPIFFS_BASE "/dedup.tmp"
+
+/* ── The previous table: linear scan over 96-byte keys ─────────── */
+
+typedef struct {
+    bool used;
+    char key[96];
+    int64_t ts_ms;
+} old_slot_t;
+
+typedef struct {
+    old_slot_t slots[FEISHU_EVENT_DEDUP_MAX];
+    int dirty;
+    uint64_t bytes_written;
+} old_table_t;
+
+typedef struct {
+    uint8_t used;
+    int64_t ts_ms;
+    char key[96];
+} old_file_entry_t;
+
+static void old_flush(old_table_t *t)
+{
+    if (++t->dirty < FEISHU_EVENT_DEDUP_FLUSH_WRITES) return;
+    t->dirty = 0;
+    t->bytes_written += 12 + sizeof(old_file_entry_t) * FEISHU_EVENT_DEDUP_MAX;
+}
+
+static bool old_contains(old_table_t *t, const char *key, int64_t now)
+{
+    for (int i = 0; i < FEISHU_EVENT_DEDUP_MAX; i++) {
+        old_slot_t *s = &t->slots[i];
+        if (!s->used) continue;
+        if (now - s->ts_ms > FEISHU_EVENT_DEDUP_EXPIRE_MS) {
+            memset(s, 0, sizeof(*s));
+            continue;
+        }
+        if (strcmp(s->key, key) == 0) return true;
+    }
+    return false;
+}
+
+static void old_mark_seen(old_table_t *t, const char *key, int64_t now)
+{
+    int free_idx = -1, oldest_idx = 0;
+    int64_t oldest_ts = INT64_MAX;
+    for (int i = 0; i < FEISHU_EVENT_DEDUP_MAX; i++) {
+        old_slot_t *s = &t->slots[i];
+        if (!s->used) {
+            if (free_idx < 0) free_idx = i;
+            continue;
+        }
+        if (now - s->ts_ms > FEISHU_EVENT_DEDUP_EXPIRE_MS) {
+            memset(s, 0, sizeof(*s));
+            if (free_idx < 0) free_idx = i;
+            continue;
+        }
+        if (strcmp(s->key, key) == 0) {
+            s->ts_ms = now;
+            old_flush(t);
+            return;
+        }
+        if (s->ts_ms < oldest_ts) {
+            oldest_ts = s->ts_ms;
+            oldest_idx = i;
+        }
+    }
+    old_slot_t *s = &t->slots[free_idx >= 0 ? free_idx : oldest_idx];
+    s->used = true;
+    snprintf(s->key, sizeof(s->key), "%s", key);
+    s->ts_ms = now;
+    old_flush(t);
+}
+
+/* ── Event stream ─────────────────────────────────────────────── */
+
+static uint32_t s_rnd = 0x1234567u;
+
+static uint32_t rnd(void)
+{
+    s_rnd ^= s_rnd << 13;
+    s_rnd ^= s_rnd >> 17;
+    s_rnd ^= s_rnd << 5;
+    return s_rnd;
+}
+
+static void event_key(char *buf, size_t size, uint32_t n)
+{
+    snprintf(buf, size, "ev_%08x%08x-0c6a-4f1e-b3d2-%012u", n * 2654435761u, n, n);
+}
+
+/* 70% new events, 25% redeliveries of recent ones, 5% of evicted ones */
+static uint32_t next_event(uint32_t *fresh)
+{
+    uint32_t r = rnd() % 100;
+    if (r < 70 || *fresh < 4 * FEISHU_EVENT_DEDUP_MAX) return (*fresh)++;
+    if (r < 95) return *fresh - 1 - rnd() % (FEISHU_EVENT_DEDUP_MAX / 2);
+    return *fresh - FEISHU_EVENT_DEDUP_MAX * 2 - rnd() % FEISHU_EVENT_DEDUP_MAX;
+}
+
+static long file_size(const char *path)
+{
+    struct stat st;
+    return stat(path, &st) == 0 ? (long)st.st_size : 0;
+}
+
+int main(void)
+{
+    host_spiffs_reset();
+    static event_dedup_t d;
+    static old_table_t old;
+    event_dedup_init(&d, LOG_PATH, TMP_PATH, 0);
+    CHECK(event_dedup_load(&d, 0, WALL0_MS) == ESP_ERR_NOT_FOUND);
+
+    /* Differential run, with flash writes tracked from the log size */
+    uint32_t fresh = 0, dups = 0;
+    uint64_t log_bytes = 0;
+    long prev_size = 0;
+    char key[96];
+    int64_t now = 0;
+    for (int i = 0; i < EVENTS; i++) {
+        now += STEP_MS;
+        event_key(key, sizeof(key), next_event(&fresh));
+        bool seen = event_dedup_contains(&d, key, now);
+        CHECK(seen == old_contains(&old, key, now));
+        if (seen) {
+            dups++;
+            continue;
+        }
+        event_dedup_mark_seen(&d, key, now, WALL0_MS + now);
+        old_mark_seen(&old, key, now);
+
+        long size = file_size(LOG_PATH);
+        log_bytes += size >= prev_size ? (uint64_t)(size - prev_size) : (uint64_t)size;
+        prev_size = size;
+    }
+    CHECK_EQ_INT(d.count, FEISHU_EVENT_DEDUP_MAX);
+    uint32_t marks = EVENTS - dups;
+    /* Bounded log: at most twice the table plus one batch */
+    CHECK(file_size(LOG_PATH) <= (long)(16 + (2 * FEISHU_EVENT_DEDUP_MAX +
+                                              FEISHU_EVENT_DEDUP_FLUSH_WRITES) *
+                                                 sizeof(event_dedup_record_t)));
+
+    /* Reboot: replay the log (uptime restarts, wall clock moved on by 1 s) */
+    event_dedup_flush(&d, now, true);
+    static event_dedup_t r;
+    event_dedup_init(&r, LOG_PATH, TMP_PATH, 0);
+    CHECK(event_dedup_load(&r, 0, WALL0_MS + now + 1000) == ESP_OK);
+    int live = 0;
+    for (uint32_t n = fresh - 2 * FEISHU_EVENT_DEDUP_MAX; n < fresh; n++) {
+        event_key(key, sizeof(key), n);
+        bool before = event_dedup_contains(&d, key, now);
+        live += before;
+        CHECK(event_dedup_contains(&r, key, 1) == before);
+    }
+    CHECK(live > FEISHU_EVENT_DEDUP_MAX / 2);
+    CHECK_EQ_INT(r.count, d.count);
+    event_key(key, sizeof(key), 0);
+    CHECK(!event_dedup_contains(&r, key, 1));
+
+    /* A day later everything has expired */
+    CHECK(!event_dedup_contains(&r, key, FEISHU_EVENT_DEDUP_EXPIRE_MS + 2));
+    event_key(key, sizeof(key), fresh - 1);
+    CHECK(!event_dedup_contains(&r, key, FEISHU_EVENT_DEDUP_EXPIRE_MS + 2));
+    CHECK_EQ_INT(r.count, 0);
+
+    /* Timing at full load, each side on its own. Marks carry no wall time,
+     * so flash writes (counted above) stay out of the numbers. */
+    const int timed = 20000;
+    uint32_t saved_fresh = fresh, saved_rnd = s_rnd;
+    int64_t t_now = now;
+    int64_t t0 = host_now_us();
+    for (int i = 0; i < timed; i++) {
+        t_now += STEP_MS;
+        event_key(key, sizeof(key), next_event(&fresh));
+        if (!event_dedup_contains(&d, key, t_now)) event_dedup_mark_seen(&d, key, t_now, 0);
+    }
+    int64_t new_us = host_now_us() - t0;
+
+    fresh = saved_fresh;
+    s_rnd = saved_rnd;
+    t_now = now;
+    t0 = host_now_us();
+    for (int i = 0; i < timed; i++) {
+        t_now += STEP_MS;
+        event_key(key, sizeof(key), next_event(&fresh));
+        if (!old_contains(&old, key, t_now)) old_mark_seen(&old, key, t_now);
+    }
+    int64_t old_us = host_now_us() - t0;
+
+    printf("bench_event_dedup: %d events at full load (%d entries), %u redeliveries caught\n",
+           EVENTS, FEISHU_EVENT_DEDUP_MAX, dups);
+    printf("  per event:  hash ring %.3f us   linear scan %.3f us   (%.0fx)\n",
+           (double)new_us / timed, (double)old_us / timed, (double)old_us / (new_us ? new_us : 1));
+    printf("  flash/mark: append log %.1f bytes   full rewrite %.1f bytes\n",
+           (double)log_bytes / marks, (double)old.bytes_written / marks);
+    CHECK(new_us * 10 < old_us);
+    CHECK(log_bytes * 10 < old.bytes_written);
+
+    return 0;
+}
@@ -0,0 +1,198 @@
+/* Queueing delay under mixed-chat load on the agent worker pool.
+ *
+ * One slow chat runs long tool loops (every LLM call waits --slow-ms)
+ * while several fast chats talk to it in a closed loop with short think
+ * times. Queueing delay is push → the turn's first LLM request, taken at
+ * the mock server. With a single agent task every fast message that lands
+ * behind the slow turn would wait for it; with the pool the fast chats
+ * keep flowing. The slow chat's second message is pushed while its first
+ * is still running and must not start before that reply is out. */
+
+#include "host_test.h"
+#include "mock_llm.h"
+
+#include "agent/agent_loop.h"
+#include "bus/message_bus.h"
+#include "llm/llm_proxy.h"
+#include "memory/memory_store.h"
+#include "memory/session_mgr.h"
+#include "proxy/conn_pool.h"
+#include "proxy/http_proxy.h"
+#include "tools/tool_registry.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CHANNEL     MIMI_CHAN_WEBSOCKET
+#define SLOW_CHAT   0
+#define MAX_CHATS   16
+#define MAX_MSGS    64
+
+static struct {
+    pthread_mutex_t lock;
+    int sent[MAX_CHATS];
+    int replies[MAX_CHATS];
+    int waiting_msg[MAX_CHATS];         /* message whose first LLM call is due, -1 none */
+    int64_t push_us[MAX_CHATS];
+    int64_t reply_us[MAX_CHATS][MAX_MSGS];
+    int64_t start_us[MAX_CHATS][MAX_MSGS];
+    int64_t delay_us[MAX_CHATS * MAX_MSGS];
+    int n_delay;
+    int chats;
+} s_q = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static void tag(char *buf, size_t size, int chat, int msg)
+{
+    snprintf(buf, size, "<q%d.%d>", chat, msg);
+}
+
+/* First LLM request of a turn: the message has left the queue */
+static void on_body(const char *body, size_t len, void *ctx)
+{
+    int64_t now = host_now_us();
+    pthread_mutex_lock(&s_q.lock);
+    for (int c = 0; c < s_q.chats; c++) {
+        int m = s_q.waiting_msg[c];
+        if (m < 0) continue;
+        char t[32];
+        tag(t, sizeof(t), c, m);
+        if (!strstr(body, t)) continue;
+        s_q.start_us[c][m] = now;
+        if (c != SLOW_CHAT) s_q.delay_us[s_q.n_delay++] = now - s_q.push_us[c];
+        s_q.waiting_msg[c] = -1;
+        break;
+    }
+    pthread_mutex_unlock(&s_q.lock);
+}
+
+static esp_err_t on_reply(const mimi_msg_t *msg, void *ctx)
+{
+    int chat = atoi(msg->chat_id + 1);
+    pthread_mutex_lock(&s_q.lock);
+    if (chat >= 0 && chat < s_q.chats && s_q.replies[chat] < MAX_MSGS) {
+        s_q.reply_us[chat][s_q.replies[chat]++] = host_now_us();
+    }
+    pthread_mutex_unlock(&s_q.lock);
+    return ESP_OK;
+}
+
+static void push(int chat, const char *extra)
+{
+    pthread_mutex_lock(&s_q.lock);
+    int m = s_q.sent[chat]++;
+    s_q.waiting_msg[chat] = m;
+    s_q.push_us[chat] = host_now_us();
+    pthread_mutex_unlock(&s_q.lock);
+
+    mimi_msg_t msg = {0};
+    strncpy(msg.channel, CHANNEL, sizeof(msg.channel) - 1);
+    snprintf(msg.chat_id, sizeof(msg.chat_id), "c%d", chat);
+    char text[128], t[32];
+    tag(t, sizeof(t), chat, m);
+    snprintf(text, sizeof(text), "message %s%s", t, extra);
+    msg.content = strdup(text);
+    while (message_bus_push_inbound(&msg) == ESP_ERR_NO_MEM) usleep(1000);
+}
+
+int main(int argc, char **argv)
+{
+    int fast = 4, msgs = 15, slow_ms = 400;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--fast-chats") == 0) fast = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--messages") == 0) msgs = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--slow-ms") == 0) slow_ms = atoi(argv[i + 1]);
+    }
+    CHECK(fast > 0 && fast < MAX_CHATS && msgs > 0 && msgs <= MAX_MSGS);
+    s_q.chats = fast + 1;
+    for (int c = 0; c < s_q.chats; c++) s_q.waiting_msg[c] = -1;
+
+    host_spiffs_reset();
+    host_write_file(MIMI_SPIFFS_BASE "/memory/MEMORY.md", "# Memory\n");
+    mock_llm_cfg_t cfg = {
+        .first_token_ms = 5,
+        .slow_ms = slow_ms,
+        .delta_ms = 1,
+        .text_deltas = 8,
+        .on_body = on_body,
+    };
+    mock_llm_t *llm = mock_llm_start(&cfg);
+    CHECK(llm);
+
+    CHECK(message_bus_init() == ESP_OK);
+    CHECK(memory_store_init() == ESP_OK);
+    CHECK(session_mgr_init() == ESP_OK);
+    CHECK(http_proxy_init() == ESP_OK);
+    CHECK(conn_pool_init() == ESP_OK);
+    CHECK(llm_proxy_init() == ESP_OK);
+    CHECK(llm_set_api_key("sk-bench") == ESP_OK);
+    CHECK(tool_registry_init() == ESP_OK);
+    CHECK(agent_loop_init() == ESP_OK);
+    mimi_outbound_opts_t opts = { .queue_len = MAX_CHATS };
+    CHECK(message_bus_subscribe_outbound(CHANNEL, on_reply, &opts) == ESP_OK);
+    CHECK(agent_loop_start() == ESP_OK);
+
+    /* The slow chat's second message queues behind its own running turn */
+    push(SLOW_CHAT, " [slow] [read_file]");
+    usleep(20 * 1000);
+    uint32_t rnd = 12345;
+    int64_t next_send[MAX_CHATS] = {0};
+    for (int c = 1; c < s_q.chats; c++) push(c, "");
+    usleep(20 * 1000);
+    push(SLOW_CHAT, " [slow]");
+
+    int64_t deadline = host_now_us() + 120 * 1000000LL;
+    while (host_now_us() < deadline) {
+        bool done = true;
+        pthread_mutex_lock(&s_q.lock);
+        int slow_replies = s_q.replies[SLOW_CHAT];
+        int ready[MAX_CHATS] = {0};
+        for (int c = 1; c < s_q.chats; c++) {
+            if (s_q.replies[c] < msgs) done = false;
+            ready[c] = s_q.replies[c] == s_q.sent[c] && s_q.sent[c] < msgs;
+        }
+        pthread_mutex_unlock(&s_q.lock);
+        if (done && slow_replies >= 2) break;
+
+        int64_t now = host_now_us();
+        for (int c = 1; c < s_q.chats; c++) {
+            if (!ready[c]) continue;
+            if (!next_send[c]) {
+                rnd = rnd * 1103515245u + 12345u;
+                next_send[c] = now + 10000 + (rnd >> 16) % 30000;   /* think 10-40 ms */
+            } else if (now >= next_send[c]) {
+                next_send[c] = 0;
+                push(c, "");
+            }
+        }
+        usleep(1000);
+    }
+
+    pthread_mutex_lock(&s_q.lock);
+    int n = s_q.n_delay;
+    int64_t p50 = host_percentile(s_q.delay_us, n, 50);
+    int64_t p99 = host_percentile(s_q.delay_us, n, 99);
+    int64_t slow_turn = s_q.reply_us[SLOW_CHAT][0] - s_q.push_us[SLOW_CHAT];
+    bool ordered = s_q.start_us[SLOW_CHAT][1] >= s_q.reply_us[SLOW_CHAT][0];
+    int slow_replies = s_q.replies[SLOW_CHAT];
+    pthread_mutex_unlock(&s_q.lock);
+
+    message_bus_stats_t bs;
+    message_bus_get_stats(&bs);
+    printf("bench_queue_delay: %d workers, 1 slow chat (%d ms per LLM call), "
+           "%d fast chats x %d messages\n", MIMI_AGENT_WORKERS, slow_ms, fast, msgs);
+    printf("  fast queueing delay: p50 %.2f ms  p99 %.2f ms  (%d samples)\n",
+           p50 / 1000.0, p99 / 1000.0, n);
+    printf("  bus: peak depth %d, wait avg %u ms max %u ms, %u coalesced\n",
+           bs.in_peak, (unsigned)bs.in_wait_avg_ms, (unsigned)bs.in_wait_max_ms,
+           (unsigned)bs.in_coalesced);
+    printf("  slow chat: first turn %.0f ms, %d replies, second turn started after the "
+           "first reply: %s\n", slow_turn / 1000.0, slow_replies, ordered ? "yes" : "no");
+
+    CHECK_EQ_INT(slow_replies, 2);
+    CHECK(ordered);
+    CHECK_EQ_INT(n, fast * msgs);
+    /* Nobody waited out a slow LLM call */
+    CHECK(p99 < (int64_t)slow_ms * 1000 / 2);
+    return 0;
+}
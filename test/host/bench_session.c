@@ -0,0 +1,161 @@
+/* Session history load over synthetic 1k / 10k / 100k-line logs.
+ *
+ * Every load is a cache miss: each log is hard-linked under more chat ids
+ * than the history cache has slots, and the ids are visited round-robin.
+ * A front-to-back line scan of the same file is timed as the baseline the
+ * tail reader replaced. The tail load must not grow with the file size.
+ * The last part appends past MIMI_SESSION_COMPACT_BYTES and waits for the
+ * background compaction to archive the head of the log. */
+
+#include "host_test.h"
+
+#include "mimi_config.h"
+#include "memory/session_mgr.h"
+
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define ALIASES     (MIMI_SESSION_CACHE_SLOTS * 2)
+#define LOADS       200
+
+static void session_file(const char *chat_id, const char *ext, char *buf, size_t size)
+{
+    snprintf(buf, size, "%s/tg_%s%s", MIMI_SPIFFS_SESSION_DIR, chat_id, ext);
+}
+
+static void write_log(const char *path, int lines)
+{
+    FILE *f = fopen(path, "w");
+    CHECK(f);
+    for (int i = 0; i < lines; i++) {
+        fprintf(f, "{\"role\":\"%s\",\"content\":\"message %d: the quick brown fox jumps "
+                   "over the lazy dog\",\"ts\":%d}\n",
+                i % 2 ? "assistant" : "user", i, 1760000000 + i);
+    }
+    fclose(f);
+}
+
+/* What loading cost before tail reads: every line is read to find the end */
+static void scan_all(const char *path)
+{
+    static char ring[MIMI_SESSION_MAX_MSGS][2048];
+    char line[2048];
+    int n = 0;
+    FILE *f = fopen(path, "r");
+    CHECK(f);
+    while (fgets(line, sizeof(line), f)) {
+        strcpy(ring[n++ % MIMI_SESSION_MAX_MSGS], line);
+    }
+    fclose(f);
+    CHECK(n > 0 && ring[(n - 1) % MIMI_SESSION_MAX_MSGS][0] == '{');
+}
+
+static void check_history(const char *chat_id, int lines)
+{
+    static char buf[16 * 1024];
+    CHECK(session_get_history_json(chat_id, buf, sizeof(buf), MIMI_SESSION_MAX_MSGS) == ESP_OK);
+    cJSON *arr = cJSON_Parse(buf);
+    CHECK(arr);
+    int count = cJSON_GetArraySize(arr);
+    CHECK_EQ_INT(count, lines < MIMI_SESSION_MAX_MSGS ? lines : MIMI_SESSION_MAX_MSGS);
+    for (int i = 0; i < count; i++) {
+        char expect[32];
+        snprintf(expect, sizeof(expect), "message %d:", lines - count + i);
+        const char *content = cJSON_GetObjectItem(cJSON_GetArrayItem(arr, i), "content")->valuestring;
+        CHECK(strncmp(content, expect, strlen(expect)) == 0);
+    }
+    cJSON_Delete(arr);
+}
+
+static int64_t bench_size(int lines)
+{
+    char base[32], path[128];
+    snprintf(base, sizeof(base), "bench%d_0", lines);
+    session_file(base, ".jsonl", path, sizeof(path));
+    write_log(path, lines);
+    for (int k = 1; k < ALIASES; k++) {
+        char id[32], alias[128];
+        snprintf(id, sizeof(id), "bench%d_%d", lines, k);
+        session_file(id, ".jsonl", alias, sizeof(alias));
+        CHECK(link(path, alias) == 0);
+    }
+    struct stat st;
+    CHECK(stat(path, &st) == 0);
+
+    static char buf[16 * 1024];
+    int64_t tail[LOADS], scan[LOADS];
+    session_cache_stats_t c0, c1;
+    session_cache_get_stats(&c0);
+    for (int i = 0; i < LOADS; i++) {
+        char id[32];
+        snprintf(id, sizeof(id), "bench%d_%d", lines, i % ALIASES);
+        int64_t t0 = host_now_us();
+        CHECK(session_get_history_json(id, buf, sizeof(buf), MIMI_SESSION_MAX_MSGS) == ESP_OK);
+        tail[i] = host_now_us() - t0;
+    }
+    session_cache_get_stats(&c1);
+    CHECK_EQ_INT(c1.misses - c0.misses, LOADS);     /* no load came from the cache */
+
+    int scans = lines >= 100000 ? 10 : 50;
+    for (int i = 0; i < scans; i++) {
+        int64_t t0 = host_now_us();
+        scan_all(path);
+        scan[i] = host_now_us() - t0;
+    }
+    check_history(base, lines);
+
+    int64_t p50 = host_percentile(tail, LOADS, 50);
+    printf("  %6d lines %9ld bytes   tail load p50 %6.3f ms p99 %6.3f ms   full scan p50 %8.3f ms\n",
+           lines, (long)st.st_size, p50 / 1000.0, host_percentile(tail, LOADS, 99) / 1000.0,
+           host_percentile(scan, scans, 50) / 1000.0);
+    return p50;
+}
+
+static void test_compaction(void)
+{
+    const char *chat = "compact";
+    char path[128], arc[128];
+    session_file(chat, ".jsonl", path, sizeof(path));
+    session_file(chat, ".arc", arc, sizeof(arc));
+
+    char content[200];
+    int appended = 0;
+    struct stat st = {0};
+    while (stat(path, &st) != 0 || st.st_size < MIMI_SESSION_COMPACT_BYTES + 4096) {
+        snprintf(content, sizeof(content), "message %d: %s", appended,
+                 "padding padding padding padding padding padding padding padding padding");
+        CHECK(session_append(chat, appended % 2 ? "assistant" : "user", content) == ESP_OK);
+        appended++;
+        if (stat(arc, &st) == 0) break;     /* compaction already ran */
+    }
+
+    int64_t deadline = host_now_us() + 5 * 1000000;
+    while (stat(arc, &st) != 0 && host_now_us() < deadline) usleep(1000);
+    CHECK(stat(arc, &st) == 0);
+    /* Wait until the rewrite is done, then the log holds only the tail */
+    while (host_now_us() < deadline) {
+        if (stat(path, &st) == 0 && st.st_size < MIMI_SESSION_COMPACT_BYTES) break;
+        usleep(1000);
+    }
+    CHECK(stat(path, &st) == 0 && st.st_size < MIMI_SESSION_COMPACT_BYTES);
+    check_history(chat, appended);
+    printf("  compaction: %d appends, log %ld bytes after archiving\n", appended, (long)st.st_size);
+}
+
+int main(void)
+{
+    host_spiffs_reset();
+    CHECK(session_mgr_init() == ESP_OK);
+
+    printf("bench_session: %d cold loads of the last %d records\n", LOADS, MIMI_SESSION_MAX_MSGS);
+    int64_t small = bench_size(1000);
+    bench_size(10000);
+    int64_t large = bench_size(100000);
+
+    /* O(tail): 100x the file may not cost more than a few times the load */
+    CHECK(large <= small * 4 + 200);
+
+    test_compaction();
+    return 0;
+}
@@ -0,0 +1,45 @@
+#include "host_test.h"
+#include "mimi_config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+void host_spiffs_reset(void)
+{
+    CHECK(system("rm -rf " MIMI_SPIFFS_BASE) == 0);
+    CHECK(mkdir(MIMI_SPIFFS_BASE, 0775) == 0);
+    CHECK(mkdir(MIMI_SPIFFS_CONFIG_DIR, 0775) == 0);
+    CHECK(mkdir(MIMI_SPIFFS_MEMORY_DIR, 0775) == 0);
+    CHECK(mkdir(MIMI_SPIFFS_SESSION_DIR, 0775) == 0);
+}
+
+static int cmp_i64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+int64_t host_percentile(int64_t *samples, int n, int p)
+{
+    if (n <= 0) return 0;
+    qsort(samples, (size_t)n, sizeof(*samples), cmp_i64);
+    int idx = (int)(((int64_t)p * (n - 1) + 50) / 100);
+    return samples[idx];
+}
+
+void host_write_file(const char *path, const char *text)
+{
+    FILE *f = fopen(path, "w");
+    CHECK(f != NULL);
+    CHECK(fputs(text, f) >= 0);
+    CHECK(fclose(f) == 0);
+}
+
+void host_url_host(const char *url, char *host, size_t size)
+{
+    const char *p = strstr(url, "://");
+    p = p ? p + 3 : url;
+    size_t n = strcspn(p, ":/");
+    snprintf(host, size, "%.*s", (int)n, p);
+}
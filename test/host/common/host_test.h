@@ -0,0 +1,43 @@
+#pragma once
+
+/* Helpers shared by the host tests and benchmarks */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define CHECK(cond) do {                                                    \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(1);                                                        \
+        }                                                                   \
+    } while (0)
+
+#define CHECK_EQ_INT(a, b) do {                                             \
+        long long a_ = (long long)(a), b_ = (long long)(b);                 \
+        if (a_ != b_) {                                                     \
+            fprintf(stderr, "%s:%d: %s == %lld, expected %lld\n",           \
+                    __FILE__, __LINE__, #a, a_, b_);                        \
+            exit(1);                                                        \
+        }                                                                   \
+    } while (0)
+
+static inline int64_t host_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/** Fresh SPIFFS tree (config, memory, sessions) under the working directory. */
+void host_spiffs_reset(void);
+
+/** Sort samples in place and return the p-th percentile (0..100). */
+int64_t host_percentile(int64_t *samples, int n, int p);
+
+/** Write a whole file, creating it; aborts the test on failure. */
+void host_write_file(const char *path, const char *text);
+
+/** Host part of a URL such as MIMI_LLM_API_URL. */
+void host_url_host(const char *url, char *host, size_t size);
@@ -0,0 +1,284 @@
+#include "mock_http.h"
+#include "shim_alloc.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define CONN_MAX        64
+#define HEAD_MAX        (16 * 1024)
+
+struct mock_http {
+    int listen_fd;
+    int port;
+    mock_http_handler_t handler;
+    void *ctx;
+    pthread_t accept_thread;
+    atomic_int requests;
+    atomic_bool stopping;
+    pthread_mutex_t lock;
+    int conn_fds[CONN_MAX];
+};
+
+struct mock_http_conn {
+    mock_http_t *srv;
+    int fd;
+    bool close_after;
+    char buf[HEAD_MAX];
+    size_t len;             /* bytes buffered past the last request */
+};
+
+static bool send_all(int fd, const void *data, size_t len)
+{
+    const char *p = data;
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static void conn_track(mock_http_t *srv, int fd, bool add)
+{
+    pthread_mutex_lock(&srv->lock);
+    for (int i = 0; i < CONN_MAX; i++) {
+        if (add && srv->conn_fds[i] < 0) {
+            srv->conn_fds[i] = fd;
+            break;
+        }
+        if (!add && srv->conn_fds[i] == fd) {
+            srv->conn_fds[i] = -1;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&srv->lock);
+}
+
+/* Read one request; false on close or a malformed request */
+static bool read_request(mock_http_conn_t *c, mock_http_req_t *req)
+{
+    char *end;
+    while (!(end = memmem(c->buf, c->len, "\r\n\r\n", 4))) {
+        if (c->len == sizeof(c->buf)) return false;
+        ssize_t n = recv(c->fd, c->buf + c->len, sizeof(c->buf) - c->len, 0);
+        if (n <= 0) return false;
+        c->len += (size_t)n;
+    }
+    size_t head_len = (size_t)(end - c->buf) + 4;
+
+    memset(req, 0, sizeof(*req));
+    char *line_end = memmem(c->buf, head_len, "\r\n", 2);
+    *line_end = '\0';
+    if (sscanf(c->buf, "%15s %1023s", req->method, req->path) != 2) return false;
+    size_t hdr_len = head_len - (size_t)(line_end + 2 - c->buf);
+    req->headers = malloc(hdr_len + 1);
+    memcpy(req->headers, line_end + 2, hdr_len);
+    req->headers[hdr_len] = '\0';
+
+    char value[32];
+    size_t body_len = 0;
+    if (mock_http_header(req, "Content-Length", value, sizeof(value))) body_len = strtoul(value, NULL, 10);
+    req->body = malloc(body_len + 1);
+    req->body_len = body_len;
+
+    size_t have = c->len - head_len;
+    size_t take = have < body_len ? have : body_len;
+    memcpy(req->body, c->buf + head_len, take);
+    memmove(c->buf, c->buf + head_len + take, have - take);
+    c->len = have - take;
+    while (take < body_len) {
+        ssize_t n = recv(c->fd, req->body + take, body_len - take, 0);
+        if (n <= 0) {
+            free(req->headers);
+            free(req->body);
+            return false;
+        }
+        take += (size_t)n;
+    }
+    req->body[body_len] = '\0';
+    return true;
+}
+
+static void *conn_thread(void *arg)
+{
+    mock_http_conn_t *c = arg;
+    mock_http_t *srv = c->srv;
+    mock_http_req_t req;
+    shim_alloc_untrack_thread();     /* only firmware allocations are measured */
+    while (!c->close_after && !atomic_load(&srv->stopping) && read_request(c, &req)) {
+        atomic_fetch_add(&srv->requests, 1);
+        srv->handler(c, &req, srv->ctx);
+        free(req.headers);
+        free(req.body);
+    }
+    conn_track(srv, c->fd, false);
+    close(c->fd);
+    free(c);
+    return NULL;
+}
+
+static void *accept_thread(void *arg)
+{
+    mock_http_t *srv = arg;
+    shim_alloc_untrack_thread();
+    while (!atomic_load(&srv->stopping)) {
+        int fd = accept(srv->listen_fd, NULL, NULL);
+        if (fd < 0) break;
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        mock_http_conn_t *c = calloc(1, sizeof(*c));
+        c->srv = srv;
+        c->fd = fd;
+        conn_track(srv, fd, true);
+        pthread_t t;
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        if (pthread_create(&t, &attr, conn_thread, c) != 0) {
+            conn_track(srv, fd, false);
+            close(fd);
+            free(c);
+        }
+        pthread_attr_destroy(&attr);
+    }
+    return NULL;
+}
+
+mock_http_t *mock_http_start(mock_http_handler_t handler, void *ctx)
+{
+    mock_http_t *srv = calloc(1, sizeof(*srv));
+    srv->handler = handler;
+    srv->ctx = ctx;
+    pthread_mutex_init(&srv->lock, NULL);
+    for (int i = 0; i < CONN_MAX; i++) srv->conn_fds[i] = -1;
+
+    srv->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(srv->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t alen = sizeof(addr);
+    if (bind(srv->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(srv->listen_fd, 64) != 0 ||
+        getsockname(srv->listen_fd, (struct sockaddr *)&addr, &alen) != 0) {
+        close(srv->listen_fd);
+        free(srv);
+        return NULL;
+    }
+    srv->port = ntohs(addr.sin_port);
+    pthread_create(&srv->accept_thread, NULL, accept_thread, srv);
+    return srv;
+}
+
+int mock_http_port(const mock_http_t *srv)
+{
+    return srv->port;
+}
+
+int mock_http_requests(const mock_http_t *srv)
+{
+    return atomic_load(&((mock_http_t *)srv)->requests);
+}
+
+void mock_http_stop(mock_http_t *srv)
+{
+    atomic_store(&srv->stopping, true);
+    shutdown(srv->listen_fd, SHUT_RDWR);
+    close(srv->listen_fd);
+    pthread_join(srv->accept_thread, NULL);
+    pthread_mutex_lock(&srv->lock);
+    for (int i = 0; i < CONN_MAX; i++) {
+        if (srv->conn_fds[i] >= 0) shutdown(srv->conn_fds[i], SHUT_RDWR);
+    }
+    pthread_mutex_unlock(&srv->lock);
+    /* Connection threads still reference srv; it is left allocated */
+}
+
+bool mock_http_header(const mock_http_req_t *req, const char *name, char *out, size_t out_size)
+{
+    size_t nlen = strlen(name);
+    for (const char *p = req->headers; p && *p; ) {
+        const char *eol = strstr(p, "\r\n");
+        if (!eol) break;
+        if ((size_t)(eol - p) > nlen && strncasecmp(p, name, nlen) == 0 && p[nlen] == ':') {
+            const char *v = p + nlen + 1;
+            while (*v == ' ') v++;
+            snprintf(out, out_size, "%.*s", (int)(eol - v), v);
+            return true;
+        }
+        p = eol + 2;
+    }
+    return false;
+}
+
+static const char *reason(int status)
+{
+    switch (status) {
+    case 200: return "OK";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 429: return "Too Many Requests";
+    case 500: return "Internal Server Error";
+    default: return "Status";
+    }
+}
+
+void mock_http_reply(mock_http_conn_t *conn, int status, const char *content_type,
+                     const char *body, size_t len)
+{
+    char head[512];
+    int n = snprintf(head, sizeof(head),
+                     "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n%s\r\n",
+                     status, reason(status), content_type ? content_type : "text/plain", len,
+                     conn->close_after ? "Connection: close\r\n" : "");
+    send_all(conn->fd, head, (size_t)n);
+    if (len) send_all(conn->fd, body, len);
+}
+
+void mock_http_chunked_begin(mock_http_conn_t *conn, int status, const char *content_type)
+{
+    char head[512];
+    int n = snprintf(head, sizeof(head),
+                     "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nTransfer-Encoding: chunked\r\n%s\r\n",
+                     status, reason(status), content_type ? content_type : "text/plain",
+                     conn->close_after ? "Connection: close\r\n" : "");
+    send_all(conn->fd, head, (size_t)n);
+}
+
+bool mock_http_chunk(mock_http_conn_t *conn, const char *data, size_t len)
+{
+    if (!len) return true;
+    char size[32];
+    int n = snprintf(size, sizeof(size), "%zx\r\n", len);
+    return send_all(conn->fd, size, (size_t)n) &&
+           send_all(conn->fd, data, len) &&
+           send_all(conn->fd, "\r\n", 2);
+}
+
+void mock_http_chunked_end(mock_http_conn_t *conn)
+{
+    send_all(conn->fd, "0\r\n\r\n", 5);
+}
+
+size_t mock_http_pending(mock_http_conn_t *conn)
+{
+    int unread = 0;
+    if (ioctl(conn->fd, FIONREAD, &unread) != 0) unread = 0;
+    return conn->len + (size_t)unread;
+}
+
+void mock_http_close(mock_http_conn_t *conn)
+{
+    conn->close_after = true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+/* Local HTTP/1.1 server for host tests. Each accepted connection gets its
+ * own thread and is kept alive across requests; the handler answers every
+ * request with exactly one response (or closes the connection). */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct mock_http mock_http_t;
+typedef struct mock_http_conn mock_http_conn_t;
+
+typedef struct {
+    char method[16];
+    char path[1024];
+    char *headers;          /* raw "Name: value\r\n" lines */
+    char *body;             /* NUL-terminated, body_len bytes */
+    size_t body_len;
+} mock_http_req_t;
+
+typedef void (*mock_http_handler_t)(mock_http_conn_t *conn, const mock_http_req_t *req, void *ctx);
+
+/** Listen on 127.0.0.1 with an ephemeral port. */
+mock_http_t *mock_http_start(mock_http_handler_t handler, void *ctx);
+int mock_http_port(const mock_http_t *srv);
+/** Requests handled so far. */
+int mock_http_requests(const mock_http_t *srv);
+/** Stop accepting; live connections are shut down. */
+void mock_http_stop(mock_http_t *srv);
+
+/** Value of a request header (copied into out), false if absent. */
+bool mock_http_header(const mock_http_req_t *req, const char *name, char *out, size_t out_size);
+
+/** Complete response with Content-Length. */
+void mock_http_reply(mock_http_conn_t *conn, int status, const char *content_type,
+                     const char *body, size_t len);
+
+/** Chunked response: begin, any number of chunks, end. A chunk returns
+ *  false once the client has gone away. */
+void mock_http_chunked_begin(mock_http_conn_t *conn, int status, const char *content_type);
+bool mock_http_chunk(mock_http_conn_t *conn, const char *data, size_t len);
+void mock_http_chunked_end(mock_http_conn_t *conn);
+
+/** Bytes of later requests already sent on this connection: non-zero while
+ *  a request is handled means the client pipelined. */
+size_t mock_http_pending(mock_http_conn_t *conn);
+
+/** Close the connection after the current response. */
+void mock_http_close(mock_http_conn_t *conn);
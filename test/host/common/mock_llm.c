@@ -0,0 +1,201 @@
+#include "mock_llm.h"
+#include "host_test.h"
+#include "mock_http.h"
+#include "shim_net.h"
+#include "mimi_config.h"
+#include "cJSON.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+struct mock_llm {
+    mock_llm_cfg_t cfg;
+    mock_http_t *http;
+    atomic_int calls;
+    atomic_int tool_ids;
+};
+
+static void sleep_ms(int ms)
+{
+    if (ms > 0) usleep((useconds_t)ms * 1000);
+}
+
+static void send_event(mock_http_conn_t *c, const char *type, cJSON *data)
+{
+    cJSON_AddStringToObject(data, "type", type);
+    char *json = cJSON_PrintUnformatted(data);
+    cJSON_Delete(data);
+    char head[64];
+    int n = snprintf(head, sizeof(head), "event: %s\ndata: ", type);
+    /* One chunk per event, as a real server flushes them */
+    size_t len = (size_t)n + strlen(json) + 2;
+    char *frame = malloc(len + 1);
+    snprintf(frame, len + 1, "%s%s\n\n", head, json);
+    mock_http_chunk(c, frame, len);
+    free(frame);
+    free(json);
+}
+
+static void send_block_start(mock_http_conn_t *c, int index, cJSON *block)
+{
+    cJSON *ev = cJSON_CreateObject();
+    cJSON_AddNumberToObject(ev, "index", index);
+    cJSON_AddItemToObject(ev, "content_block", block);
+    send_event(c, "content_block_start", ev);
+}
+
+static void send_delta(mock_http_conn_t *c, int index, const char *dtype,
+                       const char *key, const char *value)
+{
+    cJSON *ev = cJSON_CreateObject();
+    cJSON_AddNumberToObject(ev, "index", index);
+    cJSON *d = cJSON_AddObjectToObject(ev, "delta");
+    cJSON_AddStringToObject(d, "type", dtype);
+    cJSON_AddStringToObject(d, key, value);
+    send_event(c, "content_block_delta", ev);
+}
+
+static void send_block_stop(mock_http_conn_t *c, int index)
+{
+    cJSON *ev = cJSON_CreateObject();
+    cJSON_AddNumberToObject(ev, "index", index);
+    send_event(c, "content_block_stop", ev);
+}
+
+static void send_tool_use(mock_llm_t *m, mock_http_conn_t *c, int index,
+                          const char *name, const char *input_json)
+{
+    char id[32];
+    snprintf(id, sizeof(id), "toolu_%06d", atomic_fetch_add(&m->tool_ids, 1));
+    cJSON *block = cJSON_CreateObject();
+    cJSON_AddStringToObject(block, "type", "tool_use");
+    cJSON_AddStringToObject(block, "id", id);
+    cJSON_AddStringToObject(block, "name", name);
+    cJSON_AddObjectToObject(block, "input");
+    send_block_start(c, index, block);
+
+    /* Split the input in two, like the API's partial_json fragments */
+    size_t len = strlen(input_json);
+    char part[512];
+    snprintf(part, sizeof(part), "%.*s", (int)(len / 2), input_json);
+    send_delta(c, index, "input_json_delta", "partial_json", part);
+    send_delta(c, index, "input_json_delta", "partial_json", input_json + len / 2);
+    send_block_stop(c, index);
+}
+
+/* Text of the newest message, and whether it carries tool results */
+static void newest_message(cJSON *req, char *text, size_t text_size, bool *tool_result)
+{
+    text[0] = '\0';
+    *tool_result = false;
+    cJSON *msgs = cJSON_GetObjectItem(req, "messages");
+    cJSON *last = cJSON_GetArrayItem(msgs, cJSON_GetArraySize(msgs) - 1);
+    cJSON *content = cJSON_GetObjectItem(last, "content");
+    if (cJSON_IsString(content)) {
+        snprintf(text, text_size, "%s", content->valuestring);
+        return;
+    }
+    cJSON *block;
+    cJSON_ArrayForEach(block, content) {
+        const char *type = cJSON_GetStringValue(cJSON_GetObjectItem(block, "type"));
+        if (type && strcmp(type, "tool_result") == 0) *tool_result = true;
+        const char *t = cJSON_GetStringValue(cJSON_GetObjectItem(block, "text"));
+        if (t && !text[0]) snprintf(text, text_size, "%s", t);
+    }
+}
+
+static void handle(mock_http_conn_t *c, const mock_http_req_t *req, void *ctx)
+{
+    mock_llm_t *m = ctx;
+    atomic_fetch_add(&m->calls, 1);
+    if (m->cfg.on_body) m->cfg.on_body(req->body, req->body_len, m->cfg.ctx);
+
+    cJSON *root = cJSON_Parse(req->body);
+    if (!root) {
+        const char *err = "{\"type\":\"error\",\"error\":{\"type\":\"invalid_request_error\","
+                          "\"message\":\"body is not JSON\"}}";
+        mock_http_reply(c, 400, "application/json", err, strlen(err));
+        return;
+    }
+    char text[512];
+    bool tool_result;
+    newest_message(root, text, sizeof(text), &tool_result);
+    cJSON_Delete(root);
+
+    bool slow = m->cfg.slow_ms && strstr(req->body, "[slow]");
+    mock_http_chunked_begin(c, 200, "text/event-stream");
+    sleep_ms(slow ? m->cfg.slow_ms : m->cfg.first_token_ms);
+
+    cJSON *msg = cJSON_CreateObject();
+    cJSON *message = cJSON_AddObjectToObject(msg, "message");
+    cJSON_AddStringToObject(message, "id", "msg_mock");
+    cJSON_AddStringToObject(message, "role", "assistant");
+    cJSON *usage = cJSON_AddObjectToObject(message, "usage");
+    cJSON_AddNumberToObject(usage, "input_tokens", (double)req->body_len / 4);
+    cJSON_AddNumberToObject(usage, "output_tokens", 1);
+    send_event(c, "message_start", msg);
+
+    bool want_read = !tool_result && strstr(text, "[read_file]");
+    bool want_search = !tool_result && strstr(text, "[web_search]");
+    int index = 0;
+    if (want_read) {
+        send_tool_use(m, c, index++, "read_file",
+                      "{\"path\":\"" MIMI_SPIFFS_BASE "/memory/MEMORY.md\"}");
+    }
+    if (want_search) {
+        send_tool_use(m, c, index++, "web_search", "{\"query\":\"esp32 psram stacks\"}");
+    }
+    if (!index) {
+        cJSON *block = cJSON_CreateObject();
+        cJSON_AddStringToObject(block, "type", "text");
+        cJSON_AddStringToObject(block, "text", "");
+        send_block_start(c, 0, block);
+        int deltas = m->cfg.text_deltas > 0 ? m->cfg.text_deltas : 8;
+        for (int i = 0; i < deltas; i++) {
+            char piece[64];
+            snprintf(piece, sizeof(piece), "%s%d ", i == 0 ? (tool_result ? "Done: " : "Reply ") : "w",
+                     i);
+            send_delta(c, 0, "text_delta", "text", piece);
+            if (i + 1 < deltas) sleep_ms(m->cfg.delta_ms);
+        }
+        send_block_stop(c, 0);
+    }
+
+    cJSON *md = cJSON_CreateObject();
+    cJSON *delta = cJSON_AddObjectToObject(md, "delta");
+    cJSON_AddStringToObject(delta, "stop_reason", index ? "tool_use" : "end_turn");
+    cJSON *out_usage = cJSON_AddObjectToObject(md, "usage");
+    cJSON_AddNumberToObject(out_usage, "output_tokens", 16);
+    send_event(c, "message_delta", md);
+    send_event(c, "message_stop", cJSON_CreateObject());
+    mock_http_chunked_end(c);
+}
+
+mock_llm_t *mock_llm_start(const mock_llm_cfg_t *cfg)
+{
+    mock_llm_t *m = calloc(1, sizeof(*m));
+    if (cfg) m->cfg = *cfg;
+    m->http = mock_http_start(handle, m);
+    if (!m->http) {
+        free(m);
+        return NULL;
+    }
+    char host[128];
+    host_url_host(MIMI_LLM_API_URL, host, sizeof(host));
+    shim_net_route(host, 0, mock_http_port(m->http));
+    return m;
+}
+
+void mock_llm_stop(mock_llm_t *m)
+{
+    mock_http_stop(m->http);
+}
+
+int mock_llm_calls(const mock_llm_t *m)
+{
+    return atomic_load(&((mock_llm_t *)m)->calls);
+}
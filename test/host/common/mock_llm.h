@@ -0,0 +1,34 @@
+#pragma once
+
+/* Mock Anthropic Messages endpoint for host tests. It answers every
+ * streaming request with SSE and is routed in for the host of
+ * MIMI_LLM_API_URL.
+ *
+ * Replies are scripted by the newest message of the request:
+ * - a user turn whose text contains "[read_file]" and/or "[web_search]"
+ *   gets one tool_use block per marker (stop_reason "tool_use");
+ * - anything else, including tool results, gets a text reply of
+ *   text_deltas deltas (stop_reason "end_turn").
+ * A conversation that mentions "[slow]" waits slow_ms before every reply. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef void (*mock_llm_body_cb_t)(const char *body, size_t len, void *ctx);
+
+typedef struct {
+    int first_token_ms;         /* delay before the first event */
+    int slow_ms;                /* instead, for requests that mention "[slow]" */
+    int delta_ms;               /* delay between text deltas */
+    int text_deltas;            /* deltas per text reply, default 8 */
+    mock_llm_body_cb_t on_body; /* sees every request body, or NULL */
+    void *ctx;
+} mock_llm_cfg_t;
+
+typedef struct mock_llm mock_llm_t;
+
+mock_llm_t *mock_llm_start(const mock_llm_cfg_t *cfg);
+void mock_llm_stop(mock_llm_t *m);
+
+/** Requests answered so far. */
+int mock_llm_calls(const mock_llm_t *m);
@@ -0,0 +1,43 @@
+#pragma once
+
+/* Host shim: esp_tls over plain TCP. Hosts are resolved through the route
+ * table in shim_net.h, so tests talk to local mock servers; TLS itself is
+ * not exercised. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include "esp_err.h"
+
+#define ESP_TLS_ERR_SSL_WANT_READ   -0x6900
+#define ESP_TLS_ERR_SSL_WANT_WRITE  -0x6880
+
+typedef enum {
+    ESP_TLS_INIT = 0,
+    ESP_TLS_CONNECTING,
+    ESP_TLS_HANDSHAKE,
+    ESP_TLS_FAIL,
+    ESP_TLS_DONE,
+} esp_tls_conn_state_t;
+
+typedef struct esp_tls esp_tls_t;
+typedef struct esp_tls_client_session esp_tls_client_session_t;
+
+typedef struct {
+    esp_err_t (*crt_bundle_attach)(void *conf);
+    int timeout_ms;
+    bool skip_common_name;
+    const char *common_name;
+    esp_tls_client_session_t *client_session;
+} esp_tls_cfg_t;
+
+esp_tls_t *esp_tls_init(void);
+int esp_tls_conn_new_sync(const char *hostname, int hostlen, int port,
+                          const esp_tls_cfg_t *cfg, esp_tls_t *tls);
+ssize_t esp_tls_conn_read(esp_tls_t *tls, void *data, size_t datalen);
+ssize_t esp_tls_conn_write(esp_tls_t *tls, const void *data, size_t datalen);
+int esp_tls_conn_destroy(esp_tls_t *tls);
+ssize_t esp_tls_get_bytes_avail(esp_tls_t *tls);
+esp_err_t esp_tls_get_conn_sockfd(esp_tls_t *tls, int *sockfd);
+esp_err_t esp_tls_set_conn_sockfd(esp_tls_t *tls, int sockfd);
+esp_err_t esp_tls_set_conn_state(esp_tls_t *tls, esp_tls_conn_state_t state);
@@ -0,0 +1,48 @@
+#pragma once
+
+/* Host shim: FreeRTOS on POSIX threads. One tick is one millisecond;
+ * priorities and core affinity are accepted and ignored. */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint32_t StackType_t;
+
+#define pdFALSE             0
+#define pdTRUE              1
+#define pdFAIL              0
+#define pdPASS              1
+#define errQUEUE_EMPTY      0
+#define errQUEUE_FULL       0
+
+#define configTICK_RATE_HZ  1000
+#define portTICK_PERIOD_MS  1
+#define portMAX_DELAY       ((TickType_t)0xFFFFFFFFu)
+#define pdMS_TO_TICKS(ms)   ((TickType_t)(ms))
+#define pdTICKS_TO_MS(t)    ((uint32_t)(t))
+#define tskNO_AFFINITY      0x7FFFFFFF
+
+typedef struct {
+    pthread_mutex_t mutex;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED { PTHREAD_MUTEX_INITIALIZER }
+
+void shim_critical_enter(portMUX_TYPE *mux);
+void shim_critical_exit(portMUX_TYPE *mux);
+
+#define portENTER_CRITICAL(mux)         shim_critical_enter(mux)
+#define portEXIT_CRITICAL(mux)          shim_critical_exit(mux)
+#define portENTER_CRITICAL_ISR(mux)     shim_critical_enter(mux)
+#define portEXIT_CRITICAL_ISR(mux)      shim_critical_exit(mux)
+#define taskENTER_CRITICAL(mux)         shim_critical_enter(mux)
+#define taskEXIT_CRITICAL(mux)          shim_critical_exit(mux)
+#define portYIELD_FROM_ISR(x)           ((void)(x))
+
+BaseType_t xPortGetCoreID(void);
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct shim_queue *QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+void vQueueDelete(QueueHandle_t q);
+BaseType_t xQueueGenericSend(QueueHandle_t q, const void *item, TickType_t wait, bool front);
+BaseType_t xQueueReceive(QueueHandle_t q, void *out, TickType_t wait);
+BaseType_t xQueuePeek(QueueHandle_t q, void *out, TickType_t wait);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q);
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t q);
+BaseType_t xQueueReset(QueueHandle_t q);
+
+#define xQueueSend(q, item, wait)           xQueueGenericSend(q, item, wait, false)
+#define xQueueSendToBack(q, item, wait)     xQueueGenericSend(q, item, wait, false)
+#define xQueueSendToFront(q, item, wait)    xQueueGenericSend(q, item, wait, true)
+#define xQueueSendFromISR(q, item, woken)   xQueueGenericSend(q, item, 0, false)
@@ -0,0 +1,44 @@
+#pragma once
+
+/* Host shim: an in-process key/value store, empty at start.
+ * nvs_shim_reset() clears it between test cases. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef uint32_t nvs_handle_t;
+
+typedef enum {
+    NVS_READONLY,
+    NVS_READWRITE,
+} nvs_open_mode_t;
+
+esp_err_t nvs_open(const char *ns, nvs_open_mode_t mode, nvs_handle_t *out);
+void nvs_close(nvs_handle_t h);
+esp_err_t nvs_commit(nvs_handle_t h);
+esp_err_t nvs_erase_key(nvs_handle_t h, const char *key);
+esp_err_t nvs_erase_all(nvs_handle_t h);
+
+esp_err_t nvs_set_str(nvs_handle_t h, const char *key, const char *value);
+esp_err_t nvs_get_str(nvs_handle_t h, const char *key, char *out, size_t *len);
+esp_err_t nvs_set_blob(nvs_handle_t h, const char *key, const void *value, size_t len);
+esp_err_t nvs_get_blob(nvs_handle_t h, const char *key, void *out, size_t *len);
+
+esp_err_t nvs_set_i8(nvs_handle_t h, const char *key, int8_t v);
+esp_err_t nvs_get_i8(nvs_handle_t h, const char *key, int8_t *v);
+esp_err_t nvs_set_u8(nvs_handle_t h, const char *key, uint8_t v);
+esp_err_t nvs_get_u8(nvs_handle_t h, const char *key, uint8_t *v);
+esp_err_t nvs_set_u16(nvs_handle_t h, const char *key, uint16_t v);
+esp_err_t nvs_get_u16(nvs_handle_t h, const char *key, uint16_t *v);
+esp_err_t nvs_set_i32(nvs_handle_t h, const char *key, int32_t v);
+esp_err_t nvs_get_i32(nvs_handle_t h, const char *key, int32_t *v);
+esp_err_t nvs_set_u32(nvs_handle_t h, const char *key, uint32_t v);
+esp_err_t nvs_get_u32(nvs_handle_t h, const char *key, uint32_t *v);
+esp_err_t nvs_set_i64(nvs_handle_t h, const char *key, int64_t v);
+esp_err_t nvs_get_i64(nvs_handle_t h, const char *key, int64_t *v);
+esp_err_t nvs_set_u64(nvs_handle_t h, const char *key, uint64_t v);
+esp_err_t nvs_get_u64(nvs_handle_t h, const char *key, uint64_t *v);
+
+void nvs_shim_reset(void);
@@ -0,0 +1,5 @@
+#pragma once
+
+/* Host shim: no TLS session tickets, no PSRAM-specific options */
+#define CONFIG_SPIFFS_OBJ_NAME_LEN 64
+#define CONFIG_FREERTOS_HZ 1000
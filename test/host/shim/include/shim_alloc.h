@@ -0,0 +1,22 @@
+#pragma once
+
+/* Host shim: process-wide heap accounting. malloc and friends are wrapped,
+ * so every allocation made by firmware code (cJSON included) is counted. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    uint64_t allocs;        /* malloc/calloc/realloc calls that returned memory */
+    uint64_t frees;
+    size_t live_bytes;      /* usable bytes currently allocated */
+    size_t peak_bytes;      /* highest live_bytes since the last reset */
+} shim_alloc_stats_t;
+
+void shim_alloc_get(shim_alloc_stats_t *out);
+
+/** Restart the peak from the current live size. */
+void shim_alloc_reset_peak(void);
+
+/** Leave the calling thread's allocations out of the stats (mock servers). */
+void shim_alloc_untrack_thread(void);
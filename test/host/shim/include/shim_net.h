@@ -0,0 +1,14 @@
+#pragma once
+
+/* Host shim: where esp_tls and esp_http_client connect. Every host the
+ * firmware dials must be routed to a local port first; unrouted hosts fail
+ * to connect, so a test never reaches the real network. */
+
+/** Send connections for host:port (port 0 = any) to 127.0.0.1:local_port. */
+void shim_net_route(const char *host, int port, int local_port);
+
+/** Forget every route. */
+void shim_net_reset(void);
+
+/** Connect a TCP socket to the route for host:port. Returns the fd or -1. */
+int shim_net_connect(const char *host, int port, int timeout_ms);
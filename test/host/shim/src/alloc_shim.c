@@ -0,0 +1,115 @@
+/* malloc interposition for allocation counts and peak heap (glibc) */
+
+#include "shim_alloc.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <malloc.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *p, size_t size);
+extern void *__libc_memalign(size_t align, size_t size);
+extern void __libc_free(void *p);
+
+static _Atomic uint64_t s_allocs;
+static _Atomic uint64_t s_frees;
+static _Atomic size_t s_live;
+static _Atomic size_t s_peak;
+static _Thread_local bool t_untracked;
+
+static void account_add(void *p)
+{
+    if (!p || t_untracked) return;
+    size_t sz = malloc_usable_size(p);
+    atomic_fetch_add_explicit(&s_allocs, 1, memory_order_relaxed);
+    size_t live = atomic_fetch_add_explicit(&s_live, sz, memory_order_relaxed) + sz;
+    size_t peak = atomic_load_explicit(&s_peak, memory_order_relaxed);
+    while (live > peak &&
+           !atomic_compare_exchange_weak_explicit(&s_peak, &peak, live,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+static void account_sub(void *p)
+{
+    if (!p || t_untracked) return;
+    atomic_fetch_add_explicit(&s_frees, 1, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&s_live, malloc_usable_size(p), memory_order_relaxed);
+}
+
+void *malloc(size_t size)
+{
+    void *p = __libc_malloc(size);
+    account_add(p);
+    return p;
+}
+
+void *calloc(size_t n, size_t size)
+{
+    void *p = __libc_calloc(n, size);
+    account_add(p);
+    return p;
+}
+
+void *realloc(void *old, size_t size)
+{
+    size_t old_sz = old ? malloc_usable_size(old) : 0;
+    void *p = __libc_realloc(old, size);
+    if (!p) {
+        if (old && size == 0) account_sub(old);     /* realloc(p, 0) freed it */
+        return NULL;
+    }
+    if (old && !t_untracked) {
+        atomic_fetch_sub_explicit(&s_live, old_sz, memory_order_relaxed);
+    }
+    account_add(p);
+    return p;
+}
+
+void free(void *p)
+{
+    account_sub(p);
+    __libc_free(p);
+}
+
+void *memalign(size_t align, size_t size)
+{
+    void *p = __libc_memalign(align, size);
+    account_add(p);
+    return p;
+}
+
+void *aligned_alloc(size_t align, size_t size)
+{
+    return memalign(align, size);
+}
+
+int posix_memalign(void **out, size_t align, size_t size)
+{
+    void *p = memalign(align, size);
+    if (!p) return ENOMEM;
+    *out = p;
+    return 0;
+}
+
+void shim_alloc_get(shim_alloc_stats_t *out)
+{
+    out->allocs = atomic_load(&s_allocs);
+    out->frees = atomic_load(&s_frees);
+    out->live_bytes = atomic_load(&s_live);
+    out->peak_bytes = atomic_load(&s_peak);
+}
+
+void shim_alloc_reset_peak(void)
+{
+    atomic_store(&s_peak, atomic_load(&s_live));
+}
+
+void shim_alloc_untrack_thread(void)
+{
+    t_untracked = true;
+}
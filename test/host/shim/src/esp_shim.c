@@ -0,0 +1,164 @@
+/* esp_err, esp_log, esp_timer, esp_random, heap and board stubs */
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "shim_alloc.h"
+#include "audio/audio_service.h"
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+/* Nominal capacities so free-size logging stays meaningful */
+#define SHIM_INTERNAL_BYTES (320 * 1024)
+#define SHIM_PSRAM_BYTES    (8 * 1024 * 1024)
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+    case ESP_OK: return "ESP_OK";
+    case ESP_FAIL: return "ESP_FAIL";
+    case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_RESPONSE: return "ESP_ERR_INVALID_RESPONSE";
+    case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+    case ESP_ERR_HTTP_CONNECT: return "ESP_ERR_HTTP_CONNECT";
+    case ESP_ERR_HTTP_WRITE_DATA: return "ESP_ERR_HTTP_WRITE_DATA";
+    case ESP_ERR_HTTP_FETCH_HEADER: return "ESP_ERR_HTTP_FETCH_HEADER";
+    default: return "ERROR";
+    }
+}
+
+/* ── Log ──────────────────────────────────────────────────────── */
+
+static esp_log_level_t s_level = ESP_LOG_WARN;
+static pthread_once_t s_level_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t s_log_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void level_from_env(void)
+{
+    static const char *names[] = { "none", "error", "warn", "info", "debug", "verbose" };
+    const char *env = getenv("MIMI_LOG");
+    if (!env) return;
+    for (int i = 0; i < 6; i++) {
+        if (strcasecmp(env, names[i]) == 0) s_level = (esp_log_level_t)i;
+    }
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    pthread_once(&s_level_once, level_from_env);
+    if (strcmp(tag, "*") == 0) s_level = level;
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    pthread_once(&s_level_once, level_from_env);
+    if (level > s_level) return;
+
+    static const char letters[] = "NEWIDV";
+    va_list ap;
+    va_start(ap, format);
+    pthread_mutex_lock(&s_log_lock);
+    fprintf(stderr, "%c (%lld) %s: ", letters[level], (long long)(esp_timer_get_time() / 1000), tag);
+    vfprintf(stderr, format, ap);
+    fputc('\n', stderr);
+    pthread_mutex_unlock(&s_log_lock);
+    va_end(ap);
+}
+
+/* ── Timer, random, system ────────────────────────────────────── */
+
+int64_t esp_timer_get_time(void)
+{
+    /* Same clock as the tick count, so both agree across tasks */
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+uint32_t esp_random(void)
+{
+    static __thread uint64_t state;
+    if (!state) state = (uint64_t)(uintptr_t)&state ^ (uint64_t)esp_timer_get_time() ^ 0x9E3779B97F4A7C15ULL;
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return (uint32_t)(state >> 16);
+}
+
+void esp_fill_random(void *buf, size_t len)
+{
+    uint8_t *p = buf;
+    while (len > 0) {
+        uint32_t r = esp_random();
+        size_t n = len < sizeof(r) ? len : sizeof(r);
+        memcpy(p, &r, n);
+        p += n;
+        len -= n;
+    }
+}
+
+void esp_restart(void)
+{
+    fprintf(stderr, "esp_restart() called\n");
+    abort();
+}
+
+/* ── Heap ─────────────────────────────────────────────────────── */
+
+static size_t capacity(uint32_t caps)
+{
+    return (caps & MALLOC_CAP_SPIRAM) ? SHIM_PSRAM_BYTES : SHIM_INTERNAL_BYTES;
+}
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+    shim_alloc_stats_t st;
+    shim_alloc_get(&st);
+    size_t cap = capacity(caps);
+    return st.live_bytes < cap ? cap - st.live_bytes : 0;
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps)
+{
+    shim_alloc_stats_t st;
+    shim_alloc_get(&st);
+    size_t cap = capacity(caps);
+    return st.peak_bytes < cap ? cap - st.peak_bytes : 0;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps)
+{
+    return heap_caps_get_free_size(caps);
+}
+
+uint32_t esp_get_free_heap_size(void)
+{
+    return (uint32_t)heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+}
+
+uint32_t esp_get_minimum_free_heap_size(void)
+{
+    return (uint32_t)heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM);
+}
+
+/* ── Board ────────────────────────────────────────────────────── */
+
+esp_err_t audio_service_mount_sd(void)
+{
+    return ESP_ERR_NOT_SUPPORTED;       /* tool cache stays PSRAM-only */
+}
@@ -0,0 +1,466 @@
+/* FreeRTOS task, queue and semaphore API on POSIX threads */
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+struct shim_task {
+    pthread_t thread;
+    char name[16];
+    TaskFunction_t fn;
+    void *arg;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notify;
+};
+
+struct shim_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    uint8_t *items;
+    UBaseType_t len;
+    UBaseType_t size;
+    UBaseType_t head;
+    UBaseType_t count;
+};
+
+typedef enum { SEM_MUTEX, SEM_RECURSIVE, SEM_COUNTING } sem_kind_t;
+
+struct shim_sem {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    sem_kind_t kind;
+    UBaseType_t count;
+    UBaseType_t max;
+    TaskHandle_t owner;
+    UBaseType_t depth;
+};
+
+static __thread struct shim_task *t_self;
+
+/* ── Time ─────────────────────────────────────────────────────── */
+
+static struct timespec deadline_after(TickType_t ticks)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += ticks / 1000;
+    ts.tv_nsec += (long)(ticks % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    return ts;
+}
+
+/* Wait on cond until pred() holds or the wait expires. Caller holds lock. */
+#define WAIT_UNTIL(cond, lock, wait, pred) ({                               \
+        bool ok_ = true;                                                    \
+        if (!(pred)) {                                                      \
+            if ((wait) == 0) {                                              \
+                ok_ = false;                                                \
+            } else if ((wait) == portMAX_DELAY) {                           \
+                while (!(pred)) pthread_cond_wait(cond, lock);              \
+            } else {                                                        \
+                struct timespec dl_ = deadline_after(wait);                 \
+                while (!(pred)) {                                           \
+                    if (pthread_cond_timedwait(cond, lock, &dl_) == ETIMEDOUT) { \
+                        ok_ = (pred);                                       \
+                        break;                                              \
+                    }                                                       \
+                }                                                           \
+            }                                                               \
+        }                                                                   \
+        ok_;                                                                \
+    })
+
+static void cond_init_monotonic(pthread_cond_t *c)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(c, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (TickType_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    struct timespec ts = { ticks / 1000, (long)(ticks % 1000) * 1000000L };
+    if (ticks == 0) {
+        sched_yield();
+        return;
+    }
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+void taskYIELD(void)
+{
+    sched_yield();
+}
+
+void shim_critical_enter(portMUX_TYPE *mux)
+{
+    pthread_mutex_lock(&mux->mutex);
+}
+
+void shim_critical_exit(portMUX_TYPE *mux)
+{
+    pthread_mutex_unlock(&mux->mutex);
+}
+
+BaseType_t xPortGetCoreID(void)
+{
+    return 0;
+}
+
+/* ── Tasks ────────────────────────────────────────────────────── */
+
+static struct shim_task *task_new(const char *name)
+{
+    struct shim_task *t = calloc(1, sizeof(*t));
+    if (!t) return NULL;
+    strncpy(t->name, name ? name : "", sizeof(t->name) - 1);
+    pthread_mutex_init(&t->lock, NULL);
+    cond_init_monotonic(&t->cond);
+    return t;
+}
+
+static void *task_entry(void *p)
+{
+    struct shim_task *t = p;
+    t_self = t;
+    t->fn(t->arg);
+    /* FreeRTOS tasks must not return; treat it like vTaskDelete(NULL) */
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack,
+                                   void *arg, UBaseType_t prio, TaskHandle_t *out,
+                                   BaseType_t core)
+{
+    (void)prio;
+    (void)core;
+    struct shim_task *t = task_new(name);
+    if (!t) return pdFAIL;
+    t->fn = fn;
+    t->arg = arg;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    /* Host frames are larger than Xtensa ones; never go below 256 KB */
+    size_t sz = (size_t)stack * 4;
+    if (sz < 256 * 1024) sz = 256 * 1024;
+    pthread_attr_setstacksize(&attr, sz);
+
+    if (out) *out = t;
+    int rc = pthread_create(&t->thread, &attr, task_entry, t);
+    pthread_attr_destroy(&attr);
+    if (rc != 0) {
+        if (out) *out = NULL;
+        free(t);
+        return pdFAIL;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCoreWithCaps(TaskFunction_t fn, const char *name, uint32_t stack,
+                                           void *arg, UBaseType_t prio, TaskHandle_t *out,
+                                           BaseType_t core, uint32_t caps)
+{
+    (void)caps;
+    return xTaskCreatePinnedToCore(fn, name, stack, arg, prio, out, core);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task == NULL || task == t_self) {
+        /* The handle stays allocated: other tasks may still notify it */
+        pthread_exit(NULL);
+    }
+    abort();
+}
+
+void vTaskDeleteWithCaps(TaskHandle_t task)
+{
+    vTaskDelete(task);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    if (!t_self) {
+        /* A thread not created through the shim, e.g. main() */
+        t_self = task_new("main");
+        if (t_self) t_self->thread = pthread_self();
+    }
+    return t_self;
+}
+
+const char *pcTaskGetName(TaskHandle_t task)
+{
+    if (!task) task = xTaskGetCurrentTaskHandle();
+    return task ? task->name : "";
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+    (void)task;
+    return 0;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t wait)
+{
+    struct shim_task *t = xTaskGetCurrentTaskHandle();
+    pthread_mutex_lock(&t->lock);
+    WAIT_UNTIL(&t->cond, &t->lock, wait, t->notify > 0);
+    uint32_t v = t->notify;
+    if (v > 0) t->notify = clear_on_exit ? 0 : v - 1;
+    pthread_mutex_unlock(&t->lock);
+    return v;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    if (!task) return pdFAIL;
+    pthread_mutex_lock(&task->lock);
+    task->notify++;
+    pthread_cond_broadcast(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken)
+{
+    xTaskNotifyGive(task);
+    if (woken) *woken = pdFALSE;
+}
+
+/* ── Queues ───────────────────────────────────────────────────── */
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct shim_queue *q = calloc(1, sizeof(*q));
+    if (!q) return NULL;
+    q->items = calloc(length ? length : 1, item_size ? item_size : 1);
+    if (!q->items) {
+        free(q);
+        return NULL;
+    }
+    q->len = length;
+    q->size = item_size;
+    pthread_mutex_init(&q->lock, NULL);
+    cond_init_monotonic(&q->not_empty);
+    cond_init_monotonic(&q->not_full);
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t q)
+{
+    if (!q) return;
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->not_empty);
+    pthread_cond_destroy(&q->not_full);
+    free(q->items);
+    free(q);
+}
+
+BaseType_t xQueueGenericSend(QueueHandle_t q, const void *item, TickType_t wait, bool front)
+{
+    pthread_mutex_lock(&q->lock);
+    if (!WAIT_UNTIL(&q->not_full, &q->lock, wait, q->count < q->len)) {
+        pthread_mutex_unlock(&q->lock);
+        return errQUEUE_FULL;
+    }
+    UBaseType_t slot;
+    if (front) {
+        q->head = (q->head + q->len - 1) % q->len;
+        slot = q->head;
+    } else {
+        slot = (q->head + q->count) % q->len;
+    }
+    memcpy(q->items + (size_t)slot * q->size, item, q->size);
+    q->count++;
+    pthread_cond_broadcast(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+    return pdPASS;
+}
+
+static BaseType_t queue_take(QueueHandle_t q, void *out, TickType_t wait, bool remove)
+{
+    pthread_mutex_lock(&q->lock);
+    if (!WAIT_UNTIL(&q->not_empty, &q->lock, wait, q->count > 0)) {
+        pthread_mutex_unlock(&q->lock);
+        return errQUEUE_EMPTY;
+    }
+    memcpy(out, q->items + (size_t)q->head * q->size, q->size);
+    if (remove) {
+        q->head = (q->head + 1) % q->len;
+        q->count--;
+        pthread_cond_broadcast(&q->not_full);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *out, TickType_t wait)
+{
+    return queue_take(q, out, wait, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t q, void *out, TickType_t wait)
+{
+    return queue_take(q, out, wait, false);
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+    pthread_mutex_lock(&q->lock);
+    UBaseType_t n = q->count;
+    pthread_mutex_unlock(&q->lock);
+    return n;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t q)
+{
+    pthread_mutex_lock(&q->lock);
+    UBaseType_t n = q->len - q->count;
+    pthread_mutex_unlock(&q->lock);
+    return n;
+}
+
+BaseType_t xQueueReset(QueueHandle_t q)
+{
+    pthread_mutex_lock(&q->lock);
+    q->head = 0;
+    q->count = 0;
+    pthread_cond_broadcast(&q->not_full);
+    pthread_mutex_unlock(&q->lock);
+    return pdPASS;
+}
+
+/* ── Semaphores ───────────────────────────────────────────────── */
+
+static SemaphoreHandle_t sem_new(sem_kind_t kind, UBaseType_t max, UBaseType_t initial)
+{
+    struct shim_sem *s = calloc(1, sizeof(*s));
+    if (!s) return NULL;
+    pthread_mutex_init(&s->lock, NULL);
+    cond_init_monotonic(&s->cond);
+    s->kind = kind;
+    s->max = max;
+    s->count = initial;
+    return s;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return sem_new(SEM_MUTEX, 1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void)
+{
+    return sem_new(SEM_RECURSIVE, 1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return sem_new(SEM_COUNTING, 1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial)
+{
+    return sem_new(SEM_COUNTING, max, initial);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t s)
+{
+    if (!s) return;
+    pthread_mutex_destroy(&s->lock);
+    pthread_cond_destroy(&s->cond);
+    free(s);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t wait)
+{
+    pthread_mutex_lock(&s->lock);
+    bool ok = WAIT_UNTIL(&s->cond, &s->lock, wait, s->count > 0);
+    if (ok) {
+        s->count--;
+        if (s->kind != SEM_COUNTING) s->owner = xTaskGetCurrentTaskHandle();
+    }
+    pthread_mutex_unlock(&s->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t s)
+{
+    pthread_mutex_lock(&s->lock);
+    if (s->count >= s->max) {
+        pthread_mutex_unlock(&s->lock);
+        return pdFALSE;
+    }
+    s->count++;
+    s->owner = NULL;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t s, TickType_t wait)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    pthread_mutex_lock(&s->lock);
+    if (s->owner == self && s->depth > 0) {
+        s->depth++;
+        pthread_mutex_unlock(&s->lock);
+        return pdTRUE;
+    }
+    bool ok = WAIT_UNTIL(&s->cond, &s->lock, wait, s->count > 0);
+    if (ok) {
+        s->count--;
+        s->owner = self;
+        s->depth = 1;
+    }
+    pthread_mutex_unlock(&s->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t s)
+{
+    pthread_mutex_lock(&s->lock);
+    if (s->owner != xTaskGetCurrentTaskHandle() || s->depth == 0) {
+        pthread_mutex_unlock(&s->lock);
+        return pdFALSE;
+    }
+    if (--s->depth == 0) {
+        s->owner = NULL;
+        s->count++;
+        pthread_cond_broadcast(&s->cond);
+    }
+    pthread_mutex_unlock(&s->lock);
+    return pdTRUE;
+}
+
+UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t s)
+{
+    pthread_mutex_lock(&s->lock);
+    UBaseType_t n = s->count;
+    pthread_mutex_unlock(&s->lock);
+    return n;
+}
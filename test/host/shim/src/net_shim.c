@@ -0,0 +1,540 @@
+/* esp_tls and esp_http_client over plain TCP to routed local ports */
+
+#include "esp_tls.h"
+#include "esp_crt_bundle.h"
+#include "esp_http_client.h"
+#include "shim_net.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/* ── Routes ───────────────────────────────────────────────────── */
+
+#define ROUTE_MAX 16
+
+typedef struct {
+    char host[64];
+    int port;
+    int local_port;
+} route_t;
+
+static route_t s_routes[ROUTE_MAX];
+static int s_route_count;
+static pthread_mutex_t s_route_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void shim_net_route(const char *host, int port, int local_port)
+{
+    pthread_mutex_lock(&s_route_lock);
+    route_t *r = NULL;
+    for (int i = 0; i < s_route_count; i++) {
+        if (s_routes[i].port == port && strcmp(s_routes[i].host, host) == 0) r = &s_routes[i];
+    }
+    if (!r && s_route_count < ROUTE_MAX) r = &s_routes[s_route_count++];
+    if (r) {
+        snprintf(r->host, sizeof(r->host), "%s", host);
+        r->port = port;
+        r->local_port = local_port;
+    }
+    pthread_mutex_unlock(&s_route_lock);
+}
+
+void shim_net_reset(void)
+{
+    pthread_mutex_lock(&s_route_lock);
+    s_route_count = 0;
+    pthread_mutex_unlock(&s_route_lock);
+}
+
+static int route_lookup(const char *host, int port)
+{
+    int local = -1;
+    pthread_mutex_lock(&s_route_lock);
+    for (int i = 0; i < s_route_count; i++) {
+        const route_t *r = &s_routes[i];
+        if ((r->port == port || r->port == 0) && strcasecmp(r->host, host) == 0) {
+            local = r->local_port;
+            if (r->port == port) break;
+        }
+    }
+    pthread_mutex_unlock(&s_route_lock);
+    return local;
+}
+
+int shim_net_connect(const char *host, int port, int timeout_ms)
+{
+    int local = route_lookup(host, port);
+    if (local < 0) {
+        fprintf(stderr, "shim_net: no route to %s:%d\n", host, port);
+        return -1;
+    }
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons((uint16_t)local),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (timeout_ms > 0) {
+        struct timeval tv = { .tv_sec = timeout_ms / 1000, .tv_usec = (timeout_ms % 1000) * 1000 };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    }
+    return fd;
+}
+
+/* ── esp_tls ──────────────────────────────────────────────────── */
+
+struct esp_tls {
+    int sock;
+    esp_tls_conn_state_t state;
+};
+
+esp_err_t esp_crt_bundle_attach(void *conf)
+{
+    (void)conf;
+    return ESP_OK;
+}
+
+esp_tls_t *esp_tls_init(void)
+{
+    esp_tls_t *tls = calloc(1, sizeof(*tls));
+    if (tls) tls->sock = -1;
+    return tls;
+}
+
+int esp_tls_conn_new_sync(const char *hostname, int hostlen, int port,
+                          const esp_tls_cfg_t *cfg, esp_tls_t *tls)
+{
+    if (tls->state == ESP_TLS_CONNECTING && tls->sock >= 0) {
+        /* Socket injected by the caller (CONNECT tunnel): nothing to do */
+        tls->state = ESP_TLS_DONE;
+        return 1;
+    }
+    char host[128];
+    snprintf(host, sizeof(host), "%.*s", hostlen, hostname);
+    tls->sock = shim_net_connect(host, port, cfg ? cfg->timeout_ms : 0);
+    if (tls->sock < 0) {
+        tls->state = ESP_TLS_FAIL;
+        return -1;
+    }
+    tls->state = ESP_TLS_DONE;
+    return 1;
+}
+
+ssize_t esp_tls_conn_read(esp_tls_t *tls, void *data, size_t datalen)
+{
+    ssize_t n = recv(tls->sock, data, datalen, 0);
+    if (n < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return ESP_TLS_ERR_SSL_WANT_READ;
+        }
+        return -1;
+    }
+    return n;
+}
+
+ssize_t esp_tls_conn_write(esp_tls_t *tls, const void *data, size_t datalen)
+{
+    ssize_t n = send(tls->sock, data, datalen, MSG_NOSIGNAL);
+    if (n < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return ESP_TLS_ERR_SSL_WANT_WRITE;
+        }
+        return -1;
+    }
+    return n;
+}
+
+int esp_tls_conn_destroy(esp_tls_t *tls)
+{
+    if (!tls) return -1;
+    if (tls->sock >= 0) close(tls->sock);
+    free(tls);
+    return 0;
+}
+
+ssize_t esp_tls_get_bytes_avail(esp_tls_t *tls)
+{
+    (void)tls;
+    return 0;       /* no record layer, so nothing is ever buffered */
+}
+
+esp_err_t esp_tls_get_conn_sockfd(esp_tls_t *tls, int *sockfd)
+{
+    if (!tls || !sockfd) return ESP_ERR_INVALID_ARG;
+    *sockfd = tls->sock;
+    return ESP_OK;
+}
+
+esp_err_t esp_tls_set_conn_sockfd(esp_tls_t *tls, int sockfd)
+{
+    if (!tls) return ESP_ERR_INVALID_ARG;
+    tls->sock = sockfd;
+    return ESP_OK;
+}
+
+esp_err_t esp_tls_set_conn_state(esp_tls_t *tls, esp_tls_conn_state_t state)
+{
+    if (!tls) return ESP_ERR_INVALID_ARG;
+    tls->state = state;
+    return ESP_OK;
+}
+
+/* ── esp_http_client ──────────────────────────────────────────── */
+
+#define CLIENT_HEADERS_MAX  16
+#define CLIENT_RESP_MAX     32
+#define CLIENT_BUF          8192
+
+typedef struct {
+    char *key;
+    char *value;
+} header_t;
+
+struct esp_http_client {
+    esp_http_client_config_t cfg;
+    char *url;
+    header_t req[CLIENT_HEADERS_MAX];
+    int req_count;
+    header_t resp[CLIENT_RESP_MAX];
+    int resp_count;
+    int sock;
+    int status;
+    int64_t content_length;     /* -1: until close or chunked */
+    bool chunked;
+    int64_t chunk_left;         /* bytes left in the current chunk */
+    int64_t body_read;
+    bool body_done;
+    char buf[CLIENT_BUF];       /* bytes received past what was consumed */
+    int buf_len;
+    int buf_pos;
+};
+
+static void headers_clear(header_t *h, int *count)
+{
+    for (int i = 0; i < *count; i++) {
+        free(h[i].key);
+        free(h[i].value);
+    }
+    *count = 0;
+}
+
+static bool parse_url(const char *url, char *host, size_t host_size, int *port,
+                      char *path, size_t path_size)
+{
+    const char *p = strstr(url, "://");
+    bool https = strncmp(url, "https", 5) == 0;
+    p = p ? p + 3 : url;
+    const char *slash = strchr(p, '/');
+    const char *end = slash ? slash : p + strlen(p);
+    const char *colon = memchr(p, ':', (size_t)(end - p));
+    const char *host_end = colon ? colon : end;
+    if (host_end == p || (size_t)(host_end - p) >= host_size) return false;
+    memcpy(host, p, (size_t)(host_end - p));
+    host[host_end - p] = '\0';
+    *port = colon ? atoi(colon + 1) : (https ? 443 : 80);
+    snprintf(path, path_size, "%s", slash ? slash : "/");
+    return true;
+}
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config)
+{
+    if (!config || !config->url) return NULL;
+    struct esp_http_client *c = calloc(1, sizeof(*c));
+    if (!c) return NULL;
+    c->cfg = *config;
+    c->url = strdup(config->url);
+    c->sock = -1;
+    if (!c->url) {
+        free(c);
+        return NULL;
+    }
+    return c;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t c, const char *key,
+                                     const char *value)
+{
+    for (int i = 0; i < c->req_count; i++) {
+        if (strcasecmp(c->req[i].key, key) == 0) {
+            free(c->req[i].value);
+            c->req[i].value = strdup(value);
+            return ESP_OK;
+        }
+    }
+    if (c->req_count == CLIENT_HEADERS_MAX) return ESP_ERR_NO_MEM;
+    c->req[c->req_count].key = strdup(key);
+    c->req[c->req_count].value = strdup(value);
+    c->req_count++;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_get_header(esp_http_client_handle_t c, const char *key, char **value)
+{
+    /* Response headers first; the firmware reads Date from a HEAD response */
+    for (int i = 0; i < c->resp_count; i++) {
+        if (strcasecmp(c->resp[i].key, key) == 0) {
+            *value = c->resp[i].value;
+            return ESP_OK;
+        }
+    }
+    for (int i = 0; i < c->req_count; i++) {
+        if (strcasecmp(c->req[i].key, key) == 0) {
+            *value = c->req[i].value;
+            return ESP_OK;
+        }
+    }
+    *value = NULL;
+    return ESP_OK;
+}
+
+static bool send_all(int fd, const char *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        data += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+esp_err_t esp_http_client_open(esp_http_client_handle_t c, int write_len)
+{
+    static const char *methods[] = { "GET", "POST", "PUT", "PATCH", "DELETE", "HEAD" };
+    char host[128], path[1024];
+    int port;
+    if (!parse_url(c->url, host, sizeof(host), &port, path, sizeof(path))) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_http_client_close(c);
+    c->sock = shim_net_connect(host, port, c->cfg.timeout_ms);
+    if (c->sock < 0) return ESP_ERR_HTTP_CONNECT;
+
+    char head[4096];
+    int n = snprintf(head, sizeof(head), "%s %s HTTP/1.1\r\nHost: %s\r\n",
+                     methods[c->cfg.method], path, host);
+    for (int i = 0; i < c->req_count && n < (int)sizeof(head); i++) {
+        n += snprintf(head + n, sizeof(head) - n, "%s: %s\r\n", c->req[i].key, c->req[i].value);
+    }
+    if (write_len > 0 && n < (int)sizeof(head)) {
+        n += snprintf(head + n, sizeof(head) - n, "Content-Length: %d\r\n", write_len);
+    }
+    if (n < (int)sizeof(head)) n += snprintf(head + n, sizeof(head) - n, "\r\n");
+    if (n >= (int)sizeof(head) || !send_all(c->sock, head, (size_t)n)) {
+        esp_http_client_close(c);
+        return ESP_ERR_HTTP_WRITE_DATA;
+    }
+    return ESP_OK;
+}
+
+int esp_http_client_write(esp_http_client_handle_t c, const char *buffer, int len)
+{
+    return send_all(c->sock, buffer, (size_t)len) ? len : -1;
+}
+
+/* Next byte of the response, -1 on close or error */
+static int next_byte(struct esp_http_client *c)
+{
+    if (c->buf_pos == c->buf_len) {
+        ssize_t n = recv(c->sock, c->buf, sizeof(c->buf), 0);
+        if (n <= 0) return -1;
+        c->buf_len = (int)n;
+        c->buf_pos = 0;
+    }
+    return (unsigned char)c->buf[c->buf_pos++];
+}
+
+static int read_line(struct esp_http_client *c, char *line, int max)
+{
+    int n = 0;
+    while (1) {
+        int ch = next_byte(c);
+        if (ch < 0) return -1;
+        if (ch == '\n') break;
+        if (ch != '\r' && n < max - 1) line[n++] = (char)ch;
+    }
+    line[n] = '\0';
+    return n;
+}
+
+static void emit_event(struct esp_http_client *c, esp_http_client_event_id_t id,
+                       char *key, char *value, void *data, int data_len)
+{
+    if (!c->cfg.event_handler) return;
+    esp_http_client_event_t evt = {
+        .event_id = id, .client = c, .user_data = c->cfg.user_data,
+        .header_key = key, .header_value = value, .data = data, .data_len = data_len,
+    };
+    c->cfg.event_handler(&evt);
+}
+
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t c)
+{
+    char line[2048];
+    headers_clear(c->resp, &c->resp_count);
+    c->status = 0;
+    c->content_length = -1;
+    c->chunked = false;
+    c->chunk_left = 0;
+    c->body_read = 0;
+    c->body_done = false;
+
+    if (read_line(c, line, sizeof(line)) < 0) return -1;
+    if (sscanf(line, "HTTP/%*d.%*d %d", &c->status) != 1) return -1;
+
+    while (1) {
+        int n = read_line(c, line, sizeof(line));
+        if (n < 0) return -1;
+        if (n == 0) break;
+        char *colon = strchr(line, ':');
+        if (!colon) continue;
+        *colon = '\0';
+        char *value = colon + 1;
+        while (*value == ' ') value++;
+        if (strcasecmp(line, "Content-Length") == 0) c->content_length = atoll(value);
+        if (strcasecmp(line, "Transfer-Encoding") == 0 && strcasestr(value, "chunked")) {
+            c->chunked = true;
+        }
+        if (c->resp_count < CLIENT_RESP_MAX) {
+            header_t *h = &c->resp[c->resp_count++];
+            h->key = strdup(line);
+            h->value = strdup(value);
+            emit_event(c, HTTP_EVENT_ON_HEADER, h->key, h->value, NULL, 0);
+        }
+    }
+    if (c->cfg.method == HTTP_METHOD_HEAD || c->status == 204 || c->status == 304) {
+        c->content_length = 0;
+        c->chunked = false;
+    }
+    if (c->content_length == 0) c->body_done = true;
+    /* Like IDF: 0 when the length is not known up front */
+    return c->content_length > 0 ? c->content_length : 0;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t c)
+{
+    return c->status;
+}
+
+int esp_http_client_read(esp_http_client_handle_t c, char *buffer, int len)
+{
+    int out = 0;
+    while (out < len && !c->body_done) {
+        if (c->chunked && c->chunk_left == 0) {
+            char line[64];
+            if (c->body_read > 0 && read_line(c, line, sizeof(line)) < 0) return -1;
+            if (read_line(c, line, sizeof(line)) < 0) return -1;
+            c->chunk_left = strtoll(line, NULL, 16);
+            c->body_read++;     /* any non-zero value: past the first chunk */
+            if (c->chunk_left == 0) {
+                while (read_line(c, line, sizeof(line)) > 0) {}
+                c->body_done = true;
+                break;
+            }
+        }
+        int ch = next_byte(c);
+        if (ch < 0) {
+            /* Close ends a body without length; otherwise it is truncated */
+            if (c->content_length < 0 && !c->chunked) {
+                c->body_done = true;
+                break;
+            }
+            return out > 0 ? out : -1;
+        }
+        buffer[out++] = (char)ch;
+        if (c->chunked) {
+            c->chunk_left--;
+        } else if (c->content_length >= 0 && ++c->body_read >= c->content_length) {
+            c->body_done = true;
+        }
+    }
+    if (out > 0) emit_event(c, HTTP_EVENT_ON_DATA, NULL, NULL, buffer, out);
+    return out;
+}
+
+esp_err_t esp_http_client_flush_response(esp_http_client_handle_t c, int *len)
+{
+    char tmp[512];
+    int total = 0;
+    int n;
+    while ((n = esp_http_client_read(c, tmp, sizeof(tmp))) > 0) total += n;
+    if (len) *len = total;
+    return n < 0 ? ESP_FAIL : ESP_OK;
+}
+
+esp_err_t esp_http_client_set_redirection(esp_http_client_handle_t c)
+{
+    char *location = NULL;
+    for (int i = 0; i < c->resp_count; i++) {
+        if (strcasecmp(c->resp[i].key, "Location") == 0) location = c->resp[i].value;
+    }
+    if (!location) return ESP_ERR_INVALID_ARG;
+
+    char *next;
+    if (location[0] == '/') {
+        /* Keep scheme and authority, replace the path */
+        const char *p = strstr(c->url, "://");
+        p = p ? p + 3 : c->url;
+        const char *slash = strchr(p, '/');
+        size_t base = slash ? (size_t)(slash - c->url) : strlen(c->url);
+        next = malloc(base + strlen(location) + 1);
+        if (next) {
+            memcpy(next, c->url, base);
+            strcpy(next + base, location);
+        }
+    } else {
+        next = strdup(location);
+    }
+    if (!next) return ESP_ERR_NO_MEM;
+    free(c->url);
+    c->url = next;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_perform(esp_http_client_handle_t c)
+{
+    esp_err_t err = esp_http_client_open(c, 0);
+    if (err != ESP_OK) return err;
+    if (esp_http_client_fetch_headers(c) < 0) return ESP_FAIL;
+    err = esp_http_client_flush_response(c, NULL);
+    emit_event(c, HTTP_EVENT_ON_FINISH, NULL, NULL, NULL, 0);
+    return err;
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t c)
+{
+    if (c->sock >= 0) close(c->sock);
+    c->sock = -1;
+    c->buf_len = 0;
+    c->buf_pos = 0;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t c)
+{
+    if (!c) return ESP_FAIL;
+    esp_http_client_close(c);
+    headers_clear(c->req, &c->req_count);
+    headers_clear(c->resp, &c->resp_count);
+    free(c->url);
+    free(c);
+    return ESP_OK;
+}
@@ -0,0 +1,224 @@
+/* In-memory NVS: one flat table of namespace/key/value entries */
+
+#include "nvs.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NVS_ENTRIES     128
+#define NVS_HANDLES     32
+#define NVS_NAME_MAX    16
+
+typedef enum { T_STR, T_BLOB, T_INT } nvs_type_t;
+
+typedef struct {
+    bool used;
+    char ns[NVS_NAME_MAX];
+    char key[NVS_NAME_MAX];
+    nvs_type_t type;
+    void *data;             /* string (NUL included) or blob */
+    size_t len;
+    int64_t num;
+} nvs_entry_t;
+
+typedef struct {
+    bool used;
+    bool writable;
+    char ns[NVS_NAME_MAX];
+} nvs_open_t;
+
+static nvs_entry_t s_entries[NVS_ENTRIES];
+static nvs_open_t s_handles[NVS_HANDLES];
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static nvs_open_t *handle_get(nvs_handle_t h)
+{
+    if (h == 0 || h > NVS_HANDLES || !s_handles[h - 1].used) return NULL;
+    return &s_handles[h - 1];
+}
+
+static nvs_entry_t *entry_find(const char *ns, const char *key)
+{
+    for (int i = 0; i < NVS_ENTRIES; i++) {
+        nvs_entry_t *e = &s_entries[i];
+        if (e->used && strcmp(e->ns, ns) == 0 && strcmp(e->key, key) == 0) return e;
+    }
+    return NULL;
+}
+
+static void entry_clear(nvs_entry_t *e)
+{
+    free(e->data);
+    memset(e, 0, sizeof(*e));
+}
+
+esp_err_t nvs_open(const char *ns, nvs_open_mode_t mode, nvs_handle_t *out)
+{
+    if (!ns || strlen(ns) >= NVS_NAME_MAX) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&s_lock);
+    esp_err_t err = ESP_ERR_NO_MEM;
+    for (int i = 0; i < NVS_HANDLES; i++) {
+        if (!s_handles[i].used) {
+            s_handles[i].used = true;
+            s_handles[i].writable = mode == NVS_READWRITE;
+            strcpy(s_handles[i].ns, ns);
+            *out = (nvs_handle_t)(i + 1);
+            err = ESP_OK;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+void nvs_close(nvs_handle_t h)
+{
+    pthread_mutex_lock(&s_lock);
+    nvs_open_t *o = handle_get(h);
+    if (o) o->used = false;
+    pthread_mutex_unlock(&s_lock);
+}
+
+esp_err_t nvs_commit(nvs_handle_t h)
+{
+    return handle_get(h) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t h, const char *key)
+{
+    pthread_mutex_lock(&s_lock);
+    nvs_open_t *o = handle_get(h);
+    esp_err_t err = ESP_ERR_INVALID_ARG;
+    if (o && o->writable) {
+        nvs_entry_t *e = entry_find(o->ns, key);
+        if (e) entry_clear(e);
+        err = e ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t h)
+{
+    pthread_mutex_lock(&s_lock);
+    nvs_open_t *o = handle_get(h);
+    esp_err_t err = ESP_ERR_INVALID_ARG;
+    if (o && o->writable) {
+        for (int i = 0; i < NVS_ENTRIES; i++) {
+            if (s_entries[i].used && strcmp(s_entries[i].ns, o->ns) == 0) entry_clear(&s_entries[i]);
+        }
+        err = ESP_OK;
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+static esp_err_t set_value(nvs_handle_t h, const char *key, nvs_type_t type,
+                           const void *data, size_t len, int64_t num)
+{
+    if (!key || strlen(key) >= NVS_NAME_MAX) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&s_lock);
+    nvs_open_t *o = handle_get(h);
+    esp_err_t err = ESP_ERR_INVALID_ARG;
+    if (o && o->writable) {
+        nvs_entry_t *e = entry_find(o->ns, key);
+        for (int i = 0; !e && i < NVS_ENTRIES; i++) {
+            if (!s_entries[i].used) e = &s_entries[i];
+        }
+        err = ESP_ERR_NO_MEM;
+        void *copy = NULL;
+        if (e && (!data || (copy = malloc(len ? len : 1)))) {
+            if (copy) memcpy(copy, data, len);
+            entry_clear(e);
+            e->used = true;
+            strcpy(e->ns, o->ns);
+            strcpy(e->key, key);
+            e->type = type;
+            e->data = copy;
+            e->len = len;
+            e->num = num;
+            err = ESP_OK;
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+/* Copy a string/blob out; out == NULL asks for the length only */
+static esp_err_t get_value(nvs_handle_t h, const char *key, nvs_type_t type,
+                           void *out, size_t *len, int64_t *num)
+{
+    pthread_mutex_lock(&s_lock);
+    nvs_open_t *o = handle_get(h);
+    esp_err_t err = ESP_ERR_INVALID_ARG;
+    if (o) {
+        nvs_entry_t *e = entry_find(o->ns, key);
+        if (!e || e->type != type) {
+            err = ESP_ERR_NVS_NOT_FOUND;
+        } else if (type == T_INT) {
+            *num = e->num;
+            err = ESP_OK;
+        } else if (!out) {
+            *len = e->len;
+            err = ESP_OK;
+        } else if (*len < e->len) {
+            *len = e->len;
+            err = ESP_ERR_NVS_INVALID_LENGTH;
+        } else {
+            memcpy(out, e->data, e->len);
+            *len = e->len;
+            err = ESP_OK;
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+esp_err_t nvs_set_str(nvs_handle_t h, const char *key, const char *value)
+{
+    return set_value(h, key, T_STR, value, strlen(value) + 1, 0);
+}
+
+esp_err_t nvs_get_str(nvs_handle_t h, const char *key, char *out, size_t *len)
+{
+    return get_value(h, key, T_STR, out, len, NULL);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t h, const char *key, const void *value, size_t len)
+{
+    return set_value(h, key, T_BLOB, value, len, 0);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t h, const char *key, void *out, size_t *len)
+{
+    return get_value(h, key, T_BLOB, out, len, NULL);
+}
+
+#define NVS_INT(suffix, type)                                               \
+    esp_err_t nvs_set_##suffix(nvs_handle_t h, const char *key, type v)     \
+    {                                                                       \
+        return set_value(h, key, T_INT, NULL, 0, (int64_t)v);               \
+    }                                                                       \
+    esp_err_t nvs_get_##suffix(nvs_handle_t h, const char *key, type *v)    \
+    {                                                                       \
+        int64_t num = 0;                                                    \
+        esp_err_t err = get_value(h, key, T_INT, NULL, NULL, &num);         \
+        if (err == ESP_OK) *v = (type)num;                                  \
+        return err;                                                         \
+    }
+
+NVS_INT(i8, int8_t)
+NVS_INT(u8, uint8_t)
+NVS_INT(u16, uint16_t)
+NVS_INT(i32, int32_t)
+NVS_INT(u32, uint32_t)
+NVS_INT(i64, int64_t)
+NVS_INT(u64, uint64_t)
+
+void nvs_shim_reset(void)
+{
+    pthread_mutex_lock(&s_lock);
+    for (int i = 0; i < NVS_ENTRIES; i++) entry_clear(&s_entries[i]);
+    pthread_mutex_unlock(&s_lock);
+}
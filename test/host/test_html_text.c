@@ -0,0 +1,280 @@
+/* html_text over a corpus of saved pages (test/host/data/html), then
+ * web_fetch end to end against a local server.
+ *
+ * Each page is extracted whole, byte by byte and in random splits, which
+ * must all give the same text. Expected content has to survive; scripts,
+ * styles, page chrome and form controls must not. A 4 MB page checks that
+ * the extractor stops at the output budget and that web_fetch then drops
+ * the transfer instead of downloading the rest. */
+
+#include "host_test.h"
+#include "mock_http.h"
+#include "shim_net.h"
+
+#include "tools/html_text.h"
+#include "tools/tool_registry.h"
+#include "tools/tool_web_fetch.h"
+
+#include <stdatomic.h>
+#include <string.h>
+#include <unistd.h>
+
+#define OUT_SIZE    (8 * 1024)      /* agent tool output slot */
+#define BIG_PAGE    (4 * 1024 * 1024)
+
+typedef struct {
+    const char *file;
+    const char *keep[10];
+    const char *drop[10];
+} page_t;
+
+static const page_t s_corpus[] = {
+    {
+        "news_article.html",
+        { "Tiny chips, big models: running assistants on microcontrollers \xe2\x80\x94 The Circuit",
+          "can\xe2\x80\x99t run a language model, but it doesn\xe2\x80\x99t have to",
+          "\xe2\x80\x9cThe device is the agent,\xe2\x80\x9d",
+          "512 KB of SRAM",
+          "server-sent events as they arrive & keeps only one line",
+          "the model\xe2\x80\x99s budget is full",
+          "\xe2\x82\xac" "4.50 or \xc2\xa3" "3.90 per chip in volume \xe2\x80\xa6",
+          NULL },
+        { "gtag", "dataLayer", "schema.org", "font-family", "Newsletter", "Ten boards under",
+          "Sidebar story", "All rights reserved", "Search The Circuit", "querySelectorAll" },
+    },
+    {
+        "docs_page.html",
+        { "message_bus_push_inbound() \xe2\x80\x94 MimiClaw API",
+          "if (message_bus_push_inbound(&msg) != ESP_OK)",
+          "msg->prio uint8_t Priority class",
+          "ESP_ERR_NO_MEM\nThe class is full",
+          "\xc2\xa9 \xe2\x82\xac A \xf0\x9f\x98\x80",
+          "See also: message_bus_pop_inbound()",
+          NULL },
+        { "Contents", "background:#f6f8fa", "apidoc", NULL },
+    },
+    {
+        "forum_thread.html",
+        { "PSRAM stacks and SPIFFS writes crash?",
+          "Cache disabled but cached memory region accessed",
+          "- Keep flash writers on internal stacks.\n- Or hand the write",
+          "That was it \xe2\x80\x94 thanks!",
+          NULL },
+        { "csrf", "{{body}}", "Like", "Quote", "Type here", "Watch thread", "Post reply",
+          "EMOJI_PICKER", "phpBB", "Forum \xc2\xbb" },
+    },
+    {
+        "cjk_page.html",
+        { "\xe6\xb6\x88\xe6\x81\xaf\xe6\x8e\xa5\xe5\x8f\xa3",                  /* 消息接口 */
+          "x-api-key: <\xe4\xbd\xa0\xe7\x9a\x84\xe5\xaf\x86\xe9\x92\xa5>",     /* <你的密钥> */
+          "\xc2\xa5" "2.00 \xc2\xb7",
+          NULL },
+        { "__INITIAL_STATE__", "\xe5\xae\x9a\xe4\xbb\xb7</li>", "ICP", NULL },
+    },
+    {
+        "plain.txt",
+        { "MimiClaw release notes\n======================",
+          "  * Agent worker pool with per-chat ordering.",
+          NULL },
+        { "\a", "\033", NULL },
+    },
+};
+
+static char *load(const char *name, size_t *len)
+{
+    char path[512];
+    snprintf(path, sizeof(path), "%s/html/%s", HOST_DATA_DIR, name);
+    FILE *f = fopen(path, "rb");
+    CHECK(f);
+    fseek(f, 0, SEEK_END);
+    *len = (size_t)ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *buf = malloc(*len + 1);
+    CHECK(fread(buf, 1, *len, f) == *len);
+    buf[*len] = '\0';
+    fclose(f);
+    return buf;
+}
+
+/* step 0: pseudo-random split sizes */
+static size_t extract(const char *in, size_t len, size_t step, char *out, size_t cap)
+{
+    html_text_t h;
+    html_text_init(&h, out, cap);
+    uint32_t rnd = 0x2545f491u;
+    size_t off = 0;
+    while (off < len) {
+        size_t n = step;
+        if (!n) {
+            rnd ^= rnd << 13;
+            rnd ^= rnd >> 17;
+            rnd ^= rnd << 5;
+            n = 1 + rnd % 300;
+        }
+        if (n > len - off) n = len - off;
+        bool more = html_text_feed(&h, in + off, n);
+        off += n;
+        if (!more) break;
+    }
+    return off;
+}
+
+static void test_corpus(void)
+{
+    static char whole[OUT_SIZE], split[OUT_SIZE];
+    printf("  %-20s %8s %8s\n", "page", "bytes", "text");
+    for (size_t i = 0; i < sizeof(s_corpus) / sizeof(s_corpus[0]); i++) {
+        const page_t *pg = &s_corpus[i];
+        size_t len;
+        char *in = load(pg->file, &len);
+
+        extract(in, len, len, whole, sizeof(whole));
+        const size_t steps[] = { 1, 2, 3, 7, 64, 0 };
+        for (size_t s = 0; s < sizeof(steps) / sizeof(steps[0]); s++) {
+            extract(in, len, steps[s], split, sizeof(split));
+            if (strcmp(whole, split) != 0) {
+                fprintf(stderr, "%s: split %zu differs\n--- whole\n%s\n--- split\n%s\n",
+                        pg->file, steps[s], whole, split);
+                exit(1);
+            }
+        }
+
+        for (int k = 0; k < 10 && pg->keep[k]; k++) {
+            if (!strstr(whole, pg->keep[k])) {
+                fprintf(stderr, "%s: missing \"%s\" in\n%s\n", pg->file, pg->keep[k], whole);
+                exit(1);
+            }
+        }
+        for (int k = 0; k < 10 && pg->drop[k]; k++) {
+            if (strstr(whole, pg->drop[k])) {
+                fprintf(stderr, "%s: kept \"%s\" in\n%s\n", pg->file, pg->drop[k], whole);
+                exit(1);
+            }
+        }
+        /* Collapsed whitespace: no runs of blank lines, no trailing blanks */
+        CHECK(!strstr(whole, "\n\n\n"));
+        CHECK(!strstr(whole, " \n"));
+        printf("  %-20s %8zu %8zu\n", pg->file, len, strlen(whole));
+        free(in);
+    }
+}
+
+/* The article repeated until the page is BIG_PAGE bytes */
+static char *big_page(size_t *len)
+{
+    size_t one;
+    char *article = load("news_article.html", &one);
+    char *page = malloc(BIG_PAGE + 1);
+    size_t off = 0;
+    while (off + one <= BIG_PAGE) {
+        memcpy(page + off, article, one);
+        off += one;
+    }
+    page[off] = '\0';
+    *len = off;
+    free(article);
+    return page;
+}
+
+static void test_budget(void)
+{
+    size_t len;
+    char *page = big_page(&len);
+    static char out[OUT_SIZE];
+
+    int64_t t0 = host_now_us();
+    size_t used = extract(page, len, 1460, out, sizeof(out));
+    int64_t dt = host_now_us() - t0;
+    CHECK(used < len / 20);                 /* stopped long before the end */
+    CHECK(strlen(out) >= sizeof(out) - 256);
+
+    /* Throughput over the whole page with a budget that never fills */
+    size_t cap = 2 * 1024 * 1024;
+    char *huge = malloc(cap);
+    int64_t t1 = host_now_us();
+    CHECK(extract(page, len, 1460, huge, cap) == len);
+    int64_t full = host_now_us() - t1;
+    printf("  budget: %zu of %zu bytes read for %zu bytes of text (%.3f ms); "
+           "full page %.1f MB/s\n", used, len, strlen(out), dt / 1000.0,
+           len / (full / 1e6) / (1024 * 1024));
+    free(huge);
+    free(page);
+}
+
+/* ── web_fetch against a local server ─────────────────────────── */
+
+static struct {
+    char *page;
+    size_t len;
+    atomic_size_t sent;
+    atomic_bool gave_up;        /* client closed before the end */
+} s_srv;
+
+static void page_handler(mock_http_conn_t *c, const mock_http_req_t *req, void *ctx)
+{
+    if (strcmp(req->path, "/big") != 0) {
+        size_t len;
+        char *page = load(req->path + 1, &len);
+        mock_http_reply(c, 200, "text/html; charset=utf-8", page, len);
+        free(page);
+        return;
+    }
+    mock_http_chunked_begin(c, 200, "text/html");
+    for (size_t off = 0; off < s_srv.len; off += 16 * 1024) {
+        size_t n = s_srv.len - off < 16 * 1024 ? s_srv.len - off : 16 * 1024;
+        if (!mock_http_chunk(c, s_srv.page + off, n)) {
+            atomic_store(&s_srv.gave_up, true);
+            mock_http_close(c);
+            return;
+        }
+        atomic_fetch_add(&s_srv.sent, n);
+        usleep(500);    /* a network, not a memcpy */
+    }
+    mock_http_chunked_end(c);
+}
+
+static void test_web_fetch(void)
+{
+    s_srv.page = big_page(&s_srv.len);
+    mock_http_t *srv = mock_http_start(page_handler, NULL);
+    CHECK(srv);
+    shim_net_route("pages.example.com", 0, mock_http_port(srv));
+
+    static char out[OUT_SIZE];
+    CHECK(tool_web_fetch_execute("{\"url\":\"https://pages.example.com/docs_page.html\"}",
+                                 out, sizeof(out)) == ESP_OK);
+    CHECK(strstr(out, "Source: https://pages.example.com/docs_page.html"));
+    CHECK(strstr(out, "The bus took ownership of msg->content."));
+    CHECK(!strstr(out, "[truncated]"));
+
+    int64_t t0 = host_now_us();
+    CHECK(tool_web_fetch_execute("{\"url\":\"https://pages.example.com/big\"}",
+                                 out, sizeof(out)) == ESP_OK);
+    int64_t dt = host_now_us() - t0;
+    CHECK(strstr(out, "Tiny chips, big models"));
+    CHECK(strstr(out, "[truncated]"));
+    CHECK(strlen(out) < sizeof(out));
+
+    /* The transfer was dropped, not drained */
+    int64_t deadline = host_now_us() + 5 * 1000000;
+    while (!atomic_load(&s_srv.gave_up) && host_now_us() < deadline) usleep(1000);
+    CHECK(atomic_load(&s_srv.gave_up));
+    size_t sent = atomic_load(&s_srv.sent);
+    CHECK(sent < s_srv.len / 4);
+    printf("  web_fetch: %zu-byte page, server sent %zu bytes before the client left "
+           "(%.1f ms)\n", s_srv.len, sent, dt / 1000.0);
+
+    mock_http_stop(srv);
+    free(s_srv.page);
+}
+
+int main(void)
+{
+    host_spiffs_reset();
+    CHECK(tool_registry_init() == ESP_OK);
+    printf("test_html_text:\n");
+    test_corpus();
+    test_budget();
+    test_web_fetch();
+    return 0;
+}
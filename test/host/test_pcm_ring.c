@@ -0,0 +1,217 @@
+/* Record pipeline on the PCM ring with a stalling SD card.
+ *
+ * A capture thread produces numbered stereo frames at a fixed rate (8x the
+ * real 16 kHz stream, so the test runs in a few seconds) and a writer
+ * thread drains the ring into a file the way record_writer_task does:
+ * block-aligned writes after a WAV header. The writer stalls twice: once
+ * for less than the ring holds, once for much longer. The first stall must
+ * cost nothing; the second must drop whole chunks only, counted exactly,
+ * while capture keeps its pace. */
+
+#include "host_test.h"
+
+#include "audio/pcm_ring.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Sizes as in audio_service.c */
+#define RING_BYTES      (256 * 1024)
+#define BLOCK_BYTES     (16 * 1024)
+#define CHUNK_BYTES     1024
+#define HEADER_BYTES    44
+
+#define FRAME_BYTES     8                       /* two int32 channels */
+#define CHUNK_FRAMES    (CHUNK_BYTES / FRAME_BYTES)
+#define CHUNK_US        1000                    /* real rate: 8 ms */
+#define TOTAL_CHUNKS    2048                    /* 2 MB, ~2 s */
+
+#define STALL1_AT       (128 * 1024)            /* file bytes before the stall */
+#define STALL1_US       (100 * 1000)            /* ring holds ~256 ms */
+#define STALL2_AT       (512 * 1024)
+#define STALL2_US       (600 * 1000)
+
+static pcm_ring_t s_ring;
+static atomic_bool s_capture_done;
+
+static struct {
+    int64_t start_us, end_us;
+    int64_t max_write_us;
+} s_cap;
+
+static struct {
+    unsigned overruns_after_stall1;
+    unsigned overruns_after_stall2;
+    int writes, unaligned;
+    size_t data_bytes;
+} s_wr;
+
+static void *capture_thread(void *arg)
+{
+    int32_t buf[CHUNK_BYTES / sizeof(int32_t)];
+    uint32_t seq = 0;
+    s_cap.start_us = host_now_us();
+
+    /* Like i2s_read after a late wakeup, catch up on every chunk that is due */
+    for (int chunk = 0; chunk < TOTAL_CHUNKS; ) {
+        int64_t due = (host_now_us() - s_cap.start_us) / CHUNK_US + 1;
+        for (; chunk < due && chunk < TOTAL_CHUNKS; chunk++) {
+            for (int i = 0; i < CHUNK_FRAMES; i++, seq++) {
+                buf[i * 2] = (int32_t)seq;
+                buf[i * 2 + 1] = (int32_t)seq;
+            }
+            int64_t t0 = host_now_us();
+            pcm_ring_write(&s_ring, buf, sizeof(buf));
+            int64_t dt = host_now_us() - t0;
+            if (dt > s_cap.max_write_us) s_cap.max_write_us = dt;
+        }
+        usleep(CHUNK_US / 2);
+    }
+
+    s_cap.end_us = host_now_us();
+    atomic_store(&s_capture_done, true);
+    return arg;
+}
+
+static void *writer_thread(void *arg)
+{
+    FILE *fp = arg;
+    uint8_t header[HEADER_BYTES] = {0};
+    CHECK(fwrite(header, 1, sizeof(header), fp) == sizeof(header));
+    size_t file_pos = HEADER_BYTES;
+    bool stalled1 = false, stalled2 = false;
+
+    while (1) {
+        bool done = atomic_load(&s_capture_done);
+        size_t used = pcm_ring_used(&s_ring);
+        size_t want = BLOCK_BYTES - (file_pos % BLOCK_BYTES);
+
+        if (used == 0 && done) break;
+        if (used < want && !done) {
+            usleep(1000);
+            continue;
+        }
+        if (want > used) want = used;
+
+        /* The SD card stops answering for a while */
+        if (!stalled1 && s_wr.data_bytes >= STALL1_AT) {
+            usleep(STALL1_US);
+            stalled1 = true;
+            s_wr.overruns_after_stall1 = atomic_load(&s_ring.overruns);
+        }
+        if (!stalled2 && s_wr.data_bytes >= STALL2_AT) {
+            usleep(STALL2_US);
+            stalled2 = true;
+            s_wr.overruns_after_stall2 = atomic_load(&s_ring.overruns);
+        }
+
+        while (want > 0) {
+            const uint8_t *p = NULL;
+            size_t n = pcm_ring_peek(&s_ring, &p);
+            if (n > want) n = want;
+            CHECK(n > 0);
+            CHECK(fwrite(p, 1, n, fp) == n);
+            file_pos += n;
+            s_wr.data_bytes += n;
+            s_wr.writes++;
+
+            /* Short writes only where the ring wraps or at the very end */
+            bool wrapped = p + n == s_ring.buf + s_ring.cap;
+            if (file_pos % BLOCK_BYTES != 0 && !wrapped && !done) s_wr.unaligned++;
+            pcm_ring_consume(&s_ring, n);
+            want -= n;
+        }
+    }
+    CHECK(stalled1 && stalled2);
+    return NULL;
+}
+
+int main(void)
+{
+    printf("test_pcm_ring:\n");
+
+    /* Ring basics: capacity check, all-or-nothing writes, wrapped peek */
+    static uint8_t small[64];
+    pcm_ring_t r;
+    CHECK(!pcm_ring_init(&r, small, 48));
+    CHECK(pcm_ring_init(&r, small, sizeof(small)));
+    uint8_t in[40], out[64];
+    for (int i = 0; i < (int)sizeof(in); i++) in[i] = (uint8_t)i;
+    CHECK(pcm_ring_write(&r, in, sizeof(in)));
+    CHECK(!pcm_ring_write(&r, in, sizeof(in)));
+    CHECK_EQ_INT(atomic_load(&r.overruns), 1);
+    CHECK_EQ_INT(atomic_load(&r.dropped_bytes), sizeof(in));
+    const uint8_t *p;
+    CHECK_EQ_INT(pcm_ring_peek(&r, &p), sizeof(in));
+    pcm_ring_consume(&r, 32);
+    CHECK(pcm_ring_write(&r, in, sizeof(in)));          /* wraps at 64 */
+    size_t got = 0;
+    while (pcm_ring_used(&r) > 0) {
+        size_t n = pcm_ring_peek(&r, &p);
+        memcpy(out + got, p, n);
+        got += n;
+        pcm_ring_consume(&r, n);
+    }
+    CHECK_EQ_INT(got, 8 + sizeof(in));
+    CHECK(memcmp(out, in + 32, 8) == 0 && memcmp(out + 8, in, sizeof(in)) == 0);
+    CHECK_EQ_INT(atomic_load(&r.high_water), 48);
+
+    /* Pipeline */
+    uint8_t *ring_buf = malloc(RING_BYTES);
+    CHECK(ring_buf && pcm_ring_init(&s_ring, ring_buf, RING_BYTES));
+    FILE *fp = fopen("rec.wav", "w+b");
+    CHECK(fp);
+    setvbuf(fp, NULL, _IONBF, 0);
+
+    pthread_t cap, wr;
+    pthread_create(&wr, NULL, writer_thread, fp);
+    pthread_create(&cap, NULL, capture_thread, NULL);
+    pthread_join(cap, NULL);
+    pthread_join(wr, NULL);
+
+    unsigned overruns = atomic_load(&s_ring.overruns);
+    size_t dropped = atomic_load(&s_ring.dropped_bytes);
+    size_t high_water = atomic_load(&s_ring.high_water);
+    int64_t capture_us = s_cap.end_us - s_cap.start_us;
+
+    /* Capture kept its pace through both stalls */
+    CHECK(capture_us < (int64_t)TOTAL_CHUNKS * CHUNK_US + 200 * 1000);
+
+    /* A stall shorter than the ring is free; a longer one drops whole chunks */
+    CHECK_EQ_INT(s_wr.overruns_after_stall1, 0);
+    CHECK(s_wr.overruns_after_stall2 > 0);
+    CHECK_EQ_INT(dropped, (size_t)overruns * CHUNK_BYTES);
+    CHECK(high_water <= RING_BYTES && high_water > RING_BYTES - CHUNK_BYTES);
+    CHECK_EQ_INT(s_wr.data_bytes + dropped, (size_t)TOTAL_CHUNKS * CHUNK_BYTES);
+    CHECK_EQ_INT(s_wr.unaligned, 0);
+
+    /* The file holds every kept frame once, in order; gaps are whole chunks */
+    CHECK(fseek(fp, HEADER_BYTES, SEEK_SET) == 0);
+    int32_t frame[2];
+    int64_t expect = 0, frames = 0, gaps = 0;
+    while (fread(frame, sizeof(frame), 1, fp) == 1) {
+        CHECK_EQ_INT(frame[0], frame[1]);
+        if (frame[0] != expect) {
+            CHECK(frame[0] > expect);
+            CHECK_EQ_INT(expect % CHUNK_FRAMES, 0);
+            CHECK_EQ_INT(frame[0] % CHUNK_FRAMES, 0);
+            gaps++;
+        }
+        expect = frame[0] + 1;
+        frames++;
+    }
+    CHECK_EQ_INT(frames * FRAME_BYTES, s_wr.data_bytes);
+    CHECK(gaps >= 1);
+    fclose(fp);
+    free(ring_buf);
+
+    printf("  %d chunks in %.0f ms, slowest ring write %lld us\n", TOTAL_CHUNKS,
+           capture_us / 1000.0, (long long)s_cap.max_write_us);
+    printf("  stall %d ms: 0 overruns; stall %d ms: %u overruns (%zu bytes), %lld gaps\n",
+           STALL1_US / 1000, STALL2_US / 1000, overruns, dropped, (long long)gaps);
+    printf("  %d writes, %zu bytes, ring peak %zu KB\n",
+           s_wr.writes, s_wr.data_bytes, high_water / 1024);
+    return 0;
+}
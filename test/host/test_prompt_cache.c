@@ -0,0 +1,230 @@
+/* Prompt caching against a stand-in Messages endpoint that echoes each
+ * request body back as streamed text. Checks the cache_control
+ * breakpoints (system block, last tool, rolling newest message), that the
+ * cached prefix stays byte-identical across ReAct iterations, and that
+ * cache usage from the stream lands in llm_response_t. */
+
+#include "host_test.h"
+#include "mock_http.h"
+#include "shim_net.h"
+
+#include "llm/llm_proxy.h"
+#include "proxy/conn_pool.h"
+#include "proxy/http_proxy.h"
+#include "tools/tool_registry.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#define MAX_BODIES  4
+
+static struct {
+    pthread_mutex_t lock;
+    char *bodies[MAX_BODIES];
+    char api_key[64];
+    char version[32];
+    int count;
+} s_echo = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static void send_event(mock_http_conn_t *c, cJSON *ev)
+{
+    char *json = cJSON_PrintUnformatted(ev);
+    cJSON_Delete(ev);
+    size_t len = strlen(json) + 9;
+    char *frame = malloc(len + 1);
+    snprintf(frame, len + 1, "data: %s\n\n", json);
+    mock_http_chunk(c, frame, len - 1);
+    free(frame);
+    free(json);
+}
+
+/* The first call writes the cache, later ones read it */
+static void echo_handler(mock_http_conn_t *c, const mock_http_req_t *req, void *ctx)
+{
+    pthread_mutex_lock(&s_echo.lock);
+    int call = s_echo.count;
+    if (s_echo.count < MAX_BODIES) s_echo.bodies[s_echo.count++] = strdup(req->body);
+    mock_http_header(req, "x-api-key", s_echo.api_key, sizeof(s_echo.api_key));
+    mock_http_header(req, "anthropic-version", s_echo.version, sizeof(s_echo.version));
+    pthread_mutex_unlock(&s_echo.lock);
+
+    mock_http_chunked_begin(c, 200, "text/event-stream");
+    cJSON *ev = cJSON_CreateObject();
+    cJSON_AddStringToObject(ev, "type", "message_start");
+    cJSON *usage = cJSON_AddObjectToObject(cJSON_AddObjectToObject(ev, "message"), "usage");
+    cJSON_AddNumberToObject(usage, "input_tokens", 9);
+    cJSON_AddNumberToObject(usage, "cache_creation_input_tokens", call == 0 ? 1500 : 40);
+    cJSON_AddNumberToObject(usage, "cache_read_input_tokens", call == 0 ? 0 : 1500);
+    send_event(c, ev);
+
+    ev = cJSON_CreateObject();
+    cJSON_AddStringToObject(ev, "type", "content_block_start");
+    cJSON_AddNumberToObject(ev, "index", 0);
+    cJSON *block = cJSON_AddObjectToObject(ev, "content_block");
+    cJSON_AddStringToObject(block, "type", "text");
+    cJSON_AddStringToObject(block, "text", "");
+    send_event(c, ev);
+
+    for (size_t off = 0; off < req->body_len; off += 1000) {
+        char piece[1001];
+        snprintf(piece, sizeof(piece), "%.1000s", req->body + off);
+        ev = cJSON_CreateObject();
+        cJSON_AddStringToObject(ev, "type", "content_block_delta");
+        cJSON_AddNumberToObject(ev, "index", 0);
+        cJSON *delta = cJSON_AddObjectToObject(ev, "delta");
+        cJSON_AddStringToObject(delta, "type", "text_delta");
+        cJSON_AddStringToObject(delta, "text", piece);
+        send_event(c, ev);
+    }
+
+    ev = cJSON_CreateObject();
+    cJSON_AddStringToObject(ev, "type", "content_block_stop");
+    cJSON_AddNumberToObject(ev, "index", 0);
+    send_event(c, ev);
+    ev = cJSON_CreateObject();
+    cJSON_AddStringToObject(ev, "type", "message_delta");
+    cJSON_AddStringToObject(cJSON_AddObjectToObject(ev, "delta"), "stop_reason", "end_turn");
+    cJSON_AddNumberToObject(cJSON_AddObjectToObject(ev, "usage"), "output_tokens", 5);
+    send_event(c, ev);
+    ev = cJSON_CreateObject();
+    cJSON_AddStringToObject(ev, "type", "message_stop");
+    send_event(c, ev);
+    mock_http_chunked_end(c);
+}
+
+static bool has_mark(const cJSON *obj)
+{
+    cJSON *cc = cJSON_GetObjectItem(obj, "cache_control");
+    const char *type = cJSON_GetStringValue(cJSON_GetObjectItem(cc, "type"));
+    return type && strcmp(type, "ephemeral") == 0;
+}
+
+static int count_marks(const char *body)
+{
+    int n = 0;
+    for (const char *p = body; (p = strstr(p, "\"cache_control\"")); p++) n++;
+    return n;
+}
+
+/* Last content block of the newest message carries the rolling mark */
+static void check_marks(const char *body)
+{
+    cJSON *root = cJSON_Parse(body);
+    CHECK(root);
+    cJSON *system = cJSON_GetObjectItem(root, "system");
+    CHECK(cJSON_IsArray(system) && cJSON_GetArraySize(system) == 1);
+    CHECK(has_mark(cJSON_GetArrayItem(system, 0)));
+
+    cJSON *tools = cJSON_GetObjectItem(root, "tools");
+    int n_tools = cJSON_GetArraySize(tools);
+    CHECK(n_tools > 1);
+    for (int i = 0; i < n_tools; i++) {
+        CHECK(has_mark(cJSON_GetArrayItem(tools, i)) == (i == n_tools - 1));
+    }
+
+    cJSON *msgs = cJSON_GetObjectItem(root, "messages");
+    cJSON *last = cJSON_GetArrayItem(msgs, cJSON_GetArraySize(msgs) - 1);
+    cJSON *content = cJSON_GetObjectItem(last, "content");
+    CHECK(cJSON_IsArray(content));
+    CHECK(has_mark(cJSON_GetArrayItem(content, cJSON_GetArraySize(content) - 1)));
+    CHECK_EQ_INT(count_marks(body), 3);
+    CHECK(cJSON_IsTrue(cJSON_GetObjectItem(root, "stream")));
+    cJSON_Delete(root);
+}
+
+static void add_message(cJSON *messages, const char *role, const char *text)
+{
+    cJSON *m = cJSON_CreateObject();
+    cJSON_AddStringToObject(m, "role", role);
+    cJSON_AddStringToObject(m, "content", text);
+    cJSON_AddItemToArray(messages, m);
+}
+
+int main(void)
+{
+    host_spiffs_reset();
+    mock_http_t *srv = mock_http_start(echo_handler, NULL);
+    CHECK(srv);
+    char host[128];
+    host_url_host(MIMI_LLM_API_URL, host, sizeof(host));
+    shim_net_route(host, 0, mock_http_port(srv));
+
+    CHECK(http_proxy_init() == ESP_OK);
+    CHECK(conn_pool_init() == ESP_OK);
+    CHECK(llm_proxy_init() == ESP_OK);
+    CHECK(llm_set_api_key("sk-test-cache") == ESP_OK);
+    CHECK(tool_registry_init() == ESP_OK);
+    const char *tools = tool_registry_get_tools_json();
+    CHECK(tools);
+
+    cJSON *messages = cJSON_CreateArray();
+    add_message(messages, "user", "What is in my memory file?");
+
+    llm_body_t body;
+    llm_body_init(&body);
+    CHECK(llm_request_begin(&body, "You are Mimi, a pocket assistant.", tools) == ESP_OK);
+
+    /* Iteration 1: the echoed text is exactly what went on the wire */
+    llm_response_t resp;
+    CHECK(llm_chat_request(&body, messages, &resp, NULL, NULL) == ESP_OK);
+    CHECK_EQ_INT(s_echo.count, 1);
+    CHECK(strcmp(resp.text, s_echo.bodies[0]) == 0);
+    CHECK(strcmp(s_echo.api_key, "sk-test-cache") == 0);
+    CHECK(s_echo.version[0]);
+    CHECK_EQ_INT(resp.usage.cache_creation_input_tokens, 1500);
+    CHECK_EQ_INT(resp.usage.cache_read_input_tokens, 0);
+    check_marks(s_echo.bodies[0]);
+    llm_response_free(&resp);
+
+    /* Iteration 2: a tool round appends two messages */
+    cJSON *assistant = cJSON_CreateObject();
+    cJSON_AddStringToObject(assistant, "role", "assistant");
+    cJSON *blocks = cJSON_AddArrayToObject(assistant, "content");
+    cJSON *use = cJSON_CreateObject();
+    cJSON_AddStringToObject(use, "type", "tool_use");
+    cJSON_AddStringToObject(use, "id", "toolu_1");
+    cJSON_AddStringToObject(use, "name", "read_file");
+    cJSON_AddItemToObject(use, "input", cJSON_Parse("{\"path\":\"/spiffs/memory/MEMORY.md\"}"));
+    cJSON_AddItemToArray(blocks, use);
+    cJSON_AddItemToArray(messages, assistant);
+
+    cJSON *result_msg = cJSON_CreateObject();
+    cJSON_AddStringToObject(result_msg, "role", "user");
+    cJSON *results = cJSON_AddArrayToObject(result_msg, "content");
+    cJSON *result = cJSON_CreateObject();
+    cJSON_AddStringToObject(result, "type", "tool_result");
+    cJSON_AddStringToObject(result, "tool_use_id", "toolu_1");
+    cJSON_AddStringToObject(result, "content", "# Memory\n- likes tea");
+    cJSON_AddItemToArray(results, result);
+    cJSON_AddItemToArray(messages, result_msg);
+
+    CHECK(llm_chat_request(&body, messages, &resp, NULL, NULL) == ESP_OK);
+    CHECK_EQ_INT(s_echo.count, 2);
+    CHECK(strcmp(resp.text, s_echo.bodies[1]) == 0);
+    CHECK_EQ_INT(resp.usage.cache_read_input_tokens, 1500);
+    check_marks(s_echo.bodies[1]);
+    llm_response_free(&resp);
+
+    /* The mark moved instead of piling up, and the caller's tree is clean */
+    CHECK(!cJSON_HasObjectItem(result, "cache_control"));
+    char *plain = cJSON_PrintUnformatted(messages);
+    CHECK(!strstr(plain, "cache_control"));
+    free(plain);
+
+    /* Everything up to the first message is the same bytes in both calls */
+    const char *m0 = strstr(s_echo.bodies[0], "\"messages\":[");
+    CHECK(m0);
+    size_t head = (size_t)(m0 - s_echo.bodies[0]) + strlen("\"messages\":[");
+    CHECK(strncmp(s_echo.bodies[0], s_echo.bodies[1], head) == 0);
+
+    /* Iteration 3: nothing new but the same array is cheap to re-send */
+    CHECK(llm_chat_request(&body, messages, &resp, NULL, NULL) == ESP_OK);
+    CHECK(strcmp(s_echo.bodies[1], s_echo.bodies[2]) == 0);
+    llm_response_free(&resp);
+
+    llm_body_free(&body);
+    cJSON_Delete(messages);
+    mock_http_stop(srv);
+    printf("test_prompt_cache: ok\n");
+    return 0;
+}
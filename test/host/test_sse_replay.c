@@ -0,0 +1,313 @@
+/* Replays a recorded Anthropic SSE stream through llm_stream at every split
+ * size, with LF and CRLF line ends, and checks that the assembled response
+ * never depends on how the bytes arrived. Also covers error events, a
+ * stream cut before message_stop, an oversized line and bad tool input. */
+
+#include "host_test.h"
+
+#include "llm/llm_stream.h"
+
+#include <string.h>
+
+/* Text, thinking and two tool_use blocks, pings, cache usage */
+static const char s_transcript[] =
+    "event: message_start\n"
+    "data: {\"type\":\"message_start\",\"message\":{\"id\":\"msg_01\",\"role\":\"assistant\","
+    "\"usage\":{\"input_tokens\":12,\"cache_creation_input_tokens\":0,"
+    "\"cache_read_input_tokens\":2048,\"output_tokens\":1}}}\n"
+    "\n"
+    "event: ping\n"
+    "data: {\"type\":\"ping\"}\n"
+    "\n"
+    "event: content_block_start\n"
+    "data: {\"type\":\"content_block_start\",\"index\":0,\"content_block\":"
+    "{\"type\":\"thinking\",\"thinking\":\"\"}}\n"
+    "\n"
+    "event: content_block_delta\n"
+    "data: {\"type\":\"content_block_delta\",\"index\":0,\"delta\":"
+    "{\"type\":\"thinking_delta\",\"thinking\":\"Need the weather \"}}\n"
+    "\n"
+    "event: content_block_delta\n"
+    "data: {\"type\":\"content_block_delta\",\"index\":0,\"delta\":"
+    "{\"type\":\"thinking_delta\",\"thinking\":\"and the time.\"}}\n"
+    "\n"
+    "event: content_block_delta\n"
+    "data: {\"type\":\"content_block_delta\",\"index\":0,\"delta\":"
+    "{\"type\":\"signature_delta\",\"signature\":\"EqQBCgIYAhIM\"}}\n"
+    "\n"
+    "event: content_block_stop\n"
+    "data: {\"type\":\"content_block_stop\",\"index\":0}\n"
+    "\n"
+    "event: content_block_start\n"
+    "data: {\"type\":\"content_block_start\",\"index\":1,\"content_block\":"
+    "{\"type\":\"text\",\"text\":\"\"}}\n"
+    "\n"
+    "event: content_block_delta\n"
+    "data: {\"type\":\"content_block_delta\",\"index\":1,\"delta\":"
+    "{\"type\":\"text_delta\",\"text\":\"Let me check \\u00e9t\\u00e9 \"}}\n"
+    "\n"
+    "event: content_block_delta\n"
+    "data: {\"type\":\"content_block_delta\",\"index\":1,\"delta\":"
+    "{\"type\":\"text_delta\",\"text\":\"\\\"both\\\".\\n\"}}\n"
+    "\n"
+    "event: content_block_stop\n"
+    "data: {\"type\":\"content_block_stop\",\"index\":1}\n"
+    "\n"
+    "event: content_block_start\n"
+    "data: {\"type\":\"content_block_start\",\"index\":2,\"content_block\":"
+    "{\"type\":\"tool_use\",\"id\":\"toolu_01A\",\"name\":\"web_search\",\"input\":{}}}\n"
+    "\n"
+    "event: content_block_delta\n"
+    "data: {\"type\":\"content_block_delta\",\"index\":2,\"delta\":"
+    "{\"type\":\"input_json_delta\",\"partial_json\":\"\"}}\n"
+    "\n"
+    "event: content_block_delta\n"
+    "data: {\"type\":\"content_block_delta\",\"index\":2,\"delta\":"
+    "{\"type\":\"input_json_delta\",\"partial_json\":\"{\\\"query\\\": \\\"Shen\"}}\n"
+    "\n"
+    "event: content_block_delta\n"
+    "data: {\"type\":\"content_block_delta\",\"index\":2,\"delta\":"
+    "{\"type\":\"input_json_delta\",\"partial_json\":\"zhen weather\\\"}\"}}\n"
+    "\n"
+    "event: content_block_stop\n"
+    "data: {\"type\":\"content_block_stop\",\"index\":2}\n"
+    "\n"
+    "event: content_block_start\n"
+    "data: {\"type\":\"content_block_start\",\"index\":3,\"content_block\":"
+    "{\"type\":\"tool_use\",\"id\":\"toolu_01B\",\"name\":\"get_current_time\",\"input\":{}}}\n"
+    "\n"
+    "event: content_block_stop\n"
+    "data: {\"type\":\"content_block_stop\",\"index\":3}\n"
+    "\n"
+    "event: message_delta\n"
+    "data: {\"type\":\"message_delta\",\"delta\":{\"stop_reason\":\"tool_use\"},"
+    "\"usage\":{\"output_tokens\":87}}\n"
+    "\n"
+    "event: message_stop\n"
+    "data: {\"type\":\"message_stop\"}\n"
+    "\n";
+
+typedef struct {
+    char text[256];
+    size_t len;
+    int calls;
+} text_sink_t;
+
+static void on_text(const char *text, size_t len, void *ctx)
+{
+    text_sink_t *sink = ctx;
+    CHECK(sink->len + len < sizeof(sink->text));
+    memcpy(sink->text + sink->len, text, len);
+    sink->len += len;
+    sink->calls++;
+}
+
+/* Feed data in chunks of step bytes (0: one pseudo-random size per chunk) */
+static esp_err_t replay(const char *data, size_t len, size_t step, llm_response_t *resp,
+                        text_sink_t *sink)
+{
+    llm_stream_t s;
+    CHECK(llm_stream_init(&s, resp) == ESP_OK);
+    s.on_text = on_text;
+    s.cb_ctx = sink;
+    uint32_t rnd = 0x9e3779b9u ^ (uint32_t)len;
+    esp_err_t err = ESP_OK;
+    for (size_t off = 0; off < len && err == ESP_OK;) {
+        size_t n = step;
+        if (!n) {
+            rnd = rnd * 1103515245u + 12345u;
+            n = 1 + (rnd >> 16) % 97;
+        }
+        if (n > len - off) n = len - off;
+        err = llm_stream_feed(&s, data + off, n);
+        off += n;
+    }
+    esp_err_t fin = llm_stream_finish(&s);
+    llm_stream_free(&s);
+    return err != ESP_OK ? err : fin;
+}
+
+static char *to_crlf(const char *src)
+{
+    char *out = malloc(strlen(src) * 2 + 1);
+    char *o = out;
+    for (const char *p = src; *p; p++) {
+        if (*p == '\n') *o++ = '\r';
+        *o++ = *p;
+    }
+    *o = '\0';
+    return out;
+}
+
+static void check_response(const llm_response_t *r, const text_sink_t *sink)
+{
+    static const char expect_text[] = "Let me check \xc3\xa9t\xc3\xa9 \"both\".\n";
+    CHECK(r->text && strcmp(r->text, expect_text) == 0);
+    CHECK_EQ_INT(r->text_len, strlen(expect_text));
+    CHECK_EQ_INT(sink->len, strlen(expect_text));
+    CHECK(memcmp(sink->text, expect_text, sink->len) == 0);
+    CHECK_EQ_INT(sink->calls, 2);
+
+    CHECK(r->tool_use);
+    CHECK_EQ_INT(r->call_count, 2);
+    CHECK(strcmp(r->calls[0].id, "toolu_01A") == 0);
+    CHECK(strcmp(r->calls[0].name, "web_search") == 0);
+    CHECK(strcmp(r->calls[0].input, "{\"query\": \"Shenzhen weather\"}") == 0);
+    CHECK(strcmp(r->calls[1].name, "get_current_time") == 0);
+    CHECK(strcmp(r->calls[1].input, "{}") == 0);
+
+    CHECK_EQ_INT(r->usage.input_tokens, 12);
+    CHECK_EQ_INT(r->usage.cache_read_input_tokens, 2048);
+    CHECK_EQ_INT(r->usage.output_tokens, 87);
+
+    /* The assistant content goes back verbatim on the next tool round */
+    CHECK_EQ_INT(cJSON_GetArraySize(r->assistant_content), 4);
+    cJSON *thinking = cJSON_GetArrayItem(r->assistant_content, 0);
+    CHECK(strcmp(cJSON_GetObjectItem(thinking, "thinking")->valuestring,
+                 "Need the weather and the time.") == 0);
+    CHECK(strcmp(cJSON_GetObjectItem(thinking, "signature")->valuestring, "EqQBCgIYAhIM") == 0);
+    cJSON *tool = cJSON_GetArrayItem(r->assistant_content, 2);
+    cJSON *query = cJSON_GetObjectItem(cJSON_GetObjectItem(tool, "input"), "query");
+    CHECK(query && strcmp(query->valuestring, "Shenzhen weather") == 0);
+}
+
+static void test_every_split(void)
+{
+    char *crlf = to_crlf(s_transcript);
+    const char *variants[] = { s_transcript, crlf };
+    char *reference = NULL;
+
+    for (int v = 0; v < 2; v++) {
+        size_t len = strlen(variants[v]);
+        for (size_t step = 0; step <= 128; step++) {
+            llm_response_t resp;
+            text_sink_t sink = {0};
+            CHECK(replay(variants[v], len, step, &resp, &sink) == ESP_OK);
+            check_response(&resp, &sink);
+
+            char *json = cJSON_PrintUnformatted(resp.assistant_content);
+            if (!reference) {
+                reference = json;
+            } else {
+                CHECK(strcmp(json, reference) == 0);
+                free(json);
+            }
+            llm_response_free(&resp);
+        }
+    }
+    free(reference);
+    free(crlf);
+}
+
+static void test_cut_before_stop(void)
+{
+    const char *stop = strstr(s_transcript, "event: message_delta");
+    CHECK(stop);
+    llm_response_t resp;
+    text_sink_t sink = {0};
+    CHECK(replay(s_transcript, (size_t)(stop - s_transcript), 7, &resp, &sink) ==
+          ESP_ERR_INVALID_RESPONSE);
+    /* What arrived is still assembled */
+    CHECK_EQ_INT(resp.call_count, 2);
+    CHECK(!resp.tool_use);
+    llm_response_free(&resp);
+
+    /* A connection that died mid-block closes the open block; its partial
+     * input is not passed off as arguments */
+    const char *mid = strstr(s_transcript, "zhen weather");
+    CHECK(mid);
+    CHECK(replay(s_transcript, (size_t)(mid - s_transcript), 5, &resp, &sink) ==
+          ESP_ERR_INVALID_RESPONSE);
+    CHECK_EQ_INT(resp.call_count, 1);
+    CHECK(resp.calls[0].input_invalid && resp.calls[0].input == NULL);
+    llm_response_free(&resp);
+}
+
+static void test_error_event(void)
+{
+    static const char stream[] =
+        "event: message_start\n"
+        "data: {\"type\":\"message_start\",\"message\":{\"usage\":{\"input_tokens\":3}}}\n\n"
+        "event: error\n"
+        "data: {\"type\":\"error\",\"error\":{\"type\":\"overloaded_error\","
+        "\"message\":\"Overloaded\"}}\n\n"
+        "event: message_stop\n"
+        "data: {\"type\":\"message_stop\"}\n\n";
+    llm_stream_t s;
+    llm_response_t resp;
+    CHECK(llm_stream_init(&s, &resp) == ESP_OK);
+    CHECK(llm_stream_feed(&s, stream, sizeof(stream) - 1) == ESP_FAIL);
+    CHECK(strcmp(s.error_msg, "Overloaded") == 0);
+    CHECK(!s.got_message_stop);     /* nothing after the error is parsed */
+    CHECK(llm_stream_finish(&s) == ESP_FAIL);
+    llm_stream_free(&s);
+    llm_response_free(&resp);
+}
+
+static void test_oversized_line(void)
+{
+    /* A data line longer than the line window fails the stream: the lost
+     * event could have been text or tool input */
+    size_t big = MIMI_LLM_SSE_LINE_MAX + 100;
+    const char *head = "data: {\"type\":\"content_block_delta\",\"index\":0,\"delta\":"
+                       "{\"type\":\"text_delta\",\"text\":\"";
+    const char *start =
+        "data: {\"type\":\"message_start\",\"message\":{}}\n"
+        "data: {\"type\":\"content_block_start\",\"index\":0,\"content_block\":"
+        "{\"type\":\"text\",\"text\":\"\"}}\n";
+    const char *tail =
+        "\"}}\n"
+        "data: {\"type\":\"content_block_delta\",\"index\":0,\"delta\":"
+        "{\"type\":\"text_delta\",\"text\":\"ok\"}}\n"
+        "data: {\"type\":\"content_block_stop\",\"index\":0}\n"
+        "data: {\"type\":\"message_stop\"}\n";
+    size_t len = strlen(start) + strlen(head) + big + strlen(tail);
+    char *stream = malloc(len + 1);
+    char *p = stream;
+    p += sprintf(p, "%s%s", start, head);
+    memset(p, 'x', big);
+    p += big;
+    strcpy(p, tail);
+
+    llm_response_t resp;
+    text_sink_t sink = {0};
+    CHECK(replay(stream, len, 4096, &resp, &sink) == ESP_FAIL);
+    CHECK(resp.text == NULL || strstr(resp.text, "ok") == NULL);
+    llm_response_free(&resp);
+    free(stream);
+}
+
+static void test_bad_tool_input(void)
+{
+    static const char stream[] =
+        "data: {\"type\":\"message_start\",\"message\":{}}\n"
+        "data: {\"type\":\"content_block_start\",\"index\":0,\"content_block\":"
+        "{\"type\":\"tool_use\",\"id\":\"toolu_X\",\"name\":\"read_file\",\"input\":{}}}\n"
+        "data: {\"type\":\"content_block_delta\",\"index\":0,\"delta\":"
+        "{\"type\":\"input_json_delta\",\"partial_json\":\"{\\\"path\\\": \"}}\n"
+        "data: {\"type\":\"content_block_stop\",\"index\":0}\n"
+        "data: {\"type\":\"message_delta\",\"delta\":{\"stop_reason\":\"tool_use\"}}\n"
+        "data: {\"type\":\"message_stop\"}\n";
+    llm_response_t resp;
+    text_sink_t sink = {0};
+    /* Truncated tool input marks the call failed instead of running it
+     * with made-up arguments */
+    CHECK(replay(stream, sizeof(stream) - 1, 3, &resp, &sink) == ESP_OK);
+    CHECK_EQ_INT(resp.call_count, 1);
+    CHECK(resp.calls[0].input_invalid);
+    CHECK(resp.calls[0].input == NULL);
+    CHECK(strcmp(resp.calls[0].name, "read_file") == 0);
+    CHECK(resp.text == NULL || resp.text_len == 0);
+    llm_response_free(&resp);
+}
+
+int main(void)
+{
+    test_every_split();
+    test_cut_before_stop();
+    test_error_event();
+    test_oversized_line();
+    test_bad_tool_input();
+    printf("test_sse_replay: ok\n");
+    return 0;
+}
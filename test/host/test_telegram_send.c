@@ -0,0 +1,355 @@
+/* Telegram sender against a mock Bot API.
+ *
+ * The mock keeps each chat's visible messages (sendMessage adds, edit
+ * replaces, deleteMessage removes) and answers scripted faults: a 429 with
+ * retry_after, a 500, and a "can't parse entities" 400 for Markdown. Every
+ * chat must end up showing its replies exactly once, in order, and the
+ * attempt log must respect the per-chat burst and rate, the retry_after
+ * pause and the pipelining of a long reply's segments. */
+
+#include "host_test.h"
+#include "mock_http.h"
+#include "shim_net.h"
+
+#include "bus/message_bus.h"
+#include "proxy/conn_pool.h"
+#include "proxy/http_proxy.h"
+#include "telegram/telegram_bot.h"
+#include "mimi_config.h"
+
+#include "cJSON.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TOKEN           "123:host-test"
+#define MAX_MSGS        128
+#define MAX_ATTEMPTS    256
+#define LONG_LEN        10500
+
+typedef struct {
+    char chat[32];
+    int64_t id;
+    char *text;
+    bool markdown;
+    bool deleted;
+} tg_msg_t;
+
+typedef struct {
+    char chat[32];
+    char text_head[16];
+    int64_t at_ms;
+    int status;
+    bool edit;
+    bool markdown;
+    const void *conn;
+} tg_attempt_t;
+
+static struct {
+    pthread_mutex_t lock;
+    int64_t next_id;
+    tg_msg_t msgs[MAX_MSGS];
+    int n_msgs;
+    tg_attempt_t attempts[MAX_ATTEMPTS];
+    int n_attempts;
+    int deletes;
+    bool faulted_429, faulted_500;
+    bool pipelined;             /* first long segment saw the next one queued */
+    int64_t t0_ms;
+} s_tg = { .lock = PTHREAD_MUTEX_INITIALIZER, .next_id = 100 };
+
+static int64_t now_ms(void)
+{
+    return host_now_us() / 1000 - s_tg.t0_ms;
+}
+
+static void reply_json(mock_http_conn_t *c, int status, const char *json)
+{
+    mock_http_reply(c, status, "application/json", json, strlen(json));
+}
+
+static void tg_handler(mock_http_conn_t *c, const mock_http_req_t *req, void *ctx)
+{
+    const char *method = strrchr(req->path, '/');
+    if (strncmp(req->path, "/bot" TOKEN "/", strlen("/bot" TOKEN "/")) != 0 || !method) {
+        reply_json(c, 404, "{\"ok\":false,\"error_code\":404,\"description\":\"Not Found\"}");
+        return;
+    }
+    method++;
+    if (strncmp(method, "getUpdates", 10) == 0) {
+        usleep(50 * 1000);
+        reply_json(c, 200, "{\"ok\":true,\"result\":[]}");
+        return;
+    }
+
+    cJSON *body = cJSON_Parse(req->body);
+    CHECK(body);
+    const char *chat = cJSON_GetStringValue(cJSON_GetObjectItem(body, "chat_id"));
+    const char *text = cJSON_GetStringValue(cJSON_GetObjectItem(body, "text"));
+    cJSON *mid = cJSON_GetObjectItem(body, "message_id");
+    bool markdown = cJSON_GetObjectItem(body, "parse_mode") != NULL;
+    CHECK(chat);
+
+    /* The first segment of the long reply waits briefly for the next one:
+     * it only shows up before this response if the client pipelined */
+    if (strcmp(chat, "long") == 0 && text && strncmp(text, "Paragraph 0:", 12) == 0) {
+        for (int i = 0; i < 200 && mock_http_pending(c) == 0; i++) usleep(1000);
+        pthread_mutex_lock(&s_tg.lock);
+        s_tg.pipelined = mock_http_pending(c) > 0;
+        pthread_mutex_unlock(&s_tg.lock);
+    }
+
+    pthread_mutex_lock(&s_tg.lock);
+    char resp[256];
+    int status = 200;
+    if (strcmp(method, "deleteMessage") == 0) {
+        CHECK(cJSON_IsNumber(mid));
+        for (int i = 0; i < s_tg.n_msgs; i++) {
+            if (s_tg.msgs[i].id == (int64_t)mid->valuedouble) s_tg.msgs[i].deleted = true;
+        }
+        s_tg.deletes++;
+        snprintf(resp, sizeof(resp), "{\"ok\":true,\"result\":true}");
+    } else {
+        CHECK(text);
+        bool edit = strcmp(method, "editMessageText") == 0;
+        CHECK(edit || strcmp(method, "sendMessage") == 0);
+        if (strstr(text, "<429>") && !s_tg.faulted_429) {
+            s_tg.faulted_429 = true;
+            status = 429;
+            snprintf(resp, sizeof(resp), "{\"ok\":false,\"error_code\":429,"
+                     "\"description\":\"Too Many Requests: retry after 1\","
+                     "\"parameters\":{\"retry_after\":1}}");
+        } else if (strstr(text, "<500>") && !s_tg.faulted_500) {
+            s_tg.faulted_500 = true;
+            status = 500;
+            snprintf(resp, sizeof(resp), "{\"ok\":false,\"error_code\":500,"
+                     "\"description\":\"Internal Server Error\"}");
+        } else if (strstr(text, "<md>") && markdown) {
+            status = 400;
+            snprintf(resp, sizeof(resp), "{\"ok\":false,\"error_code\":400,\"description\":"
+                     "\"Bad Request: can't parse entities: Can't find end of the entity\"}");
+        } else if (edit) {
+            CHECK(cJSON_IsNumber(mid));
+            tg_msg_t *m = NULL;
+            for (int i = 0; i < s_tg.n_msgs; i++) {
+                if (s_tg.msgs[i].id == (int64_t)mid->valuedouble) m = &s_tg.msgs[i];
+            }
+            CHECK(m && !m->deleted && strcmp(m->chat, chat) == 0);
+            free(m->text);
+            m->text = strdup(text);
+            m->markdown = markdown;
+            snprintf(resp, sizeof(resp), "{\"ok\":true,\"result\":{\"message_id\":%lld}}",
+                     (long long)m->id);
+        } else {
+            CHECK(s_tg.n_msgs < MAX_MSGS);
+            tg_msg_t *m = &s_tg.msgs[s_tg.n_msgs++];
+            snprintf(m->chat, sizeof(m->chat), "%s", chat);
+            m->id = s_tg.next_id++;
+            m->text = strdup(text);
+            m->markdown = markdown;
+            snprintf(resp, sizeof(resp), "{\"ok\":true,\"result\":{\"message_id\":%lld,"
+                     "\"chat\":{\"id\":0},\"date\":0}}", (long long)m->id);
+        }
+
+        CHECK(s_tg.n_attempts < MAX_ATTEMPTS);
+        tg_attempt_t *a = &s_tg.attempts[s_tg.n_attempts++];
+        snprintf(a->chat, sizeof(a->chat), "%s", chat);
+        snprintf(a->text_head, sizeof(a->text_head), "%s", text);
+        a->at_ms = now_ms();
+        a->status = status;
+        a->edit = edit;
+        a->markdown = markdown;
+        a->conn = c;
+    }
+    pthread_mutex_unlock(&s_tg.lock);
+    cJSON_Delete(body);
+    reply_json(c, status, resp);
+}
+
+/* Concatenation of the chat's visible messages, oldest first; caller frees */
+static char *visible_text(const char *chat, int *count, bool *all_markdown)
+{
+    size_t len = 0;
+    pthread_mutex_lock(&s_tg.lock);
+    for (int i = 0; i < s_tg.n_msgs; i++) {
+        if (!s_tg.msgs[i].deleted && strcmp(s_tg.msgs[i].chat, chat) == 0) {
+            len += strlen(s_tg.msgs[i].text);
+        }
+    }
+    char *out = malloc(len + 1);
+    size_t off = 0;
+    *count = 0;
+    if (all_markdown) *all_markdown = true;
+    for (int i = 0; i < s_tg.n_msgs; i++) {
+        tg_msg_t *m = &s_tg.msgs[i];
+        if (m->deleted || strcmp(m->chat, chat) != 0) continue;
+        memcpy(out + off, m->text, strlen(m->text));
+        off += strlen(m->text);
+        (*count)++;
+        if (all_markdown && !m->markdown) *all_markdown = false;
+    }
+    out[off] = '\0';
+    pthread_mutex_unlock(&s_tg.lock);
+    return out;
+}
+
+static bool chat_shows(const char *chat, const char *expect, int count)
+{
+    int n;
+    char *text = visible_text(chat, &n, NULL);
+    bool ok = n == count && strcmp(text, expect) == 0;
+    free(text);
+    return ok;
+}
+
+/* Attempt times for a chat, in arrival order */
+static int chat_attempts(const char *chat, tg_attempt_t *out, int max)
+{
+    int n = 0;
+    pthread_mutex_lock(&s_tg.lock);
+    for (int i = 0; i < s_tg.n_attempts && n < max; i++) {
+        if (strcmp(s_tg.attempts[i].chat, chat) == 0) out[n++] = s_tg.attempts[i];
+    }
+    pthread_mutex_unlock(&s_tg.lock);
+    return n;
+}
+
+/* ~10 KB of balanced Markdown in short paragraphs: three segments */
+static char *long_reply(const char *marker_at_5k)
+{
+    char *s = malloc(LONG_LEN + 512);
+    size_t off = 0;
+    bool marked = false;
+    for (int p = 0; off < LONG_LEN; p++) {
+        off += (size_t)sprintf(s + off, "Paragraph %d: the *agent* called `read_file` and "
+                               "summarised the result for the user in a few plain "
+                               "sentences, keeping entities balanced. ", p);
+        if (marker_at_5k && !marked && off > 5000) {
+            off += (size_t)sprintf(s + off, "%s ", marker_at_5k);
+            marked = true;
+        }
+        off += (size_t)sprintf(s + off, "\n\n");
+    }
+    return s;
+}
+
+static bool all_delivered(const char *long_text, const char *faulty_long)
+{
+    return chat_shows("burst", "a0a1a2a3a4a5", 6) &&
+           chat_shows("limited", "<429> b0b1", 2) &&
+           chat_shows("long", long_text, 3) &&
+           chat_shows("flaky", faulty_long, 3) &&
+           chat_shows("markup", "<md> *bold* reply", 1) &&
+           chat_shows("draft", "Draft *final* text", 1);
+}
+
+int main(void)
+{
+    printf("test_telegram_send:\n");
+    s_tg.t0_ms = host_now_us() / 1000;
+
+    mock_http_t *srv = mock_http_start(tg_handler, NULL);
+    CHECK(srv);
+    shim_net_route("api.telegram.org", 0, mock_http_port(srv));
+
+    CHECK(message_bus_init() == ESP_OK);
+    CHECK(http_proxy_init() == ESP_OK);
+    CHECK(conn_pool_init() == ESP_OK);
+    CHECK(telegram_set_token(TOKEN) == ESP_OK);
+    CHECK(telegram_bot_init() == ESP_OK);
+    CHECK(telegram_bot_start() == ESP_OK);
+
+    /* Streamed draft, then the final reply replaces it in place */
+    CHECK(telegram_send_delta("draft", "Draft ") == ESP_OK);
+    CHECK(chat_shows("draft", "Draft ", 1));
+    CHECK(telegram_send_message("draft", "Draft *final* text") == ESP_OK);
+
+    char *long_text = long_reply(NULL);
+    char *faulty_long = long_reply("<500>");
+    int64_t start_ms = now_ms();
+    char t[8];
+    for (int i = 0; i < 6; i++) {
+        snprintf(t, sizeof(t), "a%d", i);
+        CHECK(telegram_send_message("burst", t) == ESP_OK);
+    }
+    CHECK(telegram_send_message("limited", "<429> b0") == ESP_OK);
+    CHECK(telegram_send_message("limited", "b1") == ESP_OK);
+    CHECK(telegram_send_message("long", long_text) == ESP_OK);
+    CHECK(telegram_send_message("flaky", faulty_long) == ESP_OK);
+    CHECK(telegram_send_message("markup", "<md> *bold* reply") == ESP_OK);
+
+    int64_t deadline = host_now_us() + 20 * 1000000;
+    while (!all_delivered(long_text, faulty_long) && host_now_us() < deadline) usleep(10 * 1000);
+    CHECK(chat_shows("draft", "Draft *final* text", 1));
+    CHECK(chat_shows("markup", "<md> *bold* reply", 1));
+    CHECK(chat_shows("limited", "<429> b0b1", 2));
+    CHECK(chat_shows("burst", "a0a1a2a3a4a5", 6));
+    CHECK(chat_shows("long", long_text, 3));
+    CHECK(chat_shows("flaky", faulty_long, 3));
+    int64_t done_ms = now_ms() - start_ms;
+
+    tg_attempt_t a[32];
+    int n;
+
+    /* Draft: plain send, then an edit carrying the Markdown final */
+    n = chat_attempts("draft", a, 32);
+    CHECK_EQ_INT(n, 2);
+    CHECK(!a[0].edit && !a[0].markdown);
+    CHECK(a[1].edit && a[1].markdown && a[1].status == 200);
+
+    /* Per-chat bucket: a burst of three, then one a second, in order */
+    n = chat_attempts("burst", a, 32);
+    CHECK_EQ_INT(n, 6);
+    for (int i = 0; i < 6; i++) {
+        snprintf(t, sizeof(t), "a%d", i);
+        CHECK(strcmp(a[i].text_head, t) == 0);
+    }
+    CHECK(a[2].at_ms - a[0].at_ms < 500);
+    for (int i = 3; i < 6; i++) CHECK(a[i].at_ms - a[i - 1].at_ms >= 900);
+
+    /* 429: nothing goes to the chat before retry_after has passed */
+    n = chat_attempts("limited", a, 32);
+    CHECK_EQ_INT(n, 3);
+    CHECK_EQ_INT(a[0].status, 429);
+    CHECK(strcmp(a[1].text_head, "<429> b0") == 0 && a[1].status == 200);
+    CHECK(a[1].at_ms - a[0].at_ms >= 950);
+    CHECK(strcmp(a[2].text_head, "b1") == 0 && a[2].at_ms >= a[1].at_ms);
+
+    /* Long reply: three Markdown segments written back to back on one connection */
+    int count;
+    bool md;
+    free(visible_text("long", &count, &md));
+    CHECK(md);
+    n = chat_attempts("long", a, 32);
+    CHECK_EQ_INT(n, 3);
+    CHECK(a[0].conn == a[1].conn && a[1].conn == a[2].conn);
+    CHECK(s_tg.pipelined);
+
+    /* A 5xx mid-window: the segment after it is taken back and resent, so
+     * the chat still reads in order */
+    n = chat_attempts("flaky", a, 32);
+    CHECK_EQ_INT(n, 5);
+    CHECK_EQ_INT(a[1].status, 500);
+    CHECK(a[3].at_ms - a[1].at_ms >= 950);
+    CHECK(s_tg.deletes >= 1);
+
+    /* Markdown rejected: the same text goes out once more without parse_mode */
+    n = chat_attempts("markup", a, 32);
+    CHECK_EQ_INT(n, 2);
+    CHECK(a[0].markdown && a[0].status == 400);
+    CHECK(!a[1].markdown && a[1].status == 200);
+
+    /* A full queue pushes back instead of growing */
+    int refused = 0;
+    for (int i = 0; i < MIMI_TG_SEND_QUEUE_LEN + 4; i++) {
+        if (telegram_send_message("backlog", "queued") == ESP_ERR_NO_MEM) refused++;
+    }
+    CHECK(refused >= 3);
+
+    printf("  %d requests, all replies delivered in %lld ms; backlog refused %d of %d\n",
+           mock_http_requests(srv), (long long)done_ms, refused, MIMI_TG_SEND_QUEUE_LEN + 4);
+    free(long_text);
+    free(faulty_long);
+    return 0;
+}
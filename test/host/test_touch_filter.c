@@ -0,0 +1,188 @@
+/* Touch filter against raw XPT2046 traces (data/touch/<name>.trace).
+ *
+ * Each stroke is replayed the way touch_task feeds it: reset at pen-down,
+ * one push per sample. Taps must settle on the contact point and ignore the
+ * garbage reading at release, a drag must follow its line through spikes
+ * without jumps, and a resting pen must come out steadier than it went in. */
+
+#include "host_test.h"
+
+#include "ui/touch_filter.h"
+
+#include <string.h>
+
+#define MAX_SAMPLES     512
+#define MAX_STROKES     8
+
+typedef struct {
+    int16_t x[MAX_SAMPLES], y[MAX_SAMPLES];
+    int n;
+} stroke_t;
+
+typedef struct {
+    stroke_t strokes[MAX_STROKES];
+    int n;
+} trace_t;
+
+static void load_trace(const char *name, trace_t *t)
+{
+    char path[512];
+    snprintf(path, sizeof(path), "%s/touch/%s", HOST_DATA_DIR, name);
+    FILE *f = fopen(path, "r");
+    CHECK(f);
+
+    memset(t, 0, sizeof(*t));
+    char line[128];
+    bool in_stroke = false;
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '#') continue;
+        int x, y;
+        if (sscanf(line, "%d %d", &x, &y) != 2) {
+            in_stroke = false;          /* pen lift */
+            continue;
+        }
+        if (!in_stroke) {
+            CHECK(t->n < MAX_STROKES);
+            t->n++;
+            in_stroke = true;
+        }
+        stroke_t *s = &t->strokes[t->n - 1];
+        CHECK(s->n < MAX_SAMPLES);
+        s->x[s->n] = (int16_t)x;
+        s->y[s->n] = (int16_t)y;
+        s->n++;
+    }
+    fclose(f);
+    CHECK(t->n > 0);
+}
+
+/* Replay one stroke; out[i] is valid where have[i] */
+static int replay(const stroke_t *s, int16_t *ox, int16_t *oy, bool *have)
+{
+    touch_filter_t f;
+    touch_filter_reset(&f);
+    int first = -1;
+    for (int i = 0; i < s->n; i++) {
+        have[i] = touch_filter_push(&f, s->x[i], s->y[i], &ox[i], &oy[i]);
+        if (have[i] && first < 0) first = i;
+    }
+    return first;
+}
+
+static int16_t median_of(const int16_t *v, int n)
+{
+    int16_t tmp[MAX_SAMPLES];
+    memcpy(tmp, v, n * sizeof(v[0]));
+    for (int i = 1; i < n; i++) {
+        for (int j = i; j > 0 && tmp[j - 1] > tmp[j]; j--) {
+            int16_t t = tmp[j];
+            tmp[j] = tmp[j - 1];
+            tmp[j - 1] = t;
+        }
+    }
+    return tmp[n / 2];
+}
+
+static int iabs(int v)
+{
+    return v < 0 ? -v : v;
+}
+
+static void test_taps(void)
+{
+    static trace_t t;
+    load_trace("tap.trace", &t);
+    int16_t ox[MAX_SAMPLES], oy[MAX_SAMPLES];
+    bool have[MAX_SAMPLES];
+    int worst_settled = 0, worst_first = 0;
+
+    for (int k = 0; k < t.n; k++) {
+        const stroke_t *s = &t.strokes[k];
+        int16_t cx = median_of(s->x, s->n), cy = median_of(s->y, s->n);
+
+        /* Nothing until the median has a majority, then every sample */
+        int first = replay(s, ox, oy, have);
+        CHECK_EQ_INT(first, TOUCH_FILTER_MIN_SAMPLES - 1);
+        for (int i = first; i < s->n; i++) CHECK(have[i]);
+
+        int d = iabs(ox[first] - cx) + iabs(oy[first] - cy);
+        if (d > worst_first) worst_first = d;
+        CHECK(d < 120);
+
+        /* Settled, including the out-of-range reading at release */
+        for (int i = TOUCH_FILTER_MEDIAN + 1; i < s->n; i++) {
+            d = iabs(ox[i] - cx) + iabs(oy[i] - cy);
+            if (d > worst_settled) worst_settled = d;
+            CHECK(d <= 16);
+        }
+    }
+    printf("  tap: %d taps, first point off by %d, settled within %d\n",
+           t.n, worst_first, worst_settled);
+}
+
+static void test_drag(void)
+{
+    static trace_t t;
+    load_trace("drag.trace", &t);
+    CHECK_EQ_INT(t.n, 1);
+    const stroke_t *s = &t.strokes[0];
+    int16_t ox[MAX_SAMPLES], oy[MAX_SAMPLES];
+    bool have[MAX_SAMPLES];
+    int first = replay(s, ox, oy, have);
+    CHECK(first >= 0);
+
+    /* The stroke runs along y = x + (y0 - x0) */
+    int offset = median_of((int16_t[]){ s->y[0] - s->x[0], s->y[1] - s->x[1],
+                                        s->y[2] - s->x[2] }, 3);
+    int step = (iabs(s->x[s->n - 1] - s->x[0]) + s->n - 2) / (s->n - 1);
+    int raw_jump = 0, out_jump = 0, off_line = 0;
+    for (int i = 1; i < s->n; i++) {
+        int rj = iabs(s->x[i] - s->x[i - 1]) + iabs(s->y[i] - s->y[i - 1]);
+        if (rj > raw_jump) raw_jump = rj;
+        if (i <= first) continue;
+        int oj = iabs(ox[i] - ox[i - 1]) + iabs(oy[i] - oy[i - 1]);
+        if (oj > out_jump) out_jump = oj;
+        int dl = iabs(oy[i] - ox[i] - offset);
+        if (dl > off_line) off_line = dl;
+    }
+    /* X and Y are filtered independently: while a spike is in the window
+     * each median moves by up to a sample on the ramp, possibly in opposite
+     * directions, so the point may leave the line by a couple of steps */
+    CHECK(out_jump <= 6 * step);
+    CHECK(off_line <= 4 * step);
+    CHECK(raw_jump > 10 * step);            /* the trace does have spikes */
+
+    /* Median of 5 plus the IIR trail by a few samples, no more */
+    int lag = iabs(s->x[s->n - 1] - ox[s->n - 1]);
+    CHECK(lag <= 5 * step);
+    printf("  drag: %d samples, raw jump %d, filtered jump %d (step %d), "
+           "off line %d, lag %d\n", s->n, raw_jump, out_jump, step, off_line, lag);
+}
+
+static void test_hold(void)
+{
+    static trace_t t;
+    load_trace("hold.trace", &t);
+    const stroke_t *s = &t.strokes[0];
+    int16_t ox[MAX_SAMPLES], oy[MAX_SAMPLES];
+    bool have[MAX_SAMPLES];
+    replay(s, ox, oy, have);
+
+    /* Sample-to-sample movement is what the user sees as a shaking cursor */
+    int raw_move = 0, out_move = 0;
+    for (int i = TOUCH_FILTER_MEDIAN + 1; i < s->n; i++) {
+        raw_move += iabs(s->x[i] - s->x[i - 1]) + iabs(s->y[i] - s->y[i - 1]);
+        out_move += iabs(ox[i] - ox[i - 1]) + iabs(oy[i] - oy[i - 1]);
+    }
+    CHECK(out_move * 3 <= raw_move);
+    printf("  hold: %d samples, raw movement %d, filtered %d\n", s->n, raw_move, out_move);
+}
+
+int main(void)
+{
+    printf("test_touch_filter:\n");
+    test_taps();
+    test_drag();
+    test_hold();
+    return 0;
+}